@@ -9,10 +9,14 @@
 #include "tflite/tflite_parser.h"
 #include "util/error_util.h"
 #include "util/file_util.h"
+#include "util/profile_util.h"
 
 namespace hannk {
 
-void run_benchmark(const std::string &filename, const InterpreterOptions &options) {
+// If profiles is not null, also profile each op of the model, and add the
+// profile to profiles.
+void run_benchmark(const std::string &filename, const InterpreterOptions &options,
+                   int profile_executions, std::vector<ModelProfile> *profiles) {
     if (!options.trace) {
         // In trace mode, don't send *anything* to stdout
         std::cout << filename;
@@ -26,11 +30,16 @@ void run_benchmark(const std::string &filename, const InterpreterOptions &option
     }
 
     Interpreter interpreter(std::move(model), options);
+    const auto prepare_start = std::chrono::steady_clock::now();
     if (!interpreter.prepare()) {
         std::cerr << "hannk::Interpreter::prepare() failed\n";
         // TODO: probably better form to return an error here, but for now, this is fine.
         exit(1);
     }
+    if (options.verbosity >= 1) {
+        const std::chrono::duration<double> prepare_time = std::chrono::steady_clock::now() - prepare_start;
+        HLOG(INFO) << "prepare() took " << prepare_time.count() * 1e6 << " us";
+    }
 
     if (!options.trace) {
         auto result = Halide::Tools::benchmark([&]() { interpreter.execute(); });
@@ -38,6 +47,10 @@ void run_benchmark(const std::string &filename, const InterpreterOptions &option
 
         halide_profiler_report(nullptr);
         halide_profiler_reset();
+
+        if (profiles) {
+            profiles->push_back({filename, interpreter.profile_ops(profile_executions)});
+        }
     } else {
         std::cout << std::endl;
         interpreter.execute();
@@ -51,6 +64,9 @@ void run_benchmark(const std::string &filename, const InterpreterOptions &option
 // from other targets where we compile the file into an executable.
 __attribute__((visibility("default"))) int main(int argc, char **argv) {
     hannk::InterpreterOptions options;
+    std::string profile_json, baseline;
+    double regression_threshold = 0.1;
+    int profile_executions = 20;
 
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "--verbose")) {
@@ -61,6 +77,89 @@ __attribute__((visibility("default"))) int main(int argc, char **argv) {
             options.trace = true;
             continue;
         }
+        if (!strcmp(argv[i], "--threads")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--threads requires a value.\n";
+                exit(1);
+            }
+            options.num_threads = atoi(argv[++i]);
+            if (options.num_threads < 1) {
+                HLOG(ERROR) << "--threads must be at least 1.\n";
+                exit(1);
+            }
+            continue;
+        }
+        if (!strcmp(argv[i], "--tile_cache_size")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--tile_cache_size requires a value.\n";
+                exit(1);
+            }
+            options.tile_cache_size = atoll(argv[++i]);
+            if (options.tile_cache_size < 0) {
+                HLOG(ERROR) << "--tile_cache_size must not be negative.\n";
+                exit(1);
+            }
+            continue;
+        }
+        if (!strcmp(argv[i], "--allocation_strategy")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--allocation_strategy requires a value.\n";
+                exit(1);
+            }
+            if (!hannk::parse_allocation_strategy(argv[++i], &options.allocation_strategy)) {
+                HLOG(ERROR) << "Unknown allocation strategy: " << argv[i] << ".\n";
+                exit(1);
+            }
+            continue;
+        }
+        if (!strcmp(argv[i], "--constant_cache_dir")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--constant_cache_dir requires a value.\n";
+                exit(1);
+            }
+            options.constant_cache_dir = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--profile_json")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--profile_json requires a value.\n";
+                exit(1);
+            }
+            profile_json = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--baseline")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--baseline requires a value.\n";
+                exit(1);
+            }
+            baseline = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--regression_threshold")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--regression_threshold requires a value.\n";
+                exit(1);
+            }
+            regression_threshold = atof(argv[++i]);
+            if (regression_threshold < 0) {
+                HLOG(ERROR) << "--regression_threshold must not be negative.\n";
+                exit(1);
+            }
+            continue;
+        }
+        if (!strcmp(argv[i], "--profile_executions")) {
+            if (i + 1 >= argc) {
+                HLOG(ERROR) << "--profile_executions requires a value.\n";
+                exit(1);
+            }
+            profile_executions = atoi(argv[++i]);
+            if (profile_executions < 1) {
+                HLOG(ERROR) << "--profile_executions must be at least 1.\n";
+                exit(1);
+            }
+            continue;
+        }
         if (argv[i][0] == '-') {
             HLOG(ERROR) << "Unknown flag: " << argv[i] << ".\n";
             exit(1);
@@ -72,11 +171,53 @@ __attribute__((visibility("default"))) int main(int argc, char **argv) {
         exit(1);
     }
 
+    const bool profile = !profile_json.empty() || !baseline.empty();
+    if (profile && options.trace) {
+        HLOG(ERROR) << "You cannot specify --trace with --profile_json or --baseline.\n";
+        exit(1);
+    }
+
+    // Read the baseline first, so a bad baseline fails before benchmarking.
+    std::vector<hannk::ModelProfile> baseline_profiles;
+    if (!baseline.empty()) {
+        std::vector<char> json = hannk::read_entire_file(baseline);
+        if (!hannk::read_profiles_json(std::string(json.begin(), json.end()), &baseline_profiles)) {
+            HLOG(ERROR) << "Unable to read the profiles in " << baseline << ".\n";
+            exit(1);
+        }
+    }
+
+    std::vector<hannk::ModelProfile> profiles;
     for (int i = 1; i < argc; i++) {
         if (!strncmp(argv[i], "--", 2)) {
+            if (!strcmp(argv[i], "--threads") || !strcmp(argv[i], "--tile_cache_size") || !strcmp(argv[i], "--allocation_strategy") ||
+                !strcmp(argv[i], "--constant_cache_dir") ||
+                !strcmp(argv[i], "--profile_json") || !strcmp(argv[i], "--baseline") ||
+                !strcmp(argv[i], "--regression_threshold") || !strcmp(argv[i], "--profile_executions")) {
+                i++;
+            }
             continue;
         }
-        hannk::run_benchmark(argv[i], options);
+        hannk::run_benchmark(argv[i], options, profile_executions, profile ? &profiles : nullptr);
+    }
+
+    if (!profile_json.empty()) {
+        std::ofstream f(profile_json);
+        hannk::write_profiles_json(f, profiles);
+        f.close();
+        if (f.fail()) {
+            HLOG(ERROR) << "Unable to write the profiles to " << profile_json << ".\n";
+            exit(1);
+        }
+    }
+
+    if (!baseline.empty()) {
+        int regressions = hannk::compare_profiles(baseline_profiles, profiles, regression_threshold, std::cout);
+        if (regressions > 0) {
+            std::cout << regressions << " ops regressed by more than " << regression_threshold * 100
+                      << "% from " << baseline << "\n";
+            exit(1);
+        }
     }
 
     std::cout << "Done!\n";
@@ -1178,6 +1178,39 @@ class NodeSupport {
         return false;
     }
 
+    // int8 tensors are converted to uint8, which can only be done for
+    // tensors quantized per-tensor, not per-channel.
+    bool InputsArePerTensorQuantized() const {
+        for (int i = 0; i < node_->inputs->size; i++) {
+            const int tensor_id = node_->inputs->data[i];
+            if (tensor_id == kTfLiteOptionalTensor) {
+                continue;
+            }
+            const TfLiteTensor &tensor = context_->tensors[tensor_id];
+            if (tensor.type != kTfLiteInt8 || tensor.quantization.type != kTfLiteAffineQuantization) {
+                continue;
+            }
+            const TfLiteAffineQuantization *q = (const TfLiteAffineQuantization *)tensor.quantization.params;
+            if (q && q->scale && q->scale->size > 1) {
+                if (verbose_) {
+                    failures_ << "The input[" << i << "] is quantized per-channel\n";
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The types supported by the conv-like ops: uint8 or int8 quantized, or float.
+    bool ConvHasCorrectTypes() const {
+        if (!(InputsHaveCorrectTypes({U8, U8, I32}) && OutputsHaveCorrectTypes({U8})) &&
+            !(InputsHaveCorrectTypes({I8, I8, I32}) && OutputsHaveCorrectTypes({I8})) &&
+            !(InputsHaveCorrectTypes({F32, F32, F32}) && OutputsHaveCorrectTypes({F32}))) {
+            return false;
+        }
+        return InputsArePerTensorQuantized();
+    }
+
     bool IsVersionOK(int min_version, int max_version) const {
         if (registration_->version < min_version || registration_->version > max_version) {
             if (verbose_) {
@@ -1380,10 +1413,10 @@ class NodeSupport {
     // }
 
     bool IsNodeSupported_Conv2d() const {
-        if (!IsVersionOK(1, 2)) {
+        if (!IsVersionOK(1, 3)) {
             return false;
         }
-        if (!InputsHaveCorrectTypes({U8, U8, I32})) {
+        if (!ConvHasCorrectTypes()) {
             return false;
         }
         const TfLiteConvParams *params = (const TfLiteConvParams *)(node_->builtin_data);
@@ -1394,10 +1427,10 @@ class NodeSupport {
     }
 
     bool IsNodeSupported_DepthwiseConv2d() const {
-        if (!IsVersionOK(1, 2)) {
+        if (!IsVersionOK(1, 3)) {
             return false;
         }
-        if (!InputsHaveCorrectTypes({U8, U8, I32})) {
+        if (!ConvHasCorrectTypes()) {
             return false;
         }
         const TfLiteDepthwiseConvParams *params = (const TfLiteDepthwiseConvParams *)(node_->builtin_data);
@@ -1408,20 +1441,31 @@ class NodeSupport {
     }
 
     bool IsNodeSupported_FullyConnected() const {
-        // This is correct, we don't handle the params for v2 or later yet
-        if (!IsVersionOK(1, 1)) {
+        // Versions 2 and later add params, which are checked below.
+        if (!IsVersionOK(1, 4)) {
             return false;
         }
         if (!(InputsHaveCorrectTypes({U8, U8, I32_OR_NONE}) && OutputsHaveCorrectTypes({U8})) &&
             // Not sure if this combination is actually expected, but models in the wild
             // require it, so we'll support it
-            !(InputsHaveCorrectTypes({U8, U8, I32_OR_NONE}) && OutputsHaveCorrectTypes({I16}))) {
+            !(InputsHaveCorrectTypes({U8, U8, I32_OR_NONE}) && OutputsHaveCorrectTypes({I16})) &&
+            !(InputsHaveCorrectTypes({I8, I8, I32_OR_NONE}) && OutputsHaveCorrectTypes({I8})) &&
+            !(InputsHaveCorrectTypes({F32, F32, F32}) && OutputsHaveCorrectTypes({F32}))) {
+            return false;
+        }
+        if (!InputsArePerTensorQuantized()) {
             return false;
         }
         const TfLiteFullyConnectedParams *params = (const TfLiteFullyConnectedParams *)(node_->builtin_data);
         if (!IsActivationReluOrNone(params->activation)) {
             return false;
         }
+        if (params->weights_format != kTfLiteFullyConnectedWeightsFormatDefault || params->keep_num_dims) {
+            if (verbose_) {
+                failures_ << "Shuffled weights and keep_num_dims are not supported\n";
+            }
+            return false;
+        }
         return true;
     }
 
@@ -1429,7 +1473,9 @@ class NodeSupport {
         if (!IsVersionOK(1, 2)) {
             return false;
         }
-        if (!InputsHaveCorrectTypes({U8})) {
+        if (!(InputsHaveCorrectTypes({U8}) && OutputsHaveCorrectTypes({U8})) &&
+            !(InputsHaveCorrectTypes({I8}) && OutputsHaveCorrectTypes({I8})) &&
+            !(InputsHaveCorrectTypes({F32}) && OutputsHaveCorrectTypes({F32}))) {
             return false;
         }
         const TfLitePoolParams *params = (const TfLitePoolParams *)(node_->builtin_data);
@@ -8,7 +8,7 @@ namespace hannk {
 int get_register_count(const Target &target) {
     switch (target.arch) {
     case Target::X86:
-        return target.features_any_of({Target::AVX512_Skylake, Target::AVX512_Cannonlake, Target::AVX512_SapphireRapids}) ? 32 : 16;
+        return target.features_any_of({Target::AVX512_Skylake, Target::AVX512_Cannonlake, Target::AVX512_Zen4, Target::AVX512_SapphireRapids}) ? 32 : 16;
     case Target::ARM:
         return target.bits == 64 ? 32 : 16;
     case Target::Hexagon:
@@ -21,7 +21,7 @@ int get_register_count(const Target &target) {
 int get_vector_reduction_factor(const Target &target, Type t) {
     if (target.arch == Target::Hexagon ||
         target.has_feature(Target::ARMDotProd) ||
-        target.has_feature(Target::AVX512_SapphireRapids)) {
+        target.features_any_of({Target::AVX512_Zen4, Target::AVX512_SapphireRapids})) {
         return 32 / t.bits();
     }
 
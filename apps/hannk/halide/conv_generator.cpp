@@ -1,5 +1,6 @@
 #include "Halide.h"
 #include "halide/common_halide.h"
+#include "halide/constants.h"
 
 using namespace Halide;
 using namespace Halide::BoundaryConditions;
@@ -16,7 +17,36 @@ Var ci("ci"), co("co");
 // without widening 8-bit multiplication, it's faster to just subtract the
 // offsets and use 16-bit multiplications.
 bool use_8bit_multiply(const Target &target) {
-    return target.arch != Target::X86 || target.has_feature(Target::AVX512_SapphireRapids);
+    return target.arch != Target::X86 ||
+           target.features_any_of({Target::AVX512_Zen4, Target::AVX512_SapphireRapids});
+}
+
+// The 8-bit dot products on x86 (VNNI) multiply unsigned 8-bit values by
+// signed 8-bit values. To use them, the tiled filter is stored offset by -128,
+// as signed 8-bit values. The filter_zero passed to the conv is still that of
+// the unsigned filter.
+bool use_signed_filter(const Target &target) {
+    return use_8bit_multiply(target) &&
+           (target.arch == Target::X86 || target.arch == Target::ARM);
+}
+
+// ARM's dot products (and widening multiplies) need both operands to have
+// the same signedness, so there the input is offset by -128 too. Symmetrically
+// quantized int8 filters are converted to uint8 with a zero of 128, so this
+// makes their zero 0 again, which lets Conv skip summing the input.
+bool use_signed_input(const Target &target) {
+    return use_signed_filter(target) && target.arch == Target::ARM;
+}
+
+// The type of the tiled filter produced by TileConvFilter for Conv.
+Type tiled_filter_type(const Target &target) {
+    if (!use_8bit_multiply(target)) {
+        return Int(16);
+    } else if (use_signed_filter(target)) {
+        return Int(8);
+    } else {
+        return UInt(8);
+    }
 }
 
 // How many registers to use as accumulators, as a function of the target.
@@ -42,7 +72,22 @@ public:
     // to load vectors, so making this value larger helps for big reductions.
     GeneratorParam<int> unroll_reduction_{"unroll_reduction", 4};
 
-    // Unsigned 8-bit input tensor, indexed by c, x, y, b.
+    // If true, the result of the conv is added to another tensor of the same
+    // shape before it is stored, like the Add generator in
+    // elementwise_generator.cpp would. This avoids storing the result of the
+    // conv, and loading it again in the add.
+    GeneratorParam<bool> fuse_add_{"fuse_add", false};
+
+    // If true, the input of the conv is the result of a depthwise conv, like
+    // the DepthwiseConv generator in depthwise_conv_generator.cpp would
+    // compute with a depth multiplier of 1. The depthwise conv is computed
+    // in tiles of the output, which avoids storing its result, and loading
+    // it again in the conv.
+    GeneratorParam<bool> fuse_depthwise_{"fuse_depthwise", false};
+
+    // Unsigned 8-bit input tensor, indexed by c, x, y, b. When fuse_depthwise
+    // is true, this is the input of the depthwise conv, and input_zero is the
+    // zero of its result.
     Input<Buffer<uint8_t, 4>> input_{"input"};
     Input<uint8_t> input_zero_{"input_zero"};
 
@@ -72,11 +117,57 @@ public:
 
     Output<Buffer<void, 4>> output_{"output"};
 
+    // When fuse_add is true, output_multiplier_ through output_max_ above
+    // describe the result of the conv before the add, and these inputs
+    // describe the add, with the same meaning as in the Add generator.
+    Input<int16_t> *conv_multiplier_ = nullptr;
+    Input<Buffer<uint8_t, 4>> *addend_ = nullptr;
+    Input<uint8_t> *addend_zero_ = nullptr;
+    Input<int16_t> *addend_multiplier_ = nullptr;
+    Input<uint8_t> *add_output_zero_ = nullptr;
+    Input<uint8_t> *add_output_min_ = nullptr;
+    Input<uint8_t> *add_output_max_ = nullptr;
+
+    // When fuse_depthwise is true, these inputs describe the depthwise conv,
+    // with the same meaning as in the DepthwiseConv generator. The zero of its
+    // result is input_zero above.
+    Input<uint8_t> *depthwise_input_zero_ = nullptr;
+    Input<Buffer<uint8_t, 3>> *depthwise_filter_ = nullptr;
+    Input<uint8_t> *depthwise_filter_zero_ = nullptr;
+    Input<Buffer<int32_t, 1>> *depthwise_bias_ = nullptr;
+    Input<int> *depthwise_stride_x_ = nullptr;
+    Input<int> *depthwise_stride_y_ = nullptr;
+    Input<int> *depthwise_dilation_x_ = nullptr;
+    Input<int> *depthwise_dilation_y_ = nullptr;
+    Input<int32_t> *depthwise_multiplier_ = nullptr;
+    Input<int32_t> *depthwise_shift_ = nullptr;
+    Input<uint8_t> *depthwise_min_ = nullptr;
+    Input<uint8_t> *depthwise_max_ = nullptr;
+
     void configure() {
-        if (use_8bit_multiply(target)) {
-            filter_.set_type(UInt(8));
-        } else {
-            filter_.set_type(Int(16));
+        filter_.set_type(tiled_filter_type(target));
+        if (fuse_add_) {
+            conv_multiplier_ = add_input<int16_t>("conv_multiplier");
+            addend_ = add_input<Buffer<uint8_t, 4>>("addend");
+            addend_zero_ = add_input<uint8_t>("addend_zero");
+            addend_multiplier_ = add_input<int16_t>("addend_multiplier");
+            add_output_zero_ = add_input<uint8_t>("add_output_zero");
+            add_output_min_ = add_input<uint8_t>("add_output_min");
+            add_output_max_ = add_input<uint8_t>("add_output_max");
+        }
+        if (fuse_depthwise_) {
+            depthwise_input_zero_ = add_input<uint8_t>("depthwise_input_zero");
+            depthwise_filter_ = add_input<Buffer<uint8_t, 3>>("depthwise_filter");
+            depthwise_filter_zero_ = add_input<uint8_t>("depthwise_filter_zero");
+            depthwise_bias_ = add_input<Buffer<int32_t, 1>>("depthwise_bias");
+            depthwise_stride_x_ = add_input<int>("depthwise_stride_x");
+            depthwise_stride_y_ = add_input<int>("depthwise_stride_y");
+            depthwise_dilation_x_ = add_input<int>("depthwise_dilation_x");
+            depthwise_dilation_y_ = add_input<int>("depthwise_dilation_y");
+            depthwise_multiplier_ = add_input<int32_t>("depthwise_multiplier");
+            depthwise_shift_ = add_input<int32_t>("depthwise_shift");
+            depthwise_min_ = add_input<uint8_t>("depthwise_min");
+            depthwise_max_ = add_input<uint8_t>("depthwise_max");
         }
     }
 
@@ -84,8 +175,44 @@ public:
         // The algorithm.
         Func input("input_wrapper");
         Expr input_cxyb = input_(c, x, y, b);
+
+        // The depthwise conv, computed exactly as DepthwiseConv does.
+        Func depthwise_filter_zeroed("depthwise_filter_zeroed");
+        Func depthwise_offset_c("depthwise_offset_c");
+        Func depthwise_convolved("depthwise_convolved");
+        RDom dr;
+        if (fuse_depthwise_) {
+            Func depthwise_sum_filter("depthwise_sum_filter");
+
+            // The input may have more channels than the depthwise filter, if
+            // they were aligned for an unfused depthwise conv.
+            Expr depthwise_channels = depthwise_filter_->dim(0).extent();
+            depthwise_filter_zeroed(c, x, y) = i16((*depthwise_filter_)(c, x, y)) - i16(*depthwise_filter_zero_);
+            dr = RDom(0, depthwise_filter_->dim(1).extent(), 0, depthwise_filter_->dim(2).extent());
+            depthwise_sum_filter(c) += i32(depthwise_filter_zeroed(c, dr.x, dr.y));
+            depthwise_offset_c(c) =
+                (*depthwise_bias_)(c) - depthwise_sum_filter(c) * i32(*depthwise_input_zero_);
+
+            Expr drx = x * *depthwise_stride_x_ + dr.x * *depthwise_dilation_x_;
+            Expr dry = y * *depthwise_stride_y_ + dr.y * *depthwise_dilation_y_;
+            depthwise_convolved(c, x, y, b) = depthwise_offset_c(c);
+            depthwise_convolved(c, x, y, b) +=
+                i32(depthwise_filter_zeroed(c, dr.x, dr.y)) * i32(input_(c, drx, dry, b));
+
+            // The conv reads channels up to the aligned depth of its filter. The
+            // filter is padded with its zero there, so it doesn't matter what
+            // the input is, but we must not read out of bounds of the depthwise
+            // inputs.
+            Expr depthwise_c = min(c, depthwise_channels - 1);
+            input_cxyb =
+                quantize_and_relu_u8(depthwise_convolved(depthwise_c, x, y, b), *depthwise_multiplier_,
+                                     *depthwise_shift_, input_zero_, *depthwise_min_, *depthwise_max_, target);
+        }
         if (!use_8bit_multiply(target)) {
             input_cxyb = i16(input_cxyb) - i16(input_zero_);
+        } else if (use_signed_input(target)) {
+            // Flipping the sign bit is the same as subtracting 128.
+            input_cxyb = i8(input_cxyb ^ 128);
         }
         input(c, x, y, b) = input_cxyb;
 
@@ -106,6 +233,13 @@ public:
         Expr input_rdxyc =
             input(r.z, x * stride_x_ + r.x * dilation_x_, y * stride_y_ + r.y * dilation_y_, b);
 
+        // The zeros of the tiled filter and of the input, which are offset like
+        // the values themselves.
+        const int filter_zero_offset = use_signed_filter(target) ? 128 : 0;
+        Expr filter_zero = i16(filter_zero_) - filter_zero_offset;
+        const int input_zero_offset = use_signed_input(target) ? 128 : 0;
+        Expr input_zero = i16(input_zero_) - input_zero_offset;
+
         Func offset_c("offset_c");
         Func sum_input("sum_input");
         Func convolved("convolved");
@@ -131,16 +265,20 @@ public:
             Expr r_size = filter_width * filter_height * filter_depth;
             // We need the negative of this reduction, so compute the sum first, and then
             // subtract it after.
-            offset_c(c) += i32(u16(filter_rdxyc) * u16(input_zero_));
+            if (use_signed_filter(target)) {
+                offset_c(c) += i32(i16(filter_rdxyc) * input_zero);
+            } else {
+                offset_c(c) += i32(u16(filter_rdxyc) * u16(input_zero_));
+            }
             offset_c(c) =
-                bias_(c) + i32(u16(filter_zero_) * u16(input_zero_)) * r_size - offset_c(c);
+                bias_(c) + i32(filter_zero) * i32(input_zero) * r_size - offset_c(c);
 
             // The sum of the input is used to compute the filter_zero * input term.
             // TODO: This is separable, but a bit messy to optimize this way.
             sum_input(x, y, b) += i32(input_rdxyc);
 
             // Finally, the terms that depend on all of c, x, y, b.
-            convolved(c, x, y, b) = offset_c(c) - i32(filter_zero_) * sum_input(x, y, b);
+            convolved(c, x, y, b) = offset_c(c) - i32(filter_zero) * sum_input(x, y, b);
         } else {
             // Without 8-bit widening multiplies, we already subtracted the offsets,
             // and just have a single reduction of 16-bit multiplies to compute.
@@ -156,6 +294,18 @@ public:
         } else {
             output = quantize_i16(convolved(c, x, y, b), output_multiplier_, output_shift_, target);
         }
+        if (fuse_add_) {
+            assert(output_.type() == halide_type_of<uint8_t>());
+            Expr conv = (i16(output) - i16(output_zero_)) << add_input_shift;
+            Expr addend = (i16((*addend_)(c, x, y, b)) - i16(*addend_zero_)) << add_input_shift;
+
+            conv = widening_mul(conv, *conv_multiplier_);
+            addend = widening_mul(addend, *addend_multiplier_);
+            output = i16_sat(rounding_shift_right(conv + addend, add_output_shift));
+
+            output = u8_sat(saturating_add(output, *add_output_zero_));
+            output = clamp(output, *add_output_min_, *add_output_max_);
+        }
         output_(c, x, y, b) = output;
 
         // Schedule
@@ -164,6 +314,12 @@ public:
         interpret_as_tensor(output_);
         require_same_min_extent(3, input_, output_);
         require_same_min_extent(0, bias_, output_);
+        if (fuse_add_) {
+            interpret_as_tensor(*addend_);
+            for (int d = 0; d < 4; d++) {
+                require_same_min_extent(d, *addend_, output_);
+            }
+        }
 
         const int filter_alignment = vector_reduction * accum_vector_size;
         filter_.set_host_alignment(filter_alignment * filter_.type().bytes());
@@ -174,11 +330,22 @@ public:
             filter_.dim(d).set_min(0).set_stride(align(filter_.dim(d).stride(), filter_alignment));
         }
 
-        const int input_alignment = unroll_reduction;
-        input_.set_host_alignment(input_alignment);
-        input_.dim(0).set_min(0).set_extent(filter_depth);
-        for (int d = 1; d < input_.dimensions(); d++) {
-            input_.dim(d).set_stride(align(input_.dim(d).stride(), input_alignment));
+        if (fuse_depthwise_) {
+            // The depthwise conv reads its input directly, so we don't need it
+            // to be padded or aligned.
+            input_.dim(0).set_min(0);
+            interpret_as_tensor(*depthwise_filter_);
+            interpret_as_tensor(*depthwise_bias_);
+            depthwise_filter_->dim(1).set_min(0);
+            depthwise_filter_->dim(2).set_min(0);
+            require_same_min_extent(0, *depthwise_filter_, *depthwise_bias_);
+        } else {
+            const int input_alignment = unroll_reduction;
+            input_.set_host_alignment(input_alignment);
+            input_.dim(0).set_min(0).set_extent(filter_depth);
+            for (int d = 1; d < input_.dimensions(); d++) {
+                input_.dim(d).set_stride(align(input_.dim(d).stride(), input_alignment));
+            }
         }
 
         output_.compute_root();
@@ -234,7 +401,10 @@ public:
 
         if (use_8bit_multiply(target)) {
             // Specialize this to avoid computing sum_input when it isn't needed.
-            convolved.specialize(filter_zero_ == 0);
+            // This is the common case for filters quantized symmetrically,
+            // including int8 filters converted to uint8 where the filter is
+            // signed (the zero is then 128, like the offset).
+            convolved.specialize(filter_zero_ == filter_zero_offset);
         }
 
         RVar rco, rci;
@@ -254,7 +424,32 @@ public:
             convolved.update().specialize(filter_depth == vector_reduction);
         }
 
-        if (!use_8bit_multiply(target) && get_target().arch == Target::X86) {
+        if (fuse_depthwise_) {
+            // Compute the depthwise conv for all the channels of each tile of
+            // x, and reuse it for all the tiles of output channels.
+            const int depthwise_vector_size = natural_vector_size<int32_t>();
+            input.compute_at(output_, xo)
+                .reorder(c, x)
+                .vectorize(c, depthwise_vector_size, TailStrategy::GuardWithIf);
+            depthwise_convolved.compute_at(input, c)
+                .vectorize(c, depthwise_vector_size, TailStrategy::GuardWithIf);
+            depthwise_convolved.update()
+                .reorder(c, x, dr.x, dr.y)
+                .vectorize(c, depthwise_vector_size, TailStrategy::GuardWithIf);
+            depthwise_convolved.update()
+                .specialize(depthwise_filter_->dim(1).extent() == 3 && depthwise_filter_->dim(2).extent() == 3)
+                .unroll(dr.x)
+                .unroll(dr.y);
+
+            // The filter and the offsets only depend on the channel, so compute
+            // them once.
+            depthwise_offset_c.compute_root()
+                .vectorize(c, depthwise_vector_size, TailStrategy::GuardWithIf);
+            depthwise_filter_zeroed.compute_root()
+                .vectorize(c, depthwise_vector_size, TailStrategy::GuardWithIf);
+        }
+
+        if (!fuse_depthwise_ && !use_8bit_multiply(target) && get_target().arch == Target::X86) {
             // On x86, widening subtracts eat up a lot of the already scarce
             // registers, so precomputing this outside the inner loop helps
             // a lot.
@@ -290,7 +485,7 @@ public:
             offset_c.compute_root()
                 .vectorize(c, accum_vector_size, TailStrategy::RoundUp);
             offset_c.update(0)
-                .specialize(input_zero_ != 0)
+                .specialize(input_zero != 0)
                 .split(r.z, rco, rci, unroll_reduction)
                 .split(c, co, c, accum_vector_size, TailStrategy::RoundUp)
                 .reorder(rci, c, rco, r.x, r.y, co)
@@ -330,11 +525,7 @@ public:
     Output<Buffer<void, 6>> output_{"output"};
 
     void configure() {
-        if (use_8bit_multiply(target)) {
-            output_.set_type(UInt(8));
-        } else {
-            output_.set_type(Int(16));
-        }
+        output_.set_type(tiled_filter_type(target));
     }
 
     void generate() {
@@ -347,7 +538,11 @@ public:
 
         Expr filter_cxyb =
             i16(input_bounded(co * vector_reduction + ci, x, y, bo * vector_tile + bi)) - i16(input_zero_);
-        output_(ci, bi, co, bo, x, y) = cast(output_.type(), filter_cxyb + output_zero_);
+        filter_cxyb += output_zero_;
+        if (use_signed_filter(target)) {
+            filter_cxyb -= 128;
+        }
+        output_(ci, bi, co, bo, x, y) = cast(output_.type(), filter_cxyb);
 
         // Schedule.
         output_.dim(0).set_min(0).set_extent(vector_reduction);
@@ -363,7 +558,156 @@ public:
     }
 };
 
+// A float version of Conv. The filter is tiled like that of Conv, but with a
+// vector reduction factor of 1.
+class ConvFloat : public Generator<ConvFloat> {
+public:
+    // How much to unroll the reduction loop over channels. The caller pads the
+    // input and the filter to a multiple of this.
+    GeneratorParam<int> unroll_reduction_{"unroll_reduction", 4};
+
+    // Float input tensor, indexed by c, x, y, b.
+    Input<Buffer<float, 4>> input_{"input"};
+
+    // A 6D array of filter coefficients indexed by 0, co % k, ci, co / k, x, y,
+    // where k = vector_size (below).
+    Input<Buffer<float, 6>> filter_{"filter"};
+
+    // A 1D array of biases, added to the c dimension of the output.
+    Input<Buffer<float, 1>> bias_{"bias"};
+
+    // These have the same meaning as they do for Conv.
+    Input<int> stride_x_{"stride_x"};
+    Input<int> stride_y_{"stride_y"};
+    Input<int> dilation_x_{"dilation_x"};
+    Input<int> dilation_y_{"dilation_y"};
+
+    Input<float> output_min_{"output_min"};
+    Input<float> output_max_{"output_max"};
+
+    Output<Buffer<float, 4>> output_{"output"};
+
+    void generate() {
+        // The algorithm.
+        const int vector_size = natural_vector_size<float>();
+
+        Expr filter_depth = align_up(filter_.dim(2).extent(), unroll_reduction_);
+        Expr filter_width = filter_.dim(4).extent();
+        Expr filter_height = filter_.dim(5).extent();
+        RDom r(0, filter_width, 0, filter_height, 0, filter_depth);
+        Expr filter_rdxyc = filter_(0, c % vector_size, r.z, c / vector_size, r.x, r.y);
+        Expr input_rdxyc =
+            input_(r.z, x * stride_x_ + r.x * dilation_x_, y * stride_y_ + r.y * dilation_y_, b);
+
+        Func convolved("convolved");
+        convolved(c, x, y, b) = bias_(c);
+        convolved(c, x, y, b) += input_rdxyc * filter_rdxyc;
+
+        output_(c, x, y, b) = clamp(convolved(c, x, y, b), output_min_, output_max_);
+
+        // Schedule
+        interpret_as_tensor(input_);
+        interpret_as_tensor(bias_);
+        interpret_as_tensor(output_);
+        require_same_min_extent(3, input_, output_);
+        require_same_min_extent(0, bias_, output_);
+
+        filter_.set_host_alignment(vector_size * sizeof(float));
+        filter_.dim(0).set_min(0).set_extent(1).set_stride(1);
+        filter_.dim(1).set_min(0).set_extent(vector_size).set_stride(1);
+        filter_.dim(2).set_min(0).set_stride(vector_size);
+        for (int d = 3; d < filter_.dimensions(); d++) {
+            filter_.dim(d).set_min(0).set_stride(align(filter_.dim(d).stride(), vector_size));
+        }
+
+        input_.dim(0).set_min(0).set_extent(filter_depth);
+
+        output_.compute_root();
+
+        // Tile the output like Conv does, but without the registers that
+        // Conv needs for the 8-bit inputs.
+        const int accumulators = get_accumulator_count(target);
+        std::vector<std::pair<int, int>> tile_sizes;
+        const int max_tile_c = 4;
+        for (int tile_c = max_tile_c; tile_c >= 1; tile_c /= 2) {
+            int tile_x = std::min(8, accumulators / tile_c);
+            tile_sizes.emplace_back(tile_c, tile_x);
+        }
+        tile_sizes.emplace_back(max_tile_c, 1);
+
+        Var xo("xo");
+        Expr output_channels = output_.dim(0).extent();
+        Expr output_width = output_.dim(1).extent();
+        for (auto i : tile_sizes) {
+            const int tile_c = i.first;
+            const int tile_x = i.second;
+            output_
+                .specialize(output_channels % (tile_c * vector_size) == 0 && output_width >= tile_x)
+                .split(c, co, c, tile_c * vector_size, TailStrategy::RoundUp)
+                .split(x, xo, x, tile_x, TailStrategy::ShiftInwards)
+                .reorder(x, c, co, xo, y, b)
+                .vectorize(c)
+                .unroll(x);
+        }
+
+        output_
+            .split(c, co, c, vector_size, TailStrategy::PredicateStores)
+            .split(x, xo, x, 1)
+            .reorder(c, x, co, xo, y, b)
+            .vectorize(c);
+
+        convolved.compute_at(output_, co)
+            .store_in(MemoryType::Stack)
+            .reorder(x, c)
+            .vectorize(c, vector_size, TailStrategy::RoundUp)
+            .unroll(c, max_tile_c, TailStrategy::GuardWithIf)
+            .unroll(x);
+
+        RVar rco, rci;
+        convolved.update()
+            .split(r.z, rco, rci, unroll_reduction_)
+            .reorder(c, x, rci, rco, r.x, r.y)
+            .vectorize(c, vector_size, TailStrategy::RoundUp)
+            .unroll(c, max_tile_c, TailStrategy::GuardWithIf)
+            .unroll(rci)
+            .unroll(x);
+
+        bias_.in().compute_root().store_in(MemoryType::Stack);
+    }
+};
+
+// Tile a float filter for ConvFloat.
+class TileConvFilterFloat : public Generator<TileConvFilterFloat> {
+public:
+    Input<Buffer<float, 4>> input_{"input"};
+
+    // 6D array of filter coefficients indexed by 0, co % k, ci, co / k, x, y,
+    // where k = vector_tile (below).
+    Output<Buffer<float, 6>> output_{"output"};
+
+    void generate() {
+        Func input_bounded = constant_exterior(input_, 0.0f);
+
+        const int vector_tile = natural_vector_size<float>();
+
+        Var bi("bi"), bo("bo");
+        output_(ci, bi, co, bo, x, y) = input_bounded(co + ci, x, y, bo * vector_tile + bi);
+
+        // Schedule.
+        output_.dim(0).set_min(0).set_extent(1);
+        output_.dim(1).set_min(0).set_extent(vector_tile).set_stride(1);
+        output_.dim(2).set_min(0).set_stride(vector_tile);
+
+        output_
+            .compute_root()
+            .reorder(ci, bi, bo, x, y, co)
+            .vectorize(bi);
+    }
+};
+
 }  // namespace hannk
 
 HALIDE_REGISTER_GENERATOR(hannk::Conv, Conv)
 HALIDE_REGISTER_GENERATOR(hannk::TileConvFilter, TileConvFilter)
+HALIDE_REGISTER_GENERATOR(hannk::ConvFloat, ConvFloat)
+HALIDE_REGISTER_GENERATOR(hannk::TileConvFilterFloat, TileConvFilterFloat)
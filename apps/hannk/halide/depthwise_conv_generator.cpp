@@ -238,27 +238,146 @@ public:
     }
 };
 
+// A float version of DepthwiseConv, for depth_multiplier = 1. Other depth
+// multipliers are handled by resampling the input with UpsampleChannels first.
+class DepthwiseConvFloat : public Generator<DepthwiseConvFloat> {
+public:
+    // Float input tensor, indexed by c, x, y, b.
+    Input<Buffer<float, 4>> input_{"input"};
+
+    // A 3D array of filter coefficients indexed by c, x, y.
+    Input<Buffer<float, 3>> filter_{"filter"};
+
+    // A 1D array of biases indexed by c.
+    Input<Buffer<float, 1>> bias_{"bias"};
+
+    // These have the same meaning as they do for DepthwiseConv.
+    Input<int> stride_x_{"stride_x"};
+    Input<int> stride_y_{"stride_y"};
+    Input<int> dilation_x_{"dilation_x"};
+    Input<int> dilation_y_{"dilation_y"};
+
+    Input<float> output_min_{"output_min"};
+    Input<float> output_max_{"output_max"};
+
+    Output<Buffer<float, 4>> output_{"output"};
+
+    void generate() {
+        // The algorithm.
+        const int vector_size = natural_vector_size<float>();
+
+        Var x("x"), y("y"), c("c"), b("b");
+
+        Func filter_bounded("filter_bounded");
+        Func bias_bounded("bias_bounded");
+        filter_bounded(c, x, y) = filter_(c, x, y);
+        bias_bounded(c) = bias_(c);
+
+        filter_.dim(1).set_min(0);
+        filter_.dim(2).set_min(0);
+        Expr filter_width = filter_.dim(1).extent();
+        Expr filter_height = filter_.dim(2).extent();
+        RDom r(0, filter_width, 0, filter_height);
+        Expr rx = x * stride_x_ + r.x * dilation_x_;
+        Expr ry = y * stride_y_ + r.y * dilation_y_;
+
+        Func convolved("convolved");
+        convolved(c, x, y, b) = bias_bounded(c);
+        convolved(c, x, y, b) += filter_bounded(c, r.x, r.y) * input_(c, rx, ry, b);
+
+        output_(c, x, y, b) = clamp(convolved(c, x, y, b), output_min_, output_max_);
+
+        // Schedule.
+        interpret_as_tensor(input_);
+        interpret_as_tensor(filter_);
+        interpret_as_tensor(bias_);
+        interpret_as_tensor(output_);
+        require_same_min_extent(3, input_, output_);
+        require_same_min_extent(0, output_, bias_);
+        require_same_min_extent(0, output_, filter_);
+
+        // Require the input to be aligned, as DepthwiseConv does.
+        const int input_alignment = vector_size;
+        input_.set_host_alignment(input_alignment * sizeof(float));
+        for (int d = 1; d < input_.dimensions(); d++) {
+            input_.dim(d).set_stride(align(input_.dim(d).stride(), input_alignment));
+        }
+
+        // This is scheduled like the non-shallow case of DepthwiseConv.
+        const int kTileW = 2;
+        const int kTileH = 2;
+        const int kMinTiles = 4;
+        Var xo("xo"), yo("yo"), co("co");
+        Expr output_width = output_.dim(1).extent();
+        Expr output_height = output_.dim(2).extent();
+        Expr use_tiles =
+            (output_width >= kTileW * kMinTiles || output_width % kTileW == 0) &&
+            (output_height >= kTileH * kMinTiles || output_height % kTileH == 0);
+        output_.compute_root()
+            .specialize(use_tiles)
+            .tile(x, y, xo, yo, x, y, kTileW, kTileH, TailStrategy::ShiftInwards)
+            .split(c, co, c, vector_size, TailStrategy::PredicateStores)
+            .reorder(x, y, c, xo, yo, b, co)
+            .unroll(x)
+            .unroll(y)
+            .vectorize(c);
+
+        output_
+            .tile(x, y, xo, yo, x, y, 1, 1)
+            .split(c, co, c, vector_size, TailStrategy::PredicateStores)
+            .reorder(x, y, c, xo, yo, b, co)
+            .unroll(x)
+            .unroll(y)
+            .vectorize(c);
+
+        convolved.compute_at(output_, xo)
+            .store_in(MemoryType::Register)
+            .bound_extent(c, vector_size)
+            .unroll(x)
+            .unroll(y)
+            .vectorize(c);
+        convolved.update()
+            .reorder(x, y, r.x, r.y)
+            .unroll(x)
+            .unroll(y)
+            .vectorize(c);
+        convolved.update()
+            .specialize(filter_width == 3 && filter_height == 3)
+            .unroll(r.x)
+            .unroll(r.y);
+
+        filter_bounded.compute_at(output_, co)
+            .store_in(MemoryType::Stack)
+            .align_storage(c, vector_size)
+            .vectorize(c, vector_size, TailStrategy::PredicateLoads);
+
+        bias_bounded.compute_at(output_, co)
+            .store_in(MemoryType::Stack)
+            .vectorize(c, vector_size, TailStrategy::PredicateLoads);
+    }
+};
+
 // A generator to resample the channels of a buffer. This is used to
 // implement depth_multiplier != 1 for DepthwiseConv above if the
 // depth_multiplier is too small to use the broadcasting version.
 class UpsampleChannels : public Generator<UpsampleChannels> {
 public:
-    // Unsigned 8-bit input tensor, indexed by ci, x, y, b.
-    Input<Buffer<uint8_t, 4>> input_{"input"};
+    // Input tensor, indexed by ci, x, y, b.
+    Input<Buffer<void, 4>> input_{"input"};
 
     // The depth multiplier specifies the ratio between co and ci.
     Input<int> factor_{"factor"};
 
-    // Unsigned 8-bit output tensor, indexed by co, x, y, b.
-    Output<Buffer<uint8_t, 4>> output_{"output"};
+    // Output tensor of the same type as the input, indexed by co, x, y, b.
+    Output<Buffer<void, 4>> output_{"output"};
 
     void generate() {
         Var x("x"), y("y"), c("c"), b("b");
-        output_(c, x, y, b) = input_(c / factor_, x, y, b);
+        output_(c, x, y, b) = cast(output_.type(), input_(c / factor_, x, y, b));
 
         require_same_min_extent(3, input_, output_);
 
-        const int vector_size = natural_vector_size<uint8_t>();
+        const int vector_size = natural_vector_size(output_.type());
 
         output_.compute_root()
             .vectorize(c, vector_size, TailStrategy::Predicate);
@@ -272,4 +391,5 @@ public:
 }  // namespace hannk
 
 HALIDE_REGISTER_GENERATOR(hannk::DepthwiseConv, DepthwiseConv)
+HALIDE_REGISTER_GENERATOR(hannk::DepthwiseConvFloat, DepthwiseConvFloat)
 HALIDE_REGISTER_GENERATOR(hannk::UpsampleChannels, UpsampleChannels)
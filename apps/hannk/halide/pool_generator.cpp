@@ -154,7 +154,126 @@ public:
     }
 };
 
+class AveragePoolFloat : public Generator<AveragePoolFloat> {
+public:
+    // Float input tensor, indexed by c, x, y, b.
+    Input<Buffer<float, 4>> input_{"input"};
+
+    // These have the same meaning as they do for AveragePool.
+    Input<int> stride_x_{"stride_x"};
+    Input<int> stride_y_{"stride_y"};
+    Input<int> filter_width_{"filter_width"};
+    Input<int> filter_height_{"filter_height"};
+
+    Input<float> output_min_{"output_min"};
+    Input<float> output_max_{"output_max"};
+
+    Output<Buffer<float, 4>> output_{"output"};
+
+    void generate() {
+        // The algorithm.
+        Var c("c"), x("x"), y("y"), b("b");
+
+        Expr min_x = input_.dim(1).min();
+        Expr max_x = input_.dim(1).max();
+        Expr min_y = input_.dim(2).min();
+        Expr max_y = input_.dim(2).max();
+
+        // See AveragePool for why this uses a clamp and a where clause.
+        Func input_bounded("input_bounded");
+        input_bounded(c, x, y, b) =
+            input_(c, clamp(x, min_x, max_x), clamp(y, min_y, max_y), b);
+
+        RDom r(0, filter_width_, 0, filter_height_);
+        Expr x_rx = x * stride_x_ + r.x;
+        Expr y_ry = y * stride_y_ + r.y;
+        r.where(min_x <= x_rx && x_rx <= max_x && min_y <= y_ry && y_ry <= max_y);
+
+        Func sum("sum");
+        sum(c, x, y, b) += input_bounded(c, x_rx, y_ry, b);
+
+        Expr x_start = max(x * stride_x_, min_x);
+        Expr x_end = min(x * stride_x_ + filter_width_, max_x + 1);
+        Expr y_start = max(y * stride_y_, min_y);
+        Expr y_end = min(y * stride_y_ + filter_height_, max_y + 1);
+        Expr filter_count = (x_end - x_start) * (y_end - y_start);
+        Expr average = sum(c, x, y, b) / cast<float>(filter_count);
+
+        output_(c, x, y, b) = clamp(average, output_min_, output_max_);
+
+        // Schedule.
+        require_same_min_extent(0, input_, output_);
+        require_same_min_extent(3, input_, output_);
+
+        output_.compute_root()
+            .reorder(c, b, x, y);
+
+        const int vector_size = natural_vector_size<float>();
+        Expr output_channels = output_.dim(0).extent();
+        for (int i : {4, 2, 1}) {
+            output_.specialize(output_channels >= vector_size * i)
+                .vectorize(c, vector_size * i, TailStrategy::ShiftInwards);
+        }
+    }
+};
+
+class MaxPoolFloat : public Generator<MaxPoolFloat> {
+public:
+    // Float input tensor, indexed by c, x, y, b.
+    Input<Buffer<float, 4>> input_{"input"};
+
+    // These have the same meaning as they do for MaxPool.
+    Input<int> stride_x_{"stride_x"};
+    Input<int> stride_y_{"stride_y"};
+    Input<int> filter_width_{"filter_width"};
+    Input<int> filter_height_{"filter_height"};
+
+    Input<float> output_min_{"output_min"};
+    Input<float> output_max_{"output_max"};
+
+    Output<Buffer<float, 4>> output_{"output"};
+
+    void generate() {
+        // The algorithm.
+        Var c("c"), x("x"), y("y"), b("b");
+
+        Expr min_x = input_.dim(1).min();
+        Expr max_x = input_.dim(1).max();
+        Expr min_y = input_.dim(2).min();
+        Expr max_y = input_.dim(2).max();
+
+        Func input_bounded("input_bounded");
+        input_bounded(c, x, y, b) =
+            input_(c, clamp(x, min_x, max_x), clamp(y, min_y, max_y), b);
+
+        Func maximum("maximum");
+        RDom r(0, filter_width_, 0, filter_height_);
+        Expr x_rx = x * stride_x_ + r.x;
+        Expr y_ry = y * stride_y_ + r.y;
+        r.where(min_x <= x_rx && x_rx <= max_x && min_y <= y_ry && y_ry <= max_y);
+        maximum(c, x, y, b) = output_min_;
+        maximum(c, x, y, b) = max(maximum(c, x, y, b), input_bounded(c, x_rx, y_ry, b));
+
+        output_(c, x, y, b) = min(maximum(c, x, y, b), output_max_);
+
+        // Schedule.
+        require_same_min_extent(0, input_, output_);
+        require_same_min_extent(3, input_, output_);
+
+        output_.compute_root();
+
+        const int vector_size = natural_vector_size<float>();
+        Expr output_channels = output_.dim(0).extent();
+        for (int i : {4, 2, 1}) {
+            output_.specialize(output_channels >= vector_size * i)
+                .vectorize(c, vector_size * i, TailStrategy::ShiftInwards);
+        }
+    }
+};
+
 }  // namespace hannk
 
 HALIDE_REGISTER_GENERATOR(hannk::AveragePool, AveragePool)
 HALIDE_REGISTER_GENERATOR(hannk::MaxPool, MaxPool)
+HALIDE_REGISTER_GENERATOR(hannk::AveragePoolFloat, AveragePoolFloat)
+HALIDE_REGISTER_GENERATOR(hannk::MaxPoolFloat, MaxPoolFloat)
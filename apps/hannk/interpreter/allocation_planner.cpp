@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -22,10 +23,31 @@ size_t align_up(size_t p, size_t alignment) {
 
 constexpr size_t kInvalidOffset = std::numeric_limits<size_t>::max();
 
+// AllocationStrategy::Smallest only searches for an exact layout with at
+// most this many blocks, and every exact search gives up after this many
+// steps.
+constexpr size_t kMaxExactBlocks = 32;
+constexpr int64_t kMaxExactSteps = 100000;
+
 }  // namespace
 
-AllocationPlanner::AllocationPlanner(size_t alignment)
-    : alignment_(alignment) {
+bool parse_allocation_strategy(const std::string &name, AllocationStrategy *strategy) {
+    if (name == "first_fit") {
+        *strategy = AllocationStrategy::FirstFit;
+    } else if (name == "best_fit") {
+        *strategy = AllocationStrategy::BestFit;
+    } else if (name == "exact") {
+        *strategy = AllocationStrategy::Exact;
+    } else if (name == "smallest") {
+        *strategy = AllocationStrategy::Smallest;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+AllocationPlanner::AllocationPlanner(size_t alignment, AllocationStrategy strategy)
+    : alignment_(alignment), strategy_(strategy) {
 }
 
 int AllocationPlanner::add_block(size_t size, int first_use, int last_use) {
@@ -60,6 +82,52 @@ void AllocationPlanner::commit() {
 
 #else
 
+    switch (strategy_) {
+    case AllocationStrategy::FirstFit:
+        plan_first_fit();
+        break;
+    case AllocationStrategy::BestFit:
+        plan_best_fit();
+        break;
+    case AllocationStrategy::Exact:
+        plan_smaller_fit();
+        plan_exact(kMaxExactSteps);
+        break;
+    case AllocationStrategy::Smallest:
+        plan_smaller_fit();
+        if (block_requirements_.size() <= kMaxExactBlocks) {
+            plan_exact(kMaxExactSteps);
+        }
+        break;
+    }
+
+#endif  // HANNK_USE_TRIVIAL_ALLOCATION_PLANNER
+
+#ifndef NDEBUG
+    if (!check_overlap()) {
+        abort();
+    }
+#endif
+}
+
+void AllocationPlanner::clear_offsets() {
+    for (auto &r : block_requirements_) {
+        r.calculated_offset = kInvalidOffset;
+    }
+}
+
+size_t AllocationPlanner::layout_size() const {
+    size_t needed = 0;
+    for (const auto &br : block_requirements_) {
+        assert(br.calculated_offset != kInvalidOffset);
+        needed = std::max(needed, br.calculated_offset + br.size_needed);
+    }
+    return needed;
+}
+
+void AllocationPlanner::plan_first_fit() {
+    clear_offsets();
+
     // Use a basic greedy algorithm to lay out the buffers;
     // the basic idea here is to start with the largest block,
     // then progress into smaller blocks, picking out the first large-enough
@@ -165,21 +233,187 @@ void AllocationPlanner::commit() {
             offsets.push_back(req);
         }
     }
-#endif  // HANNK_USE_TRIVIAL_ALLOCATION_PLANNER
+}
 
-#ifndef NDEBUG
-    check_overlap();
-#endif
+void AllocationPlanner::plan_best_fit() {
+    clear_offsets();
+
+    // Like plan_first_fit(), place the blocks from largest to smallest, but
+    // put each one in the smallest gap it fits in, rather than the lowest,
+    // which leaves the bigger gaps for the blocks that need them.
+    std::vector<BlockRequirements *> sorted;
+    sorted.reserve(block_requirements_.size());
+    for (auto &r : block_requirements_) {
+        sorted.push_back(&r);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](BlockRequirements *a, BlockRequirements *b) -> bool {
+        if (a->size_needed != b->size_needed) {
+            return a->size_needed > b->size_needed;
+        }
+        return a->first_use < b->first_use;
+    });
+
+    std::vector<const BlockRequirements *> placed;
+    std::vector<const BlockRequirements *> overlapping;
+    for (BlockRequirements *req : sorted) {
+        // The placed blocks that are live at the same time as req, by offset.
+        overlapping.clear();
+        for (const BlockRequirements *p : placed) {
+            if (overlaps_in_time(*p, *req)) {
+                overlapping.push_back(p);
+            }
+        }
+        std::sort(overlapping.begin(), overlapping.end(), [](const BlockRequirements *a, const BlockRequirements *b) {
+            return a->calculated_offset < b->calculated_offset;
+        });
+
+        size_t best_offset = kInvalidOffset;
+        size_t best_gap = kInvalidOffset;
+        size_t candidate_offset = 0;
+        for (const BlockRequirements *p : overlapping) {
+            if (p->calculated_offset >= candidate_offset) {
+                const size_t gap = p->calculated_offset - candidate_offset;
+                if (gap >= req->size_needed && gap < best_gap) {
+                    best_gap = gap;
+                    best_offset = candidate_offset;
+                }
+            }
+            candidate_offset = std::max(candidate_offset, align_up(p->calculated_offset + p->size_needed, alignment_));
+        }
+        // If no gap is big enough, put it above everything that overlaps it.
+        req->calculated_offset = best_offset != kInvalidOffset ? best_offset : candidate_offset;
+        placed.push_back(req);
+    }
+}
+
+void AllocationPlanner::plan_smaller_fit() {
+    plan_first_fit();
+    std::vector<size_t> first_fit_offsets;
+    first_fit_offsets.reserve(block_requirements_.size());
+    for (const auto &r : block_requirements_) {
+        first_fit_offsets.push_back(r.calculated_offset);
+    }
+    const size_t first_fit_size = layout_size();
+    plan_best_fit();
+    if (first_fit_size < layout_size()) {
+        for (size_t i = 0; i < block_requirements_.size(); i++) {
+            block_requirements_[i].calculated_offset = first_fit_offsets[i];
+        }
+    }
+}
+
+size_t AllocationPlanner::lowest_fit(const BlockRequirements &req, const std::vector<const BlockRequirements *> &placed) const {
+    size_t candidate_offset = 0;
+    for (const BlockRequirements *p : placed) {
+        if (!overlaps_in_time(*p, req)) {
+            continue;
+        }
+        if (candidate_offset + req.size_needed <= p->calculated_offset) {
+            break;
+        }
+        candidate_offset = std::max(candidate_offset, align_up(p->calculated_offset + p->size_needed, alignment_));
+    }
+    return candidate_offset;
+}
+
+void AllocationPlanner::plan_exact(int64_t max_steps) {
+    // Any layout can be made by placing the blocks in some order, each at the
+    // lowest offset that doesn't overlap the blocks placed before it (take the
+    // blocks in order of their offsets in that layout; each one lands at or
+    // below where it was). So searching over the orders finds the smallest
+    // layout. This is exponential, so stop after max_steps placements, and
+    // keep the best layout found, starting from the current one.
+    const int n = (int)block_requirements_.size();
+    const size_t bound = lower_bound();
+    size_t best_size = layout_size();
+    std::vector<size_t> best_offsets(n);
+    for (int i = 0; i < n; i++) {
+        best_offsets[i] = block_requirements_[i].calculated_offset;
+    }
+
+    std::vector<bool> is_placed(n, false);
+    std::vector<const BlockRequirements *> placed;
+    int64_t steps = 0;
+    bool gave_up = false;
+
+    std::function<void(size_t)> search = [&](size_t size_so_far) {
+        if ((int)placed.size() == n) {
+            best_size = size_so_far;
+            for (int i = 0; i < n; i++) {
+                best_offsets[i] = block_requirements_[i].calculated_offset;
+            }
+            return;
+        }
+        for (int i = 0; i < n && best_size > bound; i++) {
+            if (is_placed[i]) {
+                continue;
+            }
+            BlockRequirements &req = block_requirements_[i];
+            // Blocks that are the same size and live at the same time are
+            // interchangeable, so only try the first one that is left.
+            bool duplicate = false;
+            for (int j = 0; j < i; j++) {
+                const BlockRequirements &other = block_requirements_[j];
+                if (!is_placed[j] && other.size_needed == req.size_needed &&
+                    other.first_use == req.first_use && other.last_use == req.last_use) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (duplicate) {
+                continue;
+            }
+            if (++steps > max_steps) {
+                gave_up = true;
+                return;
+            }
+
+            req.calculated_offset = lowest_fit(req, placed);
+            const size_t new_size = std::max(size_so_far, req.calculated_offset + req.size_needed);
+            if (new_size < best_size) {
+                auto pos = std::upper_bound(placed.begin(), placed.end(), &req,
+                                            [](const BlockRequirements *a, const BlockRequirements *b) {
+                                                return a->calculated_offset < b->calculated_offset;
+                                            });
+                placed.insert(pos, &req);
+                is_placed[i] = true;
+                search(new_size);
+                is_placed[i] = false;
+                placed.erase(std::find(placed.begin(), placed.end(), &req));
+            }
+            req.calculated_offset = kInvalidOffset;
+            if (gave_up) {
+                return;
+            }
+        }
+    };
+    clear_offsets();
+    search(0);
+
+    for (int i = 0; i < n; i++) {
+        block_requirements_[i].calculated_offset = best_offsets[i];
+    }
 }
 
 size_t AllocationPlanner::memory_needed() const {
     assert(committed_);
-    size_t needed = 0;
-    for (const auto &br : block_requirements_) {
-        assert(br.calculated_offset != kInvalidOffset);
-        needed = std::max(needed, br.calculated_offset + br.size_needed);
+    return layout_size();
+}
+
+size_t AllocationPlanner::lower_bound() const {
+    // The most bytes live at any one time. Blocks only start or stop being
+    // live at a first_use, so those are the only times we need to check.
+    size_t result = 0;
+    for (const auto &a : block_requirements_) {
+        size_t live = 0;
+        for (const auto &b : block_requirements_) {
+            if (b.first_use <= a.first_use && a.first_use <= b.last_use) {
+                live += b.size_needed;
+            }
+        }
+        result = std::max(result, live);
     }
-    return needed;
+    return result;
 }
 
 size_t AllocationPlanner::get_block_offset(int block_id) const {
@@ -254,8 +488,7 @@ void AllocationPlanner::dump(std::ostream &o) {
     }
 }
 
-void AllocationPlanner::check_overlap() {
-#ifndef NDEBUG
+bool AllocationPlanner::check_overlap() const {
     assert(committed_);
     bool ok = true;
     for (size_t i = 0; i < block_requirements_.size(); ++i) {
@@ -278,10 +511,7 @@ void AllocationPlanner::check_overlap() {
             ok = false;
         }
     }
-    if (!ok) {
-        abort();
-    }
-#endif
+    return ok;
 }
 
 }  // namespace hannk
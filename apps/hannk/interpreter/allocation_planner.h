@@ -1,17 +1,41 @@
 #ifndef HANNK_MEMORY_PLANNER_H
 #define HANNK_MEMORY_PLANNER_H
 
+#include <cstdint>
 #include <iostream>
+#include <string>
 #include <vector>
 
 namespace hannk {
 
+// How AllocationPlanner lays out the blocks.
+enum class AllocationStrategy {
+    // Place the blocks from largest to smallest, each in the lowest gap
+    // it fits in.
+    FirstFit,
+    // Place the blocks from largest to smallest, each in the smallest gap
+    // it fits in.
+    BestFit,
+    // Search for the smallest layout, starting from the smaller of the
+    // FirstFit and BestFit layouts. The search is exponential in the number
+    // of blocks, so it gives up after a fixed number of steps, keeping the
+    // best layout found so far.
+    Exact,
+    // Use the smaller of the FirstFit and BestFit layouts, and then the Exact
+    // search if there are few enough blocks.
+    Smallest,
+};
+
+// Parse the name of an AllocationStrategy: "first_fit", "best_fit", "exact"
+// or "smallest". Return false if it isn't one of those.
+bool parse_allocation_strategy(const std::string &name, AllocationStrategy *strategy);
+
 // AllocationPlanner is used to plan a series of allocations in which we can
 // overlap blocks that don't have any lifespan in common.
 class AllocationPlanner {
 public:
     // All blocks allocated will be aligned to (at least) this amount.
-    explicit AllocationPlanner(size_t alignment);
+    explicit AllocationPlanner(size_t alignment, AllocationStrategy strategy = AllocationStrategy::Smallest);
 
     // Specify a block's size and lifetime. Return an id for the block, which will later
     // be used to retrieve the final layout info via get_block_offset(). Note that -- by design! --
@@ -29,10 +53,18 @@ public:
     // It is an error to call this before commit().
     size_t memory_needed() const;
 
+    // The most memory live at any one time, which no layout can be smaller than.
+    size_t lower_bound() const;
+
     // Calculated layout offset for the nth block added to the planner.
     // It is an error to call this before commit().
     size_t get_block_offset(int block_id) const;
 
+    // Check that no two blocks that are live at the same time overlap, and
+    // print any that do to stderr. Return true if there are none.
+    // It is an error to call this before commit().
+    bool check_overlap() const;
+
     // Dump details about the allocation to the given stream, along
     // with an ASCII usage map.
     void dump(std::ostream &o);
@@ -46,6 +78,7 @@ public:
 
 private:
     size_t alignment_ = 1;
+    AllocationStrategy strategy_;
 
     struct BlockRequirements {
         size_t calculated_offset;
@@ -57,7 +90,25 @@ private:
 
     bool committed_ = false;
 
-    void check_overlap();
+    static bool overlaps_in_time(const BlockRequirements &a, const BlockRequirements &b) {
+        return !(a.first_use > b.last_use || b.first_use > a.last_use);
+    }
+
+    // The size of the current layout.
+    size_t layout_size() const;
+    void clear_offsets();
+
+    // Each of these computes a new layout (see AllocationStrategy).
+    void plan_first_fit();
+    void plan_best_fit();
+    // The smaller of the FirstFit and BestFit layouts.
+    void plan_smaller_fit();
+    // This starts from the current layout, which must be complete.
+    void plan_exact(int64_t max_steps);
+
+    // The lowest offset at which req doesn't overlap any of the blocks
+    // placed, which must be sorted by offset.
+    size_t lowest_fit(const BlockRequirements &req, const std::vector<const BlockRequirements *> &placed) const;
 };
 
 }  // namespace hannk
@@ -0,0 +1,170 @@
+#include "interpreter/allocation_planner.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace hannk;
+
+namespace {
+
+struct Block {
+    size_t size;
+    int first_use;
+    int last_use;
+};
+
+struct BlockSet {
+    std::string name;
+    size_t alignment;
+    std::vector<Block> blocks;
+};
+
+const AllocationStrategy strategies[] = {
+    AllocationStrategy::FirstFit,
+    AllocationStrategy::BestFit,
+    AllocationStrategy::Exact,
+    AllocationStrategy::Smallest,
+};
+
+const char *strategy_name(AllocationStrategy strategy) {
+    switch (strategy) {
+    case AllocationStrategy::FirstFit:
+        return "first_fit";
+    case AllocationStrategy::BestFit:
+        return "best_fit";
+    case AllocationStrategy::Exact:
+        return "exact";
+    case AllocationStrategy::Smallest:
+        return "smallest";
+    }
+    return "unknown";
+}
+
+// Plan the blocks with the given strategy, check the layout, and put the
+// memory it needs in result. Return false if the layout is wrong.
+bool plan(const BlockSet &set, AllocationStrategy strategy, size_t *result) {
+    AllocationPlanner planner(set.alignment, strategy);
+    for (const Block &b : set.blocks) {
+        planner.add_block(b.size, b.first_use, b.last_use);
+    }
+    planner.commit();
+
+    const char *failure = nullptr;
+    if (!planner.check_overlap()) {
+        failure = "blocks overlap";
+    } else if (planner.memory_needed() < planner.lower_bound()) {
+        failure = "memory needed is less than the lower bound";
+    }
+    for (int i = 0; i < planner.block_count() && !failure; i++) {
+        if (planner.get_block_offset(i) % set.alignment != 0) {
+            failure = "block is not aligned";
+        } else if (planner.get_block_offset(i) + set.blocks[i].size > planner.memory_needed()) {
+            failure = "block is outside the memory needed";
+        }
+    }
+    if (failure) {
+        std::cerr << set.name << " (" << strategy_name(strategy) << "): " << failure << "\n";
+        planner.dump(std::cerr);
+        return false;
+    }
+    *result = planner.memory_needed();
+    return true;
+}
+
+bool test_block_set(const BlockSet &set, size_t expected_exact = 0) {
+    size_t needed[4];
+    for (int i = 0; i < 4; i++) {
+        if (!plan(set, strategies[i], &needed[i])) {
+            return false;
+        }
+    }
+    const size_t first_fit = needed[0];
+    const size_t best_fit = needed[1];
+    const size_t exact = needed[2];
+    const size_t smallest = needed[3];
+    if (exact > std::min(first_fit, best_fit) || smallest > std::min(first_fit, best_fit)) {
+        std::cerr << set.name << ": first_fit " << first_fit << " best_fit " << best_fit
+                  << " exact " << exact << " smallest " << smallest << "\n";
+        return false;
+    }
+    if (expected_exact && exact != expected_exact) {
+        std::cerr << set.name << ": exact " << exact << ", expected " << expected_exact << "\n";
+        return false;
+    }
+    return true;
+}
+
+BlockSet random_block_set(std::mt19937 &rng, int count, int max_time, size_t max_size, size_t alignment) {
+    BlockSet set;
+    set.name = "random_" + std::to_string(count) + "_blocks";
+    set.alignment = alignment;
+    for (int i = 0; i < count; i++) {
+        const int first_use = (int)(rng() % max_time);
+        const int last_use = first_use + (int)(rng() % (max_time - first_use));
+        set.blocks.push_back({1 + rng() % max_size, first_use, last_use});
+    }
+    return set;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    // No blocks at all.
+    if (!test_block_set({"empty", 1, {}})) {
+        return -1;
+    }
+
+    // All the blocks are live at the same time, so they can't share memory.
+    if (!test_block_set({"all_live", 1, {{10, 0, 5}, {20, 1, 4}, {30, 2, 3}, {40, 2, 2}}}, 100)) {
+        return -1;
+    }
+
+    // A chain of ops, each reading the output of the one before it, which
+    // only needs room for two blocks at a time.
+    BlockSet chain = {"chain", 64, {}};
+    for (int i = 0; i < 20; i++) {
+        chain.blocks.push_back({(size_t)(64 * (1 + i % 2)), i, i + 1});
+    }
+    if (!test_block_set(chain, 64 * 3)) {
+        return -1;
+    }
+
+    // Placing the blocks from largest to smallest leaves a gap that is
+    // too small for the last one, so both greedy layouts need 13 bytes.
+    if (!test_block_set({"greedy_gap", 1, {{4, 2, 4}, {4, 3, 4}, {3, 3, 3}, {6, 2, 2}}}, 11)) {
+        return -1;
+    }
+
+    // Many interchangeable blocks.
+    BlockSet duplicates = {"duplicates", 1, {}};
+    for (int i = 0; i < 24; i++) {
+        duplicates.blocks.push_back({100, i % 4, i % 4 + 2});
+    }
+    if (!test_block_set(duplicates)) {
+        return -1;
+    }
+
+    // Sizes that aren't a multiple of the alignment.
+    if (!test_block_set({"unaligned", 64, {{1, 0, 1}, {65, 1, 2}, {127, 2, 3}, {3, 0, 3}}})) {
+        return -1;
+    }
+
+    std::mt19937 rng(argc > 1 ? std::stoi(argv[1]) : 0);
+    for (int i = 0; i < 200; i++) {
+        if (!test_block_set(random_block_set(rng, 2 + i % 12, 8, 100, 1 << (i % 4)))) {
+            return -1;
+        }
+    }
+    // Too many blocks for the exact search to finish.
+    for (int i = 0; i < 10; i++) {
+        if (!test_block_set(random_block_set(rng, 100, 50, 10000, 64))) {
+            return -1;
+        }
+    }
+
+    std::cout << "Success!\n";
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include "interpreter/constant_cache.h"
+#include "halide/tile_conv_filter_uint8.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/ops.h"
+#include "util/error_util.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <type_traits>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hannk {
+
+namespace {
+
+// Bump this whenever the format of the file, or the layout of any constant
+// computed by prepare(), changes, so that stale files are ignored.
+constexpr uint32_t cache_version = 2;
+constexpr char cache_magic[8] = {'h', 'a', 'n', 'n', 'k', 'c', 'c', '\0'};
+
+// The data of each constant is aligned to this within the file, which is
+// enough for any of the Halide pipelines.
+constexpr size_t cache_alignment = 128;
+
+size_t align_up(size_t x) {
+    return (x + cache_alignment - 1) & ~(cache_alignment - 1);
+}
+
+// The layouts of the constants computed by prepare() (e.g. whether the packed
+// filters are signed) depend on the target the pipelines were compiled for.
+// They are all compiled for the same target.
+std::string cache_target() {
+    return tile_conv_filter_uint8_metadata()->target;
+}
+
+class Hasher {
+    uint64_t h_ = 0xcbf29ce484222325ULL;
+
+    void add_word(uint64_t w) {
+        h_ = ((h_ << 27) | (h_ >> 37)) ^ w;
+        h_ *= 0x9e3779b97f4a7c15ULL;
+    }
+
+public:
+    void add(const void *data, size_t size) {
+        const char *p = (const char *)data;
+        for (; size >= 8; p += 8, size -= 8) {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            add_word(w);
+        }
+        uint64_t w = 0;
+        memcpy(&w, p, size);
+        add_word(w ^ ((uint64_t)size << 56));
+    }
+
+    template<typename T>
+    void add(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "");
+        add(&value, sizeof(value));
+    }
+
+    void add(const std::string &s) {
+        add(s.size());
+        add(s.data(), s.size());
+    }
+
+    uint64_t value() const {
+        // The splitmix64 finalizer.
+        uint64_t z = h_;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+class ModelHasher : public OpVisitor {
+    using OpVisitor::visit;
+
+    // The data of tensors that have already been hashed.
+    std::unordered_set<const void *> hashed_data_;
+
+    void hash_tensor(const TensorPtr &t) {
+        if (!t) {
+            hasher.add(false);
+            return;
+        }
+        hasher.add(true);
+        hasher.add(t->name());
+        hasher.add(t->type());
+        hasher.add(t->rank());
+        for (int d = 0; d < t->rank(); d++) {
+            hasher.add(t->bounds(d).min);
+            hasher.add(t->extent(d));
+        }
+        const QuantizationInfo &q = t->quantization();
+        hasher.add(q.scale.size());
+        hasher.add(q.scale.data(), q.scale.size() * sizeof(float));
+        hasher.add(q.zero.size());
+        hasher.add(q.zero.data(), q.zero.size() * sizeof(int32_t));
+        hasher.add(q.dimension);
+        hasher.add(t->is_constant());
+        if (t->is_constant() && t->is_allocated()) {
+            const auto &buf = t->buffer();
+            if (hashed_data_.insert(buf.data()).second) {
+                hasher.add(buf.begin(), buf.size_in_bytes());
+            }
+        }
+    }
+
+    void hash_op(const Op *op) {
+        hasher.add(op->name());
+        hasher.add(op->input_count());
+        for (int i = 0; i < op->input_count(); i++) {
+            hash_tensor(op->input(i));
+        }
+        hasher.add(op->output_count());
+        for (int i = 0; i < op->output_count(); i++) {
+            hash_tensor(op->output(i));
+        }
+    }
+
+    void visit_leaf(const Op *op) override {
+        hash_op(op);
+    }
+
+    void visit(const OpGroup *op) override {
+        hash_op(op);
+        OpVisitor::visit(op);
+    }
+
+public:
+    Hasher hasher;
+};
+
+class Reader {
+    const char *p_;
+    const char *end_;
+
+public:
+    Reader(const char *data, size_t size)
+        : p_(data), end_(data + size) {
+    }
+
+    template<typename T>
+    bool read(T *value) {
+        if ((size_t)(end_ - p_) < sizeof(T)) {
+            return false;
+        }
+        memcpy(value, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string *s) {
+        uint32_t size;
+        if (!read(&size) || (size_t)(end_ - p_) < size) {
+            return false;
+        }
+        s->assign(p_, size);
+        p_ += size;
+        return true;
+    }
+};
+
+}  // namespace
+
+uint64_t hash_model(const Op *root) {
+    ModelHasher hasher;
+    root->accept(&hasher);
+    return hasher.hasher.value();
+}
+
+ConstantCache::ConstantCache(const std::string &dir, uint64_t model_hash, const InterpreterOptions &options) {
+    // Models prepared for different targets, or with options that change
+    // which constants are folded, get different files, so they can share a
+    // directory.
+    Hasher key_hasher;
+    key_hasher.add(model_hash);
+    key_hasher.add(cache_target());
+    key_hasher.add(options.fuse_ops);
+    key_ = key_hasher.value();
+    std::ostringstream name;
+    name << std::hex << key_ << ".hannk_constants";
+    path_ = dir + "/" + name.str();
+
+#ifdef _WIN32
+    std::ifstream f(path_, std::ios::in | std::ios::binary);
+    if (!f.is_open()) {
+        return;
+    }
+    contents_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    data_ = contents_.data();
+    size_ = contents_.size();
+#else
+    int fd = open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data_ = (const char *)p;
+            size_ = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+
+    if (data_ && !read_index()) {
+        HLOG(WARNING) << "Ignoring the constant cache " << path_ << ", which is stale or corrupt.";
+        entries_.clear();
+        unmap();
+    }
+}
+
+ConstantCache::~ConstantCache() {
+    unmap();
+}
+
+void ConstantCache::unmap() {
+#ifndef _WIN32
+    if (data_) {
+        munmap((void *)data_, size_);
+    }
+#endif
+    contents_.clear();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+bool ConstantCache::read_index() {
+    Reader r(data_, size_);
+    char magic[sizeof(cache_magic)];
+    uint32_t version, count;
+    uint64_t key;
+    std::string target;
+    if (!r.read(&magic) || memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+        !r.read(&version) || version != cache_version ||
+        !r.read(&key) || key != key_ ||
+        !r.read(&target) || target != cache_target() ||
+        !r.read(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t code, bits;
+        uint16_t lanes;
+        uint32_t rank;
+        Entry e;
+        if (!r.read(&e.name) || !r.read(&code) || !r.read(&bits) || !r.read(&lanes) ||
+            !r.read(&rank) || rank > (uint32_t)max_rank) {
+            return false;
+        }
+        for (uint32_t d = 0; d < rank; d++) {
+            Interval bounds;
+            if (!r.read(&bounds.min) || !r.read(&bounds.max)) {
+                return false;
+            }
+            e.bounds.push_back(bounds);
+        }
+        if (!r.read(&e.offset) || !r.read(&e.size)) {
+            return false;
+        }
+        if (e.offset % cache_alignment != 0 || e.offset > size_ || e.size > size_ - e.offset) {
+            return false;
+        }
+        e.type = halide_type_t((halide_type_code_t)code, bits, lanes);
+        entries_.push_back(e);
+    }
+    return true;
+}
+
+bool ConstantCache::load(const std::vector<TensorPtr> &tensors) {
+    bool matches = next_entry_ + tensors.size() <= entries_.size();
+    for (size_t i = 0; matches && i < tensors.size(); i++) {
+        const Entry &e = entries_[next_entry_ + i];
+        const TensorPtr &t = tensors[i];
+        matches = e.name == t->name() && e.type == t->type() && (int)e.bounds.size() == t->rank() &&
+                  e.size == t->storage()->storage_size();
+        for (int d = 0; matches && d < t->rank(); d++) {
+            matches = e.bounds[d].min == t->bounds(d).min && e.bounds[d].max == t->bounds(d).max;
+        }
+    }
+    if (!matches) {
+        // The rest of the file can't be for the constants after these.
+        next_entry_ = entries_.size();
+        return false;
+    }
+
+    for (const TensorPtr &t : tensors) {
+        assert(!t->is_allocated());
+        // The file is mapped read-only, but constant tensors are never
+        // written to.
+        t->allocate_from_arena_pointer((void *)(data_ + entries_[next_entry_++].offset));
+        constants_.push_back(t);
+    }
+    loaded_ += (int)tensors.size();
+    return true;
+}
+
+void ConstantCache::add(const std::vector<TensorPtr> &tensors) {
+    constants_.insert(constants_.end(), tensors.begin(), tensors.end());
+}
+
+bool ConstantCache::save() {
+    if (computed() == 0) {
+        return true;
+    }
+
+    const std::string target = cache_target();
+    size_t offset = sizeof(cache_magic) + sizeof(uint32_t) * 2 + sizeof(uint64_t) +
+                    sizeof(uint32_t) + target.size();
+    for (const TensorPtr &t : constants_) {
+        offset += sizeof(uint32_t) + t->name().size() +
+                  sizeof(uint8_t) * 2 + sizeof(uint16_t) +
+                  sizeof(uint32_t) + t->rank() * sizeof(int32_t) * 2 +
+                  sizeof(uint64_t) * 2;
+    }
+
+    // Write a temporary file and rename it over the old one, so that other
+    // processes never see a partial file, and the tensors loaded from the old
+    // file stay valid.
+#ifdef _WIN32
+    const std::string temp_path = path_ + ".tmp";
+#else
+    const std::string temp_path = path_ + ".tmp" + std::to_string(getpid());
+#endif
+    std::ofstream f(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!f.is_open()) {
+        HLOG(ERROR) << "Unable to write the constant cache " << temp_path;
+        return false;
+    }
+    const auto write = [&f](const auto &value) {
+        f.write((const char *)&value, sizeof(value));
+    };
+    f.write(cache_magic, sizeof(cache_magic));
+    write(cache_version);
+    write(key_);
+    write((uint32_t)target.size());
+    f.write(target.data(), target.size());
+    write((uint32_t)constants_.size());
+    for (const TensorPtr &t : constants_) {
+        offset = align_up(offset);
+        const uint64_t size = t->storage()->storage_size();
+        write((uint32_t)t->name().size());
+        f.write(t->name().data(), t->name().size());
+        write((uint8_t)t->type().code);
+        write((uint8_t)t->type().bits);
+        write((uint16_t)t->type().lanes);
+        write((uint32_t)t->rank());
+        for (int d = 0; d < t->rank(); d++) {
+            write((int32_t)t->bounds(d).min);
+            write((int32_t)t->bounds(d).max);
+        }
+        write((uint64_t)offset);
+        write(size);
+        offset += size;
+    }
+    for (const TensorPtr &t : constants_) {
+        static const char zeros[cache_alignment] = {};
+        const size_t position = (size_t)f.tellp();
+        f.write(zeros, align_up(position) - position);
+        f.write((const char *)t->buffer().data(), t->storage()->storage_size());
+    }
+    f.close();
+    if (!f.good()) {
+        HLOG(ERROR) << "Unable to write the constant cache " << temp_path;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    // rename() doesn't replace existing files on Windows.
+    std::remove(path_.c_str());
+#endif
+    if (std::rename(temp_path.c_str(), path_.c_str()) != 0) {
+        HLOG(ERROR) << "Unable to rename " << temp_path << " to " << path_;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace hannk
@@ -0,0 +1,93 @@
+#ifndef HANNK_CONSTANT_CACHE_H
+#define HANNK_CONSTANT_CACHE_H
+
+#include <string>
+#include <vector>
+
+#include "interpreter/model.h"
+
+namespace hannk {
+
+struct InterpreterOptions;
+
+// Hash the ops of a model (by name), the names, types, shapes and
+// quantization of their tensors, and the data of the constant tensors.
+uint64_t hash_model(const Op *root);
+
+// A file of the constant tensors computed by fold_constants() for one model,
+// target and set of options, such as the filters packed by TileConvFilterOp,
+// so that later prepares of the same model can map them from the file instead
+// of computing them again. The constants are stored in the order they are
+// folded in, which is the same every time the same model is prepared, along
+// with the name, type and bounds of each, which are checked when it is loaded.
+//
+// The tensors that load() points into the file are only valid while the
+// ConstantCache exists.
+class ConstantCache {
+    std::string path_;
+    // The hash of the model, target and options the file is for.
+    uint64_t key_;
+
+    // The mapped file, if it is for this model and target.
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<char> contents_;  // Used instead of mapping on Windows.
+
+    struct Entry {
+        std::string name;
+        halide_type_t type;
+        Box bounds;
+        uint64_t offset;
+        uint64_t size;
+    };
+    std::vector<Entry> entries_;
+    size_t next_entry_ = 0;
+
+    // Every constant folded so far, loaded or not, in order.
+    std::vector<TensorPtr> constants_;
+    int loaded_ = 0;
+
+    bool read_index();
+    void unmap();
+
+public:
+    // Open the file for the model with the given hash (see hash_model()),
+    // prepared with the given options, in the directory dir. If there isn't
+    // one, or it can't be used, nothing is loaded from the cache, and save()
+    // writes the file.
+    ConstantCache(const std::string &dir, uint64_t model_hash, const InterpreterOptions &options);
+    ~ConstantCache();
+
+    // If the next constants in the file have the names, types, bounds and
+    // sizes of the (unallocated) tensors, point the tensors at them and
+    // return true.
+    // Otherwise, return false, and don't load anything from the cache after
+    // this; the tensors must be computed and passed to add() instead.
+    bool load(const std::vector<TensorPtr> &tensors);
+
+    // Add computed constants, to be written by save().
+    void add(const std::vector<TensorPtr> &tensors);
+
+    // The number of constants loaded from the file, and computed.
+    int loaded() const {
+        return loaded_;
+    }
+    int computed() const {
+        return (int)constants_.size() - loaded_;
+    }
+
+    // If any constants were computed, (re)write the file. Returns false (and
+    // logs an error) if the file can't be written.
+    bool save();
+
+    // Neither movable nor copyable.
+    ConstantCache() = delete;
+    ConstantCache(const ConstantCache &) = delete;
+    ConstantCache &operator=(const ConstantCache &) = delete;
+    ConstantCache(ConstantCache &&) = delete;
+    ConstantCache &operator=(ConstantCache &&) = delete;
+};
+
+}  // namespace hannk
+
+#endif  // HANNK_CONSTANT_CACHE_H
@@ -1,11 +1,13 @@
 #include "interpreter/interpreter.h"
 #include "interpreter/allocation_planner.h"
+#include "interpreter/constant_cache.h"
 #include "interpreter/transforms.h"
 #include "util/error_util.h"
 
 #include "HalideBuffer.h"  // for HALIDE_RUNTIME_BUFFER_ALLOCATION_ALIGNMENT
 #include "HalideRuntime.h"
 
+#include <chrono>
 #include <map>
 #include <set>
 #include <unordered_set>
@@ -28,8 +30,18 @@ class TensorVisitor : public OpVisitor {
     virtual void visit_tensor(const TensorPtr &t) = 0;
 
     void visit(const OpGroup *g) override {
+        // The ops of a TiledOpGroup run interleaved, so their tensors are all
+        // in use for the whole group. (Its intermediate tensors are usually
+        // folded, so this is only a strip of rows of each.)
+        const bool interleaved = g->name() == "TiledOpGroup";
+        depth_++;
         for (int i = 0; i < g->op_count(); i++) {
-            op_index_++;
+            if (!interleaved) {
+                op_index_++;
+            }
+            if (depth_ == 1) {
+                root_op_index_ = i;
+            }
             const Op *op = g->op(i);
             for (int j = 0; j < op->input_count(); j++) {
                 visit_tensor(op->input(j));
@@ -39,14 +51,22 @@ class TensorVisitor : public OpVisitor {
             }
             op->accept(this);
         }
+        depth_--;
     }
 
     int op_index_ = -1;
+    int root_op_index_ = -1;
+    int depth_ = 0;
 
 public:
     int op_index() const {
         return op_index_;
     }
+
+    // The index of the op in the root OpGroup that contains the current op.
+    int root_op_index() const {
+        return root_op_index_;
+    }
 };
 
 struct TensorAllocationInfo {
@@ -76,21 +96,35 @@ class FindAllocatableTensors : public TensorVisitor {
         assert(info.size_needed == 0 || info.size_needed == storage->storage_size());
 
         info.size_needed = storage->storage_size();
-        info.first_use = std::min(info.first_use, op_index());
-        info.last_use = std::max(info.last_use, op_index());
+        if (executor_) {
+            info.first_use = std::min(info.first_use, executor_->earliest_position(root_op_index()));
+            info.last_use = std::max(info.last_use, executor_->latest_position(root_op_index()));
+        } else {
+            info.first_use = std::min(info.first_use, op_index());
+            info.last_use = std::max(info.last_use, op_index());
+        }
         // leave block_index as -1
         info.tensors.insert(t);
     }
 
+    // If the ops of the root OpGroup might run out of order, a tensor is in
+    // use from the earliest position any op using it could run in, to the
+    // latest position any of them could run in.
+    const ParallelExecutor *executor_;
+
 public:
+    explicit FindAllocatableTensors(const ParallelExecutor *executor)
+        : executor_(executor) {
+    }
+
     // Iteration order matters, so don't use unordered_map without consideration.
     std::map<TensorStoragePtr, TensorAllocationInfo> tensor_info;
 };
 
-std::unique_ptr<char[]> allocate_tensors(const Op *root, const InterpreterOptions &options) {
+std::unique_ptr<char[]> allocate_tensors(const Op *root, const ParallelExecutor *executor, const InterpreterOptions &options) {
     // Find the tensors that we want to allocate in an arena,
     // along the needed storage size and lifetime for each.
-    FindAllocatableTensors find_tensors;
+    FindAllocatableTensors find_tensors(executor);
     root->accept(&find_tensors);
 
     if (options.verbosity >= 1) {
@@ -110,7 +144,7 @@ std::unique_ptr<char[]> allocate_tensors(const Op *root, const InterpreterOption
     constexpr int kTfLiteDefaultTensorAlignment = 64;
     constexpr int kHalideBufferAlignment = HALIDE_RUNTIME_BUFFER_ALLOCATION_ALIGNMENT;
     constexpr size_t alignment = (size_t)std::max(kHalideBufferAlignment, kTfLiteDefaultTensorAlignment);
-    AllocationPlanner planner(alignment);
+    AllocationPlanner planner(alignment, options.allocation_strategy);
     for (auto &it : find_tensors.tensor_info) {
         auto &info = it.second;
         info.block_index = planner.add_block(info.size_needed, info.first_use, info.last_use);
@@ -120,7 +154,7 @@ std::unique_ptr<char[]> allocate_tensors(const Op *root, const InterpreterOption
 
     if (options.verbosity >= 1) {
         std::ostringstream oss;
-        oss << "Arena memory needed: " << planner.memory_needed() << "\n";
+        oss << "Arena memory needed: " << planner.memory_needed() << " (lower bound " << planner.lower_bound() << ")\n";
         oss << "    Offsets:";
         for (int i = 0; i < planner.block_count(); i++) {
             oss << ' ' << planner.get_block_offset(i);
@@ -226,6 +260,15 @@ bool Interpreter::prepare() {
         return false;
     }
 
+    if (!options_.constant_cache_dir.empty()) {
+        // Hash the model before any transforms change it.
+        constant_cache_ = std::make_shared<ConstantCache>(options_.constant_cache_dir, hash_model(model_.get()), options_);
+    }
+
+    // The ops only implement uint8 quantized tensors, so convert int8 tensors
+    // before anything depends on their types.
+    model_ = convert_int8_to_uint8(std::move(model_));
+
     // We must prepare the model before doing the transforms, as some of the
     // transforms may rely on information cached by prepare(), e.g. alignment requirements.
     // (Note that any transforms that add new ops are expected to call prepare() on them,
@@ -253,10 +296,33 @@ bool Interpreter::prepare() {
     }
     dump_model("Model after pad_for_ops():", 3);
 
+    if (options_.fuse_ops) {
+        FuseOpsStats fuse_stats;
+        model_ = fuse_ops(std::move(model_), &fuse_stats);
+        if (!model_) {
+            HLOG(ERROR) << "fuse_ops() failed.";
+            return false;
+        }
+        if (options_.verbosity >= 1) {
+            HLOG(INFO) << "fuse_ops() fused " << fuse_stats.ops_fused << " ops, saving "
+                       << fuse_stats.bytes_saved << " bytes of memory traffic per execution.";
+        }
+        dump_model("Model after fuse_ops():", 3);
+    }
+
     model_ = in_place(std::move(model_));
     dump_model("Model after in_place():", 3);
 
-    model_ = fold_constants(std::move(model_));
+    model_ = fold_constants(std::move(model_), constant_cache_.get());
+    if (constant_cache_) {
+        if (options_.verbosity >= 1) {
+            HLOG(INFO) << "fold_constants() loaded " << constant_cache_->loaded() << " constants from the cache, and computed "
+                       << constant_cache_->computed() << ".";
+        }
+        // Failing to write the cache (which is logged) only makes the next
+        // prepare() slower, so it isn't an error here.
+        constant_cache_->save();
+    }
     dump_model("Model after fold_constants():", 3);
 
     model_ = flatten_groups(std::move(model_));
@@ -272,11 +338,28 @@ bool Interpreter::prepare() {
     model_ = remove_dead_ops(std::move(model_));
     dump_model("Model after remove_dead_ops:", 3);
 
+    if (options_.tile_cache_size > 0) {
+        TileOpsStats tile_stats;
+        model_ = tile_ops(std::move(model_), options_.tile_cache_size, &tile_stats);
+        if (options_.verbosity >= 1) {
+            HLOG(INFO) << "tile_ops() made " << tile_stats.groups << " tiled groups of " << tile_stats.ops_tiled
+                       << " ops, keeping " << tile_stats.bytes_saved << " bytes of memory traffic in cache per execution, and folding "
+                       << tile_stats.bytes_folded << " bytes of intermediate tensors.";
+        }
+        dump_model("Model after tile_ops():", 3);
+    }
+
 #ifndef NDEBUG
     do_check_op_order(model_.get());
 #endif
+    if (options_.num_threads > 1) {
+        // The transforms above always leave a single OpGroup at the root.
+        HCHECK(model_->name() == "OpGroup");
+        executor_ = std::make_unique<ParallelExecutor>(static_cast<OpGroup *>(model_.get()), options_.num_threads);
+    }
+
     assert(tensor_storage_arena_ == nullptr);
-    tensor_storage_arena_ = allocate_tensors(model_.get(), options_);
+    tensor_storage_arena_ = allocate_tensors(model_.get(), executor_.get(), options_);
 
 #ifndef NDEBUG
     VerifyAllAllocated verify_all;
@@ -289,84 +372,182 @@ bool Interpreter::prepare() {
     return true;
 }
 
-void Interpreter::execute() {
-    if (!prepared_) {
-        HLOG(ERROR) << "Must call prepare() before execute()";
-        return;
-    }
-    model_->execute();
-}
-
-TensorPtr Interpreter::get_tensor(const std::string &name) {
-    HCHECK(prepared_);
+namespace {
 
-    class Finder : public OpVisitor {
-        using OpVisitor::visit;
+class Finder : public OpVisitor {
+    using OpVisitor::visit;
 
-        bool find_tensor(const Op *op) {
-            if (result) {
+    bool find_tensor(const Op *op) {
+        if (result) {
+            return true;
+        }
+        for (int j = 0; j < op->input_count(); j++) {
+            if (op->input(j)->name() == name_) {
+                result = op->input(j);
                 return true;
             }
-            for (int j = 0; j < op->input_count(); j++) {
-                if (op->input(j)->name() == name_) {
-                    result = op->input(j);
-                    return true;
-                }
-            }
-            for (int j = 0; j < op->output_count(); j++) {
-                if (op->output(j)->name() == name_) {
-                    result = op->output(j);
-                    return true;
-                }
+        }
+        for (int j = 0; j < op->output_count(); j++) {
+            if (op->output(j)->name() == name_) {
+                result = op->output(j);
+                return true;
             }
-            return false;
         }
+        return false;
+    }
 
-        void visit_leaf(const Op *op) override {
-            if (find_tensor(op)) {
-                return;
-            }
+    void visit_leaf(const Op *op) override {
+        if (find_tensor(op)) {
+            return;
         }
+    }
 
-        void visit(const OpGroup *op) override {
-            if (find_tensor(op)) {
-                return;
-            }
-            OpVisitor::visit(op);
+    void visit(const OpGroup *op) override {
+        if (find_tensor(op)) {
+            return;
         }
+        OpVisitor::visit(op);
+    }
 
-        const std::string &name_;
+    const std::string &name_;
 
-    public:
-        explicit Finder(const std::string &name)
-            : name_(name) {
-        }
-        TensorPtr result = nullptr;
-    };
+public:
+    explicit Finder(const std::string &name)
+        : name_(name) {
+    }
+    TensorPtr result = nullptr;
+};
 
+TensorPtr find_tensor(const Op *root, const std::string &name) {
     Finder finder(name);
-    model_->accept(&finder);
+    root->accept(&finder);
     return finder.result;
 }
 
-std::vector<TensorPtr> Interpreter::inputs() {
-    HCHECK(prepared_);
+void execute_model(Op *root, ParallelExecutor *executor) {
+    if (executor) {
+        executor->execute();
+    } else {
+        root->execute();
+    }
+}
+
+std::vector<TensorPtr> model_inputs(const Op *root) {
     std::vector<TensorPtr> result;
-    for (int i = 0; i < model_->input_count(); i++) {
-        result.push_back(model_->input(i));
+    for (int i = 0; i < root->input_count(); i++) {
+        result.push_back(root->input(i));
     }
+    return result;
+}
 
+std::vector<TensorPtr> model_outputs(const Op *root) {
+    std::vector<TensorPtr> result;
+    for (int i = 0; i < root->output_count(); i++) {
+        result.push_back(root->output(i));
+    }
     return result;
 }
 
-std::vector<TensorPtr> Interpreter::outputs() {
+}  // namespace
+
+void Interpreter::execute() {
+    if (!prepared_) {
+        HLOG(ERROR) << "Must call prepare() before execute()";
+        return;
+    }
+    execute_model(model_.get(), executor_.get());
+}
+
+std::vector<OpProfile> Interpreter::profile_ops(int executions) {
     HCHECK(prepared_);
-    std::vector<TensorPtr> result;
-    for (int i = 0; i < model_->output_count(); i++) {
-        result.push_back(model_->output(i));
+    // The transforms in prepare() always leave a single OpGroup at the root.
+    HCHECK(model_->name() == "OpGroup");
+    OpGroup *group = static_cast<OpGroup *>(model_.get());
+
+    // Dynamic tensors only have their final shapes after an execution.
+    group->execute();
+
+    std::vector<OpProfile> result(group->op_count());
+    for (int i = 0; i < group->op_count(); i++) {
+        const Op *op = group->op(i);
+        OpProfile &profile = result[i];
+        profile.name = op->name();
+        profile.arithmetic_ops = op->arithmetic_ops();
+        for (int j = 0; j < op->input_count(); j++) {
+            if (op->input(j)) {
+                profile.bytes += op->input(j)->buffer().size_in_bytes();
+            }
+        }
+        for (int j = 0; j < op->output_count(); j++) {
+            if (op->output(j)) {
+                profile.bytes += op->output(j)->buffer().size_in_bytes();
+            }
+        }
+        profile.times.reserve(executions);
     }
 
+    for (int e = 0; e < executions; e++) {
+        for (int i = 0; i < group->op_count(); i++) {
+            auto start = std::chrono::steady_clock::now();
+            group->op(i)->execute();
+            auto end = std::chrono::steady_clock::now();
+            result[i].times.push_back(std::chrono::duration<double>(end - start).count());
+        }
+    }
     return result;
 }
 
+std::unique_ptr<InterpreterContext> Interpreter::make_context() {
+    HCHECK(prepared_);
+    TensorCloner cloner;
+    return std::unique_ptr<InterpreterContext>(new InterpreterContext(model_->clone(cloner), constant_cache_, options_));
+}
+
+TensorPtr Interpreter::get_tensor(const std::string &name) {
+    HCHECK(prepared_);
+    return find_tensor(model_.get(), name);
+}
+
+std::vector<TensorPtr> Interpreter::inputs() {
+    HCHECK(prepared_);
+    return model_inputs(model_.get());
+}
+
+std::vector<TensorPtr> Interpreter::outputs() {
+    HCHECK(prepared_);
+    return model_outputs(model_.get());
+}
+
+InterpreterContext::InterpreterContext(OpPtr model, std::shared_ptr<ConstantCache> constant_cache, const InterpreterOptions &options)
+    : model_(std::move(model)), constant_cache_(std::move(constant_cache)) {
+    if (options.num_threads > 1) {
+        executor_ = std::make_unique<ParallelExecutor>(static_cast<OpGroup *>(model_.get()), options.num_threads);
+    }
+    tensor_storage_arena_ = allocate_tensors(model_.get(), executor_.get(), options);
+
+#ifndef NDEBUG
+    VerifyAllAllocated verify_all;
+    model_->accept(&verify_all);
+#endif
+}
+
+InterpreterContext::~InterpreterContext() {
+}
+
+void InterpreterContext::execute() {
+    execute_model(model_.get(), executor_.get());
+}
+
+TensorPtr InterpreterContext::get_tensor(const std::string &name) {
+    return find_tensor(model_.get(), name);
+}
+
+std::vector<TensorPtr> InterpreterContext::inputs() {
+    return model_inputs(model_.get());
+}
+
+std::vector<TensorPtr> InterpreterContext::outputs() {
+    return model_outputs(model_.get());
+}
+
 }  // namespace hannk
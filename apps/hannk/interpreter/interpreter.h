@@ -4,21 +4,105 @@
 #include <string>
 #include <vector>
 
+#include "interpreter/allocation_planner.h"
 #include "interpreter/model.h"
+#include "interpreter/parallel_executor.h"
 
 namespace hannk {
 
+class ConstantCache;
+
 struct InterpreterOptions {
     // Verbosity level. 0 = None.
     int verbosity = 0;
 
     // Whether to enable tracing.
     bool trace = false;
+
+    // The number of threads to run independent ops on at the same time.
+    // With 1, the ops run one after another on the calling thread. More
+    // threads may need a larger arena, because tensors used by ops that
+    // might run at the same time can't share memory.
+    int num_threads = 1;
+
+    // Whether to fuse ops with the ops producing their inputs where there is
+    // a combined implementation (see fuse_ops()). The fused ops get the same
+    // results, so this is only turned off to check that they do.
+    bool fuse_ops = true;
+
+    // If nonzero, run chains of ops with large intermediate tensors in
+    // strips of rows that fit in a cache of this many bytes, storing only
+    // a strip of each intermediate tensor. 0 = off.
+    int64_t tile_cache_size = 0;
+
+    // How to lay out the tensors in the arena.
+    AllocationStrategy allocation_strategy = AllocationStrategy::Smallest;
+
+    // If not empty, a directory in which to cache the constants computed by
+    // prepare(), such as the filters packed by TileConvFilterOp, with a file
+    // for each model and target. Later prepares of the same model map the
+    // file instead of computing them again.
+    std::string constant_cache_dir;
+};
+
+// The cost of one op of a prepared model, as measured by
+// Interpreter::profile_ops().
+struct OpProfile {
+    std::string name;
+
+    // Estimates of the work done and of the tensor data read and written by
+    // one execution of the op. Tensors used only inside the op (e.g. within
+    // a TiledOpGroup) aren't counted.
+    int64_t arithmetic_ops = 0;
+    int64_t bytes = 0;
+
+    // The time taken by each execution of the op, in seconds.
+    std::vector<double> times;
+};
+
+// An instance of the model of a prepared Interpreter, for executing several
+// requests at the same time. Each context has its own copies of the ops and
+// of the tensors that aren't constant, allocated in its own arena, but shares
+// the constant tensors (the weights, and what prepare() computed from them,
+// such as the filters packed by TileConvFilterOp) with the Interpreter, so
+// a context costs much less than another Interpreter. Different contexts,
+// and the Interpreter itself, can execute at the same time, but each can
+// only execute on one thread at a time.
+class InterpreterContext {
+    OpPtr model_;
+    std::unique_ptr<ParallelExecutor> executor_;
+    std::unique_ptr<char[]> tensor_storage_arena_;
+    std::shared_ptr<ConstantCache> constant_cache_;
+
+    friend class Interpreter;
+    InterpreterContext(OpPtr model, std::shared_ptr<ConstantCache> constant_cache, const InterpreterOptions &options);
+
+public:
+    ~InterpreterContext();
+
+    void execute();
+
+    // As for the Interpreter methods of the same names, but for the
+    // tensors of this context.
+    TensorPtr get_tensor(const std::string &name);
+    std::vector<TensorPtr> inputs();
+    std::vector<TensorPtr> outputs();
+
+    // Neither movable nor copyable.
+    InterpreterContext() = delete;
+    InterpreterContext(const InterpreterContext &) = delete;
+    InterpreterContext &operator=(const InterpreterContext &) = delete;
+    InterpreterContext(InterpreterContext &&) = delete;
+    InterpreterContext &operator=(InterpreterContext &&) = delete;
 };
 
 class Interpreter {
     OpPtr model_;
+    std::unique_ptr<ParallelExecutor> executor_;
     std::unique_ptr<char[]> tensor_storage_arena_;
+    // The constants loaded from the cache point into it, so it must outlive
+    // the model, and any contexts.
+    std::shared_ptr<ConstantCache> constant_cache_;
     InterpreterOptions options_;
     bool prepared_ = false;
 
@@ -42,12 +126,29 @@ public:
 
     void execute();
 
+    // Make another instance of the model, for executing another request at
+    // the same time as this one. Must be called after prepare(), and not at
+    // the same time as execute() or another call to make_context().
+    std::unique_ptr<InterpreterContext> make_context();
+
+    // Execute the model `executions` times (after one execution to warm up),
+    // timing each of the top-level ops of the prepared model. The ops run one
+    // after another on the calling thread, even if num_threads > 1, so that
+    // the time of each is its own.
+    std::vector<OpProfile> profile_ops(int executions);
+
     // Return the Tensor(s) that are the initial input(s) of the Model.
     std::vector<TensorPtr> inputs();
 
     // Return the Tensor(s) that are the final output(s) of the Model.
     std::vector<TensorPtr> outputs();
 
+    // The cache that prepare() loaded constants from (and saved them to), or
+    // null if InterpreterOptions::constant_cache_dir is empty.
+    const ConstantCache *constant_cache() const {
+        return constant_cache_.get();
+    }
+
     // Movable but not copyable.
     Interpreter() = delete;
     Interpreter(const Interpreter &) = delete;
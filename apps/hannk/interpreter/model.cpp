@@ -43,6 +43,25 @@ Op::~Op() {
     }
 }
 
+void Op::clone_tensors(const Op &op, TensorCloner &cloner) {
+    assert(inputs_.empty() && outputs_.empty());
+    // Ops are only cloned after the model is prepared, when nothing looks at
+    // the producers and consumers of constant tensors anymore. Don't add to
+    // those, so that different instances never modify the tensors they share.
+    for (const auto &i : op.inputs_) {
+        inputs_.push_back(cloner.clone(i));
+        if (inputs_.back() && !inputs_.back()->is_constant()) {
+            inputs_.back()->add_consumer(this);
+        }
+    }
+    for (const auto &i : op.outputs_) {
+        outputs_.push_back(cloner.clone(i));
+        if (outputs_.back() && !outputs_.back()->is_constant()) {
+            outputs_.back()->add_producer(this);
+        }
+    }
+}
+
 void Op::set_input(int idx, TensorPtr t) {
     if (inputs_[idx]) {
         inputs_[idx]->remove_consumer(this);
@@ -53,6 +72,16 @@ void Op::set_input(int idx, TensorPtr t) {
     }
 }
 
+void Op::set_output(int idx, TensorPtr t) {
+    if (outputs_[idx]) {
+        outputs_[idx]->remove_producer(this);
+    }
+    outputs_[idx] = std::move(t);
+    if (outputs_[idx]) {
+        outputs_[idx]->add_producer(this);
+    }
+}
+
 bool Op::is_input(const TensorPtr &t) const {
     for (auto &i : inputs_) {
         if (i == t) {
@@ -71,6 +100,16 @@ bool Op::is_output(const TensorPtr &t) const {
     return false;
 }
 
+int64_t Op::arithmetic_ops() const {
+    int64_t result = 0;
+    for (const auto &o : outputs_) {
+        if (o) {
+            result += o->number_of_elements();
+        }
+    }
+    return result;
+}
+
 void Op::dump(std::ostream &os, int indent) const {
     const std::string spaces(indent, ' ');
 
@@ -107,12 +146,149 @@ void OpGroup::execute() {
     }
 }
 
+OpGroup::OpGroup(const OpGroup &op, TensorCloner &cloner)
+    : Op(op) {
+    clone_tensors(op, cloner);
+    ops_.reserve(op.ops_.size());
+    for (const auto &i : op.ops_) {
+        ops_.push_back(i->clone(cloner));
+    }
+}
+
+OpPtr OpGroup::clone_impl(TensorCloner &cloner) const {
+    return OpPtr(new OpGroup(*this, cloner));
+}
+
 BoundsMap OpGroup::map_bounds(int input_idx, int output_idx) const {
     BoundsMap result(input(input_idx)->rank(), output(output_idx)->rank());
     // TODO
     return result;
 }
 
+TiledOpGroup::TiledOpGroup(std::vector<TensorPtr> inputs, std::vector<TensorPtr> outputs, std::vector<OpPtr> ops, int tile_height)
+    : OpGroup(std::move(inputs), std::move(outputs), std::move(ops)), tile_height_(tile_height) {
+    assert(tile_height > 0);
+    chain_inputs_.resize(op_count(), -1);
+    for (int i = 0; i < op_count(); i++) {
+        assert(op(i)->can_execute_crop());
+        if (i == 0) {
+            continue;
+        }
+        for (int j = 0; j < op(i)->input_count(); j++) {
+            if (op(i)->input(j) == op(i - 1)->output()) {
+                chain_inputs_[i] = j;
+                break;
+            }
+        }
+        assert(chain_inputs_[i] >= 0);
+    }
+}
+
+TiledOpGroup::TiledOpGroup(const TiledOpGroup &op, TensorCloner &cloner)
+    : OpGroup(op, cloner), tile_height_(op.tile_height_), chain_inputs_(op.chain_inputs_) {
+}
+
+OpPtr TiledOpGroup::clone_impl(TensorCloner &cloner) const {
+    return OpPtr(new TiledOpGroup(*this, cloner));
+}
+
+std::vector<Box> TiledOpGroup::required_crops(const Box &crop) const {
+    const int n = op_count();
+    std::vector<Box> crops(n);
+    crops[n - 1] = crop;
+    for (int i = n - 1; i > 0; i--) {
+        Box required = op(i)->map_bounds(chain_inputs_[i], 0).evaluate(crops[i]);
+        // Only the rows are tiled; always compute all of the other dimensions.
+        crops[i - 1] = op(i - 1)->output()->bounds();
+        Interval &rows = crops[i - 1][2];
+        rows.min = std::max(rows.min, required[2].min);
+        rows.max = std::min(rows.max, required[2].max);
+    }
+    return crops;
+}
+
+int64_t TiledOpGroup::fold_intermediates() {
+    const int n = op_count();
+    // Find the most rows of the output of each op stored at once by
+    // execute(): from the first row the next op needs (or the first row to
+    // compute, if that is before it) to the last row computed.
+    std::vector<int> computed(n);
+    std::vector<int> stored(n, 0);
+    for (int i = 0; i < n; i++) {
+        computed[i] = op(i)->output()->bounds(2).min - 1;
+    }
+    const Box bounds = op(n - 1)->output()->bounds();
+    for (int y = bounds[2].min; y <= bounds[2].max; y += tile_height_) {
+        Box crop = bounds;
+        crop[2] = Interval(y, std::min(y + tile_height_ - 1, bounds[2].max));
+        const std::vector<Box> crops = required_crops(crop);
+        for (int i = 0; i < n; i++) {
+            const Interval &rows = crops[i][2];
+            const int min = std::min(rows.min, computed[i] + 1);
+            computed[i] = std::max(computed[i], rows.max);
+            stored[i] = std::max(stored[i], computed[i] - min + 1);
+        }
+    }
+
+    int64_t saved = 0;
+    for (int i = 0; i < n - 1; i++) {
+        const TensorPtr &t = op(i)->output();
+        if (stored[i] >= t->extent(2) || t->is_allocated() || t->is_external() || t->is_dynamic() ||
+            t->alias_type() != AliasType::None) {
+            continue;
+        }
+        const int64_t size = t->storage()->storage_size();
+        t->fold_rows(stored[i]);
+        saved += size - t->storage()->storage_size();
+    }
+    return saved;
+}
+
+void TiledOpGroup::execute() {
+    const int n = op_count();
+    // The last row of the output of each op computed so far. The rows
+    // computed are always a prefix of the output, so any row before this
+    // can be used by the next op.
+    std::vector<int> computed(n);
+    for (int i = 0; i < n; i++) {
+        const TensorPtr &t = op(i)->output();
+        computed[i] = t->bounds(2).min - 1;
+        if (t->folded_rows() > 0) {
+            t->slide_folded_rows(t->bounds(2).min, computed[i]);
+        }
+    }
+
+    const Box bounds = op(n - 1)->output()->bounds();
+    for (int y = bounds[2].min; y <= bounds[2].max; y += tile_height_) {
+        Box crop = bounds;
+        crop[2] = Interval(y, std::min(y + tile_height_ - 1, bounds[2].max));
+        std::vector<Box> crops = required_crops(crop);
+        for (int i = 0; i < n; i++) {
+            Interval &rows = crops[i][2];
+            const TensorPtr &t = op(i)->output();
+            if (t->folded_rows() > 0) {
+                // Drop the rows the next op no longer needs, keeping
+                // the rows it needs again, as fold_intermediates() expects.
+                t->slide_folded_rows(std::min(rows.min, computed[i] + 1), computed[i]);
+            }
+            rows.min = computed[i] + 1;
+            if (rows.empty()) {
+                continue;
+            }
+            op(i)->execute_crop(crops[i]);
+            computed[i] = rows.max;
+        }
+    }
+}
+
+int64_t OpGroup::arithmetic_ops() const {
+    int64_t result = 0;
+    for (const auto &i : ops_) {
+        result += i->arithmetic_ops();
+    }
+    return result;
+}
+
 void OpGroup::dump(std::ostream &os, int indent) const {
     Op::dump(os, indent);
     for (const auto &i : ops_) {
@@ -151,9 +151,16 @@ public:
     }
 
     Interval evaluate(int dim_in, const Box &output) const {
+        // Output dimensions that dim_in doesn't depend on map to empty
+        // intervals, which shouldn't grow the result.
         Interval result = at(dim_in).bounds;
         for (int i = 0; i < (int)output.size(); i++) {
-            result = Union(result, at(dim_in, i).evaluate(output[i]));
+            Interval required = at(dim_in, i).evaluate(output[i]);
+            if (result.empty()) {
+                result = required;
+            } else if (!required.empty()) {
+                result = Union(result, required);
+            }
         }
         return result;
     }
@@ -264,6 +271,13 @@ protected:
 
     Op(std::vector<TensorPtr> inputs, std::vector<TensorPtr> outputs);
 
+    // Copies everything but the tensors, which clone() sets.
+    Op(const Op &) {
+    }
+
+    // Use cloner to copy the tensors of op into this op.
+    void clone_tensors(const Op &op, TensorCloner &cloner);
+
 public:
     virtual ~Op();
 
@@ -285,9 +299,21 @@ public:
         return true;
     }
 
-    // Execute the op on a given crop.
+    // Execute the op.
     virtual void execute() = 0;
 
+    // Whether execute_crop() is supported.
+    virtual bool can_execute_crop() const {
+        return false;
+    }
+
+    // Execute the op on just the region crop of output(0), reading only the
+    // regions of the inputs that map_bounds() says that requires. This is
+    // only called if can_execute_crop() returns true.
+    virtual void execute_crop(const Box &crop) {
+        HLOG(FATAL) << name() << " does not support execute_crop()";
+    }
+
     // Call the visitor's appropriate methods for this op, and any sub-ops.
     inline void accept(OpVisitor *v) const {
         return accept_impl(v);
@@ -309,6 +335,18 @@ public:
         return mutate_fn(std::move(op), m);
     }
 
+    // Make a copy of this op, and any sub-ops, for another instance of the
+    // model, using cloner to copy the tensors. The copy is ready to execute
+    // once its tensors are allocated; prepare() is not called again.
+    OpPtr clone(TensorCloner &cloner) const {
+        return clone_impl(cloner);
+    }
+
+    // An estimate of the number of arithmetic operations one execute() does,
+    // for reporting the throughput of the op. By default, one per element
+    // of the outputs.
+    virtual int64_t arithmetic_ops() const;
+
     virtual void dump(std::ostream &os, int indent = 0) const;
 
     virtual std::string name() const = 0;
@@ -328,6 +366,7 @@ public:
 
     // TODO: remove me
     void set_input(int idx, TensorPtr t);
+    void set_output(int idx, TensorPtr t);
 
     bool is_input(const TensorPtr &t) const;
     bool is_output(const TensorPtr &t) const;
@@ -339,9 +378,8 @@ public:
         return outputs_;
     }
 
-    // Neither movable nor copyable.
+    // Neither movable nor copyable, other than by clone().
     Op() = delete;
-    Op(const Op &) = delete;
     Op &operator=(const Op &) = delete;
     Op(Op &&) = delete;
     Op &operator=(Op &&) = delete;
@@ -349,6 +387,7 @@ public:
 private:
     virtual void accept_impl(OpVisitor *v) const = 0;
     virtual OpMutatorFn mutate_impl() const = 0;
+    virtual OpPtr clone_impl(TensorCloner &cloner) const = 0;
 };
 
 class OpGroup : public Op {
@@ -386,6 +425,8 @@ public:
         return ops_[i].get();
     }
 
+    int64_t arithmetic_ops() const override;
+
     void dump(std::ostream &os, int indent = 0) const override;
 
     std::string name() const override {
@@ -399,9 +440,71 @@ public:
     OpGroup(OpGroup &&) = delete;
     OpGroup &operator=(OpGroup &&) = delete;
 
+protected:
+    // Make a copy of op, using cloner to copy its tensors and ops. Like
+    // Op::clone_tensors(), this doesn't add the copy to the producers and
+    // consumers of constant tensors, which are shared with op.
+    OpGroup(const OpGroup &op, TensorCloner &cloner);
+
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
+};
+
+// An OpGroup of a chain of ops, each of which uses the output of the one
+// before it, that runs in tiles of rows (dimension 2) of the output of the
+// last op, much like compute_at in a Halide schedule. Each tile runs each op
+// on just the rows of its output needed for that tile, so the intermediate
+// tensors are used soon after they are produced, while they are still in
+// cache. Rows already computed for an earlier tile aren't computed again,
+// so this does no more work than running the ops one after another. The
+// intermediate tensors can also be folded (see fold_intermediates()), so
+// they only take the memory of the rows a tile needs.
+//
+// OpVisitors and OpMutators see this as an OpGroup; mutating it makes a
+// plain OpGroup, so this should be made after any other transforms.
+class TiledOpGroup : public OpGroup {
+    int tile_height_;
+
+    // The index of the input of each op that is the output of the op before it.
+    std::vector<int> chain_inputs_;
+
+public:
+    // Every op must support execute_crop().
+    TiledOpGroup(std::vector<TensorPtr> inputs, std::vector<TensorPtr> outputs, std::vector<OpPtr> ops, int tile_height);
+
+    int tile_height() const {
+        return tile_height_;
+    }
+    // This must not be called after fold_intermediates().
+    void set_tile_height(int tile_height) {
+        assert(tile_height > 0);
+        tile_height_ = tile_height;
+    }
+
+    // The regions of the outputs of each op needed to compute the region
+    // crop of the output of the last op.
+    std::vector<Box> required_crops(const Box &crop) const;
+
+    // Fold the (unallocated) outputs of the ops before the last, so only the
+    // rows that are needed at the same time are stored: the rows of a tile,
+    // plus the rows the next op reads again for the next tile. Returns the
+    // number of bytes this saves. Outputs that are aliased, or that can't
+    // be folded to fewer rows, are stored whole.
+    int64_t fold_intermediates();
+
+    void execute() override;
+
+    std::string name() const override {
+        return "TiledOpGroup";
+    }
+
+private:
+    // Make a copy of op, as for OpGroup.
+    TiledOpGroup(const TiledOpGroup &op, TensorCloner &cloner);
+
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 }  // namespace hannk
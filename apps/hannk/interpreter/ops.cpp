@@ -1,29 +1,41 @@
 #include <atomic>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <type_traits>
 
 #include "halide/add_uint8_uint8.h"
+#include "halide/average_pool_float32.h"
 #include "halide/average_pool_uint8.h"
 #include "halide/constants.h"
+#include "halide/conv_add_u8_u8_u8.h"
+#include "halide/conv_depthwise_u8_u8_u8.h"
+#include "halide/conv_f32_f32_f32.h"
 #include "halide/conv_u8_u8_i16.h"
 #include "halide/conv_u8_u8_u8.h"
 #ifdef CONV_R16
+#include "halide/conv_r16_add_u8_u8_u8.h"
+#include "halide/conv_r16_depthwise_u8_u8_u8.h"
 #include "halide/conv_r16_u8_u8_i16.h"
 #include "halide/conv_r16_u8_u8_u8.h"
 #endif
 #include "halide/copy_uint8_uint8.h"
 #include "halide/depthwise_conv_broadcast_uint8.h"
+#include "halide/depthwise_conv_float32.h"
 #include "halide/depthwise_conv_shallow_uint8.h"
 #include "halide/depthwise_conv_uint8.h"
 #include "halide/elementwise_5xint16_1xuint8int16.h"
 #include "halide/elementwise_5xuint8_1xuint8.h"
 #include "halide/fill_uint8.h"
 #include "halide/l2_normalization_uint8.h"
+#include "halide/max_pool_float32.h"
 #include "halide/max_pool_uint8.h"
 #include "halide/mean_uint8.h"
 #include "halide/mul_uint8_uint8_uint8.h"
 #include "halide/softmax_uint8.h"
+#include "halide/tile_conv_filter_float32.h"
 #include "halide/tile_conv_filter_uint8.h"
+#include "halide/upsample_channels_float32.h"
 #include "halide/upsample_channels_uint8.h"
 #include "interpreter/elementwise_program.h"
 #include "interpreter/ops.h"
@@ -318,6 +330,35 @@ void crop_to_union(HalideBuffer<T> &a, HalideBuffer<U> &b) {
     }
 }
 
+// Crop buf to the intersection of buf and box.
+template<typename T>
+void crop_to_intersection(HalideBuffer<T> &buf, const Box &box) {
+    assert(buf.dimensions() == (int)box.size());
+    for (int d = 0; d < buf.dimensions(); d++) {
+        int min = std::max(buf.dim(d).min(), box[d].min);
+        int max = std::min(buf.dim(d).max(), box[d].max);
+        buf.crop(d, min, max - min + 1);
+    }
+}
+
+// The buffer of input i of op, cropped to the region needed to compute the
+// region crop of the output.
+HalideBuffer<void> cropped_input(const Op *op, int i, const Box &crop) {
+    HalideBuffer<void> buf = op->input(i)->buffer();
+    crop_to_intersection(buf, op->map_bounds(i, 0).evaluate(crop));
+    return buf;
+}
+
+HalideBuffer<void> cropped_output(const Op *op, const Box &crop) {
+    HalideBuffer<void> buf = op->output()->buffer();
+    crop_to_intersection(buf, crop);
+    return buf;
+}
+
+bool same_bounds(const TensorPtr &a, const TensorPtr &b) {
+    return is_subset_of(a->bounds(), b->bounds()) && is_subset_of(b->bounds(), a->bounds());
+}
+
 // A type safe power of two.
 struct power_of_two {
     int value;
@@ -413,6 +454,29 @@ Interval get_output_range(ActivationFunction activation, const QuantizationInfo
     return output_range;
 }
 
+struct FloatInterval {
+    float min;
+    float max;
+};
+
+// The range of an unquantized output with the given activation.
+FloatInterval get_float_output_range(ActivationFunction activation) {
+    const float inf = std::numeric_limits<float>::infinity();
+    switch (activation) {
+    case ActivationFunction::None:
+        return {-inf, inf};
+    case ActivationFunction::Relu:
+        return {0.0f, inf};
+    case ActivationFunction::Relu6:
+        return {0.0f, 6.0f};
+    case ActivationFunction::ReluN1To1:
+        return {-1.0f, 1.0f};
+    default:
+        HLOG(FATAL) << "Unsupported float activation function type.";
+        return {-inf, inf};
+    }
+}
+
 struct MultiplyParams {
     int a_zero;
     int b_zero;
@@ -659,17 +723,11 @@ void BinaryOp::execute() {
     if (in1->type() == halide_type_of<uint8_t>() &&
         in2->type() == halide_type_of<uint8_t>() &&
         out->type() == halide_type_of<uint8_t>()) {
-        const auto &in1_buf = in1->buffer();
-        const auto &in2_buf = in2->buffer();
-        const auto &out_buf = out->buffer();
-
         switch (op_) {
         case Add:
         case Sub:
-            add_uint8(in1_buf, in1->quantization(), 1, in2_buf, in2->quantization(), op_ == Add ? 1 : -1, out_buf, out->quantization(), activation_);
-            return;
         case Mul:
-            mul_uint8(in1_buf, in1->quantization(), in2_buf, in2->quantization(), out_buf, out->quantization(), activation_);
+            execute_uint8(in1->buffer(), in2->buffer(), out->buffer());
             return;
         default:
             break;
@@ -720,6 +778,39 @@ void BinaryOp::execute() {
         << " for types " << in1->type() << ", " << in2->type() << ", " << out->type();
 }
 
+void BinaryOp::execute_uint8(const HalideBuffer<const void> &in1_buf, const HalideBuffer<const void> &in2_buf,
+                             const HalideBuffer<void> &out_buf) {
+    const TensorPtr &in1 = input(0);
+    const TensorPtr &in2 = input(1);
+    const TensorPtr &out = output();
+
+    switch (op_) {
+    case Add:
+    case Sub:
+        add_uint8(in1_buf, in1->quantization(), 1, in2_buf, in2->quantization(), op_ == Add ? 1 : -1, out_buf, out->quantization(), activation_);
+        break;
+    case Mul:
+        mul_uint8(in1_buf, in1->quantization(), in2_buf, in2->quantization(), out_buf, out->quantization(), activation_);
+        break;
+    default:
+        HLOG(FATAL) << "Unsupported binary op " << to_string(op_) << " for uint8";
+    }
+}
+
+bool BinaryOp::can_execute_crop() const {
+    // Inputs that are broadcast would need different crops than the output.
+    return (op_ == Add || op_ == Sub || op_ == Mul) &&
+           input(0)->type() == halide_type_of<uint8_t>() &&
+           input(1)->type() == halide_type_of<uint8_t>() &&
+           output()->type() == halide_type_of<uint8_t>() &&
+           same_bounds(input(0), output()) &&
+           same_bounds(input(1), output());
+}
+
+void BinaryOp::execute_crop(const Box &crop) {
+    execute_uint8(cropped_input(this, 0, crop), cropped_input(this, 1, crop), cropped_output(this, crop));
+}
+
 BoundsMap ConcatenationOp::map_bounds(int input_idx, int output_idx) const {
     int rank = output()->rank();
     assert(rank == input(input_idx)->rank());
@@ -763,6 +854,10 @@ halide_type_t ConvOp::filter_type() const {
                output()->type() == halide_type_of<int16_t>()) {
         const halide_filter_metadata_t *metadata = conv_u8_u8_i16_metadata();
         return metadata->arguments[2].type;
+    } else if (input()->type() == halide_type_of<float>() &&
+               output()->type() == halide_type_of<float>()) {
+        const halide_filter_metadata_t *metadata = conv_f32_f32_f32_metadata();
+        return metadata->arguments[1].type;
     } else {
         HLOG(FATAL) << "Unsupported type " << output()->type() << "\n";
         return halide_type_t(halide_type_int, 0, 0);
@@ -774,7 +869,8 @@ BoundsMap ConvOp::map_bounds(int input_idx, int output_idx) const {
     assert(vector_tile_ > 0);
 
 #ifdef CONV_R16
-    const int unroll_reduction = filter()->extent(0) >= 16 ? 16 : 4;
+    const bool use_r16 = filter()->extent(0) >= 16 && input()->type() != halide_type_of<float>();
+    const int unroll_reduction = use_r16 ? 16 : 4;
 #else
     const int unroll_reduction = 4;
 #endif
@@ -799,9 +895,11 @@ BoundsMap ConvOp::map_bounds(int input_idx, int output_idx) const {
             result.constant(i + 3, filter()->bounds(i));
         }
         return result;
-    } else {
-        assert(input_idx == 2);
+    } else if (input_idx == 2) {
         return BoundsMap(1, output()->rank()).elementwise(0, 0);
+    } else {
+        assert(input_idx == 3);
+        return BoundsMap::elementwise(output()->rank());
     }
 }
 
@@ -831,10 +929,68 @@ void call_conv2d(halide_buffer_t *input, halide_buffer_t *filter, halide_buffer_
        output);
 }
 
+struct AddParams {
+    int a_multiplier;
+    int b_zero;
+    int b_multiplier;
+    int c_zero;
+    Interval c_range;
+};
+
+// The parameters for the add in a fused conv + add; these are the same as
+// add_uint8 would use.
+AddParams get_quantized_add_params(const QuantizationInfo &a, int a_sign, const QuantizationInfo &b, int b_sign,
+                                   const QuantizationInfo &c, ActivationFunction activation) {
+    const float a_scale = a.uniform_scale() * (1 << add_output_shift);
+    const float b_scale = b.uniform_scale() * (1 << add_output_shift);
+    const float c_scale = c.uniform_scale() * (1 << add_input_shift);
+
+    AddParams result;
+    result.a_multiplier = std::lround(a_scale / c_scale) * a_sign;
+    result.b_zero = b.uniform_zero();
+    result.b_multiplier = std::lround(b_scale / c_scale) * b_sign;
+    result.c_zero = c.uniform_zero();
+    result.c_range = get_output_range(activation, c);
+    return result;
+}
+
+void call_conv2d_add(halide_buffer_t *input, halide_buffer_t *filter, halide_buffer_t *bias,
+                     const MultiplyParams &params, const std::array<int, 2> &stride,
+                     const std::array<int, 2> &dilation, const Interval &conv_range,
+                     halide_buffer_t *addend, const AddParams &add_params, halide_buffer_t *output) {
+    using Conv2DAddFn = decltype(&::hannk::conv_add_u8_u8_u8);
+
+    Conv2DAddFn fn = hannk::conv_add_u8_u8_u8;
+#ifdef CONV_R16
+    if (input->dim[0].extent >= 16) {
+        // As in call_conv2d.
+        fn = hannk::conv_r16_add_u8_u8_u8;
+    }
+#endif
+    fn(input, (uint8_t)params.a_zero, filter, (uint8_t)params.b_zero, bias,
+       stride[0], stride[1], dilation[0], dilation[1], params.c.mantissa(),
+       -params.c.exponent(), (uint8_t)params.c_zero, conv_range.min, conv_range.max,
+       add_params.a_multiplier, addend, (uint8_t)add_params.b_zero, add_params.b_multiplier,
+       (uint8_t)add_params.c_zero, add_params.c_range.min, add_params.c_range.max, output);
+}
+
 }  // namespace
 
 bool ConvOp::prepare() {
     // Pass minimal sized buffers to learn about the alignment requirements.
+    if (input()->type() == halide_type_of<float>()) {
+        HalideBuffer<float, 4> input_buf(nullptr, 1, 1, 1, 1);
+        HalideBuffer<float, 1> bias_buf(nullptr, 1);
+        HalideBuffer<float, 6> filter_buf(nullptr, 1, 1, 1, 1, 1, 1);
+        HalideBuffer<float, 4> output_buf(nullptr, 1, 1, 1, 1);
+        if (conv_f32_f32_f32(input_buf, filter_buf, bias_buf, 1, 1, 1, 1, 0.0f, 0.0f, output_buf) != 0) {
+            return false;
+        }
+        vector_reduction_ = filter_buf.dim(0).extent();
+        vector_tile_ = filter_buf.dim(1).extent();
+        return true;
+    }
+
     // TODO: need to adapt this to the types of in, filt, out once we support multiple variants
     HalideBuffer<uint8_t, 4> input_buf(nullptr, 1, 1, 1, 1);
     HalideBuffer<int32_t, 1> bias_buf(nullptr, 1);
@@ -850,56 +1006,115 @@ bool ConvOp::prepare() {
 }
 
 void ConvOp::execute() {
+    execute_impl(input()->buffer(), has_addend() ? addend()->buffer() : HalideBuffer<void>(), output()->buffer());
+}
+
+bool ConvOp::can_execute_crop() const {
+    if (input()->type() == halide_type_of<float>()) {
+        return output()->type() == halide_type_of<float>();
+    }
+    return input()->type() == halide_type_of<uint8_t>() &&
+           (output()->type() == halide_type_of<uint8_t>() || output()->type() == halide_type_of<int16_t>());
+}
+
+void ConvOp::execute_crop(const Box &crop) {
+    execute_impl(cropped_input(this, 0, crop), has_addend() ? cropped_input(this, 3, crop) : HalideBuffer<void>(),
+                 cropped_output(this, crop));
+}
+
+int64_t ConvOp::arithmetic_ops() const {
+    // A multiply and an add for each input channel and filter tap of each
+    // output. pad_for_ops tiles the filter, which adds two dimensions before
+    // the spatial ones.
+    const int spatial_offset = filter()->rank() > input()->rank() ? 3 : 0;
+    int64_t taps = input()->extent(0);
+    for (int i = 1; i < input()->rank() - 1; i++) {
+        taps *= filter()->extent(i + spatial_offset);
+    }
+    return 2 * taps * output()->number_of_elements();
+}
+
+void ConvOp::execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> addend_buf, HalideBuffer<void> output_buf) {
     const TensorPtr &in = input();
     const TensorPtr &filt = filter();
     const TensorPtr &out = output();
 
-    if (in->type() == halide_type_of<uint8_t>() &&
-        (out->type() == halide_type_of<uint8_t>() || out->type() == halide_type_of<int16_t>())) {
-        auto input_buf = in->buffer();
-        auto filter_buf = filt->buffer();
-        auto bias_buf = bias()->buffer();
-        auto output_buf = out->buffer();
-
-        MultiplyParams params =
-            get_quantized_multiply_params(in->quantization(), filt->quantization(), out->quantization());
+    const bool is_uint8 = in->type() == halide_type_of<uint8_t>() &&
+                          (out->type() == halide_type_of<uint8_t>() || out->type() == halide_type_of<int16_t>());
+    const bool is_float = in->type() == halide_type_of<float>() && out->type() == halide_type_of<float>();
+    if (!is_uint8 && !is_float) {
+        HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
+    }
 
-        const auto output_range = get_output_range(activation_, out->quantization());
+    auto filter_buf = filt->buffer();
+    auto bias_buf = bias()->buffer();
 
-        // Pad with dummy dimensions up to 2D.
-        while (input_buf.dimensions() < 4) {
-            input_buf.embed(input_buf.dimensions() - 1, 1);
-            output_buf.embed(output_buf.dimensions() - 1, 1);
-            filter_buf.add_dimension();
+    // Pad with dummy dimensions up to 2D.
+    while (input_buf.dimensions() < 4) {
+        input_buf.embed(input_buf.dimensions() - 1, 1);
+        output_buf.embed(output_buf.dimensions() - 1, 1);
+        if (has_addend()) {
+            addend_buf.embed(addend_buf.dimensions() - 1, 1);
         }
-
-        assert(filter_buf.dimensions() == 6);
-        const int filter_width = filter_buf.dim(4).extent();
-        const int filter_height = filter_buf.dim(5).extent();
-        if (filter_width == 1 && filter_height == 1) {
-            // For 1x1 filters, we can fuse x and y, which can help avoid overhead for
-            // small output sizes.
-            // TODO: Maybe we can just treat all of x, y, b as batch dimensions and fuse
-            // them all where possible, which might be a further improvement.
-            while (can_fuse_xy(FuseType::Pad, input_buf) &&
-                   can_fuse_xy(FuseType::Pad, output_buf) &&
-                   input_buf.dim(1).extent() == output_buf.dim(1).extent()) {
-                fuse_xy(FuseType::Pad, input_buf);
-                fuse_xy(FuseType::Pad, output_buf);
+        filter_buf.add_dimension();
+    }
+
+    assert(filter_buf.dimensions() == 6);
+    const int filter_width = filter_buf.dim(4).extent();
+    const int filter_height = filter_buf.dim(5).extent();
+    if (filter_width == 1 && filter_height == 1) {
+        // For 1x1 filters, we can fuse x and y, which can help avoid overhead for
+        // small output sizes.
+        // TODO: Maybe we can just treat all of x, y, b as batch dimensions and fuse
+        // them all where possible, which might be a further improvement.
+        while (can_fuse_xy(FuseType::Pad, input_buf) &&
+               can_fuse_xy(FuseType::Pad, output_buf) &&
+               (!has_addend() || can_fuse_xy(FuseType::Pad, addend_buf)) &&
+               input_buf.dim(1).extent() == output_buf.dim(1).extent()) {
+            fuse_xy(FuseType::Pad, input_buf);
+            fuse_xy(FuseType::Pad, output_buf);
+            if (has_addend()) {
+                fuse_xy(FuseType::Pad, addend_buf);
             }
+        }
 
-            if (output_buf.dim(1).extent() < output_buf.dim(2).extent()) {
-                // Some networks have shapes with very small x and large y that we can't fuse.
-                // This case is bad for us because we tile the x dimension. It would be better
-                // if we tiled y instead. We can do this by just swapping the x and y dimensions.
-                input_buf.transpose(1, 2);
-                output_buf.transpose(1, 2);
+        if (output_buf.dim(1).extent() < output_buf.dim(2).extent()) {
+            // Some networks have shapes with very small x and large y that we can't fuse.
+            // This case is bad for us because we tile the x dimension. It would be better
+            // if we tiled y instead. We can do this by just swapping the x and y dimensions.
+            input_buf.transpose(1, 2);
+            output_buf.transpose(1, 2);
+            if (has_addend()) {
+                addend_buf.transpose(1, 2);
             }
         }
+    }
 
-        call_conv2d(input_buf, filter_buf, bias_buf, params, stride_, dilation_, output_range, output_buf);
+    if (is_float) {
+        // fuse_ops only fuses adds into quantized convs.
+        assert(!has_addend());
+        const auto output_range = get_float_output_range(activation_);
+        conv_f32_f32_f32(input_buf, filter_buf, bias_buf, stride_[0], stride_[1], dilation_[0], dilation_[1],
+                         output_range.min, output_range.max, output_buf);
+        return;
+    }
+
+    // If there is an addend, the conv's own result is requantized as
+    // the tensor we fused away would have been.
+    const QuantizationInfo &conv_quantization = has_addend() ? conv_quantization_ : out->quantization();
+    MultiplyParams params =
+        get_quantized_multiply_params(in->quantization(), filt->quantization(), conv_quantization);
+
+    const auto output_range = get_output_range(activation_, conv_quantization);
+
+    if (has_addend()) {
+        const AddParams add_params =
+            get_quantized_add_params(conv_quantization_, conv_sign_, addend()->quantization(), addend_sign_,
+                                     out->quantization(), add_activation_);
+        call_conv2d_add(input_buf, filter_buf, bias_buf, params, stride_, dilation_, output_range,
+                        addend_buf, add_params, output_buf);
     } else {
-        HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
+        call_conv2d(input_buf, filter_buf, bias_buf, params, stride_, dilation_, output_range, output_buf);
     }
 }
 
@@ -952,7 +1167,7 @@ BoundsMap DepthwiseConv2DOp::map_bounds(int input_idx, int output_idx) const {
             .downsample(2, 2, stride_[1], Interval(0, dilation_[1] * (filter()->extent(2) - 1)))
             .elementwise(3, 3);
         if (depth_multiplier_ == 1) {
-            if (stride_[0] == 1 &&
+            if (stride_[0] == 1 && input()->type() == halide_type_of<uint8_t>() &&
                 can_be_shallow(channel_alignment_, input()->extent(0), input()->extent(1))) {
                 // We can use the shallow version of depthwise here.
             } else {
@@ -974,6 +1189,18 @@ BoundsMap DepthwiseConv2DOp::map_bounds(int input_idx, int output_idx) const {
 
 bool DepthwiseConv2DOp::prepare() {
     // Pass minimal sized buffers to learn about the alignment requirements.
+    if (input()->type() == halide_type_of<float>()) {
+        HalideBuffer<float, 4> input_buf(nullptr, 1, 1, 1, 1);
+        HalideBuffer<float, 1> bias_buf(nullptr, 1);
+        HalideBuffer<float, 3> filter_buf(nullptr, 1, 1, 1);
+        HalideBuffer<float, 4> output_buf(nullptr, 1, 1, 1, 1);
+        if (depthwise_conv_float32(input_buf, filter_buf, bias_buf, 1, 1, 1, 1, 0.0f, 0.0f, output_buf) != 0) {
+            return false;
+        }
+        channel_alignment_ = input_buf.dim(0).extent();
+        return true;
+    }
+
     // TODO: need to adapt this to the types of in, filt, out once we support multiple variants
     HalideBuffer<uint8_t, 4> input_buf(nullptr, 1, 1, 1, 1);
     HalideBuffer<int32_t, 1> bias_buf(nullptr, 1);
@@ -987,6 +1214,30 @@ bool DepthwiseConv2DOp::prepare() {
 }
 
 void DepthwiseConv2DOp::execute() {
+    execute_impl(input()->buffer(), output()->buffer());
+}
+
+bool DepthwiseConv2DOp::can_execute_crop() const {
+    if (input()->type() == halide_type_of<float>()) {
+        return filter()->type() == halide_type_of<float>() &&
+               output()->type() == halide_type_of<float>();
+    }
+    return input()->type() == halide_type_of<uint8_t>() &&
+           filter()->type() == halide_type_of<uint8_t>() &&
+           output()->type() == halide_type_of<uint8_t>();
+}
+
+void DepthwiseConv2DOp::execute_crop(const Box &crop) {
+    execute_impl(cropped_input(this, 0, crop), cropped_output(this, crop));
+}
+
+int64_t DepthwiseConv2DOp::arithmetic_ops() const {
+    // A multiply and an add for each filter tap of each output.
+    const int64_t taps = (int64_t)filter()->extent(1) * filter()->extent(2);
+    return 2 * taps * output()->number_of_elements();
+}
+
+void DepthwiseConv2DOp::execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> output_buf) {
     const TensorPtr &in = input();
     const TensorPtr &filt = filter();
     const TensorPtr &out = output();
@@ -994,10 +1245,8 @@ void DepthwiseConv2DOp::execute() {
     if (in->type() == halide_type_of<uint8_t>() &&
         filt->type() == halide_type_of<uint8_t>() &&
         out->type() == halide_type_of<uint8_t>()) {
-        auto input_buf = in->buffer();
         auto filter_buf = filt->buffer().sliced(3, 0);
         auto bias_buf = bias()->buffer();
-        auto output_buf = out->buffer();
 
         MultiplyParams params =
             get_quantized_multiply_params(in->quantization(), filt->quantization(), out->quantization());
@@ -1021,6 +1270,18 @@ void DepthwiseConv2DOp::execute() {
         assert(depth_multiplier_ == 1 || depth_multiplier_ >= out->extent(0));
         call_depthwise_conv_uint8(input_buf, filter_buf, bias_buf, params,
                                   stride_, dilation_, input_stride_x, output_range, output_buf);
+    } else if (in->type() == halide_type_of<float>() &&
+               filt->type() == halide_type_of<float>() &&
+               out->type() == halide_type_of<float>()) {
+        auto filter_buf = filt->buffer().sliced(3, 0);
+        auto bias_buf = bias()->buffer();
+
+        const auto output_range = get_float_output_range(activation_);
+
+        // pad_for_ops always upsamples the input of float depthwise convs.
+        assert(depth_multiplier_ == 1);
+        depthwise_conv_float32(input_buf, filter_buf, bias_buf, stride_[0], stride_[1], dilation_[0], dilation_[1],
+                               output_range.min, output_range.max, output_buf);
     } else {
         HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
     }
@@ -1249,56 +1510,94 @@ void PadOp::execute() {
         out->resize_dynamic(new_shape);
     }
 
-    if (out->type().bytes() == 1) {
-        auto input_buf = in->buffer();
-        auto output_buf = out->buffer();
+    execute_impl(in->buffer(), out->buffer());
+}
 
-        const int dims = input_buf.dimensions();
-        for (int d = 0; d < input_buf.dimensions(); d++) {
-            const int idx = dims - d - 1;
-            input_buf.translate(d, padding_buf(0, idx));
+bool PadOp::can_execute_crop() const {
+    const bool supported_type = output()->type().bytes() == 1 || output()->type() == halide_type_of<float>();
+    if (output()->is_dynamic() || !supported_type || !input(1) || !input(1)->is_constant()) {
+        return false;
+    }
+    // map_bounds doesn't account for the padding before, which is only a
+    // superset of what is needed when that padding isn't negative.
+    const auto &padding_buf = input(1)->buffer<const int32_t>();
+    for (int d = 0; d < padding_buf.dim(1).extent(); d++) {
+        if (padding_buf(0, d) < 0) {
+            return false;
         }
+    }
+    return true;
+}
 
-        uint8_t pad_value = in->quantization().uniform_zero();
+void PadOp::execute_crop(const Box &crop) {
+    // The input is translated by the padding below, and the copy only reads
+    // the part of it that it needs, so don't crop it.
+    execute_impl(input(0)->buffer(), cropped_output(this, crop));
+}
+
+void PadOp::execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> output_buf) {
+    const TensorPtr &in = input(0);
+    const TensorPtr &padding = input(1);
+    const TensorPtr &out = output();
 
-        // TODO: should we pad_to_rank(4) the input and output bufs before the loop?
+    const bool is_float = out->type() == halide_type_of<float>();
+    if (out->type().bytes() != 1 && !is_float) {
+        HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
+    }
 
-        int fill_min_dim = 0;
-        if (input_buf.dim(0).extent() == 3 && output_buf.dim(0).extent() == 4) {
-            // copy can handle padding dimension 0, which is much faster than
-            // filling the extra channel for interleaved 3/4 channel paddings.
-            fill_min_dim = 1;
+    const auto &padding_buf = padding->buffer<const int32_t>();
+    const int dims = input_buf.dimensions();
+    for (int d = 0; d < input_buf.dimensions(); d++) {
+        const int idx = dims - d - 1;
+        input_buf.translate(d, padding_buf(0, idx));
+    }
+
+    // Quantized tensors are padded with the zero point, float tensors with 0.
+    const uint8_t pad_value = is_float ? 0 : in->quantization().uniform_zero();
+    auto fill = [&](HalideBuffer<void> buf) {
+        pad_to_rank(4, buf);
+        if (is_float) {
+            buf.as<float>().fill(0.0f);
+        } else {
+            fill_uint8(pad_value, buf);
         }
-        for (int d = output_buf.dimensions() - 1; d >= fill_min_dim; d--) {
-            int input_min = input_buf.dim(d).min();
-            int output_min = output_buf.dim(d).min();
-            int input_max = input_buf.dim(d).max();
-            int output_max = output_buf.dim(d).max();
-            if (output_min < input_min) {
-                auto before = output_buf.cropped(d, output_min, input_min - output_min);
-                pad_to_rank(4, before);
-                fill_uint8(pad_value, before);
-            } else {
-                input_min = output_min;
-            }
-            if (output_max > input_max) {
-                auto after = output_buf.cropped(d, input_max + 1, output_max - input_max);
-                pad_to_rank(4, after);
-                fill_uint8(pad_value, after);
-            } else {
-                input_max = output_max;
-            }
-            output_buf.crop(d, input_min, input_max - input_min + 1);
+    };
+
+    // TODO: should we pad_to_rank(4) the input and output bufs before the loop?
+
+    int fill_min_dim = 0;
+    if (!is_float && input_buf.dim(0).extent() == 3 && output_buf.dim(0).extent() == 4) {
+        // copy can handle padding dimension 0, which is much faster than
+        // filling the extra channel for interleaved 3/4 channel paddings.
+        fill_min_dim = 1;
+    }
+    for (int d = output_buf.dimensions() - 1; d >= fill_min_dim; d--) {
+        int input_min = input_buf.dim(d).min();
+        int output_min = output_buf.dim(d).min();
+        int input_max = input_buf.dim(d).max();
+        int output_max = output_buf.dim(d).max();
+        if (output_min < input_min) {
+            fill(output_buf.cropped(d, output_min, input_min - output_min));
+        } else {
+            input_min = output_min;
         }
-        if (!is_alias(input_buf, output_buf) ||
-            input_buf.dim(0).min() > output_buf.dim(0).min() ||
-            input_buf.dim(0).max() < output_buf.dim(0).max()) {
+        if (output_max > input_max) {
+            fill(output_buf.cropped(d, input_max + 1, output_max - input_max));
+        } else {
+            input_max = output_max;
+        }
+        output_buf.crop(d, input_min, input_max - input_min + 1);
+    }
+    if (!is_alias(input_buf, output_buf) ||
+        input_buf.dim(0).min() > output_buf.dim(0).min() ||
+        input_buf.dim(0).max() < output_buf.dim(0).max()) {
+        if (is_float) {
+            output_buf.copy_from(input_buf);
+        } else {
             pad_to_rank(4, input_buf);
             pad_to_rank(4, output_buf);
             copy_uint8_uint8(input_buf, pad_value, output_buf);
         }
-    } else {
-        HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
     }
 }
 
@@ -1337,35 +1636,118 @@ void Pool2DOp::execute() {
     const TensorPtr &in = input();
     const TensorPtr &out = output();
 
-    if (in->type() == halide_type_of<uint8_t>() &&
-        out->type() == halide_type_of<uint8_t>()) {
-        auto input_buf = in->buffer();
-        auto output_buf = out->buffer();
+    const bool is_uint8 = in->type() == halide_type_of<uint8_t>() && out->type() == halide_type_of<uint8_t>();
+    const bool is_float = in->type() == halide_type_of<float>() && out->type() == halide_type_of<float>();
+    if (!is_uint8 && !is_float) {
+        HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
+    }
 
-        const auto output_range = get_output_range(activation_, out->quantization());
+    auto input_buf = in->buffer();
+    auto output_buf = out->buffer();
 
-        const int in_width = input_buf.dim(1).extent();
-        const int in_height = input_buf.dim(2).extent();
-        const int out_width = output_buf.dim(1).extent();
-        const int out_height = output_buf.dim(2).extent();
-        input_buf.translate(1, compute_padding(stride_[0], in_width, filter_size_[0], out_width));
-        input_buf.translate(2, compute_padding(stride_[1], in_height, filter_size_[1], out_height));
+    const int in_width = input_buf.dim(1).extent();
+    const int in_height = input_buf.dim(2).extent();
+    const int out_width = output_buf.dim(1).extent();
+    const int out_height = output_buf.dim(2).extent();
+    input_buf.translate(1, compute_padding(stride_[0], in_width, filter_size_[0], out_width));
+    input_buf.translate(2, compute_padding(stride_[1], in_height, filter_size_[1], out_height));
 
+    if (is_float) {
+        const auto output_range = get_float_output_range(activation_);
         switch (op_) {
         case Average:
-            average_pool_uint8(input_buf, stride_[0], stride_[1], filter_size_[0], filter_size_[1],
-                               output_range.min, output_range.max, output_buf);
+            average_pool_float32(input_buf, stride_[0], stride_[1], filter_size_[0], filter_size_[1],
+                                 output_range.min, output_range.max, output_buf);
             break;
         case Max:
-            max_pool_uint8(input_buf, stride_[0], stride_[1], filter_size_[0], filter_size_[1],
-                           output_range.min, output_range.max, output_buf);
+            max_pool_float32(input_buf, stride_[0], stride_[1], filter_size_[0], filter_size_[1],
+                             output_range.min, output_range.max, output_buf);
             break;
         }
-    } else {
-        HLOG(FATAL) << "Unsupported type " << out->type() << "\n";
+        return;
+    }
+
+    const auto output_range = get_output_range(activation_, out->quantization());
+
+    switch (op_) {
+    case Average:
+        average_pool_uint8(input_buf, stride_[0], stride_[1], filter_size_[0], filter_size_[1],
+                           output_range.min, output_range.max, output_buf);
+        break;
+    case Max:
+        max_pool_uint8(input_buf, stride_[0], stride_[1], filter_size_[0], filter_size_[1],
+                       output_range.min, output_range.max, output_buf);
+        break;
     }
 }
 
+int64_t Pool2DOp::arithmetic_ops() const {
+    // An add or a max for each filter tap of each output.
+    const int64_t taps = (int64_t)filter_size_[0] * filter_size_[1];
+    return taps * output()->number_of_elements();
+}
+
+namespace {
+
+// Requantize with a scalar loop. The zero points and scales of float tensors
+// are 0 and 1.
+template<typename TIn, typename TOut>
+bool try_quantize(const HalideBuffer<const void> &in_buf, const QuantizationInfo &inq,
+                  const HalideBuffer<void> &out_buf, const QuantizationInfo &outq) {
+    if (in_buf.type() != halide_type_of<TIn>() || out_buf.type() != halide_type_of<TOut>()) {
+        return false;
+    }
+    const bool in_float = std::is_floating_point<TIn>::value;
+    const bool out_float = std::is_floating_point<TOut>::value;
+    const float in_zero = in_float ? 0.0f : inq.uniform_zero();
+    const float out_zero = out_float ? 0.0f : outq.uniform_zero();
+    const float scale = (in_float ? 1.0f : inq.uniform_scale()) / (out_float ? 1.0f : outq.uniform_scale());
+
+    const auto quantize = [&](TIn in, TOut &out) {
+        const float value = (in - in_zero) * scale + out_zero;
+        if (out_float) {
+            out = (TOut)value;
+        } else {
+            const float out_min = std::numeric_limits<TOut>::min();
+            const float out_max = std::numeric_limits<TOut>::max();
+            out = (TOut)std::min(std::max(std::round(value), out_min), out_max);
+        }
+    };
+    scalar_elementwise_loop_nest(quantize, in_buf.as<const TIn>(), out_buf.as<TOut>());
+    return true;
+}
+
+}  // namespace
+
+void QuantizeOp::execute() {
+    execute_impl(input()->buffer(), output()->buffer());
+}
+
+bool QuantizeOp::can_execute_crop() const {
+    return true;
+}
+
+void QuantizeOp::execute_crop(const Box &crop) {
+    execute_impl(cropped_input(this, 0, crop), cropped_output(this, crop));
+}
+
+void QuantizeOp::execute_impl(const HalideBuffer<const void> &input_buf, const HalideBuffer<void> &output_buf) {
+    const QuantizationInfo &inq = input()->quantization();
+    const QuantizationInfo &outq = output()->quantization();
+    if (try_quantize<uint8_t, uint8_t>(input_buf, inq, output_buf, outq) ||
+        try_quantize<uint8_t, int8_t>(input_buf, inq, output_buf, outq) ||
+        try_quantize<int8_t, uint8_t>(input_buf, inq, output_buf, outq) ||
+        try_quantize<int8_t, int8_t>(input_buf, inq, output_buf, outq) ||
+        try_quantize<float, uint8_t>(input_buf, inq, output_buf, outq) ||
+        try_quantize<float, int8_t>(input_buf, inq, output_buf, outq) ||
+        try_quantize<uint8_t, float>(input_buf, inq, output_buf, outq) ||
+        try_quantize<int8_t, float>(input_buf, inq, output_buf, outq)) {
+        return;
+    }
+    HLOG(FATAL)
+        << "Unsupported QuantizeOp for types " << input()->type() << ", " << output()->type();
+}
+
 const char *ReductionOp::to_string(Operator op) {
     switch (op) {
     case Mean:
@@ -1523,6 +1905,116 @@ void ReshapeOp::execute() {
     }
 }
 
+BoundsMap SeparableConvOp::map_bounds(int input_idx, int output_idx) const {
+    assert(output_idx == 0);
+
+    if (input_idx == 0) {
+        // The 1x1 conv needs all of the channels of the depthwise conv, at the
+        // same x, y as its output.
+        BoundsMap result(4, 4);
+        result
+            .constant(0, input()->bounds(0))
+            .downsample(1, 1, depthwise_stride_[0], Interval(0, depthwise_dilation_[0] * (depthwise_filter()->extent(1) - 1)))
+            .downsample(2, 2, depthwise_stride_[1], Interval(0, depthwise_dilation_[1] * (depthwise_filter()->extent(2) - 1)))
+            .elementwise(3, 3);
+        return result;
+    } else if (input_idx == 1) {
+        return BoundsMap(3, 4)
+            .constant(0, depthwise_filter()->bounds(0))
+            .constant(1, depthwise_filter()->bounds(1))
+            .constant(2, depthwise_filter()->bounds(2));
+    } else if (input_idx == 2) {
+        return BoundsMap(1, 4).constant(0, depthwise_bias()->bounds(0));
+    } else if (input_idx == 3) {
+        BoundsMap result(filter()->rank(), 4);
+        for (int i = 0; i < filter()->rank(); i++) {
+            result.constant(i, filter()->bounds(i));
+        }
+        return result;
+    } else {
+        assert(input_idx == 4);
+        return BoundsMap(1, 4).elementwise(0, 0);
+    }
+}
+
+namespace {
+
+void call_conv2d_depthwise(halide_buffer_t *input, halide_buffer_t *depthwise_filter, halide_buffer_t *depthwise_bias,
+                           const MultiplyParams &depthwise_params, const std::array<int, 2> &depthwise_stride,
+                           const std::array<int, 2> &depthwise_dilation, const Interval &depthwise_range,
+                           halide_buffer_t *filter, halide_buffer_t *bias, const MultiplyParams &params,
+                           const Interval &output_range, halide_buffer_t *output) {
+    using Conv2DDepthwiseFn = decltype(&::hannk::conv_depthwise_u8_u8_u8);
+
+    Conv2DDepthwiseFn fn = hannk::conv_depthwise_u8_u8_u8;
+#ifdef CONV_R16
+    if (filter->dim[0].extent * filter->dim[2].extent >= 16) {
+        // As in call_conv2d, but the input of the 1x1 conv is the result of
+        // the depthwise conv, so use the depth of the tiled filter instead.
+        fn = hannk::conv_r16_depthwise_u8_u8_u8;
+    }
+#endif
+    // The 1x1 conv has a stride and dilation of 1.
+    fn(input, (uint8_t)params.a_zero, filter, (uint8_t)params.b_zero, bias,
+       1, 1, 1, 1, params.c.mantissa(), -params.c.exponent(), (uint8_t)params.c_zero,
+       output_range.min, output_range.max,
+       (uint8_t)depthwise_params.a_zero, depthwise_filter, (uint8_t)depthwise_params.b_zero, depthwise_bias,
+       depthwise_stride[0], depthwise_stride[1], depthwise_dilation[0], depthwise_dilation[1],
+       depthwise_params.c.mantissa(), -depthwise_params.c.exponent(),
+       depthwise_range.min, depthwise_range.max, output);
+}
+
+}  // namespace
+
+void SeparableConvOp::execute() {
+    execute_impl(input()->buffer(), output()->buffer());
+}
+
+bool SeparableConvOp::can_execute_crop() const {
+    return input()->type() == halide_type_of<uint8_t>() &&
+           depthwise_filter()->type() == halide_type_of<uint8_t>() &&
+           output()->type() == halide_type_of<uint8_t>();
+}
+
+void SeparableConvOp::execute_crop(const Box &crop) {
+    execute_impl(cropped_input(this, 0, crop), cropped_output(this, crop));
+}
+
+int64_t SeparableConvOp::arithmetic_ops() const {
+    // The depthwise conv computes each channel of its result at each output
+    // x, y, then the 1x1 conv reduces over those channels.
+    const int64_t depthwise_taps = (int64_t)depthwise_filter()->extent(1) * depthwise_filter()->extent(2);
+    const int64_t depthwise_elements = output()->number_of_elements() / output()->extent(0) * depthwise_filter()->extent(0);
+    return 2 * depthwise_taps * depthwise_elements +
+           2 * (int64_t)depthwise_filter()->extent(0) * output()->number_of_elements();
+}
+
+void SeparableConvOp::execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> output_buf) {
+    const TensorPtr &in = input();
+    const TensorPtr &depthwise_filt = depthwise_filter();
+    const TensorPtr &filt = filter();
+    const TensorPtr &out = output();
+
+    assert(in->type() == halide_type_of<uint8_t>() && out->type() == halide_type_of<uint8_t>());
+
+    auto depthwise_filter_buf = depthwise_filt->buffer().sliced(3, 0);
+    auto depthwise_bias_buf = depthwise_bias()->buffer();
+    auto filter_buf = filt->buffer();
+    auto bias_buf = bias()->buffer();
+
+    MultiplyParams depthwise_params =
+        get_quantized_multiply_params(in->quantization(), depthwise_filt->quantization(), depthwise_quantization_);
+    const auto depthwise_range = get_output_range(depthwise_activation_, depthwise_quantization_);
+
+    MultiplyParams params =
+        get_quantized_multiply_params(depthwise_quantization_, filt->quantization(), out->quantization());
+    const auto output_range = get_output_range(activation_, out->quantization());
+
+    call_conv2d_depthwise(input_buf, depthwise_filter_buf, depthwise_bias_buf, depthwise_params,
+                          depthwise_stride_, depthwise_dilation_, depthwise_range,
+                          filter_buf, bias_buf, params, output_range, output_buf);
+}
+
 BoundsMap ShapeOp::map_bounds(int input_idx, int output_idx) const {
     assert(input_idx == 0);
     assert(output_idx == 0);
@@ -1725,6 +2217,16 @@ void TileConvFilterOp::execute() {
         }
 
         tile_conv_filter_uint8(input_buf, input_zero, output_zero, output_buf);
+    } else if (in->type() == halide_type_of<float>()) {
+        auto input_buf = in->buffer();
+        auto output_buf = out->buffer();
+
+        while (input_buf.dimensions() < 4) {
+            input_buf.embed(input_buf.dimensions() - 1, 0);
+            output_buf.add_dimension();
+        }
+
+        tile_conv_filter_float32(input_buf, output_buf);
     } else {
         HLOG(FATAL) << "Unsupported type " << in->type() << "\n";
     }
@@ -1871,6 +2373,11 @@ void UpsampleChannelsOp::execute() {
         auto out_buf = out->buffer();
         upsample_channels_uint8(in_buf, factor_, out_buf);
         return;
+    } else if (in->type() == halide_type_of<float>() && out->type() == halide_type_of<float>()) {
+        auto in_buf = in->buffer();
+        auto out_buf = out->buffer();
+        upsample_channels_float32(in_buf, factor_, out_buf);
+        return;
     }
     HLOG(FATAL)
         << "Unsupported UpsampleChannels op for types " << in->type() << ", " << out->type();
@@ -1896,12 +2403,14 @@ ACCEPT_AND_MUTATE_IMPL(GatherOp)
 ACCEPT_AND_MUTATE_IMPL(L2NormalizationOp)
 ACCEPT_AND_MUTATE_IMPL(PadOp)
 ACCEPT_AND_MUTATE_IMPL(Pool2DOp)
+ACCEPT_AND_MUTATE_IMPL(QuantizeOp)
 ACCEPT_AND_MUTATE_IMPL(ShapeOp)
 ACCEPT_AND_MUTATE_IMPL(SoftmaxOp)
 ACCEPT_AND_MUTATE_IMPL(SpaceDepthOp)
 ACCEPT_AND_MUTATE_IMPL(SplitOp)
 ACCEPT_AND_MUTATE_IMPL(ReductionOp)
 ACCEPT_AND_MUTATE_IMPL(ReshapeOp)
+ACCEPT_AND_MUTATE_IMPL(SeparableConvOp)
 ACCEPT_AND_MUTATE_IMPL(TileConvFilterOp)
 ACCEPT_AND_MUTATE_IMPL(TransposeOp)
 ACCEPT_AND_MUTATE_IMPL(UpsampleChannelsOp)
@@ -1911,6 +2420,37 @@ ACCEPT_AND_MUTATE_IMPL(OpGroup)
 
 #undef ACCEPT_AND_MUTATE_IMPL
 
+#define CLONE_IMPL(OP)                                 \
+    OpPtr OP::clone_impl(TensorCloner &cloner) const { \
+        auto result = std::make_unique<OP>(*this);     \
+        result->clone_tensors(*this, cloner);          \
+        return result;                                 \
+    }
+
+CLONE_IMPL(BinaryOp)
+CLONE_IMPL(ConcatenationOp)
+CLONE_IMPL(ConvOp)
+CLONE_IMPL(DepthwiseConv2DOp)
+CLONE_IMPL(ElementwiseProgramOp)
+CLONE_IMPL(GatherOp)
+CLONE_IMPL(L2NormalizationOp)
+CLONE_IMPL(PadOp)
+CLONE_IMPL(Pool2DOp)
+CLONE_IMPL(QuantizeOp)
+CLONE_IMPL(ShapeOp)
+CLONE_IMPL(SoftmaxOp)
+CLONE_IMPL(SpaceDepthOp)
+CLONE_IMPL(SplitOp)
+CLONE_IMPL(ReductionOp)
+CLONE_IMPL(ReshapeOp)
+CLONE_IMPL(SeparableConvOp)
+CLONE_IMPL(TileConvFilterOp)
+CLONE_IMPL(TransposeOp)
+CLONE_IMPL(UpsampleChannelsOp)
+CLONE_IMPL(UnaryOp)
+
+#undef CLONE_IMPL
+
 void OpVisitor::visit(const OpGroup *op) {
     for (int i = 0; i < op->op_count(); i++) {
         op->op(i)->accept(this);
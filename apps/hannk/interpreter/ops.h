@@ -55,15 +55,28 @@ public:
         : ElementwiseOp({a, b}, {output}), op_(op), activation_(activation) {
     }
 
+    Operator op() const {
+        return op_;
+    }
+    ActivationFunction activation() const {
+        return activation_;
+    }
+
     void execute() override;
+    bool can_execute_crop() const override;
+    void execute_crop(const Box &crop) override;
 
     std::string name() const override {
         return std::string("BinaryOp(") + to_string(op_) + ")";
     }
 
 private:
+    void execute_uint8(const HalideBuffer<const void> &in1_buf, const HalideBuffer<const void> &in2_buf,
+                       const HalideBuffer<void> &out_buf);
+
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class ConcatenationOp : public Op {
@@ -93,6 +106,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class ConvOp : public Op {
@@ -101,6 +115,12 @@ class ConvOp : public Op {
     Padding padding_;
     ActivationFunction activation_;
 
+    // Only used if there is an addend, see below.
+    QuantizationInfo conv_quantization_;
+    int conv_sign_ = 1;
+    int addend_sign_ = 1;
+    ActivationFunction add_activation_ = ActivationFunction::None;
+
     // calculated in prepare()
     int vector_reduction_ = 0;
     int vector_tile_ = 0;
@@ -116,12 +136,38 @@ public:
           activation_(activation) {
     }
 
+    // A conv followed by an elementwise add of addend (see fuse_ops). The
+    // result of the conv is never stored; conv_quantization and activation
+    // describe it as if it were, and the signs and add_activation describe
+    // the add, as for BinaryOp.
+    ConvOp(const TensorPtr &input, const TensorPtr &filter, const TensorPtr &bias, const TensorPtr &addend,
+           const TensorPtr &output, std::array<int, 2> stride, std::array<int, 2> dilation, Padding padding,
+           ActivationFunction activation, QuantizationInfo conv_quantization, int conv_sign, int addend_sign,
+           ActivationFunction add_activation)
+        : Op({input, filter, bias, addend}, {output}),
+          stride_(stride),
+          dilation_(dilation),
+          padding_(padding),
+          activation_(activation),
+          conv_quantization_(std::move(conv_quantization)),
+          conv_sign_(conv_sign),
+          addend_sign_(addend_sign),
+          add_activation_(add_activation) {
+    }
+
     const TensorPtr &filter() const {
         return Op::input(1);
     }
     const TensorPtr &bias() const {
         return Op::input(2);
     }
+    bool has_addend() const {
+        return input_count() > 3;
+    }
+    const TensorPtr &addend() const {
+        assert(has_addend());
+        return Op::input(3);
+    }
 
     std::array<int, 2> stride() const {
         return stride_;
@@ -141,14 +187,20 @@ public:
 
     bool prepare() override;
     void execute() override;
+    bool can_execute_crop() const override;
+    void execute_crop(const Box &crop) override;
+    int64_t arithmetic_ops() const override;
 
     std::string name() const override {
-        return "ConvOp";
+        return has_addend() ? "ConvOp(Add)" : "ConvOp";
     }
 
 private:
+    void execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> addend_buf, HalideBuffer<void> output_buf);
+
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class DepthwiseConv2DOp : public Op {
@@ -200,14 +252,20 @@ public:
 
     bool prepare() override;
     void execute() override;
+    bool can_execute_crop() const override;
+    void execute_crop(const Box &crop) override;
+    int64_t arithmetic_ops() const override;
 
     std::string name() const override {
         return "DepthwiseConv2DOp";
     }
 
 private:
+    void execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> output_buf);
+
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class ElementwiseProgramOp : public ElementwiseOp {
@@ -231,6 +289,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class GatherOp : public Op {
@@ -253,6 +312,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class L2NormalizationOp : public Op {
@@ -274,6 +334,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class PadOp : public Op {
@@ -292,14 +353,19 @@ public:
     BoundsMap map_bounds(int input_idx, int output_idx) const override;
 
     void execute() override;
+    bool can_execute_crop() const override;
+    void execute_crop(const Box &crop) override;
 
     std::string name() const override {
         return "PadOp";
     }
 
 private:
+    void execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> output_buf);
+
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class Pool2DOp : public Op {
@@ -340,6 +406,7 @@ public:
     BoundsMap map_bounds(int input_idx, int output_idx) const override;
 
     void execute() override;
+    int64_t arithmetic_ops() const override;
 
     std::string name() const override {
         return std::string("Pool2DOp(") + to_string(op_) + ")";
@@ -348,6 +415,32 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
+};
+
+// Converts between float and quantized tensors, or between two quantizations
+// of a tensor (TFLite's QUANTIZE and DEQUANTIZE). This is implemented in C++,
+// and is only intended for the inputs and outputs of models.
+class QuantizeOp : public ElementwiseOp {
+public:
+    QuantizeOp(const TensorPtr &input, const TensorPtr &output)
+        : ElementwiseOp({input}, {output}) {
+    }
+
+    void execute() override;
+    bool can_execute_crop() const override;
+    void execute_crop(const Box &crop) override;
+
+    std::string name() const override {
+        return "QuantizeOp";
+    }
+
+private:
+    void execute_impl(const HalideBuffer<const void> &input_buf, const HalideBuffer<void> &output_buf);
+
+    void accept_impl(OpVisitor *v) const override;
+    OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class ReductionOp : public Op {
@@ -379,6 +472,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class ReshapeOp : public Op {
@@ -403,6 +497,64 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
+};
+
+// A DepthwiseConv2DOp with a depth multiplier of 1, followed by a 1x1 ConvOp
+// (see fuse_ops). The result of the depthwise conv is never stored;
+// depthwise_quantization and depthwise_activation describe it as if it were.
+// The filter of the 1x1 conv is already tiled by pad_for_ops.
+class SeparableConvOp : public Op {
+    std::array<int, 2> depthwise_stride_;
+    std::array<int, 2> depthwise_dilation_;
+    ActivationFunction depthwise_activation_;
+    QuantizationInfo depthwise_quantization_;
+    ActivationFunction activation_;
+
+public:
+    SeparableConvOp(const TensorPtr &input, const TensorPtr &depthwise_filter, const TensorPtr &depthwise_bias,
+                    const TensorPtr &filter, const TensorPtr &bias, const TensorPtr &output,
+                    std::array<int, 2> depthwise_stride, std::array<int, 2> depthwise_dilation,
+                    ActivationFunction depthwise_activation, QuantizationInfo depthwise_quantization,
+                    ActivationFunction activation)
+        : Op({input, depthwise_filter, depthwise_bias, filter, bias}, {output}),
+          depthwise_stride_(depthwise_stride),
+          depthwise_dilation_(depthwise_dilation),
+          depthwise_activation_(depthwise_activation),
+          depthwise_quantization_(std::move(depthwise_quantization)),
+          activation_(activation) {
+    }
+
+    const TensorPtr &depthwise_filter() const {
+        return Op::input(1);
+    }
+    const TensorPtr &depthwise_bias() const {
+        return Op::input(2);
+    }
+    const TensorPtr &filter() const {
+        return Op::input(3);
+    }
+    const TensorPtr &bias() const {
+        return Op::input(4);
+    }
+
+    BoundsMap map_bounds(int input_idx, int output_idx) const override;
+
+    void execute() override;
+    bool can_execute_crop() const override;
+    void execute_crop(const Box &crop) override;
+    int64_t arithmetic_ops() const override;
+
+    std::string name() const override {
+        return "SeparableConvOp";
+    }
+
+private:
+    void execute_impl(HalideBuffer<void> input_buf, HalideBuffer<void> output_buf);
+
+    void accept_impl(OpVisitor *v) const override;
+    OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class ShapeOp : public Op {
@@ -422,6 +574,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class SoftmaxOp : public Op {
@@ -444,6 +597,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class SpaceDepthOp : public Op {
@@ -465,6 +619,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class SplitOp : public Op {
@@ -494,6 +649,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class TileConvFilterOp : public Op {
@@ -513,6 +669,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class TransposeOp : public Op {
@@ -532,6 +689,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class UnaryOp : public ElementwiseOp {
@@ -565,6 +723,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class UpsampleChannelsOp : public Op {
@@ -586,6 +745,7 @@ public:
 private:
     void accept_impl(OpVisitor *v) const override;
     OpMutatorFn mutate_impl() const override;
+    OpPtr clone_impl(TensorCloner &cloner) const override;
 };
 
 class OpVisitor {
@@ -607,8 +767,10 @@ protected:
     friend class L2NormalizationOp;
     friend class PadOp;
     friend class Pool2DOp;
+    friend class QuantizeOp;
     friend class ReductionOp;
     friend class ReshapeOp;
+    friend class SeparableConvOp;
     friend class ShapeOp;
     friend class SoftmaxOp;
     friend class SpaceDepthOp;
@@ -629,8 +791,10 @@ protected:
     virtual void visit(const L2NormalizationOp *op) { visit_leaf(op); }
     virtual void visit(const PadOp *op) { visit_leaf(op); }
     virtual void visit(const Pool2DOp *op) { visit_leaf(op); }
+    virtual void visit(const QuantizeOp *op) { visit_leaf(op); }
     virtual void visit(const ReductionOp *op) { visit_leaf(op); }
     virtual void visit(const ReshapeOp *op) { visit_leaf(op); }
+    virtual void visit(const SeparableConvOp *op) { visit_leaf(op); }
     virtual void visit(const ShapeOp *op) { visit_leaf(op); }
     virtual void visit(const SoftmaxOp *op) { visit_leaf(op); }
     virtual void visit(const SpaceDepthOp *op) { visit_leaf(op); }
@@ -669,8 +833,10 @@ protected:
     friend class L2NormalizationOp;
     friend class PadOp;
     friend class Pool2DOp;
+    friend class QuantizeOp;
     friend class ReductionOp;
     friend class ReshapeOp;
+    friend class SeparableConvOp;
     friend class ShapeOp;
     friend class SoftmaxOp;
     friend class SpaceDepthOp;
@@ -691,8 +857,10 @@ protected:
     virtual OpPtr visit(std::unique_ptr<L2NormalizationOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<PadOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<Pool2DOp> op) { return visit_leaf(std::move(op)); }
+    virtual OpPtr visit(std::unique_ptr<QuantizeOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<ReductionOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<ReshapeOp> op) { return visit_leaf(std::move(op)); }
+    virtual OpPtr visit(std::unique_ptr<SeparableConvOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<ShapeOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<SoftmaxOp> op) { return visit_leaf(std::move(op)); }
     virtual OpPtr visit(std::unique_ptr<SpaceDepthOp> op) { return visit_leaf(std::move(op)); }
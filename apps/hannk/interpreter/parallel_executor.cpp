@@ -0,0 +1,191 @@
+#include "interpreter/parallel_executor.h"
+#include "util/error_util.h"
+
+#include <bitset>
+#include <map>
+#include <set>
+
+namespace hannk {
+
+namespace {
+
+// Tensors that alias each other share a TensorStorage, so dependencies are
+// tracked per TensorStorage rather than per Tensor. Dynamic tensors get their
+// storage when they are resized, and nothing aliases them.
+const void *storage_key(const TensorPtr &t) {
+    if (t->is_dynamic()) {
+        return t.get();
+    }
+    return t->storage().get();
+}
+
+// A set of ops, as a bitmask.
+class OpSet {
+    std::vector<uint64_t> bits_;
+
+public:
+    explicit OpSet(int size)
+        : bits_((size + 63) / 64, 0) {
+    }
+
+    void insert(int i) {
+        bits_[i / 64] |= (uint64_t)1 << (i % 64);
+    }
+
+    void insert(const OpSet &other) {
+        for (size_t i = 0; i < bits_.size(); i++) {
+            bits_[i] |= other.bits_[i];
+        }
+    }
+
+    int size() const {
+        int result = 0;
+        for (uint64_t b : bits_) {
+            result += (int)std::bitset<64>(b).count();
+        }
+        return result;
+    }
+};
+
+}  // namespace
+
+ParallelExecutor::ParallelExecutor(OpGroup *group, int num_threads)
+    : num_threads_(num_threads) {
+    assert(num_threads >= 1);
+    const int n = group->op_count();
+    for (int i = 0; i < n; i++) {
+        ops_.push_back(group->op(i));
+    }
+
+    // Find the dependencies by walking the ops in the order they would
+    // run in serially, keeping track of the last op to write each storage,
+    // and the ops that have read it since.
+    std::map<const void *, int> last_writer;
+    std::map<const void *, std::vector<int>> readers;
+    std::vector<std::set<int>> dependencies(n);
+    for (int i = 0; i < n; i++) {
+        const Op *op = ops_[i];
+        std::set<const void *> reads, writes;
+        for (int j = 0; j < op->input_count(); j++) {
+            const TensorPtr &t = op->input(j);
+            if (t && !t->is_constant()) {
+                reads.insert(storage_key(t));
+            }
+        }
+        for (int j = 0; j < op->output_count(); j++) {
+            const TensorPtr &t = op->output(j);
+            if (t) {
+                writes.insert(storage_key(t));
+            }
+        }
+
+        for (const void *s : reads) {
+            auto w = last_writer.find(s);
+            if (w != last_writer.end()) {
+                dependencies[i].insert(w->second);
+            }
+        }
+        for (const void *s : writes) {
+            auto w = last_writer.find(s);
+            if (w != last_writer.end()) {
+                dependencies[i].insert(w->second);
+            }
+            for (int r : readers[s]) {
+                dependencies[i].insert(r);
+            }
+        }
+        dependencies[i].erase(i);
+
+        for (const void *s : writes) {
+            last_writer[s] = i;
+            readers[s].clear();
+        }
+        for (const void *s : reads) {
+            if (!writes.count(s)) {
+                readers[s].push_back(i);
+            }
+        }
+    }
+
+    dependents_.resize(n);
+    dependency_count_.resize(n);
+    for (int i = 0; i < n; i++) {
+        dependency_count_[i] = (int)dependencies[i].size();
+        for (int d : dependencies[i]) {
+            dependents_[d].push_back(i);
+        }
+    }
+
+    // Op i can't run before any of its ancestors, or after any of its
+    // descendants. Dependencies always point to earlier ops, so one pass in
+    // each direction finds them.
+    earliest_.resize(n);
+    latest_.resize(n);
+    std::vector<OpSet> ancestors(n, OpSet(n));
+    for (int i = 0; i < n; i++) {
+        for (int d : dependencies[i]) {
+            ancestors[i].insert(ancestors[d]);
+            ancestors[i].insert(d);
+        }
+        earliest_[i] = ancestors[i].size();
+    }
+    std::vector<OpSet> descendants(n, OpSet(n));
+    for (int i = n - 1; i >= 0; i--) {
+        for (int d : dependents_[i]) {
+            descendants[i].insert(descendants[d]);
+            descendants[i].insert(d);
+        }
+        latest_[i] = n - 1 - descendants[i].size();
+    }
+}
+
+int ParallelExecutor::worker(void *user_context, int task_number, uint8_t *closure) {
+    ((ParallelExecutor *)closure)->run_ops();
+    return 0;
+}
+
+void ParallelExecutor::run_ops() {
+    halide_mutex_lock(&mutex_);
+    while (finished_ < op_count()) {
+        if (ready_.empty()) {
+            halide_cond_wait(&cond_, &mutex_);
+            continue;
+        }
+        const int i = ready_.back();
+        ready_.pop_back();
+
+        halide_mutex_unlock(&mutex_);
+        ops_[i]->execute();
+        halide_mutex_lock(&mutex_);
+
+        finished_++;
+        for (int d : dependents_[i]) {
+            if (--pending_[d] == 0) {
+                ready_.push_back(d);
+            }
+        }
+        // Wake the other workers, either to run the ops that are now
+        // ready, or to return if everything is done.
+        halide_cond_broadcast(&cond_);
+    }
+    halide_mutex_unlock(&mutex_);
+}
+
+void ParallelExecutor::execute() {
+    pending_ = dependency_count_;
+    ready_.clear();
+    // Push in reverse, so the ready ops are started in their serial order.
+    for (int i = op_count() - 1; i >= 0; i--) {
+        if (pending_[i] == 0) {
+            ready_.push_back(i);
+        }
+    }
+    finished_ = 0;
+
+    // If the thread pool has fewer threads than this, the workers just
+    // take turns; a worker only waits when another one is running an op.
+    int result = halide_do_par_for(nullptr, worker, 0, num_threads_, (uint8_t *)this);
+    HCHECK(result == 0) << "ParallelExecutor failed: " << result;
+}
+
+}  // namespace hannk
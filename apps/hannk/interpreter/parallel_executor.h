@@ -0,0 +1,67 @@
+#ifndef HANNK_PARALLEL_EXECUTOR_H
+#define HANNK_PARALLEL_EXECUTOR_H
+
+#include <vector>
+
+#include "HalideRuntime.h"
+#include "interpreter/model.h"
+
+namespace hannk {
+
+// ParallelExecutor runs the ops of an OpGroup on several threads at once. An op
+// can run as soon as the ops it depends on have finished: those earlier in the
+// group that write storage it reads or writes, or that read storage it writes.
+// Independent ops (e.g. the branches of an Inception module) then run at the
+// same time, on Halide's thread pool.
+class ParallelExecutor {
+public:
+    // The group must not be changed after this, and must outlive the executor.
+    ParallelExecutor(OpGroup *group, int num_threads);
+
+    int op_count() const {
+        return (int)ops_.size();
+    }
+
+    // The earliest and latest positions op i can run in, over all the orders
+    // that the dependencies allow. If the latest position of op a is before the
+    // earliest position of op b, a always finishes before b starts. This is
+    // what lets the AllocationPlanner overlap blocks when ops run out of order.
+    int earliest_position(int i) const {
+        return earliest_[i];
+    }
+    int latest_position(int i) const {
+        return latest_[i];
+    }
+
+    void execute();
+
+    // Neither movable nor copyable.
+    ParallelExecutor() = delete;
+    ParallelExecutor(const ParallelExecutor &) = delete;
+    ParallelExecutor &operator=(const ParallelExecutor &) = delete;
+    ParallelExecutor(ParallelExecutor &&) = delete;
+    ParallelExecutor &operator=(ParallelExecutor &&) = delete;
+
+private:
+    std::vector<Op *> ops_;
+    int num_threads_;
+
+    // The ops that depend on each op, and the number of ops each op depends on.
+    std::vector<std::vector<int>> dependents_;
+    std::vector<int> dependency_count_;
+    std::vector<int> earliest_, latest_;
+
+    // The state of the current execute(), guarded by mutex_.
+    halide_mutex mutex_ = {};
+    halide_cond cond_ = {};
+    std::vector<int> pending_;
+    std::vector<int> ready_;
+    int finished_ = 0;
+
+    static int worker(void *user_context, int task_number, uint8_t *closure);
+    void run_ops();
+};
+
+}  // namespace hannk
+
+#endif  // HANNK_PARALLEL_EXECUTOR_H
@@ -1,5 +1,7 @@
 #include "interpreter/tensor.h"
 
+#include <cstring>
+
 namespace hannk {
 
 namespace {
@@ -40,6 +42,13 @@ Tensor::Tensor(std::string name, halide_type_t type, const Box &bounds, Quantiza
     : Tensor(name, make_unallocated_buffer(type, bounds), quantization) {
 }
 
+void Tensor::set_type(halide_type_t type, QuantizationInfo quantization) {
+    assert(!is_allocated());
+    assert(type.bytes() == buffer_.type().bytes());
+    buffer_.raw_buffer()->type = type;
+    quantization_ = std::move(quantization);
+}
+
 bool Tensor::is_dense() const {
     return ::hannk::is_dense(buffer());
 }
@@ -123,7 +132,19 @@ void Tensor::finish_buffer_allocation() {
     halide_buffer_t *raw_storage_buffer = storage_buffer.raw_buffer();
     assert(raw_storage_buffer->host);
 
-    if (alias_type() == AliasType::Reshaped) {
+    if (folded_rows_ > 0) {
+        // Only the first rows are stored, but the buffer has the bounds of
+        // the whole tensor, with the strides of the storage.
+        assert(storage_offset_.empty());
+        assert(raw_storage_buffer->type.bytes() == buffer_.type().bytes());
+        TensorDimensions dims(raw_storage_buffer->dimensions);
+        for (int i = 0; i < raw_storage_buffer->dimensions; i++) {
+            dims[i] = raw_storage_buffer->dim[i];
+        }
+        dims[2].extent = buffer_.dim(2).extent();
+        buffer_ = HalideBuffer<void>(buffer_.type(), raw_storage_buffer->host, (int)dims.size(), dims.data());
+        fold_min_ = buffer_.dim(2).min();
+    } else if (alias_type() == AliasType::Reshaped) {
         assert(raw_storage_buffer->number_of_elements() == buffer_.number_of_elements());
         assert(raw_storage_buffer->type == buffer_.type());
         assert(storage_offset_.empty());
@@ -157,6 +178,43 @@ void Tensor::finish_buffer_allocation() {
     assert(is_allocated());
 }
 
+void Tensor::fold_rows(int rows) {
+    assert(!is_allocated());
+    assert(!is_external() && !is_dynamic());
+    assert(alias_type() == AliasType::None);
+    assert(rank() >= 3 && rows > 0 && rows <= extent(2));
+
+    // Make the storage dense with just `rows` rows.
+    halide_buffer_t *raw_storage_buffer = storage()->buffer.raw_buffer();
+    raw_storage_buffer->dim[2].extent = rows;
+    for (int i = 3; i < raw_storage_buffer->dimensions; i++) {
+        const halide_dimension_t &inner = raw_storage_buffer->dim[i - 1];
+        raw_storage_buffer->dim[i].stride = inner.stride * inner.extent;
+    }
+    folded_rows_ = rows;
+}
+
+void Tensor::slide_folded_rows(int min, int keep_max) {
+    assert(folded_rows_ > 0 && is_allocated());
+    assert(keep_max < min + folded_rows_);
+
+    const halide_buffer_t *raw_storage_buffer = storage()->buffer.raw_buffer();
+    uint8_t *host = raw_storage_buffer->host;
+    const int64_t row_bytes = (int64_t)raw_storage_buffer->dim[2].stride * type().bytes();
+    if (keep_max >= min) {
+        // Move the rows to keep to the start of each block of rows.
+        assert(min >= fold_min_ && keep_max < fold_min_ + folded_rows_);
+        const int64_t block_bytes = folded_rows_ * row_bytes;
+        const int64_t blocks = storage()->storage_size() / block_bytes;
+        for (int64_t b = 0; b < blocks; b++) {
+            uint8_t *block = host + b * block_bytes;
+            memmove(block, block + (min - fold_min_) * row_bytes, (keep_max - min + 1) * row_bytes);
+        }
+    }
+    fold_min_ = min;
+    buffer_.raw_buffer()->host = host - (min - buffer_.dim(2).min()) * row_bytes;
+}
+
 void Tensor::resize_dynamic(const Box &new_shape) {
     assert(is_dynamic());
     assert(!is_external());
@@ -337,6 +395,40 @@ bool Tensor::can_alias(const TensorPtr &source, AliasType alias_type) const {
 #endif
 }
 
+TensorPtr TensorCloner::clone(const TensorPtr &t) {
+    if (!t || t->is_constant()) {
+        return t;
+    }
+    TensorPtr &result = tensors_[t.get()];
+    if (result) {
+        return result;
+    }
+
+    result = std::make_shared<Tensor>(t->name(), t->type(), t->bounds(), t->quantization());
+    result->is_external_ = t->is_external_;
+    result->is_dynamic_ = t->is_dynamic_;
+    if (t->storage_) {
+        TensorStoragePtr &storage = storage_[t->storage_.get()];
+        if (!storage) {
+            const halide_buffer_t *raw_buf = t->storage_->buffer.raw_buffer();
+            storage = std::make_shared<TensorStorage>(raw_buf->type, raw_buf->dimensions, raw_buf->dim);
+        }
+        result->storage_ = storage;
+        result->storage_offset_ = t->storage_offset_;
+        result->folded_rows_ = t->folded_rows_;
+    }
+    if (t->alias_info_) {
+        std::shared_ptr<Tensor::AliasInfo> &alias_info = aliases_[t->alias_info_.get()];
+        if (!alias_info) {
+            alias_info = std::make_shared<Tensor::AliasInfo>();
+            alias_info->alias_type = t->alias_info_->alias_type;
+        }
+        alias_info->aliases.push_back(result);
+        result->alias_info_ = alias_info;
+    }
+    return result;
+}
+
 void Tensor::dump(std::ostream &os) const {
     os << "  \"" << name() << "\" this:@" << (const void *)this;
 
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <list>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -45,6 +46,7 @@ using TensorDimensions = SmallVector<halide_dimension_t, max_rank>;
 
 class TensorStorage {
     friend class Tensor;
+    friend class TensorCloner;
 
     HalideBuffer<void> buffer;
 
@@ -71,6 +73,8 @@ enum class AliasType {
 };
 
 class Tensor {
+    friend class TensorCloner;
+
     std::string name_;
     HalideBuffer<void> buffer_;
     QuantizationInfo quantization_;
@@ -115,6 +119,11 @@ class Tensor {
     // If storage_offset_.size() < rank(), remaining offset entries are implicitly zero.
     TensorOffset storage_offset_;
 
+    // If nonzero, only this many rows (dimension 2) of the tensor are stored
+    // at a time, starting at row fold_min_. See fold_rows().
+    int folded_rows_ = 0;
+    int fold_min_ = 0;
+
     // A list of ops that use this tensor as an output or an input, respectively.
     std::list<Op *> producers_;
     std::list<Op *> consumers_;
@@ -178,6 +187,10 @@ public:
         return quantization_;
     }
 
+    // Change the type and quantization of the tensor. This is only allowed
+    // before it is allocated, and the new type must have the same size.
+    void set_type(halide_type_t type, QuantizationInfo quantization);
+
     bool is_constant() const {
         return is_constant_;
     }
@@ -263,6 +276,23 @@ public:
 
     bool is_dense() const;
 
+    // Store only `rows` rows (dimension 2) of the tensor at a time, like
+    // storage folding in a Halide schedule. The buffer keeps the bounds of
+    // the whole tensor, but only the stored rows can be accessed; initially,
+    // these are the first rows. This is only allowed before the tensor is
+    // allocated, and not for aliased, external or dynamic tensors.
+    void fold_rows(int rows);
+
+    // The number of rows stored at a time, or 0 if the tensor isn't folded.
+    int folded_rows() const {
+        return folded_rows_;
+    }
+
+    // Store the rows of a folded tensor starting at row min instead, keeping
+    // the rows [min, keep_max], which must be stored already. Rows before min
+    // can't be accessed after this.
+    void slide_folded_rows(int min, int keep_max);
+
     void add_consumer(Op *op);
     void add_producer(Op *op);
     void remove_consumer(Op *op);
@@ -278,6 +308,20 @@ public:
     void dump(std::ostream &os) const;
 };
 
+// Makes the copies of the Tensors needed by another instance of a model.
+// Constant Tensors are never written, so they are shared rather than copied.
+// The copies of the others are unallocated, and alias each other in the same
+// way as the originals.
+class TensorCloner {
+    std::map<const Tensor *, TensorPtr> tensors_;
+    std::map<const TensorStorage *, TensorStoragePtr> storage_;
+    std::map<const Tensor::AliasInfo *, std::shared_ptr<Tensor::AliasInfo>> aliases_;
+
+public:
+    // Returns the same copy each time it is called with the same Tensor.
+    TensorPtr clone(const TensorPtr &t);
+};
+
 }  // namespace hannk
 
 #endif  // HANNK_TENSOR_H
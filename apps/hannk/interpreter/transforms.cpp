@@ -1,6 +1,8 @@
 #include "interpreter/transforms.h"
+#include "interpreter/constant_cache.h"
 #include "util/small_vector.h"
 
+#include <algorithm>
 #include <unordered_set>
 
 namespace hannk {
@@ -166,6 +168,11 @@ class InPlace : public OpMutator {
             return false;
         }
 
+        // Constant data must not be overwritten.
+        if (input->is_constant()) {
+            return false;
+        }
+
         // If the input is used anywhere else, we should not alias it.
         // TODO: This is conservative, we could alias it if it is the *last* use.
         if (input->consumers().size() != 1) {
@@ -406,7 +413,11 @@ class PadForOps : public OpMutator {
 
     OpPtr visit(std::unique_ptr<DepthwiseConv2DOp> op) override {
         OpPtr upsample_op = nullptr;
-        if (op->depth_multiplier() != 1 && op->depth_multiplier() < op->output()->extent(0)) {
+        // There is no broadcasting version of the float depthwise conv, so
+        // float inputs are always upsampled.
+        const bool can_broadcast = op->input()->type() != halide_type_of<float>() &&
+                                   op->depth_multiplier() >= op->output()->extent(0);
+        if (op->depth_multiplier() != 1 && !can_broadcast) {
             // Make an UpsampleChannels op and a new tensor for the upsampled result.
             TensorPtr input = op->input();
             TensorPtr output = op->output();
@@ -479,6 +490,112 @@ OpPtr pad_for_ops(OpPtr op) {
 
 namespace {
 
+void replace_producers(const TensorPtr &from, const TensorPtr &to) {
+    auto producers = from->producers();
+    for (Op *i : producers) {
+        for (int j = 0; j < i->output_count(); j++) {
+            if (i->output(j).get() == from.get()) {
+                i->set_output(j, to);
+            }
+        }
+    }
+}
+
+// Find all the tensors used by the leaf ops, in the order they are first used.
+class FindTensors : public OpVisitor {
+    std::unordered_set<Tensor *> found_;
+
+    void add(const TensorPtr &t) {
+        if (t && found_.insert(t.get()).second) {
+            tensors.push_back(t);
+        }
+    }
+
+    void visit_leaf(const Op *op) override {
+        for (int i = 0; i < op->input_count(); i++) {
+            add(op->input(i));
+        }
+        for (int i = 0; i < op->output_count(); i++) {
+            add(op->output(i));
+        }
+    }
+
+public:
+    std::vector<TensorPtr> tensors;
+};
+
+bool is_per_tensor_int8(const TensorPtr &t) {
+    const QuantizationInfo &q = t->quantization();
+    return t->type() == halide_type_of<int8_t>() && q.scale.size() == 1 && q.zero.size() == 1;
+}
+
+}  // namespace
+
+OpPtr convert_int8_to_uint8(OpPtr op) {
+    FindTensors finder;
+    op->accept(&finder);
+
+    const std::vector<TensorPtr> inputs = op->inputs();
+    const std::vector<TensorPtr> outputs = op->outputs();
+    const auto is_root_input = [&](const TensorPtr &t) {
+        return std::find(inputs.begin(), inputs.end(), t) != inputs.end();
+    };
+    const auto is_root_output = [&](const TensorPtr &t) {
+        return std::find(outputs.begin(), outputs.end(), t) != outputs.end();
+    };
+
+    std::vector<OpPtr> input_converts, output_converts;
+    for (const TensorPtr &t : finder.tensors) {
+        if (!is_per_tensor_int8(t) || t->is_dynamic()) {
+            continue;
+        }
+        QuantizationInfo quantization = t->quantization();
+        quantization.zero[0] += 128;
+
+        const bool root_input = is_root_input(t);
+        const bool root_output = is_root_output(t);
+        if (t->is_constant()) {
+            if (!t->is_allocated()) {
+                continue;
+            }
+            const auto &int8_buf = t->buffer<const int8_t>();
+            auto uint8_buf = HalideBuffer<uint8_t>::make_with_shape_of(int8_buf);
+            uint8_buf.for_each_value([](uint8_t &out, int8_t in) { out = (uint8_t)(in + 128); }, int8_buf);
+
+            TensorPtr converted = std::make_shared<Tensor>(t->name(), uint8_buf, quantization);
+            converted->set_constant();
+            replace_consumers(t, converted);
+        } else if (root_input && root_output) {
+            // Nothing computes this tensor, so there is nothing to convert.
+        } else if (root_input || root_output) {
+            TensorPtr converted = std::make_shared<Tensor>(t->name() + ".uint8", halide_type_of<uint8_t>(),
+                                                           t->bounds(), quantization);
+            replace_consumers(t, converted);
+            replace_producers(t, converted);
+            if (root_input) {
+                input_converts.push_back(make_op<QuantizeOp>(t, converted));
+            } else {
+                output_converts.push_back(make_op<QuantizeOp>(converted, t));
+            }
+        } else if (!t->is_external()) {
+            t->set_type(halide_type_of<uint8_t>(), quantization);
+        }
+    }
+
+    if (input_converts.empty() && output_converts.empty()) {
+        return op;
+    }
+
+    std::vector<OpPtr> ops = std::move(input_converts);
+    ops.push_back(std::move(op));
+    for (OpPtr &i : output_converts) {
+        ops.push_back(std::move(i));
+    }
+    return make_op<OpGroup>(inputs, outputs, std::move(ops));
+}
+
+namespace {
+
 class FusePadOps : public OpMutator {
     using OpMutator::visit;
 
@@ -535,6 +652,162 @@ OpPtr fuse_pad_ops(OpPtr op) {
 
 namespace {
 
+// Fuse an Add or Sub into the ConvOp that produces one of its operands, and a
+// DepthwiseConv2DOp into the 1x1 ConvOp that consumes its output, so the
+// intermediate result is never stored.
+class FuseOps : public OpMutator {
+    using OpMutator::visit;
+
+    std::unordered_set<Tensor *> root_outputs_;
+
+    bool is_root_output(const TensorPtr &t) const {
+        return root_outputs_.count(t.get()) > 0;
+    };
+
+    static bool is_uint8(const TensorPtr &t) {
+        return t->type() == halide_type_of<uint8_t>() && !t->is_dynamic();
+    }
+
+    static bool same_bounds(const TensorPtr &a, const TensorPtr &b) {
+        return is_subset_of(a->bounds(), b->bounds()) && is_subset_of(b->bounds(), a->bounds());
+    }
+
+    // This runs before flatten_groups(), and the OpGroups made by pad_for_ops()
+    // also produce and consume the tensors of the ops they contain, so don't
+    // count them.
+    static std::vector<const Op *> without_groups(const std::list<Op *> &ops) {
+        std::vector<const Op *> result;
+        for (const Op *op : ops) {
+            if (!cast_op<OpGroup>(op)) {
+                result.push_back(op);
+            }
+        }
+        return result;
+    }
+
+    // Returns the op of type T producing t, if t is only used by one op, so the
+    // producer can be fused into that op.
+    template<typename T>
+    const T *get_fusable_producer(const TensorPtr &t) const {
+        if (is_root_output(t) || !is_uint8(t)) {
+            return nullptr;
+        }
+        const std::vector<const Op *> producers = without_groups(t->producers());
+        if (producers.size() != 1 || without_groups(t->consumers()).size() != 1) {
+            return nullptr;
+        }
+        return cast_op<T>(producers.front());
+    }
+
+    const ConvOp *get_fusable_conv(const TensorPtr &t) const {
+        const ConvOp *conv = get_fusable_producer<ConvOp>(t);
+        if (!conv || conv->has_addend()) {
+            return nullptr;
+        }
+        return conv;
+    }
+
+    OpPtr visit(std::unique_ptr<ConvOp> op) override {
+        // The fused op only supports 1x1 convs with a stride and dilation of 1,
+        // and a filter already tiled by pad_for_ops().
+        const TensorPtr &filter = op->filter();
+        const std::array<int, 2> ones = {1, 1};
+        if (op->has_addend() || !is_uint8(op->output()) || filter->rank() != 6 ||
+            filter->extent(4) != 1 || filter->extent(5) != 1 ||
+            op->stride() != ones || op->dilation() != ones) {
+            return op;
+        }
+
+        const TensorPtr &depthwise_output = op->input();
+        const DepthwiseConv2DOp *depthwise = get_fusable_producer<DepthwiseConv2DOp>(depthwise_output);
+        if (!depthwise || depthwise->depth_multiplier() != 1 || !is_uint8(depthwise->input()) ||
+            depthwise->filter()->type() != halide_type_of<uint8_t>()) {
+            return op;
+        }
+
+        // The depthwise conv no longer writes its output, and the conv no longer reads it.
+        stats.ops_fused++;
+        stats.bytes_saved += 2 * (int64_t)depthwise_output->number_of_elements() * depthwise_output->type().bytes();
+
+        // The depthwise conv becomes dead; we'll rely on remove_dead_ops to get rid of it.
+        return make_prepared_op<SeparableConvOp>(depthwise->input(), depthwise->filter(), depthwise->bias(),
+                                                 op->filter(), op->bias(), op->output(),
+                                                 depthwise->stride(), depthwise->dilation(), depthwise->activation(),
+                                                 depthwise_output->quantization(), op->activation());
+    }
+
+    OpPtr visit(std::unique_ptr<BinaryOp> op) override {
+        if (op->op() != BinaryOp::Add && op->op() != BinaryOp::Sub) {
+            return op;
+        }
+        const TensorPtr &output = op->output();
+        if (!is_uint8(output)) {
+            return op;
+        }
+
+        for (int i = 0; i < 2; i++) {
+            const TensorPtr &conv_output = op->input(i);
+            const TensorPtr &addend = op->input(1 - i);
+            const ConvOp *conv = get_fusable_conv(conv_output);
+            if (!conv || !is_uint8(addend) || addend == conv_output) {
+                continue;
+            }
+            // The fused op doesn't support broadcasting.
+            if (!same_bounds(conv_output, output) || !same_bounds(addend, output)) {
+                continue;
+            }
+            const int conv_sign = op->op() == BinaryOp::Sub && i == 1 ? -1 : 1;
+            const int addend_sign = op->op() == BinaryOp::Sub && i == 0 ? -1 : 1;
+
+            // The conv no longer writes its output, and the add no longer reads it.
+            stats.ops_fused++;
+            stats.bytes_saved += 2 * (int64_t)conv_output->number_of_elements() * conv_output->type().bytes();
+
+            // The conv becomes dead; we'll rely on remove_dead_ops to get rid of it.
+            return make_prepared_op<ConvOp>(conv->input(), conv->filter(), conv->bias(), addend, output,
+                                            conv->stride(), conv->dilation(), conv->padding(), conv->activation(),
+                                            conv_output->quantization(), conv_sign, addend_sign, op->activation());
+        }
+        return op;
+    }
+
+    template<class T, class... Args>
+    std::unique_ptr<T> make_prepared_op(Args &&...args) {
+        auto op = std::make_unique<T>(std::forward<Args>(args)...);
+        if (!op->prepare()) {
+            HLOG(ERROR) << "fuse_ops: new_op " << op->name() << " failed prepare()";
+            prepare_failed = true;
+        }
+        return op;
+    }
+
+public:
+    explicit FuseOps(const Op *root) {
+        for (int i = 0; i < root->output_count(); i++) {
+            root_outputs_.insert(root->output(i).get());
+        }
+    }
+
+    bool prepare_failed = false;
+    FuseOpsStats stats;
+};
+
+}  // namespace
+
+OpPtr fuse_ops(OpPtr op, FuseOpsStats *stats) {
+    FuseOps fuser(op.get());
+    op = fuser.mutate(std::move(op));
+    if (fuser.prepare_failed) {
+        return nullptr;
+    }
+    if (stats) {
+        *stats = fuser.stats;
+    }
+    return op;
+}
+
+namespace {
+
 bool can_execute_with_all_constant_inputs(const Op *op) {
     for (int i = 0; i < op->input_count(); i++) {
         if (!op->input(i)->is_constant()) {
@@ -548,21 +821,38 @@ bool can_execute_with_all_constant_inputs(const Op *op) {
 class ConstantFolder : public OpMutator {
     using OpMutator::visit;
 
+    ConstantCache *cache_;
+
     OpPtr visit_leaf(OpPtr op) override {
         if (can_execute_with_all_constant_inputs(op.get())) {
-            // Allocate all the outputs.
-            // Since we aren't ready for arena allocation,
-            // we'll just do these as one-off heap allocs.
+            // Only outputs with storage of their own can be cached.
+            std::vector<TensorPtr> outputs;
+            bool cacheable = cache_ != nullptr;
             for (int j = 0; j < op->output_count(); j++) {
-                // Note that an output could be 'allocated' here if it
-                // is the result of a ReshapeOp that aliases constant data.
-                if (!op->output(j)->is_allocated()) {
-                    op->output(j)->allocate_from_heap();
-                }
+                const TensorPtr &output = op->output(j);
+                cacheable = cacheable && !output->is_allocated() && output->alias_type() == AliasType::None;
+                outputs.push_back(output);
             }
 
-            // Run the whole op.
-            op->execute();
+            if (!cacheable || !cache_->load(outputs)) {
+                // Allocate all the outputs.
+                // Since we aren't ready for arena allocation,
+                // we'll just do these as one-off heap allocs.
+                for (const TensorPtr &output : outputs) {
+                    // Note that an output could be 'allocated' here if it
+                    // is the result of a ReshapeOp that aliases constant data.
+                    if (!output->is_allocated()) {
+                        output->allocate_from_heap();
+                    }
+                }
+
+                // Run the whole op.
+                op->execute();
+
+                if (cacheable) {
+                    cache_->add(outputs);
+                }
+            }
 
             // Mark the outputs constant.
             for (int j = 0; j < op->output_count(); j++) {
@@ -574,12 +864,17 @@ class ConstantFolder : public OpMutator {
             return op;
         }
     }
+
+public:
+    explicit ConstantFolder(ConstantCache *cache)
+        : cache_(cache) {
+    }
 };
 
 }  // namespace
 
-OpPtr fold_constants(OpPtr op) {
-    ConstantFolder folder;
+OpPtr fold_constants(OpPtr op, ConstantCache *cache) {
+    ConstantFolder folder(cache);
     return folder.mutate(std::move(op));
 }
 
@@ -608,4 +903,154 @@ OpPtr flatten_groups(OpPtr op) {
     return make_op<OpGroup>(inputs, outputs, std::move(flattener.flattened));
 }
 
+namespace {
+
+bool can_tile(const Op *op) {
+    if (op->output_count() != 1) {
+        return false;
+    }
+    const TensorPtr &output = op->output();
+    return output && output->rank() == 4 && !output->is_dynamic() && op->can_execute_crop();
+}
+
+// The number of bytes in one row (dimension 2) of t.
+int64_t row_bytes(const TensorPtr &t) {
+    return (int64_t)t->number_of_elements() / t->extent(2) * t->type().bytes();
+}
+
+// The number of bytes of the tensors (other than constants) used to compute
+// the region crop of the output of group.
+int64_t working_set(const TiledOpGroup *group, const Box &crop) {
+    const std::vector<Box> crops = group->required_crops(crop);
+    int64_t result = 0;
+    for (int i = 0; i < group->op_count(); i++) {
+        const Op *op = group->op(i);
+        result += crops[i][2].extent() * row_bytes(op->output());
+        for (int j = 0; j < op->input_count(); j++) {
+            const TensorPtr &t = op->input(j);
+            if (!t || t->is_constant() || t->rank() != 4 || (i > 0 && t == group->op(i - 1)->output())) {
+                continue;
+            }
+            const Interval rows = op->map_bounds(j, 0).evaluate(crops[i])[2];
+            result += std::min(rows.extent(), t->extent(2)) * row_bytes(t);
+        }
+    }
+    return result;
+}
+
+class TileOps {
+    int64_t cache_size_;
+    std::unordered_set<Tensor *> root_outputs_;
+
+    // Whether op can be in the same TiledOpGroup as prev, the op before it.
+    bool can_follow(const Op *prev, const Op *op) const {
+        const TensorPtr &t = prev->output();
+        if (root_outputs_.count(t.get()) || !can_tile(op)) {
+            return false;
+        }
+        const auto &consumers = t->consumers();
+        return consumers.size() == 1 && consumers.front() == op;
+    }
+
+    // Make a TiledOpGroup of ops, if that helps. Otherwise, the ops are
+    // added to result as they are.
+    void tile(std::vector<OpPtr> ops, std::vector<OpPtr> &result) {
+        if (ops.size() < 2) {
+            for (auto &i : ops) {
+                result.push_back(std::move(i));
+            }
+            return;
+        }
+
+        std::vector<TensorPtr> inputs;
+        std::unordered_set<Tensor *> produced;
+        for (const auto &op : ops) {
+            for (int j = 0; j < op->input_count(); j++) {
+                const TensorPtr &t = op->input(j);
+                if (t && !produced.count(t.get()) && std::find(inputs.begin(), inputs.end(), t) == inputs.end()) {
+                    inputs.push_back(t);
+                }
+            }
+            produced.insert(op->output().get());
+        }
+        std::vector<TensorPtr> outputs = {ops.back()->output()};
+
+        const int op_count = (int)ops.size();
+        const Box bounds = outputs[0]->bounds();
+        const int height = bounds[2].extent();
+        auto group = std::make_unique<TiledOpGroup>(inputs, outputs, std::move(ops), height);
+
+        // Halve the tile height until a tile fits in the cache.
+        int tile_height = height;
+        Box crop = bounds;
+        while (tile_height > 1 && working_set(group.get(), crop) > cache_size_) {
+            tile_height = (tile_height + 1) / 2;
+            crop[2].set_extent(tile_height);
+        }
+
+        if (tile_height == height) {
+            // Everything fits in the cache already.
+            for (int i = 0; i < op_count; i++) {
+                result.push_back(group->take_op(i));
+            }
+            return;
+        }
+
+        int64_t intermediate_bytes = 0;
+        for (int i = 0; i < op_count - 1; i++) {
+            const TensorPtr &t = group->op(i)->output();
+            intermediate_bytes += (int64_t)t->number_of_elements() * t->type().bytes();
+        }
+        stats.groups++;
+        stats.ops_tiled += op_count;
+        stats.bytes_saved += 2 * intermediate_bytes;
+
+        group->set_tile_height(tile_height);
+        stats.bytes_folded += group->fold_intermediates();
+        result.push_back(std::move(group));
+    }
+
+public:
+    TileOps(const Op *root, int64_t cache_size)
+        : cache_size_(cache_size) {
+        for (int i = 0; i < root->output_count(); i++) {
+            root_outputs_.insert(root->output(i).get());
+        }
+    }
+
+    OpPtr run(std::unique_ptr<OpGroup> root) {
+        std::vector<OpPtr> result;
+        std::vector<OpPtr> chain;
+        for (int i = 0; i < root->op_count(); i++) {
+            if (!chain.empty() && !can_follow(chain.back().get(), root->op(i))) {
+                tile(std::move(chain), result);
+                chain.clear();
+            }
+            OpPtr op = root->take_op(i);
+            if (can_tile(op.get())) {
+                chain.push_back(std::move(op));
+            } else {
+                result.push_back(std::move(op));
+            }
+        }
+        tile(std::move(chain), result);
+        return make_op<OpGroup>(root->inputs(), root->outputs(), std::move(result));
+    }
+
+    TileOpsStats stats;
+};
+
+}  // namespace
+
+OpPtr tile_ops(OpPtr op, int64_t cache_size, TileOpsStats *stats) {
+    // The transforms before this always leave a single flat OpGroup at the root.
+    HCHECK(op->name() == "OpGroup");
+    TileOps tiler(op.get(), cache_size);
+    op = tiler.run(std::unique_ptr<OpGroup>(static_cast<OpGroup *>(op.release())));
+    if (stats) {
+        *stats = tiler.stats;
+    }
+    return op;
+}
+
 }  // namespace hannk
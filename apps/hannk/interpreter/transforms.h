@@ -5,6 +5,16 @@
 
 namespace hannk {
 
+class ConstantCache;
+
+// Convert int8 tensors with per-tensor quantization to uint8 tensors with the
+// same scale and a zero point 128 greater, which represent the same values, so
+// that the uint8 implementations of the ops can be used. Constant tensors are
+// replaced by converted copies. The inputs and outputs of the model keep their
+// types, and are converted by QuantizeOps. Tensors quantized per-channel are
+// left alone. This must be run before the ops are prepared.
+[[nodiscard]] OpPtr convert_int8_to_uint8(OpPtr op);
+
 // Rewrites ops to be in-place operations when possible.
 [[nodiscard]] OpPtr in_place(OpPtr op);
 
@@ -18,8 +28,9 @@ namespace hannk {
 [[nodiscard]] OpPtr pad_for_ops(OpPtr op);
 
 // Execute ops that are constant, and mark the results
-// constant as well.
-[[nodiscard]] OpPtr fold_constants(OpPtr op);
+// constant as well. If cache is not null, results are loaded
+// from it instead where possible, and the others are added to it.
+[[nodiscard]] OpPtr fold_constants(OpPtr op, ConstantCache *cache = nullptr);
 
 // Flatten all nested OpGroups into a single OpGroup.
 // TODO: OpGroups that represent subgraphs shouldn't be flattened;
@@ -31,6 +42,41 @@ namespace hannk {
 // a waste; this combines them. (This should be run after flatten_groups().)
 [[nodiscard]] OpPtr fuse_pad_ops(OpPtr op);
 
+struct FuseOpsStats {
+    int ops_fused = 0;
+    // The number of bytes of intermediate tensors that no longer need to
+    // be written and read again, per execution.
+    int64_t bytes_saved = 0;
+};
+
+// Fuse ops into the op producing their input when there is a combined
+// implementation, so the intermediate tensor is never stored. Currently,
+// this fuses an Add or Sub into the ConvOp producing one of its operands,
+// and a DepthwiseConv2DOp into the 1x1 ConvOp consuming its output.
+// The ops made dead are left for remove_dead_ops() to remove. This should
+// be run before in_place(), so no aliasing involves the removed tensors.
+// New ops will have prepare() called on them; this will return nullptr
+// if any of those calls fail.
+[[nodiscard]] OpPtr fuse_ops(OpPtr op, FuseOpsStats *stats = nullptr);
+
+struct TileOpsStats {
+    int groups = 0;
+    int ops_tiled = 0;
+    // The number of bytes of intermediate tensors that are written and read
+    // again while still in cache, instead of going to memory, per execution.
+    int64_t bytes_saved = 0;
+    // The number of bytes of memory not allocated, by storing only the rows
+    // of the intermediate tensors that the tiles need at once.
+    int64_t bytes_folded = 0;
+};
+
+// Find chains of ops, each of which only feeds the next, with intermediate
+// tensors too big to stay in a cache of cache_size bytes, and wrap each in a
+// TiledOpGroup that runs the chain in strips of rows small enough to fit,
+// and folds the intermediate tensors to store only the rows of a strip.
+// This must be run on a flattened OpGroup, after any other transforms.
+[[nodiscard]] OpPtr tile_ops(OpPtr op, int64_t cache_size, TileOpsStats *stats = nullptr);
+
 }  // namespace hannk
 
 #endif  // HANNK_TRANSFORMS_H
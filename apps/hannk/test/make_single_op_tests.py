@@ -0,0 +1,344 @@
+#!/usr/bin/env python3
+"""Writes the single-op float32 and int8 models in test/float32 and test/int8,
+and the int8 models of chains of ops that hannk fuses in test/fused.
+
+The other test models were extracted from real networks, which are all uint8.
+These cover the float32 and (per-tensor) int8 kernels instead. The models are
+written directly in the TFLite flatbuffer format, so that neither TensorFlow nor
+flatbuffers is needed to regenerate them:
+
+    python3 test/make_single_op_tests.py
+"""
+
+import os
+import random
+import struct
+
+# Values from tensorflow/lite/schema/schema.fbs.
+FLOAT32, INT32, INT8 = 0, 2, 9
+ADD, AVERAGE_POOL_2D, CONV_2D, DEPTHWISE_CONV_2D = 0, 1, 3, 4
+DEQUANTIZE, FULLY_CONNECTED, MAX_POOL_2D, QUANTIZE = 6, 9, 17, 114
+CONV_2D_OPTIONS, DEPTHWISE_CONV_2D_OPTIONS, POOL_2D_OPTIONS, FULLY_CONNECTED_OPTIONS = 1, 2, 5, 8
+ADD_OPTIONS = 11
+SAME, VALID = 0, 1
+NONE, RELU, RELU6 = 0, 1, 3
+
+SCALAR_FORMATS = {'u8': '<B', 'i8': '<b', 'bool': '<B', 'i32': '<i', 'u32': '<I', 'f32': '<f'}
+
+
+class Table:
+    """A table, as a list of (field index, kind, value). kind is a scalar format
+    from SCALAR_FORMATS, or 'ref' for a Table, Vector or string."""
+
+    def __init__(self, *fields):
+        self.fields = [f for f in fields if f[2] is not None]
+
+
+class Vector:
+    """A vector of scalars ('u8', 'i32', 'i64', 'f32') or of refs ('ref')."""
+
+    def __init__(self, kind, items, align=4):
+        self.kind = kind
+        self.items = items
+        self.align = align
+
+
+class Writer:
+    """Lays out objects front to back, so that every offset points forward."""
+
+    def __init__(self):
+        self.buf = bytearray()
+
+    def pad_to(self, alignment, skew=0):
+        while (len(self.buf) + skew) % alignment:
+            self.buf.append(0)
+
+    def patch_offset(self, at, target):
+        struct.pack_into('<I', self.buf, at, target - at)
+
+    def write(self, obj):
+        if isinstance(obj, Table):
+            return self.write_table(obj)
+        if isinstance(obj, Vector):
+            return self.write_vector(obj)
+        return self.write_string(obj)
+
+    def write_string(self, s):
+        data = s.encode()
+        self.pad_to(4)
+        pos = len(self.buf)
+        self.buf += struct.pack('<I', len(data)) + data + b'\0'
+        return pos
+
+    def write_vector(self, v):
+        if v.kind == 'ref':
+            self.pad_to(4)
+            pos = len(self.buf)
+            self.buf += struct.pack('<I', len(v.items)) + bytes(4 * len(v.items))
+            for i, item in enumerate(v.items):
+                self.patch_offset(pos + 4 + 4 * i, self.write(item))
+            return pos
+        fmt = {'u8': 'B', 'i32': 'i', 'i64': 'q', 'f32': 'f'}[v.kind]
+        elem_size = struct.calcsize(fmt)
+        # The elements, not the length before them, must be aligned.
+        self.pad_to(max(v.align, elem_size, 4), 4)
+        pos = len(self.buf)
+        self.buf += struct.pack('<I', len(v.items)) + struct.pack('<%d%s' % (len(v.items), fmt), *v.items)
+        return pos
+
+    def write_table(self, t):
+        # Lay out the fields after the soffset to the vtable, largest first.
+        layout = []
+        size = 4
+        for index, kind, value in sorted(t.fields, key=lambda f: -field_size(f[1])):
+            n = field_size(kind)
+            size = (size + n - 1) // n * n
+            layout.append((index, kind, value, size))
+            size += n
+        num_slots = max([f[0] for f in t.fields], default=-1) + 1
+        slots = [0] * num_slots
+        for index, _, _, offset in layout:
+            slots[index] = offset
+
+        self.pad_to(2)
+        vtable = len(self.buf)
+        self.buf += struct.pack('<HH', 4 + 2 * num_slots, size)
+        self.buf += struct.pack('<%dH' % num_slots, *slots)
+        self.pad_to(4)
+        pos = len(self.buf)
+        self.buf += bytes(size)
+        struct.pack_into('<i', self.buf, pos, pos - vtable)
+        refs = []
+        for index, kind, value, offset in layout:
+            if kind == 'ref':
+                refs.append((pos + offset, value))
+            else:
+                struct.pack_into(SCALAR_FORMATS[kind], self.buf, pos + offset, value)
+        for at, value in refs:
+            self.patch_offset(at, self.write(value))
+        return pos
+
+
+def field_size(kind):
+    return 4 if kind == 'ref' else struct.calcsize(SCALAR_FORMATS[kind])
+
+
+def serialize(model):
+    w = Writer()
+    w.buf += bytes(4) + b'TFL3'
+    w.patch_offset(0, w.write(model))
+    return bytes(w.buf)
+
+
+class Model:
+    """Builds a model of a chain of ops."""
+
+    def __init__(self):
+        self.tensors = []
+        self.constants = set()
+        self.buffers = [Table()]  # Buffer 0 is always empty.
+        self.opcodes = []
+        self.operators = []
+        self.produced = set()
+        self.inputs = []
+
+    def tensor(self, name, tensor_type, shape, quant=None, data=None):
+        buffer = 0
+        if data is not None:
+            fmt = {FLOAT32: 'f', INT32: 'i', INT8: 'b'}[tensor_type]
+            raw = list(struct.pack('<%d%s' % (len(data), fmt), *data))
+            self.buffers.append(Table((0, 'ref', Vector('u8', raw, align=16))))
+            buffer = len(self.buffers) - 1
+            self.constants.add(len(self.tensors))
+        quantization = None
+        if quant is not None:
+            scale, zero = quant
+            quantization = Table((2, 'ref', Vector('f32', [scale])),
+                                 (3, 'ref', Vector('i64', [zero])),
+                                 (6, 'i32', 0))
+        self.tensors.append(Table((0, 'ref', Vector('i32', shape)),
+                                  (1, 'i8', tensor_type),
+                                  (2, 'u32', buffer),
+                                  (3, 'ref', name),
+                                  (4, 'ref', quantization)))
+        return len(self.tensors) - 1
+
+    def op(self, op_code, version, inputs, outputs, options_type=0, options=None):
+        if (op_code, version) not in self.opcodes:
+            self.opcodes.append((op_code, version))
+        self.operators.append(Table((0, 'u32', self.opcodes.index((op_code, version))),
+                                    (1, 'ref', Vector('i32', inputs)),
+                                    (2, 'ref', Vector('i32', outputs)),
+                                    (3, 'u8', options_type),
+                                    (4, 'ref', options)))
+        # The inputs of the model are the inputs of its ops that aren't
+        # constant, or produced by an op before.
+        for i in inputs:
+            if i not in self.constants and i not in self.produced and i not in self.inputs:
+                self.inputs.append(i)
+        self.produced.update(outputs)
+
+    def finish(self, op_code, version, inputs, outputs, options_type=0, options=None):
+        """Adds the last op, whose outputs are the outputs of the model."""
+        self.op(op_code, version, inputs, outputs, options_type, options)
+        subgraph = Table((0, 'ref', Vector('ref', self.tensors)),
+                         (1, 'ref', Vector('i32', self.inputs)),
+                         (2, 'ref', Vector('i32', outputs)),
+                         (3, 'ref', Vector('ref', self.operators)),
+                         (4, 'ref', 'main'))
+        opcodes = [Table((0, 'i8', code), (2, 'i32', version), (3, 'i32', code)) for code, version in self.opcodes]
+        return serialize(Table((0, 'u32', 3),
+                               (1, 'ref', Vector('ref', opcodes)),
+                               (2, 'ref', Vector('ref', [subgraph])),
+                               (3, 'ref', 'hannk single op test'),
+                               (4, 'ref', Vector('ref', self.buffers))))
+
+
+def random_values(rng, n, lo, hi, integer):
+    if integer:
+        return [rng.randint(lo, hi) for _ in range(n)]
+    return [rng.uniform(lo, hi) for _ in range(n)]
+
+
+def conv_options(stride, padding, activation):
+    return Table((0, 'i8', padding), (1, 'i32', stride), (2, 'i32', stride), (3, 'i8', activation),
+                 (4, 'i32', 1), (5, 'i32', 1))
+
+
+def depthwise_options(stride, padding, activation):
+    return Table((0, 'i8', padding), (1, 'i32', stride), (2, 'i32', stride), (3, 'i32', 1),
+                 (4, 'i8', activation), (5, 'i32', 1), (6, 'i32', 1))
+
+
+def pool_options(size, stride, padding, activation):
+    return Table((0, 'i8', padding), (1, 'i32', stride), (2, 'i32', stride), (3, 'i32', size),
+                 (4, 'i32', size), (5, 'i8', activation))
+
+
+def fully_connected_options(activation):
+    return Table((0, 'i8', activation))
+
+
+def add_options(activation):
+    return Table((0, 'i8', activation))
+
+
+# The quantization of the int8 models: (scale, zero) of the input, filter and
+# output. Filters are quantized symmetrically, as TFLite requires for int8.
+INPUT_Q = (0.02, -5)
+FILTER_Q = (0.01, 0)
+OUTPUT_Q = (0.1, 3)
+
+
+def make_filtered(op, is_int8, rng):
+    m = Model()
+    t = INT8 if is_int8 else FLOAT32
+    q = (lambda quant: quant) if is_int8 else (lambda quant: None)
+    weights = (lambda n: random_values(rng, n, -127, 127, True)) if is_int8 else \
+        (lambda n: random_values(rng, n, -1, 1, False))
+    bias_type = INT32 if is_int8 else FLOAT32
+    bias_q = (INPUT_Q[0] * FILTER_Q[0], 0) if is_int8 else None
+    biases = (lambda n: random_values(rng, n, -1000, 1000, True)) if is_int8 else \
+        (lambda n: random_values(rng, n, -1, 1, False))
+
+    if op == 'CONV_2D':
+        i = m.tensor('input', t, [1, 12, 10, 16], q(INPUT_Q))
+        f = m.tensor('filter', t, [24, 3, 3, 16], q(FILTER_Q), weights(24 * 3 * 3 * 16))
+        b = m.tensor('bias', bias_type, [24], bias_q, biases(24))
+        o = m.tensor('output', t, [1, 12, 10, 24], q(OUTPUT_Q))
+        return m.finish(CONV_2D, 3 if is_int8 else 1, [i, f, b], [o],
+                        CONV_2D_OPTIONS, conv_options(1, SAME, RELU))
+    if op == 'DEPTHWISE_CONV_2D':
+        i = m.tensor('input', t, [1, 13, 11, 32], q(INPUT_Q))
+        f = m.tensor('filter', t, [1, 3, 3, 32], q(FILTER_Q), weights(3 * 3 * 32))
+        b = m.tensor('bias', bias_type, [32], bias_q, biases(32))
+        o = m.tensor('output', t, [1, 7, 6, 32], q(OUTPUT_Q))
+        return m.finish(DEPTHWISE_CONV_2D, 3 if is_int8 else 1, [i, f, b], [o],
+                        DEPTHWISE_CONV_2D_OPTIONS, depthwise_options(2, SAME, RELU6))
+    if op == 'FULLY_CONNECTED':
+        i = m.tensor('input', t, [1, 64], q(INPUT_Q))
+        f = m.tensor('filter', t, [20, 64], q(FILTER_Q), weights(20 * 64))
+        b = m.tensor('bias', bias_type, [20], bias_q, biases(20))
+        o = m.tensor('output', t, [1, 20], q(OUTPUT_Q))
+        return m.finish(FULLY_CONNECTED, 4 if is_int8 else 1, [i, f, b], [o],
+                        FULLY_CONNECTED_OPTIONS, fully_connected_options(NONE))
+    raise ValueError(op)
+
+
+def make_pool(op, is_int8):
+    m = Model()
+    t = INT8 if is_int8 else FLOAT32
+    # TFLite requires the same quantization for the input and output.
+    q = INPUT_Q if is_int8 else None
+    i = m.tensor('input', t, [1, 15, 15, 8], q)
+    o = m.tensor('output', t, [1, 7, 7, 8], q)
+    code = AVERAGE_POOL_2D if op == 'AVERAGE_POOL_2D' else MAX_POOL_2D
+    return m.finish(code, 2 if is_int8 else 1, [i], [o],
+                    POOL_2D_OPTIONS, pool_options(3, 2, VALID, NONE))
+
+
+def make_quantize(op):
+    m = Model()
+    # Float inputs are filled with values in [0, 1].
+    int8_q = (1.0 / 200.0, -100)
+    if op == 'QUANTIZE':
+        i = m.tensor('input', FLOAT32, [1, 6, 5, 8])
+        o = m.tensor('output', INT8, [1, 6, 5, 8], int8_q)
+        return m.finish(QUANTIZE, 2, [i], [o])
+    i = m.tensor('input', INT8, [1, 6, 5, 8], int8_q)
+    o = m.tensor('output', FLOAT32, [1, 6, 5, 8])
+    return m.finish(DEQUANTIZE, 2, [i], [o])
+
+
+def make_fused(ops, rng):
+    """Makes an int8 model of a chain of ops that hannk fuses into one."""
+    m = Model()
+    weights = lambda n: random_values(rng, n, -127, 127, True)
+    biases = lambda n: random_values(rng, n, -1000, 1000, True)
+
+    if ops == 'CONV_2D_ADD':
+        # A residual connection: the conv's result is never stored.
+        i = m.tensor('input', INT8, [1, 12, 10, 16], INPUT_Q)
+        f = m.tensor('filter', INT8, [16, 3, 3, 16], FILTER_Q, weights(16 * 3 * 3 * 16))
+        b = m.tensor('bias', INT32, [16], (INPUT_Q[0] * FILTER_Q[0], 0), biases(16))
+        c = m.tensor('conv', INT8, [1, 12, 10, 16], OUTPUT_Q)
+        m.op(CONV_2D, 3, [i, f, b], [c], CONV_2D_OPTIONS, conv_options(1, SAME, RELU))
+        a = m.tensor('addend', INT8, [1, 12, 10, 16], INPUT_Q)
+        o = m.tensor('output', INT8, [1, 12, 10, 16], (0.12, -2))
+        return m.finish(ADD, 2, [c, a], [o], ADD_OPTIONS, add_options(NONE))
+    if ops == 'DEPTHWISE_CONV_2D_CONV_2D':
+        # A depthwise separable conv: the depthwise conv's result is never stored.
+        i = m.tensor('input', INT8, [1, 13, 11, 32], INPUT_Q)
+        df = m.tensor('depthwise_filter', INT8, [1, 3, 3, 32], FILTER_Q, weights(3 * 3 * 32))
+        db = m.tensor('depthwise_bias', INT32, [32], (INPUT_Q[0] * FILTER_Q[0], 0), biases(32))
+        d = m.tensor('depthwise', INT8, [1, 13, 11, 32], OUTPUT_Q)
+        m.op(DEPTHWISE_CONV_2D, 3, [i, df, db], [d], DEPTHWISE_CONV_2D_OPTIONS, depthwise_options(1, SAME, RELU6))
+        f = m.tensor('filter', INT8, [24, 1, 1, 32], FILTER_Q, weights(24 * 32))
+        b = m.tensor('bias', INT32, [24], (OUTPUT_Q[0] * FILTER_Q[0], 0), biases(24))
+        o = m.tensor('output', INT8, [1, 13, 11, 24], (0.12, -2))
+        return m.finish(CONV_2D, 3, [d, f, b], [o], CONV_2D_OPTIONS, conv_options(1, SAME, RELU))
+    raise ValueError(ops)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    rng = random.Random(12345)
+    models = {}
+    for is_int8, dir in ((False, 'float32'), (True, 'int8')):
+        for op in ('CONV_2D', 'DEPTHWISE_CONV_2D', 'FULLY_CONNECTED'):
+            models[(dir, op)] = make_filtered(op, is_int8, rng)
+        for op in ('AVERAGE_POOL_2D', 'MAX_POOL_2D'):
+            models[(dir, op)] = make_pool(op, is_int8)
+    for op in ('QUANTIZE', 'DEQUANTIZE'):
+        models[('int8', op)] = make_quantize(op)
+    for ops in ('CONV_2D_ADD', 'DEPTHWISE_CONV_2D_CONV_2D'):
+        models[('fused', ops)] = make_fused(ops, rng)
+
+    for (dir, op), data in sorted(models.items()):
+        os.makedirs(os.path.join(here, dir), exist_ok=True)
+        with open(os.path.join(here, dir, op + '.tflite'), 'wb') as f:
+            f.write(data)
+
+
+if __name__ == '__main__':
+    main()
@@ -370,6 +370,25 @@ public:
         return make_op<L2NormalizationOp>(input, output, axis);
     }
 
+    OpPtr parse_quantize(const tflite::Operator *op) {
+        TensorPtr input = tensors_[op->inputs()->Get(0)];
+        TensorPtr output = tensors_[op->outputs()->Get(0)];
+        // QuantizeOp handles per-tensor uint8 and int8 in either direction,
+        // and to or from float32. Check that here rather than failing when
+        // it runs, which for constants is during prepare().
+        const auto supported = [](const TensorPtr &t) {
+            if (t->type() == halide_type_of<float>()) {
+                return true;
+            }
+            return (t->type() == halide_type_of<uint8_t>() || t->type() == halide_type_of<int8_t>()) &&
+                   t->quantization().scale.size() == 1 && t->quantization().zero.size() == 1;
+        };
+        HCHECK(supported(input) && supported(output) &&
+               !(input->type() == halide_type_of<float>() && output->type() == halide_type_of<float>()))
+            << "Unsupported QUANTIZE or DEQUANTIZE from " << input->type() << " to " << output->type();
+        return make_op<QuantizeOp>(input, output);
+    }
+
     OpPtr parse_reduction(const tflite::Operator *op, ReductionOp::Operator reduction_op) {
         TensorPtr input = tensors_[op->inputs()->Get(0)];
         TensorPtr indices = tensors_[op->inputs()->Get(1)];
@@ -441,6 +460,8 @@ public:
             return parse_depth_to_space(op);
         case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
             return parse_depthwise_conv2D(op);
+        case tflite::BuiltinOperator_DEQUANTIZE:
+            return parse_quantize(op);
         case tflite::BuiltinOperator_EQUAL:
             return parse_binary(op, BinaryOp::Equal);
         case tflite::BuiltinOperator_FULLY_CONNECTED:
@@ -476,6 +497,8 @@ public:
             return parse_binary(op, BinaryOp::NotEqual);
         case tflite::BuiltinOperator_PAD:
             return parse_pad(op);
+        case tflite::BuiltinOperator_QUANTIZE:
+            return parse_quantize(op);
         case tflite::BuiltinOperator_RELU:
             return parse_unary(op, UnaryOp::Relu);
         case tflite::BuiltinOperator_RELU6:
@@ -2,6 +2,7 @@
 #include <dlfcn.h>
 #include <iostream>
 #include <random>
+#include <thread>
 
 #ifndef _WIN32
 #include <unistd.h>
@@ -13,6 +14,7 @@
 #include "delegate/hannk_delegate.h"
 #endif
 #include "halide_benchmark.h"
+#include "interpreter/constant_cache.h"
 #include "interpreter/interpreter.h"
 #include "tflite/tflite_parser.h"
 #include "util/buffer_util.h"
@@ -404,9 +406,7 @@ ModelRunner::RunResult ModelRunner::run_in_hannk(const std::vector<char> &buffer
         model->dump(std::cout);
     }
 
-    InterpreterOptions options;
-    options.verbosity = verbosity;
-    Interpreter interpreter(std::move(model), std::move(options));
+    Interpreter interpreter(std::move(model), hannk_options());
     if (!interpreter.prepare()) {
         std::cerr << "hannk::Interpreter::prepare() failed\n";
         // TODO: probably better form to return an error here, but for now, this is fine.
@@ -427,8 +427,9 @@ ModelRunner::RunResult ModelRunner::run_in_hannk(const std::vector<char> &buffer
         }
     }
 
-    // No: we won't be parallelizing within Halide code, that will be done within
-    // our interpreter. Leaving this here as an example of what *not* to do.
+    // No: we won't be parallelizing within Halide code, that is done by running
+    // independent ops at the same time (see InterpreterOptions::num_threads).
+    // Leaving this here as an example of what *not* to do.
     // halide_set_num_threads(threads);
 
     // Execute once, to prime the pump
@@ -443,6 +444,16 @@ ModelRunner::RunResult ModelRunner::run_in_hannk(const std::vector<char> &buffer
         result.outputs.emplace_back(t->buffer().copy());
     }
 
+    if (contexts > 0) {
+        run_hannk_contexts(interpreter, result.outputs);
+    }
+    if (!constant_cache_dir.empty()) {
+        run_hannk_cached(buffer, interpreter, result.outputs);
+    }
+    if (check_unfused) {
+        run_hannk_unfused(buffer, interpreter, result.outputs);
+    }
+
     // Now benchmark it
     if (do_benchmark) {
         result.time = bench([&interpreter]() {
@@ -453,6 +464,120 @@ ModelRunner::RunResult ModelRunner::run_in_hannk(const std::vector<char> &buffer
     return result;
 }
 
+void ModelRunner::run_hannk_contexts(Interpreter &interpreter, const std::vector<HalideBuffer<const void>> &expected) {
+    // Give each context the same inputs as the interpreter.
+    std::vector<std::unique_ptr<InterpreterContext>> instances;
+    const std::vector<TensorPtr> inputs = interpreter.inputs();
+    for (int i = 0; i < contexts; i++) {
+        instances.push_back(interpreter.make_context());
+        const std::vector<TensorPtr> context_inputs = instances.back()->inputs();
+        for (size_t j = 0; j < inputs.size(); j++) {
+            if (!inputs[j]->is_constant()) {
+                auto buf = context_inputs[j]->buffer();
+                buf.copy_from(inputs[j]->buffer());
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    for (auto &c : instances) {
+        workers.emplace_back([&c]() {
+            c->execute();
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    // Running concurrently on the same weights must give exactly the same results.
+    for (int i = 0; i < contexts; i++) {
+        const std::vector<TensorPtr> outputs = instances[i]->outputs();
+        for (size_t j = 0; j < outputs.size(); j++) {
+            const auto actual = outputs[j]->buffer().copy();
+            if (actual.size_in_bytes() != expected[j].size_in_bytes() ||
+                memcmp(actual.data(), expected[j].data(), actual.size_in_bytes()) != 0) {
+                std::cerr << "hannk context " << i << " output " << outputs[j]->name() << " does not match the interpreter\n";
+                exit(1);
+            }
+        }
+    }
+    if (verbosity) {
+        std::cout << "HALIDE outputs of " << contexts << " contexts match\n";
+    }
+}
+
+InterpreterOptions ModelRunner::hannk_options() const {
+    InterpreterOptions options;
+    options.verbosity = verbosity;
+    options.num_threads = threads;
+    options.tile_cache_size = tile_cache_size;
+    options.allocation_strategy = allocation_strategy;
+    options.constant_cache_dir = constant_cache_dir;
+    return options;
+}
+
+void ModelRunner::check_hannk_outputs(Interpreter &interpreter, Interpreter &other, const std::string &what,
+                                      const std::vector<HalideBuffer<const void>> &expected) {
+    // Give it the same inputs as the interpreter.
+    const std::vector<TensorPtr> inputs = interpreter.inputs();
+    const std::vector<TensorPtr> other_inputs = other.inputs();
+    for (size_t j = 0; j < inputs.size(); j++) {
+        if (!inputs[j]->is_constant()) {
+            auto buf = other_inputs[j]->buffer();
+            buf.copy_from(inputs[j]->buffer());
+        }
+    }
+
+    other.execute();
+
+    const std::vector<TensorPtr> outputs = other.outputs();
+    for (size_t j = 0; j < outputs.size(); j++) {
+        const auto actual = outputs[j]->buffer().copy();
+        if (actual.size_in_bytes() != expected[j].size_in_bytes() ||
+            memcmp(actual.data(), expected[j].data(), actual.size_in_bytes()) != 0) {
+            std::cerr << "hannk output " << outputs[j]->name() << " " << what << " does not match the interpreter\n";
+            exit(1);
+        }
+    }
+    if (verbosity) {
+        std::cout << "HALIDE outputs " << what << " match\n";
+    }
+}
+
+void ModelRunner::run_hannk_cached(const std::vector<char> &buffer, Interpreter &interpreter, const std::vector<HalideBuffer<const void>> &expected) {
+    // The interpreter's prepare() saved what it computed, so preparing
+    // the same model again must load every constant from the cache.
+    Interpreter cached(parse_tflite_model_from_buffer(buffer.data()), hannk_options());
+    if (!cached.prepare()) {
+        std::cerr << "hannk::Interpreter::prepare() failed with the constant cache\n";
+        exit(1);
+    }
+    const ConstantCache *cache = cached.constant_cache();
+    if (cache->computed() != 0 || cache->loaded() == 0) {
+        std::cerr << "hannk constant cache in " << constant_cache_dir << " loaded " << cache->loaded()
+                  << " constants, and computed " << cache->computed() << "\n";
+        exit(1);
+    }
+
+    // The constants from the cache must give exactly the same results.
+    check_hannk_outputs(interpreter, cached, "with cached constants", expected);
+}
+
+void ModelRunner::run_hannk_unfused(const std::vector<char> &buffer, Interpreter &interpreter, const std::vector<HalideBuffer<const void>> &expected) {
+    InterpreterOptions options = hannk_options();
+    options.fuse_ops = false;
+    // The cached constants are those of the fused model.
+    options.constant_cache_dir.clear();
+    Interpreter unfused(parse_tflite_model_from_buffer(buffer.data()), std::move(options));
+    if (!unfused.prepare()) {
+        std::cerr << "hannk::Interpreter::prepare() failed without fusing ops\n";
+        exit(1);
+    }
+
+    // The fused ops must give exactly the same results as the ops they replace.
+    check_hannk_outputs(interpreter, unfused, "without fusing ops", expected);
+}
+
 #if HANNK_BUILD_TFLITE
 ModelRunner::RunResult ModelRunner::run_in_tflite(const std::vector<char> &buffer, TfLiteDelegate *delegate) {
     RunResult result;
@@ -490,7 +615,13 @@ bool ModelRunner::compare_results(const std::string &name_a, const std::string &
             HCHECK(tflite_buf.dim(d).stride() == halide_buf.dim(d).stride());  // TODO: must the strides match?
         }
         CompareBuffersOptions options;
-        options.close_thresh = std::ceil((1ull << tflite_buf.type().bits) * tolerance);
+        if (tflite_buf.type().code == halide_type_float) {
+            // The tolerance is a fraction of the range of integer types, which
+            // would allow almost any float, so use it as an absolute error.
+            options.close_thresh = tolerance;
+        } else {
+            options.close_thresh = std::ceil((1ull << tflite_buf.type().bits) * tolerance);
+        }
         options.max_diffs_to_log = 8;
         options.verbose = !csv_output;
         CompareBuffersResult r = dynamic_type_dispatch<CompareBuffers>(tflite_buf.type(), tflite_buf, halide_buf, options);
@@ -518,14 +649,33 @@ int ModelRunner::parse_flags(int argc, char **argv, std::vector<std::string> &fi
     };
 
     fp.flag_handlers = FlagProcessor::FnMap{
+        {"allocation_strategy", [this](const std::string &value) {
+             if (!parse_allocation_strategy(value, &this->allocation_strategy)) {
+                 std::cerr << "Unknown allocation strategy: " << value << "\n";
+                 return -1;
+             }
+             return 0;
+         }},
         {"benchmark", [this](const std::string &value) {
              this->do_benchmark = std::stoi(value) != 0;
              return 0;
          }},
+        {"check_unfused", [this](const std::string &value) {
+             this->check_unfused = std::stoi(value) != 0;
+             return 0;
+         }},
         {"compare", [this](const std::string &value) {
              this->do_compare_results = std::stoi(value) != 0;
              return 0;
          }},
+        {"constant_cache_dir", [this](const std::string &value) {
+             this->constant_cache_dir = value;
+             return 0;
+         }},
+        {"contexts", [this](const std::string &value) {
+             this->contexts = std::stoi(value);
+             return 0;
+         }},
         {"csv", [this](const std::string &value) {
              this->csv_output = std::stoi(value) != 0;
              return 0;
@@ -580,6 +730,10 @@ int ModelRunner::parse_flags(int argc, char **argv, std::vector<std::string> &fi
              this->threads = std::stoi(value);
              return 0;
          }},
+        {"tile_cache_size", [this](const std::string &value) {
+             this->tile_cache_size = std::stoll(value);
+             return 0;
+         }},
         {"tolerance", [this](const std::string &value) {
              this->tolerance = std::stof(value);
              return 0;
@@ -2,12 +2,14 @@
 #define HANNK_MODEL_RUNNER_H
 
 #include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <vector>
 
+#include "interpreter/allocation_planner.h"
 #include "util/buffer_util.h"
 
 #if HANNK_BUILD_TFLITE
@@ -19,6 +21,9 @@ struct TfLiteModel;
 
 namespace hannk {
 
+class Interpreter;
+struct InterpreterOptions;
+
 struct FlagProcessor {
     using Fn = std::function<int(const std::string &)>;
     using FnMap = std::map<std::string, Fn>;
@@ -101,6 +106,18 @@ struct ModelRunner {
     };
 
     int threads = 1;
+    int64_t tile_cache_size = 0;
+    AllocationStrategy allocation_strategy = AllocationStrategy::Smallest;
+    // If nonzero, also run this many InterpreterContexts of the hannk model at
+    // the same time, and check they all get the same results as the Interpreter.
+    int contexts = 0;
+    // If not empty, prepare the hannk model with this constant cache
+    // directory, then prepare it again, and check the second prepare loads
+    // every constant from the cache and gets the same results.
+    std::string constant_cache_dir;
+    // If true, also prepare the hannk model without fusing ops, and check
+    // it gets the same results.
+    bool check_unfused = false;
     int verbosity = 0;
     bool do_run[kNumRuns];  // no way to default-init everything to anything but zero, alas
     bool do_benchmark = true;
@@ -134,6 +151,12 @@ private:
         std::chrono::duration<double> time{0};
     };
     RunResult run_in_hannk(const std::vector<char> &buffer);
+    void run_hannk_contexts(Interpreter &interpreter, const std::vector<HalideBuffer<const void>> &expected);
+    InterpreterOptions hannk_options() const;
+    void check_hannk_outputs(Interpreter &interpreter, Interpreter &other, const std::string &what,
+                             const std::vector<HalideBuffer<const void>> &expected);
+    void run_hannk_cached(const std::vector<char> &buffer, Interpreter &interpreter, const std::vector<HalideBuffer<const void>> &expected);
+    void run_hannk_unfused(const std::vector<char> &buffer, Interpreter &interpreter, const std::vector<HalideBuffer<const void>> &expected);
 #if HANNK_BUILD_TFLITE
     RunResult run_in_tflite(const std::vector<char> &buffer, TfLiteDelegate *delegate = nullptr);
 #endif
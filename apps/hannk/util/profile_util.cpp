@@ -0,0 +1,349 @@
+#include "util/profile_util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <utility>
+
+namespace hannk {
+
+namespace {
+
+// Bump this whenever the meaning of the fields changes, so that stale
+// baselines are rejected.
+constexpr int profile_version = 1;
+
+// Regressions smaller than this are assumed to be noise.
+constexpr double min_regression_seconds = 5e-6;
+
+// The value at quantile q of the sorted times, by the nearest rank.
+double quantile(const std::vector<double> &sorted, double q) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const size_t rank = (size_t)std::ceil(q * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+double median(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    return quantile(times, 0.5);
+}
+
+void write_string(std::ostream &os, const std::string &s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+// Just enough of JSON to read back what write_profiles_json() writes.
+struct JsonValue {
+    enum Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+    Type type = Null;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    const JsonValue *find(const std::string &key) const {
+        auto i = object.find(key);
+        return i != object.end() ? &i->second : nullptr;
+    }
+};
+
+class JsonParser {
+    const std::string &s_;
+    size_t pos_ = 0;
+
+    void skip_whitespace() {
+        while (pos_ < s_.size() && isspace((unsigned char)s_[pos_])) {
+            pos_++;
+        }
+    }
+
+    bool consume(const char *token) {
+        const size_t n = strlen(token);
+        if (s_.compare(pos_, n, token) == 0) {
+            pos_ += n;
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_string(std::string *result) {
+        if (!consume("\"")) {
+            return false;
+        }
+        while (pos_ < s_.size() && s_[pos_] != '"') {
+            char c = s_[pos_++];
+            if (c == '\\') {
+                if (pos_ >= s_.size()) {
+                    return false;
+                }
+                c = s_[pos_++];
+                switch (c) {
+                case 'n':
+                    c = '\n';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'u':
+                    // Only the control characters write_string() escapes.
+                    if (pos_ + 4 > s_.size()) {
+                        return false;
+                    }
+                    c = (char)strtol(s_.substr(pos_, 4).c_str(), nullptr, 16);
+                    pos_ += 4;
+                    break;
+                default:
+                    break;
+                }
+            }
+            result->push_back(c);
+        }
+        return consume("\"");
+    }
+
+public:
+    explicit JsonParser(const std::string &s)
+        : s_(s) {
+    }
+
+    bool parse(JsonValue *result) {
+        skip_whitespace();
+        if (pos_ >= s_.size()) {
+            return false;
+        }
+        const char c = s_[pos_];
+        if (c == '{') {
+            pos_++;
+            result->type = JsonValue::Object;
+            skip_whitespace();
+            if (consume("}")) {
+                return true;
+            }
+            do {
+                skip_whitespace();
+                std::string key;
+                if (!parse_string(&key)) {
+                    return false;
+                }
+                skip_whitespace();
+                if (!consume(":") || !parse(&result->object[key])) {
+                    return false;
+                }
+                skip_whitespace();
+            } while (consume(","));
+            return consume("}");
+        } else if (c == '[') {
+            pos_++;
+            result->type = JsonValue::Array;
+            skip_whitespace();
+            if (consume("]")) {
+                return true;
+            }
+            do {
+                result->array.emplace_back();
+                if (!parse(&result->array.back())) {
+                    return false;
+                }
+                skip_whitespace();
+            } while (consume(","));
+            return consume("]");
+        } else if (c == '"') {
+            result->type = JsonValue::String;
+            return parse_string(&result->string);
+        } else if (consume("true") || consume("false")) {
+            result->type = JsonValue::Bool;
+            result->number = c == 't';
+            return true;
+        } else if (consume("null")) {
+            result->type = JsonValue::Null;
+            return true;
+        } else {
+            const char *begin = s_.c_str() + pos_;
+            char *end = nullptr;
+            result->type = JsonValue::Number;
+            result->number = strtod(begin, &end);
+            pos_ += end - begin;
+            return end != begin;
+        }
+    }
+
+    bool at_end() {
+        skip_whitespace();
+        return pos_ == s_.size();
+    }
+};
+
+}  // namespace
+
+void write_profiles_json(std::ostream &os, const std::vector<ModelProfile> &profiles) {
+    os << std::setprecision(6);
+    os << "{\n"
+       << "  \"version\": " << profile_version << ",\n"
+       << "  \"models\": [";
+    for (size_t m = 0; m < profiles.size(); m++) {
+        const ModelProfile &model = profiles[m];
+        double total_seconds = 0.0;
+        for (const OpProfile &op : model.ops) {
+            total_seconds += median(op.times);
+        }
+        os << (m > 0 ? ",\n" : "\n")
+           << "    {\n"
+           << "      \"model\": ";
+        write_string(os, model.model);
+        os << ",\n"
+           << "      \"sum_of_median_us\": " << total_seconds * 1e6 << ",\n"
+           << "      \"ops\": [";
+        for (size_t i = 0; i < model.ops.size(); i++) {
+            const OpProfile &op = model.ops[i];
+            std::vector<double> sorted = op.times;
+            std::sort(sorted.begin(), sorted.end());
+            double mean = 0.0;
+            for (double t : sorted) {
+                mean += t;
+            }
+            mean /= std::max(sorted.size(), (size_t)1);
+            const double median_seconds = quantile(sorted, 0.5);
+            const double gops = median_seconds > 0 ? op.arithmetic_ops / median_seconds * 1e-9 : 0.0;
+            const double gbps = median_seconds > 0 ? op.bytes / median_seconds * 1e-9 : 0.0;
+
+            os << (i > 0 ? ",\n" : "\n")
+               << "        {\n"
+               << "          \"index\": " << i << ",\n"
+               << "          \"name\": ";
+            write_string(os, op.name);
+            os << ",\n"
+               << "          \"arithmetic_ops\": " << op.arithmetic_ops << ",\n"
+               << "          \"bytes\": " << op.bytes << ",\n"
+               << "          \"min_us\": " << quantile(sorted, 0.0) * 1e6 << ",\n"
+               << "          \"p10_us\": " << quantile(sorted, 0.1) * 1e6 << ",\n"
+               << "          \"median_us\": " << median_seconds * 1e6 << ",\n"
+               << "          \"p90_us\": " << quantile(sorted, 0.9) * 1e6 << ",\n"
+               << "          \"max_us\": " << quantile(sorted, 1.0) * 1e6 << ",\n"
+               << "          \"mean_us\": " << mean * 1e6 << ",\n"
+               << "          \"gops\": " << gops << ",\n"
+               << "          \"gbps\": " << gbps << ",\n"
+               << "          \"times_us\": [";
+            for (size_t j = 0; j < op.times.size(); j++) {
+                os << (j > 0 ? ", " : "") << op.times[j] * 1e6;
+            }
+            os << "]\n"
+               << "        }";
+        }
+        os << "\n"
+           << "      ]\n"
+           << "    }";
+    }
+    os << "\n"
+       << "  ]\n"
+       << "}\n";
+}
+
+bool read_profiles_json(const std::string &json, std::vector<ModelProfile> *profiles) {
+    JsonValue root;
+    JsonParser parser(json);
+    if (!parser.parse(&root) || !parser.at_end() || root.type != JsonValue::Object) {
+        return false;
+    }
+    const JsonValue *version = root.find("version");
+    const JsonValue *models = root.find("models");
+    if (!version || version->number != profile_version || !models || models->type != JsonValue::Array) {
+        return false;
+    }
+
+    for (const JsonValue &m : models->array) {
+        const JsonValue *name = m.find("model");
+        const JsonValue *ops = m.find("ops");
+        if (!name || name->type != JsonValue::String || !ops || ops->type != JsonValue::Array) {
+            return false;
+        }
+        ModelProfile model;
+        model.model = name->string;
+        for (const JsonValue &o : ops->array) {
+            const JsonValue *op_name = o.find("name");
+            const JsonValue *times = o.find("times_us");
+            if (!op_name || op_name->type != JsonValue::String || !times || times->type != JsonValue::Array) {
+                return false;
+            }
+            OpProfile op;
+            op.name = op_name->string;
+            for (const JsonValue &t : times->array) {
+                op.times.push_back(t.number * 1e-6);
+            }
+            model.ops.push_back(std::move(op));
+        }
+        profiles->push_back(std::move(model));
+    }
+    return true;
+}
+
+int compare_profiles(const std::vector<ModelProfile> &baseline, const std::vector<ModelProfile> &current,
+                     double threshold, std::ostream &os) {
+    std::map<std::string, const ModelProfile *> baseline_models;
+    for (const ModelProfile &m : baseline) {
+        baseline_models[m.model] = &m;
+    }
+
+    int regressions = 0;
+    for (const ModelProfile &m : current) {
+        auto b = baseline_models.find(m.model);
+        if (b == baseline_models.end()) {
+            os << m.model << ": not in the baseline\n";
+            continue;
+        }
+        const ModelProfile &base = *b->second;
+        bool same_ops = base.ops.size() == m.ops.size();
+        for (size_t i = 0; same_ops && i < m.ops.size(); i++) {
+            same_ops = base.ops[i].name == m.ops[i].name;
+        }
+        if (!same_ops) {
+            os << m.model << ": the ops differ from those in the baseline\n";
+            continue;
+        }
+
+        for (size_t i = 0; i < m.ops.size(); i++) {
+            const double before = median(base.ops[i].times);
+            const double after = median(m.ops[i].times);
+            if (before > 0 && after > before * (1.0 + threshold) && after - before > min_regression_seconds) {
+                os << m.model << ": op " << i << " (" << m.ops[i].name << ") regressed from "
+                   << before * 1e6 << " us to " << after * 1e6 << " us (+"
+                   << std::lround((after / before - 1.0) * 100) << "%)\n";
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+}  // namespace hannk
@@ -0,0 +1,41 @@
+#ifndef HANNK_PROFILE_UTIL_H
+#define HANNK_PROFILE_UTIL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "interpreter/interpreter.h"
+
+namespace hannk {
+
+// The per-op profile of one model, as measured by Interpreter::profile_ops().
+struct ModelProfile {
+    std::string model;
+    std::vector<OpProfile> ops;
+};
+
+// Write the profiles as JSON. For each op, this includes a summary of the
+// distribution of its times, the GOPS and GB/s achieved at the median time,
+// and every time measured, so that the file can be used as a baseline.
+void write_profiles_json(std::ostream &os, const std::vector<ModelProfile> &profiles);
+
+// Read profiles written by write_profiles_json(). Only the model and op
+// names and the times are read back; the other fields are recomputed from
+// them, or are ignored. Returns false if the JSON is malformed.
+[[nodiscard]] bool read_profiles_json(const std::string &json, std::vector<ModelProfile> *profiles);
+
+// Compare the median time of each op with that of the same op in the
+// baseline, and report the ops more than `threshold` (e.g. 0.1 = 10%)
+// slower than the baseline to os. Very short ops are only reported if they
+// are slower by more than a few microseconds, to avoid noise. Ops of models
+// that aren't in the baseline, or whose ops differ from those in the
+// baseline, are reported but don't count as regressions.
+//
+// Returns the number of regressions.
+int compare_profiles(const std::vector<ModelProfile> &baseline, const std::vector<ModelProfile> &current,
+                     double threshold, std::ostream &os);
+
+}  // namespace hannk
+
+#endif  // HANNK_PROFILE_UTIL_H
@@ -1,6 +1,9 @@
 #ifndef BENCHMARKING_UTILS_H_
 #define BENCHMARKING_UTILS_H_
 
+#include <time.h>
+#include <vector>
+
 // Flush the content of all the CPU caches by updating more data than what would fit in cache. This is simply needed when benchmarking in order to get more reliable performance numbers.
 class CacheEvictor {
 public:
@@ -19,4 +22,42 @@ private:
     std::vector<int> buffer_;
 };
 
+// Return the average runtime in nanoseconds of num_iters calls to run(),
+// each of them made with cold caches. The time spent flushing the caches is
+// measured separately and isn't included.
+template<typename F>
+double benchmark_with_cold_caches(F run, int num_iters) {
+    // large array used to flush the caches after each iteration of benchmarking.
+    CacheEvictor cache_evictor;
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (int i = 0; i < num_iters; ++i) {
+        // Increment the coefficients store in the cache evictor: this ensures that
+        // all the data left in caches from the previous iteration is flushed out.
+        cache_evictor.flush_caches();
+        run();
+    }
+    clock_gettime(CLOCK_REALTIME, &end);
+
+    double total_runtime =
+        (end.tv_sec - start.tv_sec) * 1e9 + end.tv_nsec - start.tv_nsec;
+
+    // Figure out how long it took to flush the caches at every iteration and
+    // adjust the runtime accordingly.
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (int i = 0; i < num_iters; ++i) {
+        cache_evictor.flush_caches();
+    }
+    clock_gettime(CLOCK_REALTIME, &end);
+    double flush_time =
+        (end.tv_sec - start.tv_sec) * 1e9 + end.tv_nsec - start.tv_nsec;
+
+    total_runtime -= flush_time;
+
+    // Return the average runtime. TODO: filter the outliers if any.
+    return total_runtime / num_iters;
+}
+
 #endif
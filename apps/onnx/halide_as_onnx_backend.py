@@ -2,12 +2,105 @@
 
 
 from onnx.backend.base import Backend as BackendBase
+from onnx.backend.base import BackendRep
 import onnx
 import model as halide_model
 import signal
 import base64
 import hashlib
 import datetime
+import collections
+
+# The batch sizes the scheduled models are specialized for. Other batch sizes
+# (and all the batch sizes of the models that aren't scheduled) run the generic
+# code.
+SPECIALIZED_BATCH_SIZES = (1, 2, 4, 8, 16, 32)
+
+
+class CompiledModelCache():
+    """Cache of the models compiled by the backend, keyed by the hash of the
+    graph, the device, and the bucket of the shapes of the inputs.
+
+    The dims of the inputs that aren't fixed by the model (e.g. the batch size
+    or the length of a sequence) are symbolic in the compiled code, so a model
+    compiled once can run on inputs of any shape. The bucket only tunes the
+    estimates given to the autoscheduler: each symbolic dim other than the
+    batch size is rounded up to the next power of two. The batch size is
+    always estimated as the largest of SPECIALIZED_BATCH_SIZES, and the
+    scheduled models are specialized for each of those instead.
+    """
+
+    def __init__(self, max_entries=16):
+        self.max_entries = max_entries
+        self.entries = collections.OrderedDict()
+
+    def get(self, onnx_model, graph_hash, expected_dim_sizes, device):
+        key = (graph_hash, device, tuple(sorted(expected_dim_sizes.items())))
+        if key in self.entries:
+            self.entries.move_to_end(key)
+            return self.entries[key]
+
+        compiled = halide_model.Model()
+        compiled.BuildFromOnnxModel(onnx_model, expected_dim_sizes)
+        # Optimize the schedule of nontrivial models to make sure they
+        # complete in a reasonable amount of time. The specializations copy
+        # the schedule, so they would only compile the same unscheduled code
+        # again for the others.
+        if len(onnx_model.graph.node) > 10:
+            compiled.OptimizeSchedule()
+            compiled.SpecializeBatchSizes(SPECIALIZED_BATCH_SIZES)
+
+        self.entries[key] = compiled
+        if len(self.entries) > self.max_entries:
+            self.entries.popitem(last=False)
+        return compiled
+
+
+compiled_models = CompiledModelCache()
+
+
+def _bucket(size):
+    bucket = 1
+    while bucket < size:
+        bucket *= 2
+    return bucket
+
+
+class HalideBackendRep(BackendRep):
+    """A model prepared by the backend. It is compiled for the shapes of the
+    inputs it runs on, through the compiled_models cache."""
+
+    def __init__(self, model, device):
+        self.model = model
+        self.device = device
+        self.graph_hash = hashlib.sha256(model.SerializeToString()).hexdigest()
+
+        initializers = set(i.name for i in model.graph.initializer)
+        self.inputs = [i for i in model.graph.input
+                       if i.name not in initializers]
+        # The batch size is the first dim of the first input whose first
+        # dim isn't fixed.
+        self.batch_dim = None
+        for i in self.inputs:
+            dims = i.type.tensor_type.shape.dim
+            if len(dims) > 0 and dims[0].HasField('dim_param'):
+                self.batch_dim = dims[0].dim_param
+                break
+
+    def run(self, inputs, device=''):
+        expected_dim_sizes = {}
+        for i, value in zip(self.inputs, inputs):
+            for dim, size in zip(i.type.tensor_type.shape.dim, value.shape):
+                if dim.HasField('dim_param') and dim.dim_param != self.batch_dim:
+                    expected_dim_sizes[dim.dim_param] = _bucket(size)
+        # Otherwise the converter estimates the batch size as 128, which is
+        # far larger than any of the specializations.
+        if self.batch_dim is not None:
+            expected_dim_sizes[self.batch_dim] = max(SPECIALIZED_BATCH_SIZES)
+
+        compiled = compiled_models.get(self.model, self.graph_hash,
+                                       expected_dim_sizes, self.device)
+        return compiled.run(inputs, device)
 
 
 class HalideBackend(BackendBase):
@@ -31,8 +124,11 @@ class HalideBackend(BackendBase):
                 ):
         """Prepare an ONNX model to run using the Halide backend.
 
-        Builds and returns an internal representation of the model (which
-        includes the actual Halide pipeline).
+        Returns an internal representation of the model, which builds the
+        actual Halide pipeline when it is first run with inputs of a given
+        shape. The pipelines are cached and shared by all the prepared copies
+        of the same model, so that preparing and running a model again (or
+        with a different batch size) doesn't recompile it.
 
         :param model: The ONNX model to be converted.
         :param device: The device to execute this model on (Ignored for now).
@@ -41,13 +137,7 @@ class HalideBackend(BackendBase):
         """
         onnx.checker.check_model(model)
 
-        prepared = halide_model.Model()
-        prepared.BuildFromOnnxModel(model)
-        # Optimize the schedule of nontrivial models to make sure they
-        # complete in a reasonable amount of time
-        if len(model.graph.node) > 10:
-            prepared.OptimizeSchedule()
-        return prepared
+        return HalideBackendRep(model, device)
 
     @classmethod
     def run_model(cls,
@@ -7,6 +7,7 @@
 #include "denormal_disabler.h"
 #include "onnx_converter.h"
 #include <fstream>
+#include <map>
 #include <random>
 #include <sys/time.h>
 #include <unordered_set>
@@ -70,6 +71,62 @@ std::string auto_schedule(const HalideModel &pipeline) {
     return schedule.schedule_source;
 }
 
+void apply_schedule(const HalideModel &pipeline, const std::string &schedule) {
+    ModelSchedule model_schedule;
+    if (schedule == "per_node") {
+        model_schedule = ModelSchedule::PerNode;
+    } else if (schedule == "fused") {
+        model_schedule = ModelSchedule::Fused;
+    } else {
+        throw std::invalid_argument(
+            "Unknown schedule " + schedule + ", expected per_node or fused");
+    }
+    schedule_model(*pipeline.model, model_schedule, Halide::get_host_target());
+}
+
+// Specialize the model for each of the given batch sizes, i.e. values of the
+// first dimension of the first input whose first dimension isn't fixed by the
+// model. Returns false if there is no such input. A specialization only
+// applies to the loop nest of the Func it is added to (and the Funcs computed
+// within it), so this specializes the outputs and every other Func computed
+// at root. This must be done after scheduling the model, since the
+// specializations copy the schedule of the Funcs, and before the model is run.
+bool specialize_batch_sizes(
+    const HalideModel &pipeline,
+    const std::vector<int> &batch_sizes) {
+    Halide::Expr batch_size;
+    for (const std::string &input_name : pipeline.input_names) {
+        const Tensor &t = pipeline.model->tensors.at(input_name);
+        if (!t.shape.empty() && !Halide::Internal::as_const_int(t.shape[0])) {
+            batch_size = t.shape[0];
+            break;
+        }
+    }
+    if (!batch_size.defined()) {
+        return false;
+    }
+    std::map<std::string, Halide::Func> funcs;
+    for (const std::string &output_name : pipeline.output_names) {
+        Halide::Func f = pipeline.model->outputs.at(output_name).rep;
+        funcs.emplace(f.name(), f);
+    }
+    // LoopLevels can't be inspected until they are locked by lowering, but
+    // the name of the var they are at can be.
+    const std::string root = Halide::LoopLevel::root().var_name();
+    for (const auto &it : pipeline.model->tensors) {
+        Halide::Func f = it.second.rep;
+        if (f.defined() && f.function().schedule().compute_level().var_name() == root) {
+            funcs.emplace(f.name(), f);
+        }
+    }
+    for (auto &it : funcs) {
+        for (int size : batch_sizes) {
+            it.second.specialize(batch_size == size);
+        }
+    }
+    return true;
+}
+
 template<typename T>
 struct Distribution {
     typedef typename std::conditional<
@@ -432,9 +489,6 @@ double benchmark(
     // called.
     DenormalDisabler scoped_denormal_disabler;
 
-    // large array used to flush the caches after each iteration of benchmarking.
-    CacheEvictor cache_evictor;
-
     // Generate random value for every input
     for (ssize_t i = 0; i < pipeline.model->inputs.size(); ++i) {
         const std::string &input_name = pipeline.input_names[i];
@@ -469,34 +523,32 @@ double benchmark(
     pipeline.rep->realize(real, tgt);
 
     // Now benchmark by computing the value of the outputs num_iter times
-    struct timespec start;
-    struct timespec end;
-    clock_gettime(CLOCK_REALTIME, &start);
-    for (int i = 0; i < num_iters; ++i) {
-        // Increment the coefficients store in the cache evictor: this ensures that
-        // all the data left in caches from the previous iteration is flushed out.
-        cache_evictor.flush_caches();
-        pipeline.rep->realize(real, tgt);
-    }
-    clock_gettime(CLOCK_REALTIME, &end);
-
-    double total_runtime =
-        (end.tv_sec - start.tv_sec) * 1e9 + end.tv_nsec - start.tv_nsec;
-
-    // Figure out how long it took to generate new inputs at every iteration
-    // and adjust the runtime accordingly.
-    clock_gettime(CLOCK_REALTIME, &start);
-    for (int i = 0; i < num_iters; ++i) {
-        cache_evictor.flush_caches();
-    }
-    clock_gettime(CLOCK_REALTIME, &end);
-    double input_gen_time =
-        (end.tv_sec - start.tv_sec) * 1e9 + end.tv_nsec - start.tv_nsec;
-
-    total_runtime -= input_gen_time;
-
-    // Return the average runtime. TODO: filter the outliers if any.
-    return total_runtime / num_iters;
+    return benchmark_with_cold_caches(
+        [&]() { pipeline.rep->realize(real, tgt); }, num_iters);
+}
+
+// Schedule the model with each of the given schedules, and return the
+// average runtime of each of them. Since scheduling a model can't be undone,
+// the model is converted again for each schedule.
+std::map<std::string, double> compare_schedules(
+    const std::string &onnx_model_str,
+    const std::unordered_map<std::string, int> &expected_dim_sizes,
+    const IOLayout layout,
+    const std::vector<std::string> &schedules,
+    int num_iters,
+    const std::string &device) {
+    std::map<std::string, double> results;
+    for (const std::string &schedule : schedules) {
+        HalideModel pipeline =
+            convert_onnx_model(onnx_model_str, expected_dim_sizes, layout);
+        if (schedule == "auto") {
+            auto_schedule(pipeline);
+        } else if (schedule != "none") {
+            apply_schedule(pipeline, schedule);
+        }
+        results[schedule] = benchmark(pipeline, num_iters, device);
+    }
+    return results;
 }
 
 void compile(
@@ -557,8 +609,20 @@ PYBIND11_MODULE(model_cpp, m) {
         "AutoSchedule",
         &auto_schedule,
         "A function to automatic schedule HalideModel.");
+    m.def(
+        "ApplySchedule",
+        &apply_schedule,
+        "Applies a heuristic schedule (per_node or fused) to HalideModel.");
+    m.def(
+        "SpecializeBatchSizes",
+        &specialize_batch_sizes,
+        "Specializes HalideModel for the given batch sizes.");
     m.def("Run", &run, "A function to JIT compile and run HalideModel.");
     m.def("Benchmark", &benchmark, "A function to benchmark the model");
+    m.def(
+        "CompareSchedules",
+        &compare_schedules,
+        "Benchmark an onnx model proto with each of the given schedules.");
     m.def("Compile", &compile, "Compile the pipeline");
     m.def(
         "PrintLoopNest",
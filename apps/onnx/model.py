@@ -29,6 +29,19 @@ class Model():
             raise Exception("model not initialized, call BuildFromOnnxModel first")
         return model_cpp.AutoSchedule(self.pipeline)
 
+    def ApplySchedule(self, schedule='fused'):
+        # schedule is either 'per_node' or 'fused'.
+        if not self.pipeline:
+            raise Exception("model not initialized, call BuildFromOnnxModel first")
+        model_cpp.ApplySchedule(self.pipeline, schedule)
+
+    def SpecializeBatchSizes(self, batch_sizes):
+        # Call after the schedule is set, and before the model is run.
+        # Returns False if the batch size is fixed by the model.
+        if not self.pipeline:
+            raise Exception("model not initialized, call BuildFromOnnxModel first")
+        return model_cpp.SpecializeBatchSizes(self.pipeline, list(batch_sizes))
+
     def run(self, inputs, device=''):
         if not self.pipeline:
             raise Exception("model not initialized, call BuildFromOnnxModel first")
@@ -39,6 +52,22 @@ class Model():
             raise Exception("model not initialized, call BuildFromOnnxModel first")
         return model_cpp.Benchmark(self.pipeline, num_iters, device)
 
+    @staticmethod
+    def CompareSchedules(onnx_model, expected_dim_sizes=None,
+                         layout=model_cpp.Layout.NumPy,
+                         schedules=('none', 'per_node', 'fused'),
+                         num_iters=5, device=''):
+        # Returns the average runtime in ns of the model with each schedule.
+        # 'auto' runs the autoscheduler, and 'none' leaves every Func inlined.
+        if not expected_dim_sizes:
+            expected_dim_sizes = {}
+        if type(onnx_model) is str:
+            onnx_model = onnx_model.encode()
+        elif type(onnx_model) is not bytes:
+            onnx_model = onnx_model.SerializeToString()
+        return model_cpp.CompareSchedules(onnx_model, expected_dim_sizes,
+            layout, list(schedules), num_iters, device)
+
     def Compile(self, func_name, lib_name):
         if not self.pipeline:
             raise Exception("model not initialized, call BuildFromOnnxModel first")
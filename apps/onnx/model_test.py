@@ -117,3 +117,49 @@ class ModelTest(unittest.TestCase):
         outputs = model.run([input_data])
         self.assertEqual(6, outputs[0])
         self.assertAlmostEqual(3.14, outputs[1])
+
+    def test_schedules(self):
+        X = helper.make_tensor_value_info('X', TensorProto.FLOAT, [4, 3, 17])
+        Z = helper.make_tensor_value_info('Z', TensorProto.FLOAT, [4, 3, 17])
+
+        exp_node = helper.make_node('Exp', ['X'], ['Y'])
+        add_node = helper.make_node('Add', ['X', 'Y'], ['Z'])
+
+        graph_def = helper.make_graph([exp_node, add_node],
+            "schedule_test",
+            [X],
+            [Z])
+        onnx_model = helper.make_model(graph_def,
+                                       producer_name='onnx-example')
+        input_data = np.random.rand(4, 3, 17).astype(np.float32)
+        expected = input_data + np.exp(input_data)
+        for schedule in ['per_node', 'fused']:
+            model = Model()
+            model.BuildFromOnnxModel(onnx_model)
+            model.ApplySchedule(schedule)
+            outputs = model.run([input_data])
+            np.testing.assert_allclose(expected, outputs[0], rtol=1e-6)
+
+        runtimes = Model.CompareSchedules(onnx_model, num_iters=1)
+        self.assertEqual({'none', 'per_node', 'fused'}, set(runtimes.keys()))
+
+    def test_specialized_batch_sizes(self):
+        X = helper.make_tensor_value_info('X', TensorProto.FLOAT, ['N', 3])
+        Z = helper.make_tensor_value_info('Z', TensorProto.FLOAT, ['N', 3])
+        abs_def = helper.make_node('Abs', ['X'], ['Y'])
+        neg_def = helper.make_node('Neg', ['Y'], ['Z'])
+
+        graph_def = helper.make_graph([abs_def, neg_def], "batch_test", [X], [Z])
+        onnx_model = helper.make_model(graph_def,
+                                       producer_name='onnx-example')
+        # The per_node schedule computes Y at root, so it is specialized
+        # along with the output.
+        for schedule in ['per_node', 'fused']:
+            model = Model()
+            model.BuildFromOnnxModel(onnx_model)
+            model.ApplySchedule(schedule)
+            self.assertTrue(model.SpecializeBatchSizes([1, 4]))
+            for batch_size in [1, 3, 4]:
+                input_data = (np.random.rand(batch_size, 3) - 0.5).astype('float32')
+                outputs = model.run([input_data])
+                np.testing.assert_allclose(-np.abs(input_data), outputs[0])
@@ -1,6 +1,8 @@
 #include "onnx_converter.h"
+#include <algorithm>
 #include <climits>
 #include <exception>
+#include <map>
 #include <math.h>
 #include <unordered_set>
 
@@ -4640,6 +4642,7 @@ Model convert_model(
     const std::unordered_map<std::string, int> &expected_dim_sizes,
     IOLayout layout) {
     Model result;
+    result.layout = layout;
     std::unordered_map<std::string, Tensor> &reps = result.tensors;
     std::unordered_map<std::string, Halide::Internal::Dimension> symbolic_dims;
 
@@ -4858,3 +4861,131 @@ void compute_expected_output_shapes(
     extract_expected_input_shapes(model, &expected_input_shapes);
     compute_output_shapes(model, expected_input_shapes, output_shapes);
 }
+
+// Whether the Func only reads an input or a constant buffer, in which case
+// it's never worth copying it into a buffer of its own.
+static bool is_buffer_wrapper(const Halide::Internal::Function &f) {
+    if (f.has_update_definition() || f.values().size() != 1) {
+        return false;
+    }
+    const Halide::Internal::Call *call = f.values()[0].as<Halide::Internal::Call>();
+    return call && call->call_type == Halide::Internal::Call::Image;
+}
+
+// Vectorize a Func computed at root along its innermost dimension, and
+// parallelize it along its outermost ones. The dims are ordered innermost
+// first.
+static void schedule_loops(
+    Halide::Func f,
+    const std::vector<Halide::Var> &dims,
+    const Halide::Target &target) {
+    if (dims.empty()) {
+        return;
+    }
+    std::vector<Halide::VarOrRVar> loops(dims.begin(), dims.end());
+    f.reorder(loops);
+
+    // The extents of the dimensions aren't known until runtime, and are often
+    // smaller than the vector size, so guard the tail instead of shifting it
+    // outside of the region that is computed.
+    const int vector_size = target.natural_vector_size(f.types()[0]);
+    f.vectorize(dims.front(), vector_size, Halide::TailStrategy::GuardWithIf);
+
+    const int rank = dims.size();
+    if (rank >= 3) {
+        // The outermost dimension is usually the batch, which is often 1.
+        Halide::Var fused;
+        f.fuse(dims[rank - 2], dims[rank - 1], fused).parallel(fused);
+    } else if (rank == 2) {
+        f.parallel(dims[1]);
+    }
+
+    // Parallelize the updates (e.g. the accumulation of convolutions) along
+    // the outermost of their pure dimensions.
+    const std::vector<Halide::Var> args = f.args();
+    for (int i = 0; i < f.num_update_definitions(); ++i) {
+        const std::vector<Halide::Expr> &update_args = f.update_args(i);
+        for (int j = rank - 1; j >= 0; --j) {
+            const Halide::Var &dim = dims[j];
+            auto arg = std::find_if(args.begin(), args.end(), [&](const Halide::Var &v) {
+                return v.same_as(dim);
+            });
+            const int index = arg - args.begin();
+            const Halide::Internal::Variable *var =
+                update_args[index].as<Halide::Internal::Variable>();
+            if (var && var->name == dim.name()) {
+                f.update(i).parallel(dim);
+                break;
+            }
+        }
+    }
+}
+
+void schedule_model(const Model &model, ModelSchedule schedule, const Halide::Target &target) {
+    std::vector<Halide::Internal::Function> outputs;
+    std::unordered_set<std::string> output_names;
+    for (const auto &output : model.outputs) {
+        outputs.push_back(output.second.rep.function());
+        output_names.insert(output.second.rep.name());
+    }
+    // All the Funcs of the pipeline, including the ones used internally by
+    // the nodes (e.g. the padded input of a convolution).
+    const std::map<std::string, Halide::Internal::Function> env =
+        Halide::Internal::build_environment(outputs);
+
+    std::unordered_set<std::string> node_outputs;
+    for (const auto &tensor : model.tensors) {
+        if (tensor.second.rep.defined()) {
+            node_outputs.insert(tensor.second.rep.name());
+        }
+    }
+
+    std::unordered_map<std::string, int> num_consumers;
+    for (const auto &f : env) {
+        for (const auto &callee : Halide::Internal::find_direct_calls(f.second)) {
+            if (callee.first != f.first) {
+                num_consumers[callee.first]++;
+            }
+        }
+    }
+
+    for (const auto &it : env) {
+        const std::string &name = it.first;
+        const Halide::Internal::Function &function = it.second;
+        if (function.has_extern_definition() || is_buffer_wrapper(function)) {
+            continue;
+        }
+        Halide::Func f(function);
+        std::vector<Halide::Var> dims = f.args();
+
+        if (output_names.count(name)) {
+            // The storage of the outputs is set by the layout of the model.
+            if (model.layout == NumPy) {
+                std::reverse(dims.begin(), dims.end());
+            }
+            schedule_loops(f, dims, target);
+            continue;
+        }
+
+        bool compute_root = false;
+        switch (schedule) {
+        case ModelSchedule::PerNode:
+            compute_root = node_outputs.count(name) > 0;
+            break;
+        case ModelSchedule::Fused:
+            compute_root = !function.can_be_inlined() || num_consumers[name] > 1;
+            break;
+        }
+        if (!compute_root) {
+            continue;
+        }
+        // The constants are stored with their last dimension innermost, so
+        // store and traverse the intermediates the same way.
+        std::reverse(dims.begin(), dims.end());
+        f.compute_root();
+        if (dims.size() > 1) {
+            f.reorder_storage(dims);
+        }
+        schedule_loops(f, dims, target);
+    }
+}
@@ -24,6 +24,12 @@ Node convert_node(
     const onnx::NodeProto &node,
     const std::vector<Tensor> &inputs);
 
+// Layout of the inputs and outputs to the model.
+enum IOLayout {
+    Native = 0,
+    NumPy = 1,
+};
+
 struct Model {
     std::unordered_map<std::string, Halide::ImageParam> inputs;
     std::unordered_map<std::string, Tensor> outputs;
@@ -31,17 +37,34 @@ struct Model {
     std::unordered_map<std::string, Tensor> tensors;
 
     std::vector<Halide::Expr> requirements;
-};
 
-// Layout of the inputs and outputs to the model.
-enum IOLayout {
-    Native = 0,
-    NumPy = 1,
+    IOLayout layout = Native;
 };
+
 Model convert_model(const onnx::ModelProto &model, const std::unordered_map<std::string, int> &expected_dim_sizes, IOLayout layout);
 
 Halide::Type get_halide_type(const Tensor &tensor);
 
+// How schedule_model() schedules the Funcs of a model.
+enum class ModelSchedule {
+    // Compute the output of every node of the graph at root, as if each node
+    // was run on its own.
+    PerNode,
+    // Compute at root only the Funcs that are used more than once or that are
+    // reductions (e.g. convolutions, matrix multiplications or pooling), and
+    // inline all the others (e.g. elementwise ops, reshapes and transposes)
+    // into their consumers, so that whole chains of nodes are computed in a
+    // single loop nest.
+    Fused,
+};
+
+// Schedule the whole graph of a converted model for the CPU of the target.
+// The Funcs that are computed at root are vectorized along their innermost
+// dimension and parallelized along their outermost ones. This is a cheap
+// alternative to running an autoscheduler on the pipeline, and must be
+// applied before the pipeline is compiled.
+void schedule_model(const Model &model, ModelSchedule schedule, const Halide::Target &target);
+
 void compute_output_shapes(
     const Model &model,
     const std::map<std::string, std::vector<int>> &input_shapes,
@@ -498,6 +498,63 @@ static void test_model() {
     EXPECT_EQ(7, output_shape(1));
 }
 
+static void test_scheduled_model() {
+    for (ModelSchedule schedule : {ModelSchedule::PerNode, ModelSchedule::Fused}) {
+        onnx::ModelProto model;
+        onnx::ValueInfoProto *input_def = model.mutable_graph()->add_input();
+        input_def->set_name("model_input");
+        input_def->mutable_type()->mutable_tensor_type()->set_elem_type(
+            onnx::TensorProto_DataType_FLOAT);
+        onnx::TensorShapeProto *shape =
+            input_def->mutable_type()->mutable_tensor_type()->mutable_shape();
+        shape->add_dim()->set_dim_value(2);
+        shape->add_dim()->set_dim_value(5);
+        shape->add_dim()->set_dim_value(37);
+
+        model.mutable_graph()->add_output()->set_name("model_output");
+
+        // The output of the first node is used twice, and must be computed
+        // at root by both schedules.
+        onnx::NodeProto *first_node = model.mutable_graph()->add_node();
+        first_node->set_name("exp_of_input");
+        first_node->set_op_type("Exp");
+        first_node->add_input("model_input");
+        first_node->add_output("input_exp");
+
+        onnx::NodeProto *second_node = model.mutable_graph()->add_node();
+        second_node->set_name("log_of_exp");
+        second_node->set_op_type("Log");
+        second_node->add_input("input_exp");
+        second_node->add_output("log_exp");
+
+        onnx::NodeProto *third_node = model.mutable_graph()->add_node();
+        third_node->set_name("sum");
+        third_node->set_op_type("Add");
+        third_node->add_input("input_exp");
+        third_node->add_input("log_exp");
+        third_node->add_output("model_output");
+
+        std::unordered_map<std::string, int> dummy;
+        Model converted = convert_model(model, dummy, IOLayout::Native);
+        schedule_model(converted, schedule, Halide::get_jit_target_from_environment());
+
+        Halide::Buffer<float, 3> input_values(2, 5, 37);
+        std::uniform_real_distribution<float> dis(-1.0, 1.0);
+        std::mt19937 rnd;
+        input_values.for_each_value([&](float &f) { f = dis(rnd); });
+
+        converted.inputs.at("model_input").set(input_values);
+        Tensor node = converted.outputs.at("model_output");
+        Halide::Buffer<float, 3> output_values = node.rep.realize({2, 5, 37});
+
+        output_values.for_each_element([&](int i, int j, int k) {
+            float expected =
+                std::exp(input_values(i, j, k)) + std::log(std::exp(input_values(i, j, k)));
+            EXPECT_NEAR(output_values(i, j, k), expected, 1e-6f);
+        });
+    }
+}
+
 int main() {
     test_abs();
     test_activation_function();
@@ -511,6 +568,7 @@ int main() {
     test_concat();
     test_constant_fill();
     test_model();
+    test_scheduled_model();
     printf("Success!\n");
     return 0;
 }
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <map>
 
 #include "Argument.h"
@@ -202,6 +203,76 @@ Callable::FailureFn Callable::check_fcci(size_t argc, const FullCallCheckInfo *a
     return exit_status;
 }
 
+namespace {
+
+struct BatchClosure {
+    JITCache *jit_cache;
+    const void *const *const *argvs;
+    // Set once any entry fails, so that the entries that haven't started yet
+    // are skipped, as they are when the batch runs serially.
+    std::atomic<bool> failed{false};
+};
+
+int batch_task(JITUserContext *context, int idx, uint8_t *closure) {
+    BatchClosure *c = (BatchClosure *)closure;
+    if (c->failed.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    int exit_status = c->jit_cache->call_jit_code(c->argvs[idx]);
+    if (exit_status != 0) {
+        c->failed.store(true, std::memory_order_relaxed);
+    }
+    return exit_status;
+}
+
+}  // namespace
+
+int Callable::call_argv_batch(size_t argc, size_t batch_size, const void *const *const *argvs, bool parallel) const {
+    user_assert(defined()) << "Cannot call() a default-constructed Callable.";
+    user_assert(argc == contents->jit_cache.arguments.size())
+        << "Error calling '" << contents->name << "' on a batch: "
+        << "Expected argv arrays of length " << contents->jit_cache.arguments.size()
+        << ", but saw " << argc << ".";
+    assert(contents->jit_cache.jit_target.has_feature(Target::UserContext));
+    assert(contents->jit_cache.arguments[0].name == "__user_context");
+
+    if (batch_size == 0) {
+        return 0;
+    }
+
+    JITUserContext *context = *(JITUserContext **)const_cast<void *>(argvs[0][0]);
+    assert(context != nullptr);
+    for (size_t i = 1; i < batch_size; i++) {
+        assert(*(JITUserContext **)const_cast<void *>(argvs[i][0]) == context);
+    }
+
+    JITFuncCallContext jit_call_context(context, contents->saved_jit_handlers);
+
+    int exit_status = 0;
+    // The wasm executor isn't reentrant, so it always runs the batch serially.
+    if (parallel && batch_size > 1 &&
+        contents->jit_cache.get_compiled_jit_target().arch != Target::WebAssembly) {
+        // Populating the JIT handlers above filled in the thread pool
+        // that the shared runtime uses, so reuse it for the batch.
+        BatchClosure closure;
+        closure.jit_cache = &contents->jit_cache;
+        closure.argvs = argvs;
+        exit_status = context->handlers.custom_do_par_for(context, batch_task, 0, (int)batch_size,
+                                                          (uint8_t *)&closure);
+    } else {
+        for (size_t i = 0; i < batch_size && exit_status == 0; i++) {
+            exit_status = contents->jit_cache.call_jit_code(argvs[i]);
+        }
+    }
+
+    // If we're profiling, report runtimes and reset profiler stats.
+    contents->jit_cache.finish_profiling(context);
+
+    jit_call_context.finalize(exit_status);
+
+    return exit_status;
+}
+
 int Callable::call_argv_checked(size_t argc, const void *const *argv, const QuickCallCheckInfo *actual_qcci) const {
     user_assert(defined()) << "Cannot call() a default-constructed Callable.";
 
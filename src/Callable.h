@@ -403,6 +403,27 @@ public:
      *
      */
     int call_argv_fast(size_t argc, const void *const *argv) const;
+
+    /** Unsafe low-overhead way of invoking the Callable on a batch of inputs.
+     *
+     * Each of the batch_size entries in argvs is an argv of length argc that
+     * follows the calling convention of call_argv_fast(). Every entry must
+     * refer to the same JITUserContext. The per-call setup (installing the
+     * JIT handlers, reporting errors and profiles) is done once for the whole
+     * batch rather than once per entry. If parallel is true, the entries are
+     * distributed over the Halide thread pool, so each one may be run on a
+     * different thread; parallel loops inside the pipeline still work.
+     *
+     * The batch stops at the first entry that fails: no entry is started
+     * after it. When the batch runs serially, this means exactly the entries
+     * before it have run. When it runs in parallel, the entries already
+     * running on other threads still finish, and which of the other entries
+     * ran is unspecified.
+     *
+     * Returns zero if every entry succeeded, or a nonzero exit status from one
+     * of the entries that failed.
+     */
+    int call_argv_batch(size_t argc, size_t batch_size, const void *const *const *argvs, bool parallel = true) const;
 };
 
 }  // namespace Halide
@@ -6,6 +6,7 @@
 #include "IROperator.h"
 #include "Simplify.h"
 #include "Substitute.h"
+#include "Target.h"
 
 #include <algorithm>
 
@@ -122,11 +123,43 @@ vector<Stmt> block_to_vector(const Stmt &s) {
     return result;
 }
 
-Expr scratch_index(int i, Type t) {
-    if (t.is_scalar()) {
-        return i;
-    } else {
-        return Ramp::make(i * t.lanes(), 1, t.lanes());
+/** How many values loop_carry may keep live across loop iterations. */
+struct CarryBudget {
+    // The maximum number of values to carry across a loop, if there
+    // is no register model.
+    int max_carried_values = 8;
+
+    // The number of vector registers on the target, and their
+    // width. If nonzero, carried values are costed in registers, and
+    // each loop may carry as many as are left over after the values
+    // its body needs anyway.
+    int vector_registers = 0;
+    int vector_bits = 0;
+
+    // The size of the scratch buffer to spend on carrying values
+    // across a loop over a constant-extent inner loop. Zero disables
+    // carrying values across such loops.
+    int max_outer_carried_bytes = 0;
+};
+
+int vector_registers(const Target &t) {
+    switch (t.arch) {
+    case Target::X86:
+        if (t.bits == 32) {
+            return 8;
+        } else if (t.has_feature(Target::AVX512) || t.has_feature(Target::AVX10_1)) {
+            return 32;
+        } else {
+            return 16;
+        }
+    case Target::ARM:
+        return t.bits == 64 ? 32 : 16;
+    case Target::Hexagon:
+    case Target::POWERPC:
+    case Target::RISCV:
+        return 32;
+    default:
+        return 16;
     }
 }
 
@@ -190,10 +223,43 @@ class LoopCarryOverLoop : public IRMutator {
     // to lift out.
     const Scope<> &in_consume;
 
-    int max_carried_values;
+    const CarryBudget &budget;
+
+    // The constant-extent loop we're inside, if we're carrying values
+    // across iterations of the loop around it, and the number of
+    // containing lets outside of it.
+    const For *inner_loop = nullptr;
+    size_t inner_loop_lets = 0;
 
     using IRMutator::visit;
 
+    /** The index in a scratch buffer of the i'th value of a chain of
+     * length n. Within an inner loop, each iteration gets its own
+     * chain. */
+    Expr scratch_index(int i, int n, Type t) const {
+        Expr base = i * t.lanes();
+        if (inner_loop) {
+            base = (Variable::make(Int(32), inner_loop->name) - inner_loop->min) * (n * t.lanes()) + base;
+        }
+        if (t.is_scalar()) {
+            return base;
+        } else {
+            return Ramp::make(base, 1, t.lanes());
+        }
+    }
+
+    /** The cost of carrying a value of the given type, in units of
+     * the budget. */
+    int carry_cost(Type t) const {
+        if (inner_loop) {
+            return (int)(t.bytes() * t.lanes() * *as_const_int(inner_loop->extent));
+        } else if (budget.vector_bits > 0) {
+            return (t.bits() * t.lanes() + budget.vector_bits - 1) / budget.vector_bits;
+        } else {
+            return 1;
+        }
+    }
+
     Stmt visit(const LetStmt *op) override {
         // Track containing LetStmts and their linearity w.r.t. the
         // loop variable.
@@ -387,24 +453,54 @@ class LoopCarryOverLoop : public IRMutator {
             }
         }
 
-        // Only keep the top N carried values. Otherwise we'll just
-        // spray stack spills everywhere. This is ugly, because we're
-        // relying on a heuristic.
+        // Only keep as many carried values as we have room
+        // for. Otherwise we'll just spray stack spills
+        // everywhere. This is ugly, because we're relying on a
+        // heuristic.
+        int capacity = budget.max_carried_values;
+        if (inner_loop) {
+            capacity = budget.max_outer_carried_bytes;
+        } else if (budget.vector_registers > 0) {
+            // The loads we don't carry and the values being stored
+            // need registers too.
+            set<int> carried;
+            for (const vector<int> &c : chains) {
+                carried.insert(c.begin(), c.end());
+            }
+            capacity = budget.vector_registers - (int)block_to_vector(orig_stmt).size();
+            for (size_t i = 0; i < loads.size(); i++) {
+                if (!carried.count((int)i)) {
+                    capacity -= carry_cost(loads[i][0]->type);
+                }
+            }
+        }
         vector<vector<int>> trimmed;
-        size_t sz = 0;
+        int used = 0;
         for (const vector<int> &c : chains) {
-            if (sz + c.size() > (size_t)max_carried_values) {
-                if (sz < (size_t)max_carried_values - 1) {
-                    // Take a partial chain
-                    trimmed.emplace_back(c.begin(), c.begin() + max_carried_values - sz);
+            vector<int> kept;
+            for (int i : c) {
+                int cost = carry_cost(loads[i][0]->type);
+                if (used + cost > capacity) {
+                    break;
                 }
+                used += cost;
+                kept.push_back(i);
+            }
+            // A partial chain is only worth taking if it reuses
+            // at least one value.
+            if (kept.size() > 1) {
+                trimmed.push_back(kept);
+            }
+            if (kept.size() < c.size()) {
                 break;
             }
-            trimmed.push_back(c);
-            sz += c.size();
         }
         chains.swap(trimmed);
 
+        if (chains.empty()) {
+            return orig_stmt;
+        }
+
         // We now have chains of the form:
         // f[x] <- f[x+1] <- ... <- f[x+N-1]
 
@@ -428,7 +524,7 @@ class LoopCarryOverLoop : public IRMutator {
 
             for (size_t i = 0; i < c.size(); i++) {
                 const Load *orig_load = loads[c[i]][0];
-                Expr scratch_idx = scratch_index(i, orig_load->type);
+                Expr scratch_idx = scratch_index(i, c.size(), orig_load->type);
                 // Don't worry about alignment - the load is at a constant address.
                 Expr load_from_scratch = Load::make(orig_load->type, scratch, scratch_idx,
                                                     Buffer<>(), Parameter(), const_true(orig_load->type.lanes()), ModulusRemainder());
@@ -445,7 +541,7 @@ class LoopCarryOverLoop : public IRMutator {
                 }
                 if (i > 0) {
                     Stmt shuffle = Store::make(scratch, load_from_scratch,
-                                               scratch_index(i - 1, orig_load->type),
+                                               scratch_index(i - 1, c.size(), orig_load->type),
                                                Parameter(), const_true(orig_load->type.lanes()), ModulusRemainder());
                     scratch_shuffles.push_back(shuffle);
                 }
@@ -470,7 +566,7 @@ class LoopCarryOverLoop : public IRMutator {
             // Create the initial stores to scratch
             vector<Stmt> initial_scratch_stores;
             for (size_t i = 0; i < c.size() - 1; i++) {
-                Expr scratch_idx = scratch_index(i, initial_scratch_values[i].type());
+                Expr scratch_idx = scratch_index(i, c.size(), initial_scratch_values[i].type());
                 Stmt store_to_scratch = Store::make(scratch, initial_scratch_values[i],
                                                     scratch_idx, Parameter(),
                                                     const_true(scratch_idx.type().lanes()),
@@ -486,17 +582,28 @@ class LoopCarryOverLoop : public IRMutator {
                 initial_stores = LetStmt::make(l.first, l.second, initial_stores);
             }
             // We may be lifting the initial stores out of let stmts,
-            // so rewrap them in the necessary ones.
+            // and out of an inner loop, so rewrap them in the
+            // necessary ones.
+            int size = (int)c.size() * loads[c.front()][0]->type.lanes();
             for (size_t i = containing_lets.size(); i > 0; i--) {
+                if (inner_loop && i == inner_loop_lets) {
+                    initial_stores = wrap_in_inner_loop(initial_stores);
+                }
                 const auto &l = containing_lets[i - 1];
                 if (stmt_uses_var(initial_stores, l.first)) {
                     initial_stores = LetStmt::make(l.first, l.second, initial_stores);
                 }
             }
+            if (inner_loop) {
+                if (inner_loop_lets == 0) {
+                    initial_stores = wrap_in_inner_loop(initial_stores);
+                }
+                size *= (int)*as_const_int(inner_loop->extent);
+            }
 
             allocs.push_back({scratch,
                               loads[c.front()][0]->type.element_of(),
-                              (int)c.size() * loads[c.front()][0]->type.lanes(),
+                              size,
                               initial_stores});
         }
 
@@ -507,11 +614,45 @@ class LoopCarryOverLoop : public IRMutator {
         return s;
     }
 
+    Stmt wrap_in_inner_loop(const Stmt &s) const {
+        return For::make(inner_loop->name, inner_loop->min, inner_loop->extent,
+                         ForType::Serial, inner_loop->partition_policy, inner_loop->device_api, s);
+    }
+
     Stmt visit(const For *op) override {
         // Don't lift loads out of code that might not run. Besides,
         // stashing things in registers while we run an inner loop
-        // probably isn't a good use of registers.
-        return op;
+        // probably isn't a good use of registers. The exception is a
+        // serial inner loop with a constant extent and a min that
+        // doesn't change with the outer loop, like the loop over
+        // columns in a vertical stencil. Each of its iterations can
+        // reuse values loaded on the same iteration of the previous
+        // outer iteration, which we stash in a small buffer.
+        const int64_t *extent = as_const_int(op->extent);
+        if (inner_loop ||
+            budget.max_outer_carried_bytes <= 0 ||
+            op->for_type != ForType::Serial ||
+            !extent || *extent <= 0 ||
+            !is_const_zero(is_linear(op->min, linear))) {
+            return op;
+        }
+
+        inner_loop = op;
+        inner_loop_lets = containing_lets.size();
+        Stmt body;
+        {
+            // The inner loop var is the same on matching iterations
+            // of consecutive outer iterations.
+            ScopedBinding<Expr> bind(linear, op->name, make_zero(Int(32)));
+            body = mutate(op->body);
+        }
+        inner_loop = nullptr;
+
+        if (body.same_as(op->body)) {
+            return op;
+        } else {
+            return For::make(op->name, op->min, op->extent, op->for_type, op->partition_policy, op->device_api, body);
+        }
     }
 
     Stmt visit(const IfThenElse *op) override {
@@ -520,8 +661,8 @@ class LoopCarryOverLoop : public IRMutator {
     }
 
 public:
-    LoopCarryOverLoop(const string &var, const Scope<> &s, int max_carried_values)
-        : in_consume(s), max_carried_values(max_carried_values) {
+    LoopCarryOverLoop(const string &var, const Scope<> &s, const CarryBudget &budget)
+        : in_consume(s), budget(budget) {
         linear.push(var, 1);
     }
 
@@ -538,7 +679,7 @@ public:
 class LoopCarry : public IRMutator {
     using IRMutator::visit;
 
-    int max_carried_values;
+    const CarryBudget &budget;
     Scope<> in_consume;
 
     Stmt visit(const ProducerConsumer *op) override {
@@ -552,10 +693,14 @@ class LoopCarry : public IRMutator {
     }
 
     Stmt visit(const For *op) override {
-        if (op->for_type == ForType::Serial && !is_const_one(op->extent)) {
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            // Leave code for other devices alone.
+            return op;
+        } else if (op->for_type == ForType::Serial && !is_const_one(op->extent)) {
             Stmt stmt;
             Stmt body = mutate(op->body);
-            LoopCarryOverLoop carry(op->name, in_consume, max_carried_values);
+            LoopCarryOverLoop carry(op->name, in_consume, budget);
             body = carry.mutate(body);
             if (body.same_as(op->body)) {
                 stmt = op;
@@ -578,15 +723,26 @@ class LoopCarry : public IRMutator {
     }
 
 public:
-    LoopCarry(int max_carried_values)
-        : max_carried_values(max_carried_values) {
+    LoopCarry(const CarryBudget &budget)
+        : budget(budget) {
     }
 };
 
 }  // namespace
 
 Stmt loop_carry(Stmt s, int max_carried_values) {
-    s = LoopCarry(max_carried_values).mutate(s);
+    CarryBudget budget;
+    budget.max_carried_values = max_carried_values;
+    s = LoopCarry(budget).mutate(s);
+    return s;
+}
+
+Stmt loop_carry(Stmt s, const Target &t, int max_outer_carried_bytes) {
+    CarryBudget budget;
+    budget.vector_registers = vector_registers(t);
+    budget.vector_bits = t.natural_vector_size<uint8_t>() * 8;
+    budget.max_outer_carried_bytes = max_outer_carried_bytes;
+    s = LoopCarry(budget).mutate(s);
     return s;
 }
 
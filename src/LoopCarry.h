@@ -4,6 +4,9 @@
 #include "Expr.h"
 
 namespace Halide {
+
+struct Target;
+
 namespace Internal {
 
 /** Reuse loads done on previous loop iterations by stashing them in
@@ -14,6 +17,16 @@ namespace Internal {
  * for Hexagon. */
 Stmt loop_carry(Stmt, int max_carried_values = 8);
 
+/** As above, but choose how many values to carry across each loop from
+ * the number of vector registers on the target, less an estimate of
+ * how many the loop body already needs. Also carry values across a
+ * serial loop whose body is a serial loop of constant extent, such as
+ * the row loop of a vertical stencil. Those values live in a stack
+ * buffer with one slot per inner loop iteration, of at most
+ * max_outer_carried_bytes. Used when the target has the loop_carry
+ * feature. */
+Stmt loop_carry(Stmt, const Target &t, int max_outer_carried_bytes = 8 * 1024);
+
 }  // namespace Internal
 }  // namespace Halide
 
@@ -333,6 +333,12 @@ void lower_impl(const vector<Function> &output_funcs,
     s = unify_duplicate_lets(s);
     log("Lowering after second simplification:", s);
 
+    if (t.has_feature(Target::AutoPrefetch)) {
+        debug(1) << "Injecting automatic prefetches...\n";
+        s = inject_auto_prefetch(s, t);
+        log("Lowering after injecting automatic prefetches:", s);
+    }
+
     debug(1) << "Reduce prefetch dimension...\n";
     s = reduce_prefetch_dimension(s, t);
     log("Lowering after reduce prefetch dimension:", s);
@@ -442,6 +448,13 @@ void lower_impl(const vector<Function> &output_funcs,
     s = hoist_loop_invariant_if_statements(s);
     log("Lowering after removing dead allocations and hoisting loop invariants:", s);
 
+    // Hexagon carries values itself in codegen, after aligning loads.
+    if (t.has_feature(Target::LoopCarry) && t.arch != Target::Hexagon) {
+        debug(1) << "Carrying values across loop iterations...\n";
+        s = loop_carry(s, t);
+        log("Lowering after carrying values across loop iterations:", s);
+    }
+
     debug(1) << "Finding intrinsics...\n";
     // Must be run after the last simplification, because it turns
     // divisions into shifts, which the simplifier reverses.
@@ -7,6 +7,7 @@
 #include "Deserialization.h"
 #include "FindCalls.h"
 #include "Func.h"
+#include "IRMutator.h"
 #include "IRVisitor.h"
 #include "InferArguments.h"
 #include "LLVM_Output.h"
@@ -70,6 +71,50 @@ std::string sanitize_function_name(const std::string &s) {
     return name;
 }
 
+// Replaces calls to an input buffer with calls to a Func, and uses of
+// its bounds with a given region.
+class FuseInput : public IRMutator {
+    using IRMutator::visit;
+
+    const Parameter &input;
+    const Function &producer;
+    const Region &bounds;
+
+    Expr visit(const Call *op) override {
+        if (op->call_type == Call::Image && op->param.same_as(input)) {
+            vector<Expr> args;
+            for (const Expr &a : op->args) {
+                args.push_back(mutate(a));
+            }
+            return Call::make(producer, args, op->value_index);
+        }
+        return IRMutator::visit(op);
+    }
+
+    Expr visit(const Variable *op) override {
+        if (!op->param.same_as(input)) {
+            return op;
+        }
+        const string &prefix = input.name();
+        for (size_t d = 0; d < bounds.size(); d++) {
+            if (op->name == prefix + ".min." + std::to_string(d)) {
+                return bounds[d].min;
+            } else if (op->name == prefix + ".extent." + std::to_string(d)) {
+                return bounds[d].extent;
+            }
+        }
+        user_error << "Can't fuse " << producer.name() << " into input " << prefix
+                   << ", because the pipeline uses " << op->name
+                   << ". Pass the bounds of the input to fuse_input.\n";
+        return op;
+    }
+
+public:
+    FuseInput(const Parameter &input, const Function &producer, const Region &bounds)
+        : input(input), producer(producer), bounds(bounds) {
+    }
+};
+
 }  // namespace
 
 namespace Internal {
@@ -857,6 +902,47 @@ void Pipeline::add_requirement(const Expr &condition, const std::vector<Expr> &e
     contents->requirements.emplace_back(Internal::AssertStmt::make(condition, error));
 }
 
+void Pipeline::fuse_input(const Parameter &input, const Func &producer, const Region &bounds) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(input.defined() && input.is_buffer())
+        << "fuse_input requires a buffer input Parameter\n";
+    user_assert(producer.defined() && producer.outputs() == 1)
+        << "Can't fuse " << producer.name() << " into input " << input.name()
+        << ", because it must be a defined Func with a single output.\n";
+    user_assert(producer.dimensions() == input.dimensions() &&
+                producer.type() == input.type())
+        << "Can't fuse " << producer.name() << " into input " << input.name()
+        << ", because they have different types or dimensionalities.\n";
+    user_assert(bounds.empty() || (int)bounds.size() == input.dimensions())
+        << "The bounds passed to fuse_input must have one entry per dimension of "
+        << input.name() << "\n";
+
+    const Function &f = producer.function();
+    std::map<string, Function> env;
+    for (const Function &out : contents->outputs) {
+        user_assert(!out.same_as(f) && !find_transitive_calls(f).count(out.name()))
+            << "Can't fuse " << producer.name() << " into input " << input.name()
+            << ", because it depends on the outputs of this pipeline.\n";
+        env[out.name()] = out;
+        for (const auto &it : find_transitive_calls(out)) {
+            env.insert(it);
+        }
+    }
+
+    FuseInput fuser(input, f, bounds);
+    for (auto &it : env) {
+        Function &g = it.second;
+        g.mutate(&fuser);
+        for (ExternFuncArgument &arg : g.extern_arguments()) {
+            if (arg.is_image_param() && arg.image_param.same_as(input)) {
+                arg = ExternFuncArgument(f.get_contents());
+            }
+        }
+    }
+
+    invalidate_cache();
+}
+
 void Pipeline::trace_pipeline() {
     user_assert(defined()) << "Pipeline is undefined\n";
     contents->trace_pipeline = true;
@@ -1080,6 +1166,73 @@ void Pipeline::realize(JITUserContext *context,
     jit_call_context.finalize(exit_status);
 }
 
+void Pipeline::realize_strips(Realization outputs, int strip_height,
+                              const std::function<void(int, int)> &input_handler,
+                              const std::function<void(const Realization &, int, int)> &output_handler,
+                              const Target &target) {
+    realize_strips(nullptr, std::move(outputs), strip_height, input_handler, output_handler, target);
+}
+
+void Pipeline::realize_strips(JITUserContext *context,
+                              Realization outputs, int strip_height,
+                              const std::function<void(int, int)> &input_handler,
+                              const std::function<void(const Realization &, int, int)> &output_handler,
+                              const Target &target) {
+    user_assert(defined()) << "Can't realize an undefined Pipeline\n";
+    user_assert(strip_height > 0) << "realize_strips requires a positive strip height\n";
+    user_assert(outputs.size() > 0 && outputs[0].dimensions() >= 2)
+        << "realize_strips requires outputs with at least two dimensions\n";
+    for (size_t i = 1; i < outputs.size(); i++) {
+        user_assert(outputs[i].dimensions() >= 2 &&
+                    outputs[i].dim(1).min() == outputs[0].dim(1).min() &&
+                    outputs[i].dim(1).extent() == outputs[0].dim(1).extent())
+            << "All outputs passed to realize_strips must span the same rows\n";
+    }
+
+    compile_jit(target);
+
+    // The inputs to stream are the ones the caller hasn't bound.
+    vector<Parameter> streamed_inputs;
+    for (const InferredArgument &arg : contents->inferred_args) {
+        if (arg.param.defined() && arg.param.is_buffer() && !arg.param.buffer().defined()) {
+            streamed_inputs.push_back(arg.param);
+        }
+    }
+
+    const int y_begin = outputs[0].dim(1).min();
+    const int y_end = y_begin + outputs[0].dim(1).extent();
+    for (int y = y_begin; y < y_end; y += strip_height) {
+        const int extent = std::min(strip_height, y_end - y);
+        vector<Buffer<>> strip_bufs;
+        for (size_t i = 0; i < outputs.size(); i++) {
+            strip_bufs.emplace_back(outputs[i].get()->cropped(1, y, extent));
+        }
+        Realization strip(std::move(strip_bufs));
+
+        // Drop the previous strip's inputs so that bounds inference
+        // gives us buffers sized for this one.
+        for (Parameter &p : streamed_inputs) {
+            p.set_buffer(Buffer<>());
+        }
+        if (!streamed_inputs.empty()) {
+            infer_input_bounds(context, strip, target);
+        }
+        if (input_handler) {
+            input_handler(y, extent);
+        }
+
+        realize(context, strip, target);
+
+        if (output_handler) {
+            output_handler(strip, y, extent);
+        }
+    }
+
+    for (Parameter &p : streamed_inputs) {
+        p.set_buffer(Buffer<>());
+    }
+}
+
 void Pipeline::infer_input_bounds(RealizationArg outputs, const Target &target) {
     infer_input_bounds(nullptr, std::move(outputs), target);
 }
@@ -432,6 +432,34 @@ public:
                  RealizationArg output,
                  const Target &target = Target());
 
+    /** Evaluate this Pipeline into an existing allocated Realization
+     * one strip of rows at a time, for use when the input arrives
+     * incrementally (e.g. from a camera or scanner). Rows are
+     * dimension 1 of the outputs, and strips of strip_height rows
+     * are produced in increasing order. Before each strip is
+     * computed, every ImageParam that was unbound at the time of
+     * the call is bound to a fresh buffer covering exactly the
+     * region of it that the strip requires (as in
+     * infer_input_bounds), and input_handler is called with the
+     * strip's first row and height so that the caller can fill
+     * those buffers. Once the strip has been computed,
+     * output_handler is called with the strip cropped out of the
+     * outputs. Intermediate Funcs are only ever as large as a single
+     * strip requires, at the cost of recomputing the rows that
+     * neighboring strips share. The ImageParams are left unbound
+     * again on return. */
+    // @{
+    void realize_strips(Realization outputs, int strip_height,
+                        const std::function<void(int y_min, int y_extent)> &input_handler,
+                        const std::function<void(const Realization &strip, int y_min, int y_extent)> &output_handler,
+                        const Target &target = Target());
+    void realize_strips(JITUserContext *context,
+                        Realization outputs, int strip_height,
+                        const std::function<void(int y_min, int y_extent)> &input_handler,
+                        const std::function<void(const Realization &strip, int y_min, int y_extent)> &output_handler,
+                        const Target &target = Target());
+    // @}
+
     /** For a given size of output, or a given set of output buffers,
      * determine the bounds required of all unbound ImageParams
      * referenced. Communicates the result by allocating new buffers
@@ -491,6 +519,27 @@ public:
     }
     // @}
 
+    /** Fuse a separately-defined producer into this Pipeline by
+     * replacing every use of an input buffer Parameter (e.g. an
+     * ImageParam, or the input of another Pipeline) in the Funcs that
+     * this Pipeline computes with a call to producer. This lets chains
+     * of pipelines that were written separately (e.g. denoise, then
+     * demosaic, then tone map) be lowered as a single pipeline. Unlike
+     * an extern stage, the producer is visible to bounds inference, so
+     * it can then be scheduled like any other Func (tiled, computed at
+     * a consumer, slid, or inlined) instead of writing a
+     * full-resolution intermediate. Uses of the input's bounds (e.g. by
+     * BoundaryConditions) are replaced with the corresponding entries
+     * of bounds, which must be given if there are any such uses. The
+     * Funcs of this Pipeline are modified in place. */
+    // @{
+    void fuse_input(const Parameter &input, const Func &producer, const Region &bounds = Region());
+    template<typename T>
+    HALIDE_NO_USER_CODE_INLINE void fuse_input(const T &image, const Func &producer, const Region &bounds = Region()) {
+        fuse_input(image.parameter(), producer, bounds);
+    }
+    // @}
+
     /** Generate begin_pipeline and end_pipeline tracing calls for this pipeline. */
     void trace_pipeline();
 
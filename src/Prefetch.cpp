@@ -3,6 +3,7 @@
 #include <utility>
 
 #include "Bounds.h"
+#include "Debug.h"
 #include "ExprUsesVar.h"
 #include "Function.h"
 #include "IRMutator.h"
@@ -10,6 +11,7 @@
 #include "Prefetch.h"
 #include "Scope.h"
 #include "Simplify.h"
+#include "Substitute.h"
 #include "Target.h"
 #include "Util.h"
 
@@ -428,6 +430,238 @@ class HoistPrefetches : public IRMutator {
     }
 };
 
+// The number of bytes each prefetch instruction fetches on a
+// target. ARM's cache line size can be 32 or 64 bytes and it can
+// switch the size at runtime. To be safe, we just use 32 bytes.
+int prefetch_line_bytes(const Target &t) {
+    return t.arch == Target::ARM ? 32 : 64;
+}
+
+// A rough number of cycles it takes for a load that misses all
+// the way to DRAM to come back. Used along with an estimate of the
+// work per loop iteration to choose how far ahead to prefetch.
+constexpr int memory_latency_cycles = 200;
+constexpr int max_auto_prefetch_distance = 64;
+
+// Does a loop body contain a loop that will stay a loop after
+// lowering (i.e. anything but vectorized or unrolled loops)?
+class ContainsNonTrivialLoop : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const For *op) override {
+        if (op->for_type != ForType::Vectorized &&
+            op->for_type != ForType::Unrolled) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+};
+
+// Collects the loads in the body of an innermost serial loop, with
+// the lets and inner loop variables they depend on substituted
+// away, so that the indices only depend on the serial loop and
+// things defined outside it. Also estimates how much work one
+// iteration of the loop does.
+class CollectLoopLoads : public IRVisitor {
+    using IRVisitor::visit;
+
+    // Name and possible values of each let or inner loop variable
+    // enclosing the node currently being visited, outermost first.
+    vector<std::pair<string, vector<Expr>>> bindings;
+    int work_multiplier = 1;
+
+    void visit(const LetStmt *op) override {
+        op->value.accept(this);
+        bindings.emplace_back(op->name, vector<Expr>{op->value});
+        op->body.accept(this);
+        bindings.pop_back();
+    }
+
+    void visit(const Let *op) override {
+        op->value.accept(this);
+        bindings.emplace_back(op->name, vector<Expr>{op->value});
+        op->body.accept(this);
+        bindings.pop_back();
+    }
+
+    void visit(const For *op) override {
+        vector<Expr> values{op->min};
+        const int64_t *extent = as_const_int(op->extent);
+        if (op->for_type == ForType::Unrolled && extent && *extent <= 16) {
+            // Each unrolled iteration may touch a different cache line.
+            for (int i = 1; i < *extent; i++) {
+                values.push_back(simplify(op->min + i));
+            }
+        }
+        // A vectorized loop becomes a single vector instruction, so
+        // only unrolling multiplies the work.
+        int old_multiplier = work_multiplier;
+        if (op->for_type == ForType::Unrolled && extent) {
+            work_multiplier *= (int)std::max<int64_t>(*extent, 1);
+        }
+        bindings.emplace_back(op->name, std::move(values));
+        op->body.accept(this);
+        bindings.pop_back();
+        work_multiplier = old_multiplier;
+    }
+
+    void visit(const Allocate *op) override {
+        // Loads from allocations local to the loop body will be in cache.
+        local_allocations.insert(op->name);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) override {
+        work += work_multiplier;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Call *op) override {
+        if (op->is_intrinsic(Call::prefetch)) {
+            if (const Variable *base = op->args[0].as<Variable>()) {
+                explicitly_prefetched.insert(base->name);
+            }
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Load *op) override {
+        IRVisitor::visit(op);
+        work += work_multiplier;
+        if (!op->index.type().is_scalar()) {
+            return;
+        }
+        vector<Expr> indices{op->index};
+        for (auto it = bindings.rbegin(); it != bindings.rend(); it++) {
+            vector<Expr> expanded;
+            for (const Expr &e : indices) {
+                if (!expr_uses_var(e, it->first)) {
+                    expanded.push_back(e);
+                    continue;
+                }
+                for (const Expr &v : it->second) {
+                    expanded.push_back(substitute(it->first, v, e));
+                    // Don't let nested unrolled loops blow up the candidate list.
+                    if (expanded.size() >= 64) {
+                        break;
+                    }
+                }
+            }
+            indices.swap(expanded);
+        }
+        for (const Expr &e : indices) {
+            loads.push_back({op->name, op->type.element_of(), e});
+        }
+    }
+
+public:
+    struct LoadSite {
+        string name;
+        Type type;
+        Expr index;
+    };
+    vector<LoadSite> loads;
+    set<string> local_allocations, explicitly_prefetched;
+    int work = 0;
+};
+
+// Prefetch loads that stride across cache lines in innermost serial
+// loops. Contiguous loads are left to the hardware prefetcher.
+class InjectAutoPrefetch : public IRMutator {
+    using IRMutator::visit;
+
+    const int line_bytes;
+    const int forced_distance;
+
+    Stmt visit(const For *op) override {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            // Leave device code alone.
+            return op;
+        }
+
+        Stmt stmt = IRMutator::visit(op);
+        if (op->for_type != ForType::Serial || starts_with(op->name, "prefetch_")) {
+            return stmt;
+        }
+
+        ContainsNonTrivialLoop inner;
+        op->body.accept(&inner);
+        if (inner.result) {
+            return stmt;
+        }
+
+        CollectLoopLoads collector;
+        op->body.accept(&collector);
+
+        int distance = forced_distance;
+        if (distance <= 0) {
+            int work = std::max(collector.work, 1);
+            distance = std::min((memory_latency_cycles + work - 1) / work, max_auto_prefetch_distance);
+        }
+
+        Expr loop_var = Variable::make(Int(32), op->name);
+        vector<CollectLoopLoads::LoadSite> chosen;
+        for (const auto &l : collector.loads) {
+            if (collector.local_allocations.count(l.name) ||
+                collector.explicitly_prefetched.count(l.name)) {
+                continue;
+            }
+
+            Expr stride = simplify(substitute(op->name, loop_var + 1, l.index) - l.index);
+            if (is_const_zero(stride) || expr_uses_var(stride, op->name)) {
+                continue;
+            }
+            Expr stride_bytes = stride * l.type.bytes();
+            if (can_prove(stride_bytes < line_bytes && stride_bytes > -line_bytes)) {
+                continue;
+            }
+
+            // Skip loads that land on a cache line we're already fetching.
+            bool duplicate = false;
+            for (const auto &c : chosen) {
+                if (c.name != l.name) {
+                    continue;
+                }
+                const int64_t *delta = as_const_int(simplify(c.index - l.index));
+                if (delta && std::abs(*delta * l.type.bytes()) < line_bytes) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) {
+                chosen.push_back(l);
+            }
+        }
+
+        if (chosen.empty()) {
+            return stmt;
+        }
+
+        op = stmt.as<For>();
+        internal_assert(op);
+        Stmt body = op->body;
+        for (auto it = chosen.rbegin(); it != chosen.rend(); it++) {
+            Expr base = Variable::make(Handle(), it->name);
+            Expr offset = simplify(substitute(op->name, loop_var + distance, it->index));
+            Expr call = Call::make(it->type, Call::prefetch, {base, offset, 1, 1}, Call::Intrinsic);
+            body = Block::make(Evaluate::make(call), body);
+        }
+        debug(4) << "Auto-prefetching " << chosen.size() << " loads "
+                 << distance << " iterations ahead in loop " << op->name << "\n";
+        return For::make(op->name, op->min, op->extent, op->for_type,
+                         op->partition_policy, op->device_api, std::move(body));
+    }
+
+public:
+    InjectAutoPrefetch(int line_bytes, int forced_distance)
+        : line_bytes(line_bytes), forced_distance(forced_distance) {
+    }
+};
+
 }  // anonymous namespace
 
 Stmt inject_placeholder_prefetch(const Stmt &s, const map<string, Function> &env,
@@ -443,6 +677,19 @@ Stmt inject_prefetch(const Stmt &s, const map<string, Function> &env) {
     return InjectPrefetch(env, finder.buffers).mutate(s);
 }
 
+Stmt inject_auto_prefetch(const Stmt &s, const Target &t) {
+    if (!t.has_feature(Target::AutoPrefetch) || t.has_feature(Target::HVX)) {
+        return s;
+    }
+    int distance = 0;
+    string distance_str = get_env_variable("HL_AUTO_PREFETCH_DISTANCE");
+    if (!distance_str.empty()) {
+        distance = std::atoi(distance_str.c_str());
+        user_assert(distance > 0) << "HL_AUTO_PREFETCH_DISTANCE must be a positive integer.\n";
+    }
+    return InjectAutoPrefetch(prefetch_line_bytes(t), distance).mutate(s);
+}
+
 Stmt reduce_prefetch_dimension(Stmt stmt, const Target &t) {
     size_t max_dim = 0;
     Expr max_byte_size;
@@ -451,14 +698,9 @@ Stmt reduce_prefetch_dimension(Stmt stmt, const Target &t) {
     // two dimension. Other architectures generate one prefetch per cache line.
     if (t.has_feature(Target::HVX)) {
         max_dim = 2;
-    } else if (t.arch == Target::ARM) {
-        // ARM's cache line size can be 32 or 64 bytes and it can switch the
-        // size at runtime. To be safe, we just use 32 bytes.
-        max_dim = 1;
-        max_byte_size = 32;
     } else {
         max_dim = 1;
-        max_byte_size = 64;
+        max_byte_size = prefetch_line_bytes(t);
     }
     internal_assert(max_dim > 0);
 
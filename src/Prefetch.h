@@ -31,6 +31,16 @@ Stmt inject_placeholder_prefetch(const Stmt &s, const std::map<std::string, Func
  * applicable. */
 Stmt inject_prefetch(const Stmt &s, const std::map<std::string, Function> &env);
 
+/** Find loads in innermost serial loops that touch a different cache
+ * line on every iteration (e.g. walking down a column), and prefetch
+ * them some number of iterations ahead. The distance is chosen from a
+ * rough estimate of the work done per iteration and the latency of a
+ * cache miss, or can be forced by setting the environment variable
+ * HL_AUTO_PREFETCH_DISTANCE (useful for sweeping distances when
+ * tuning). Only does anything if the target has the AutoPrefetch
+ * feature. Must be run after storage flattening. */
+Stmt inject_auto_prefetch(const Stmt &s, const Target &t);
+
 /** Reduce a multi-dimensional prefetch into a prefetch of lower dimension
  * (max dimension of the prefetch is specified by target architecture).
  * This keeps the 'max_dim' innermost dimensions and adds loops for the rest
@@ -8,7 +8,10 @@
  */
 
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "AutoScheduleUtils.h"
@@ -144,6 +147,20 @@ struct RegionCosts {
      * in the pipeline. The first function to be realized comes first. */
     RegionCosts(const std::map<std::string, Function> &env,
                 const std::vector<std::string> &order);
+
+private:
+    /** The costs of producing a single value of a function stage with some
+     * functions inlined into it, keyed by the function, the stage and the
+     * inlined functions. Inlining and simplifying the definition dominates
+     * these queries, and the auto scheduler asks the same ones many times
+     * as it tries different groupings, so they are memoized. They only
+     * depend on the function definitions, so they never go stale. */
+    using StageQuery = std::tuple<std::string, int, std::set<std::string>>;
+    mutable std::map<StageQuery, Cost> stage_cost_cache;
+    mutable std::map<StageQuery, std::map<std::string, Expr>> stage_load_costs_cache;
+    /** Guards the caches above, so that costs can be queried from several
+     * threads at once. */
+    mutable std::mutex cache_mutex;
 };
 
 /** Return true if the cost of inlining a function is equivalent to the
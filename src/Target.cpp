@@ -715,6 +715,8 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"semihosting", Target::Semihosting},
     {"avx10_1", Target::AVX10_1},
     {"x86apx", Target::X86APX},
+    {"auto_prefetch", Target::AutoPrefetch},
+    {"loop_carry", Target::LoopCarry},
     // NOTE: When adding features to this map, be sure to update PyEnums.cpp as well.
 };
 
@@ -179,6 +179,8 @@ struct Target {
         Semihosting = halide_target_feature_semihosting,
         AVX10_1 = halide_target_feature_avx10_1,
         X86APX = halide_target_feature_x86_apx,
+        AutoPrefetch = halide_target_feature_auto_prefetch,
+        LoopCarry = halide_target_feature_loop_carry,
         FeatureEnd = halide_target_feature_end
     };
     Target() = default;
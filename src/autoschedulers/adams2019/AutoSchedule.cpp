@@ -44,8 +44,11 @@
 
 #include <algorithm>
 #include <chrono>
+#include <exception>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <queue>
 #include <random>
 #include <set>
@@ -66,8 +69,11 @@
 #include "NetworkSize.h"
 #include "ParamParser.h"
 #include "PerfectHashMap.h"
+#include "ScheduleDatabase.h"
+#include "SearchBudget.h"
 #include "State.h"
 #include "Timer.h"
+#include "halide_thread_pool.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -216,6 +222,141 @@ public:
     }
 };
 
+// A cost model that holds on to the states enqueued into it while
+// states are expanded concurrently, so that they can be passed on to
+// the real cost model in a deterministic order.
+class DeferredCostModel : public CostModel {
+    struct Entry {
+        StageMapOfScheduleFeatures schedule_feats;
+        double *cost_ptr;
+    };
+    vector<Entry> entries;
+
+public:
+    void set_pipeline_features(const FunctionDAG &dag,
+                               const Adams2019Params &params) override {
+        internal_error << "DeferredCostModel only supports enqueue\n";
+    }
+
+    void enqueue(const FunctionDAG &dag,
+                 const StageMapOfScheduleFeatures &schedule_feats,
+                 double *cost_ptr) override {
+        entries.push_back({schedule_feats, cost_ptr});
+    }
+
+    void evaluate_costs() override {
+        internal_error << "DeferredCostModel only supports enqueue\n";
+    }
+
+    void reset() override {
+        entries.clear();
+    }
+
+    // Pass everything enqueued so far on to another cost model.
+    void forward(const FunctionDAG &dag, CostModel *cost_model) {
+        for (const auto &e : entries) {
+            cost_model->enqueue(dag, e.schedule_feats, e.cost_ptr);
+        }
+        entries.clear();
+    }
+};
+
+// Generate the children of some states from the beam. If there's a
+// thread pool, this happens concurrently, but the children and the
+// states they enqueue into the cost model are passed on in the same
+// order as if the states had been expanded one by one, so the search
+// does not depend on the number of threads.
+void expand_states(const vector<IntrusivePtr<State>> &states,
+                   const FunctionDAG &dag,
+                   const Adams2019Params &params,
+                   CostModel *cost_model,
+                   std::function<void(IntrusivePtr<State> &&)> &accept_child,
+                   Cache *cache,
+                   Tools::ThreadPool<void> *pool) {
+    if (!pool || !cost_model || states.size() < 2) {
+        for (const auto &state : states) {
+            state->generate_children(dag, params, cost_model, accept_child, cache);
+        }
+        return;
+    }
+
+    struct Expansion {
+        DeferredCostModel cost_model;
+        vector<IntrusivePtr<State>> children;
+        bool done = false;
+    };
+    vector<Expansion> expansions(states.size());
+    size_t next_to_pass_on = 0;
+    std::mutex mutex;
+
+    auto expand = [&](size_t i) {
+        Expansion &e = expansions[i];
+        std::function<void(IntrusivePtr<State> &&)> collect_child =
+            [&](IntrusivePtr<State> &&s) {
+                e.children.emplace_back(std::move(s));
+            };
+        states[i]->generate_children(dag, params, &e.cost_model, collect_child, cache);
+
+        // Pass on the results of every finished expansion that isn't
+        // waiting on an earlier one.
+        std::lock_guard<std::mutex> lock(mutex);
+        e.done = true;
+        while (next_to_pass_on < expansions.size() && expansions[next_to_pass_on].done) {
+            Expansion &next = expansions[next_to_pass_on++];
+            next.cost_model.forward(dag, cost_model);
+            for (auto &child : next.children) {
+                accept_child(std::move(child));
+            }
+            next.children.clear();
+        }
+    };
+
+    // The thread pool can't carry exceptions out of its tasks, so the
+    // first one thrown by any expansion is kept here, and rethrown once
+    // every task in flight has finished, since they all refer to the
+    // locals above. No more tasks are started after that.
+    std::exception_ptr error;
+    auto failed = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error != nullptr;
+    };
+    auto expand_catching = [&](size_t i) {
+        try {
+            expand(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    vector<std::future<void>> running;
+    auto wait_for_running = [&]() {
+        for (auto &f : running) {
+            f.get();
+        }
+        running.clear();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    };
+
+    for (size_t i = 0; i < states.size() && !failed(); i++) {
+        if (cache->may_memoize_blocks(states[i].get(), dag, params)) {
+            // The block cache can't be added to while other states
+            // are reading it, so expand this one on its own.
+            wait_for_running();
+            expand_catching(i);
+        } else {
+            running.emplace_back(pool->async([&expand_catching, i]() { expand_catching(i); }));
+        }
+    }
+    wait_for_running();
+
+    internal_assert(next_to_pass_on == states.size());
+}
+
 // Configure a cost model to process a specific pipeline.
 void configure_pipeline_features(const FunctionDAG &dag,
                                  const Adams2019Params &params,
@@ -224,7 +365,9 @@ void configure_pipeline_features(const FunctionDAG &dag,
     cost_model->set_pipeline_features(dag, params);
 }
 
-// A single pass of coarse-to-fine beam search.
+// A single pass of coarse-to-fine beam search. If a guide is given,
+// the states along the path it describes are always expanded, whether
+// or not they make it into the beam.
 IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
                                           const vector<Function> &outputs,
                                           const Adams2019Params &params,
@@ -234,7 +377,10 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
                                           int num_passes,
                                           ProgressBar &tick,
                                           std::unordered_set<uint64_t> &permitted_hashes,
-                                          Cache *cache) {
+                                          Cache *cache,
+                                          Tools::ThreadPool<void> *pool,
+                                          SearchBudget *budget,
+                                          const vector<ScheduleDecision> *guide) {
 
     if (cost_model) {
         configure_pipeline_features(dag, params, cost_model);
@@ -242,10 +388,18 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
 
     StateQueue q, pending;
 
+    // The state on the guide's path with the most decisions made, its
+    // parent, and whether it matched the guide exactly.
+    IntrusivePtr<State> guided, guided_parent;
+    bool guided_exactly = false;
+
     // The initial state, with no decisions made
     {
         IntrusivePtr<State> initial{new State};
         initial->root = new LoopNest;
+        if (guide) {
+            guided = initial;
+        }
         q.emplace(std::move(initial));
     }
 
@@ -256,6 +410,20 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
             // Each child should have one more decision made than its parent state.
             internal_assert(s->num_decisions_made == s->parent->num_decisions_made + 1);
 
+            // Follow the guide, preferring the child it describes
+            // exactly, but settling for one with the same structure at
+            // the root if the pipeline has changed since.
+            if (guided_parent.defined() && s->parent.get() == guided_parent.get() &&
+                s->num_decisions_made <= (int)guide->size()) {
+                const ScheduleDecision &d = (*guide)[s->num_decisions_made - 1];
+                if (!guided_exactly && d.matches(*s)) {
+                    guided = s;
+                    guided_exactly = true;
+                } else if (!guided.defined() && d.roughly_matches(*s)) {
+                    guided = s;
+                }
+            }
+
             int progress = s->num_decisions_made * params.beam_size + expanded;
             size_t max_progress = dag.nodes.size() * params.beam_size * 2;
 
@@ -292,7 +460,10 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
                                              num_passes,
                                              tick,
                                              permitted_hashes,
-                                             cache);
+                                             cache,
+                                             pool,
+                                             budget,
+                                             guide);
             } else {
                 internal_error << "Ran out of legal states with beam size " << params.beam_size << "\n";
             }
@@ -302,12 +473,28 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
             aslog(1) << "*** Warning: Huge number of states generated (" << pending.size() << ").\n";
         }
 
+        // Once the time budget is spent, finish the pass greedily from
+        // the best state in the beam, so that there is always a
+        // complete schedule to return.
+        int beam_size = params.beam_size;
+        if (budget && budget->spent()) {
+            if (budget->decisions_when_spent < 0) {
+                budget->decisions_when_spent = pending.top()->num_decisions_made;
+                budget->cut_short = true;
+            }
+            beam_size = 1;
+        }
+
+        // The states to expand. Choosing them depends only on
+        // pending, so we can expand them all at once afterwards.
+        vector<IntrusivePtr<State>> to_expand;
+
         expanded = 0;
-        while (expanded < params.beam_size && !pending.empty()) {
+        while (expanded < beam_size && !pending.empty()) {
 
             IntrusivePtr<State> state{pending.pop()};
 
-            if (params.beam_size > 1 && num_passes > 1) {
+            if (beam_size > 1 && num_passes > 1) {
                 // We are doing coarse-to-fine beam search using the
                 // hashing strategy mentioned in the paper.
                 //
@@ -380,10 +567,26 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
                 return best;
             }
 
-            state->generate_children(dag, params, cost_model, enqueue_new_children, cache);
+            to_expand.emplace_back(std::move(state));
             expanded++;
         }
 
+        if (guided.defined()) {
+            // Keep the guide's path alive even if the beam dropped it.
+            bool in_beam = false;
+            for (const auto &s : to_expand) {
+                in_beam |= (s.get() == guided.get());
+            }
+            if (!in_beam && guided->num_decisions_made < 2 * (int)dag.nodes.size()) {
+                to_expand.push_back(guided);
+            }
+        }
+        guided_parent = guided;
+        guided = IntrusivePtr<State>();
+        guided_exactly = false;
+
+        expand_states(to_expand, dag, params, cost_model, enqueue_new_children, cache, pool);
+
         // Drop the other states unconsidered.
         pending.clear();
 
@@ -425,13 +628,18 @@ IntrusivePtr<State> optimal_schedule_pass(FunctionDAG &dag,
     }
 }
 
-// Performance coarse-to-fine beam search and return the best state found.
+// Performance coarse-to-fine beam search and return the best state
+// found. If a guide is given, do a single pass that always considers
+// the path it describes instead. If a budget is given, stop once it is
+// spent.
 IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
                                      const vector<Function> &outputs,
                                      const Adams2019Params &params,
                                      CostModel *cost_model,
                                      std::mt19937 &rng,
-                                     const CachingOptions &options) {
+                                     const CachingOptions &options,
+                                     SearchBudget *budget,
+                                     const vector<ScheduleDecision> *guide = nullptr) {
 
     IntrusivePtr<State> best;
 
@@ -440,9 +648,25 @@ IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
     // Set up cache with options and size.
     Cache cache(options, dag.nodes.size());
 
+    // Set up a thread pool to expand states on, if asked for one.
+    std::unique_ptr<Tools::ThreadPool<void>> pool;
+    if (params.search_threads != 1) {
+        size_t threads = params.search_threads > 0 ?
+                             (size_t)params.search_threads :
+                             Tools::ThreadPool<void>::num_processors_online();
+        pool = std::make_unique<Tools::ThreadPool<void>>(threads);
+    }
+
     // If the beam size is one, it's pointless doing multiple passes.
     int num_passes = (params.beam_size == 1) ? 1 : 5;
 
+    // A guide from a similar pipeline is already a good
+    // schedule. Refining the search around it is what the later passes
+    // would be for.
+    if (guide) {
+        num_passes = 1;
+    }
+
 #ifdef HALIDE_AUTOSCHEDULER_ALLOW_CYOS
     string cyos_str = get_env_variable("HL_CYOS");
     if (cyos_str == "1") {
@@ -459,12 +683,18 @@ IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
     }
 
     for (int i = 0; i < num_passes; i++) {
+        if (i > 0 && budget && budget->spent()) {
+            budget->cut_short = true;
+            break;
+        }
+
         ProgressBar tick;
 
         Timer timer;
 
         auto pass = optimal_schedule_pass(dag, outputs, params, cost_model,
-                                          rng, i, num_passes, tick, permitted_hashes, &cache);
+                                          rng, i, num_passes, tick, permitted_hashes, &cache, pool.get(),
+                                          budget, guide);
 
         std::chrono::duration<double> total_time = timer.elapsed();
         auto milli = std::chrono::duration_cast<std::chrono::milliseconds>(total_time).count();
@@ -488,6 +718,20 @@ IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
             // not necessarily the final one.
             best = pass;
         }
+
+        if (budget) {
+            budget->passes++;
+        }
+    }
+
+    if (budget && budget->cut_short) {
+        aslog(1) << "Time budget of " << budget->seconds << "s spent after " << budget->passes
+                 << " of " << num_passes << " passes";
+        if (budget->decisions_when_spent >= 0) {
+            aslog(1) << ", the last of which made " << budget->decisions_when_spent << " of "
+                     << 2 * dag.nodes.size() << " decisions with the full beam and the rest greedily";
+        }
+        aslog(1) << "\n";
     }
 
     aslog(1) << "Best cost: " << best->cost << "\n";
@@ -500,13 +744,74 @@ IntrusivePtr<State> optimal_schedule(FunctionDAG &dag,
     return best;
 }
 
+// Follow the decisions stored in a schedule database entry from the
+// initial state. Returns an undefined pointer if the decisions don't
+// apply to this pipeline.
+IntrusivePtr<State> replay_schedule(const FunctionDAG &dag,
+                                    const Adams2019Params &params,
+                                    const ScheduleDatabaseEntry &entry,
+                                    const CachingOptions &options) {
+    // generate_children still featurizes each child to prune the silly
+    // ones, but there's no need to evaluate them.
+    struct NullCostModel : public CostModel {
+        void set_pipeline_features(const FunctionDAG &, const Adams2019Params &) override {
+        }
+        void enqueue(const FunctionDAG &, const StageMapOfScheduleFeatures &, double *) override {
+        }
+        void evaluate_costs() override {
+        }
+        void reset() override {
+        }
+    } null_cost_model;
+
+    Cache cache(options, dag.nodes.size());
+
+    IntrusivePtr<State> state{new State};
+    state->root = new LoopNest;
+    for (const ScheduleDecision &d : entry.decisions) {
+        IntrusivePtr<State> next;
+        std::function<void(IntrusivePtr<State> &&)> find_decision =
+            [&](IntrusivePtr<State> &&s) {
+                if (!next.defined() && d.matches(*s)) {
+                    next = std::move(s);
+                }
+            };
+        state->generate_children(dag, params, &null_cost_model, find_decision, &cache);
+        if (!next.defined()) {
+            return IntrusivePtr<State>();
+        }
+        state = next;
+    }
+    if (state->num_decisions_made != 2 * (int)dag.nodes.size()) {
+        return IntrusivePtr<State>();
+    }
+    state->cost = entry.cost;
+    return state;
+}
+
+// When scheduling for throughput, each concurrent instance of the
+// pipeline gets an equal share of the cores, so search for the
+// schedule of one instance with that many.
+Adams2019Params params_per_instance(const Adams2019Params &params) {
+    // The params of the alternative entrypoint don't go through the parser.
+    user_assert(params.parallelism > 0 && params.concurrent_instances > 0)
+        << "Adams2019.parallelism and Adams2019.concurrent_instances must be positive\n";
+    Adams2019Params p = params;
+    if (params.concurrent_instances > 1) {
+        p.parallelism = std::max(1, params.parallelism / params.concurrent_instances);
+    }
+    return p;
+}
+
 // The main entrypoint to generate a schedule for a pipeline.
 void generate_schedule(const std::vector<Function> &outputs,
                        const Target &target,
-                       const Adams2019Params &params,
+                       const Adams2019Params &params_in,
                        AutoSchedulerResults *auto_scheduler_results) {
+    const Adams2019Params params = params_per_instance(params_in);
     aslog(1) << "generate_schedule for target=" << target.to_string() << "\n";
-    aslog(1) << "Adams2019.parallelism:" << params.parallelism << "\n";
+    aslog(1) << "Adams2019.parallelism:" << params_in.parallelism << "\n";
+    aslog(1) << "Adams2019.concurrent_instances:" << params.concurrent_instances << "\n";
     aslog(1) << "Adams2019.beam_size:" << params.beam_size << "\n";
     aslog(1) << "Adams2019.random_dropout:" << params.random_dropout << "\n";
     aslog(1) << "Adams2019.random_dropout_seed:" << params.random_dropout_seed << "\n";
@@ -515,12 +820,14 @@ void generate_schedule(const std::vector<Function> &outputs,
     aslog(1) << "Adams2019.disable_memoized_features:" << params.disable_memoized_features << "\n";
     aslog(1) << "Adams2019.disable_memoized_blocks:" << params.disable_memoized_blocks << "\n";
     aslog(1) << "Adams2019.memory_limit:" << params.memory_limit << "\n";
+    aslog(1) << "Adams2019.thread_memory_limit:" << params.thread_memory_limit << "\n";
+    aslog(1) << "Adams2019.search_threads:" << params.search_threads << "\n";
+    aslog(1) << "Adams2019.schedule_database:" << params.schedule_database << "\n";
+    aslog(1) << "Adams2019.time_budget_s:" << params.time_budget_s << "\n";
 
     // Start a timer
     HALIDE_TIC;
 
-    State::cost_calculations = 0;
-
     std::mt19937 rng((uint32_t)params.random_dropout_seed);
 
     string weights_in_path = params.weights_path;
@@ -538,7 +845,7 @@ void generate_schedule(const std::vector<Function> &outputs,
     // Construct a cost model to use to evaluate states. Currently we
     // just have the one, but it's an abstract interface, so others
     // can be slotted in for experimentation.
-    std::unique_ptr<CostModel> cost_model = make_default_cost_model(weights_in_path, weights_out_path, randomize_weights);
+    std::unique_ptr<DefaultCostModel> cost_model = make_default_cost_model(weights_in_path, weights_out_path, randomize_weights);
     internal_assert(cost_model != nullptr);
 
     IntrusivePtr<State> optimal;
@@ -546,17 +853,64 @@ void generate_schedule(const std::vector<Function> &outputs,
     // Options generated from environment variables, decide whether or not to cache features and/or tilings.
     CachingOptions cache_options = CachingOptions::MakeOptionsFromParams(params);
 
-    // Run beam search
-    optimal = optimal_schedule(dag, outputs, params, cost_model.get(), rng, cache_options);
+    std::unique_ptr<ScheduleDatabase> database;
+    uint64_t database_key = 0;
+    if (!params.schedule_database.empty()) {
+        if (params.random_dropout < 100) {
+            aslog(1) << "Not using the schedule database, because random dropout is enabled\n";
+        } else {
+            database = std::make_unique<ScheduleDatabase>(params.schedule_database);
+            database_key = ScheduleDatabase::key(dag, target, params, cost_model->weights_hash());
+        }
+    }
+
+    ScheduleDatabaseEntry cached;
+    bool have_similar = false;
+    if (database && database->lookup(database_key, &cached)) {
+        Timer timer;
+        optimal = replay_schedule(dag, params, cached, cache_options);
+        if (optimal.defined()) {
+            auto milli = std::chrono::duration_cast<std::chrono::milliseconds>(timer.elapsed()).count();
+            aslog(1) << "Replayed schedule from the database, time (ms): " << milli << "\n";
+        } else {
+            aslog(1) << "Schedule in the database no longer applies, searching again\n";
+        }
+    } else if (database && database->find_nearest(dag, target, &cached)) {
+        aslog(1) << "Warm-starting the search from the schedule of a similar pipeline in the database\n";
+        have_similar = true;
+    }
+
+    if (!optimal.defined()) {
+        // Run beam search
+        SearchBudget budget(params.time_budget_s);
+        optimal = optimal_schedule(dag, outputs, params, cost_model.get(), rng, cache_options, &budget,
+                                   have_similar ? &cached.decisions : nullptr);
+        // Don't remember a schedule that a longer search might improve on.
+        if (database && !budget.cut_short) {
+            database->insert(ScheduleDatabase::make_entry(database_key, dag, target, *optimal));
+        }
+    }
 
     HALIDE_TOC;
 
-    aslog(1) << "Cost evaluated this many times: " << State::cost_calculations << "\n";
+    aslog(1) << "Cost evaluated this many times: " << dag.cost_calculations << "\n";
+    if (aslog::aslog_level() >= 1) {
+        dag.featurization_profile.dump(aslog(1).get_ostream());
+    }
+
+    {
+        int64_t per_thread = 0;
+        int64_t peak = optimal->root->peak_memory(params, &per_thread);
+        aslog(1) << "Estimated peak memory (bytes): " << peak << ", per thread: " << per_thread << "\n";
+    }
 
     // Dump the schedule found
     aslog(1) << "** Optimal schedule:\n";
 
-    // Just to get the debugging prints to fire
+    // Just to get the debugging prints to fire. A schedule replayed from
+    // the database was never evaluated, so the cost model isn't configured
+    // for this pipeline yet.
+    configure_pipeline_features(dag, params, cost_model.get());
     optimal->calculate_cost(dag, params, cost_model.get(), cache_options, /*verbosity_level*/ 1);
 
     // Apply the schedules to the pipeline
@@ -590,6 +944,7 @@ struct Adams2019 {
         {
             ParamParser parser(params_in.extra);
             parser.parse("parallelism", &params.parallelism);
+            parser.parse("concurrent_instances", &params.concurrent_instances);
             parser.parse("beam_size", &params.beam_size);
             parser.parse("random_dropout", &params.random_dropout);
             parser.parse("random_dropout_seed", &params.random_dropout_seed);
@@ -598,8 +953,16 @@ struct Adams2019 {
             parser.parse("disable_memoized_features", &params.disable_memoized_features);
             parser.parse("disable_memoized_blocks", &params.disable_memoized_blocks);
             parser.parse("memory_limit", &params.memory_limit);
+            parser.parse("thread_memory_limit", &params.thread_memory_limit);
+            parser.parse("search_threads", &params.search_threads);
+            parser.parse("schedule_database", &params.schedule_database);
+            parser.parse("time_budget_s", &params.time_budget_s);
             parser.finish();
         }
+        user_assert(params.parallelism > 0)
+            << "Adams2019.parallelism must be positive, but is " << params.parallelism << "\n";
+        user_assert(params.concurrent_instances > 0)
+            << "Adams2019.concurrent_instances must be positive, but is " << params.concurrent_instances << "\n";
         Autoscheduler::generate_schedule(outputs, target, params, results);
         results->autoscheduler_params = params_in;
     }
@@ -612,13 +975,15 @@ REGISTER_AUTOSCHEDULER(Adams2019)
 // An alternative entrypoint for other uses
 void find_and_apply_schedule(FunctionDAG &dag,
                              const std::vector<Function> &outputs,
-                             const Adams2019Params &params,
+                             const Adams2019Params &params_in,
                              CostModel *cost_model,
                              StageMap<ScheduleFeatures> *schedule_features) {
+    const Adams2019Params params = params_per_instance(params_in);
 
     std::mt19937 rng(12345);
     CachingOptions cache_options = CachingOptions::MakeOptionsFromParams(params);
-    IntrusivePtr<State> optimal = optimal_schedule(dag, outputs, params, cost_model, rng, cache_options);
+    SearchBudget budget(params.time_budget_s);
+    IntrusivePtr<State> optimal = optimal_schedule(dag, outputs, params, cost_model, rng, cache_options, &budget);
 
     // Apply the schedules
     optimal->apply_schedule(dag, params);
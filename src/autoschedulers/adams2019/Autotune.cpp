@@ -0,0 +1,586 @@
+#include "Autotune.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+#include "CostModelTraining.h"
+#include "DefaultCostModel.h"
+#include "HalideBuffer.h"
+#include "cmdline.h"
+#include "halide_benchmark.h"
+#include "halide_thread_pool.h"
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using std::string;
+using std::vector;
+
+// Run a step that may fail with a Halide error, recording the error
+// instead of letting it escape from a worker thread.
+template<typename Fn>
+bool run_and_catch(Fn &&fn, string *error) {
+#ifdef HALIDE_WITH_EXCEPTIONS
+    try {
+        fn();
+    } catch (const Halide::Error &e) {
+        *error = e.what();
+        return false;
+    }
+#else
+    fn();
+#endif
+    return true;
+}
+
+double seconds_since(std::chrono::high_resolution_clock::time_point start) {
+    std::chrono::duration<double> d = std::chrono::high_resolution_clock::now() - start;
+    return d.count();
+}
+
+// The shape to allocate for a buffer argument: its estimates where it
+// has them, and its constraints otherwise.
+bool estimated_shape(const Parameter &p, vector<int> *mins, vector<int> *extents) {
+    for (int i = 0; i < p.dimensions(); i++) {
+        Expr min = p.min_constraint_estimate(i);
+        Expr extent = p.extent_constraint_estimate(i);
+        if (!min.defined()) {
+            min = p.min_constraint(i);
+        }
+        if (!extent.defined()) {
+            extent = p.extent_constraint(i);
+        }
+        min = min.defined() ? simplify(min) : Expr(0);
+        extent = extent.defined() ? simplify(extent) : Expr();
+        const int64_t *m = as_const_int(min);
+        const int64_t *e = as_const_int(extent);
+        if (!m || !e) {
+            return false;
+        }
+        mins->push_back((int)*m);
+        extents->push_back((int)*e);
+    }
+    return true;
+}
+
+// Fill a buffer with random data, as RunGen's --estimate_all does.
+void fill_with_random(Buffer<> &b, std::mt19937 &rng) {
+    const Type t = b.type();
+    if (t.is_float() && t.bits() == 32) {
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        b.as<float>().for_each_value([&](float &v) { v = dist(rng); });
+    } else if (t.is_float() && t.bits() == 64) {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        b.as<double>().for_each_value([&](double &v) { v = dist(rng); });
+    } else if (t.is_float() || t.is_handle()) {
+        memset(b.data(), 0, b.size_in_bytes());
+    } else {
+        uint8_t *data = (uint8_t *)b.data();
+        for (size_t i = 0; i < b.size_in_bytes(); i++) {
+            data[i] = t.is_bool() ? (rng() & 1) : (uint8_t)rng();
+        }
+    }
+}
+
+// The value to pass for a scalar argument: its estimate, or else its
+// default, or else zero.
+halide_scalar_value_t estimated_scalar(const Parameter &p) {
+    halide_scalar_value_t result = {};
+
+    const ArgumentEstimates estimates = p.get_argument_estimates();
+    Expr value = estimates.scalar_estimate.defined() ? estimates.scalar_estimate : estimates.scalar_def;
+    if (!value.defined()) {
+        return result;
+    }
+    const Type t = p.type();
+    if (t.is_float()) {
+        value = simplify(cast(Float(64), value));
+        const double *f = as_const_float(value);
+        if (f && t.bits() == 64) {
+            result.u.f64 = *f;
+        } else if (f) {
+            result.u.f32 = (float)*f;
+        }
+        return result;
+    }
+
+    value = simplify(cast(Int(64), value));
+    const int64_t *i = as_const_int(value);
+    if (!i) {
+        return result;
+    }
+    if (t.is_bool()) {
+        result.u.b = *i != 0;
+    } else if (t.bits() == 8) {
+        result.u.u8 = (uint8_t)*i;
+    } else if (t.bits() == 16) {
+        result.u.u16 = (uint16_t)*i;
+    } else if (t.bits() == 32) {
+        result.u.u32 = (uint32_t)*i;
+    } else {
+        result.u.u64 = (uint64_t)*i;
+    }
+    return result;
+}
+
+// One randomized schedule of one pipeline, from autoscheduling through
+// to its measured runtime.
+struct Candidate {
+    int pipeline_id = 0;
+    int schedule_id = 0;
+    string name, dir;
+    GeneratorParamsMap generator_params;
+    AutoschedulerParams autoscheduler_params;
+
+    AutoSchedulerResults results;
+    Callable callable;
+    vector<Buffer<>> buffers;
+    vector<halide_scalar_value_t> scalars;
+    // Which of the Callable's arguments (after the user context) are
+    // scalars, and their index in buffers or scalars.
+    vector<std::pair<bool, size_t>> args;
+
+    // When compilation started, published by setting compiling, so that
+    // the thread waiting on it can tell when it has run too long.
+    std::chrono::high_resolution_clock::time_point compile_start;
+    std::atomic<bool> compiling{false};
+
+    double compile_time = 0;
+    double runtime = -1;  // in seconds
+    string error;
+};
+
+void compile_candidate(const AutotuneOptions &options, Candidate *c) {
+    auto start = std::chrono::high_resolution_clock::now();
+    c->compile_start = start;
+    c->compiling = true;
+
+    // Give up between steps once the timeout has passed, as the caller
+    // will already have discarded this candidate.
+    auto timed_out = [&]() {
+        return seconds_since(start) > options.compile_timeout;
+    };
+
+    auto compile = [&]() {
+        auto g = get_registered_generators().create(options.generator_name, GeneratorContext(options.target));
+        user_assert(g != nullptr) << "There is no Generator with the name '" << options.generator_name << "' currently available.";
+        g->set_generatorparam_values(c->generator_params);
+
+        Pipeline pipeline = g->build_pipeline();
+        c->results = pipeline.apply_autoscheduler(options.target, c->autoscheduler_params);
+        if (timed_out()) {
+            return;
+        }
+
+        // Collect the inputs in the order the Generator declares them, as
+        // AbstractGenerator::compile_to_callable does.
+        std::mt19937 rng((uint32_t)c->schedule_id);
+        vector<Parameter> inputs;
+        for (const auto &a : g->arginfos()) {
+            if (a.dir == ArgInfoDirection::Input) {
+                for (const Parameter &p : g->input_parameter(a.name)) {
+                    inputs.push_back(p);
+                }
+            }
+        }
+        vector<Parameter> outputs;
+        for (const Func &f : pipeline.outputs()) {
+            for (const OutputImageParam &o : f.output_buffers()) {
+                outputs.push_back(o.parameter());
+            }
+        }
+
+        vector<Argument> arguments;
+        for (const Parameter &p : inputs) {
+            arguments.emplace_back(p.name(),
+                                   p.is_buffer() ? Argument::InputBuffer : Argument::InputScalar,
+                                   p.type(), p.dimensions(), p.get_argument_estimates());
+        }
+        for (const Parameter &p : inputs) {
+            if (p.is_buffer()) {
+                vector<int> mins, extents;
+                user_assert(estimated_shape(p, &mins, &extents))
+                    << "Input " << p.name() << " has no estimates or constant constraints to size it with.\n";
+                Buffer<> b(p.type(), extents);
+                b.set_min(mins);
+                fill_with_random(b, rng);
+                c->args.emplace_back(false, c->buffers.size());
+                c->buffers.push_back(b);
+            } else {
+                c->args.emplace_back(true, c->scalars.size());
+                c->scalars.push_back(estimated_scalar(p));
+            }
+        }
+        for (const Parameter &p : outputs) {
+            vector<int> mins, extents;
+            user_assert(estimated_shape(p, &mins, &extents))
+                << "Output " << p.name() << " has no estimates or constant constraints to size it with.\n";
+            Buffer<> b(p.type(), extents);
+            b.set_min(mins);
+            c->args.emplace_back(false, c->buffers.size());
+            c->buffers.push_back(b);
+        }
+
+        c->callable = pipeline.compile_to_callable(arguments, options.target);
+    };
+    run_and_catch(compile, &c->error);
+
+    c->compile_time = seconds_since(start);
+    if (c->error.empty() && timed_out()) {
+        c->error = "Compilation took " + std::to_string(c->compile_time) + " seconds";
+        c->callable = Callable();
+    }
+}
+
+void benchmark_candidate(const AutotuneOptions &options, Candidate *c) {
+    if (!c->error.empty()) {
+        return;
+    }
+
+    JITUserContext context;
+    JITUserContext *context_ptr = &context;
+    vector<const void *> argv;
+    argv.push_back(&context_ptr);
+    for (const auto &a : c->args) {
+        if (a.first) {
+            argv.push_back(&c->scalars[a.second]);
+        } else {
+            argv.push_back(c->buffers[a.second].raw_buffer());
+        }
+    }
+
+    Tools::BenchmarkConfig config;
+    config.max_time = std::max(config.min_time, options.benchmark_time);
+    int result = 0;
+    auto call = [&]() {
+        result = c->callable.call_argv_fast(argv.size(), argv.data());
+    };
+    auto run = [&]() {
+        // Run once first, to catch failures before timing anything.
+        call();
+        if (result == 0) {
+            c->runtime = Tools::benchmark(call, config).wall_time;
+        }
+    };
+    run_and_catch(run, &c->error);
+    if (c->error.empty() && result != 0) {
+        c->error = "Pipeline returned error code " + std::to_string(result);
+    }
+    if (!c->error.empty()) {
+        c->runtime = -1;
+    }
+}
+
+// A few epochs of training on everything measured so far, in the same way
+// adams2019_retrain_cost_model does.
+void retrain(DefaultCostModel *model, SampleSet &samples, const AutotuneOptions &options, std::mt19937 &rng) {
+    SampleSet no_validation;
+    for (int e = 0; e < options.epochs; e++) {
+        EpochStats stats = train_epoch(model, samples, no_validation, options.learning_rate,
+                                       options.parallelism, 8, rng);
+        if (stats.loss_count == 0) {
+            std::cout << "Not enough samples to retrain on yet\n";
+            return;
+        }
+        if (e == 0 || e == options.epochs - 1) {
+            std::cout << "Epoch " << e << " loss: " << stats.loss_sum / stats.loss_count << "\n";
+        }
+    }
+    model->save_weights();
+}
+
+void copy_file(const string &from, const string &to) {
+    std::ifstream src(from, std::ios::binary);
+    std::ofstream dst(to, std::ios::binary);
+    dst << src.rdbuf();
+}
+
+}  // namespace
+
+void autotune(const AutotuneOptions &options_in) {
+    AutotuneOptions options = options_in;
+    user_assert(!options.samples_dir.empty()) << "No samples directory specified for autotuning.\n";
+    user_assert(options.batch_size > 0) << "The autotuning batch size must be positive.\n";
+
+    if (!options.plugin_path.empty()) {
+        load_plugin(options.plugin_path);
+    }
+    if (options.generator_name.empty()) {
+        vector<string> names = get_registered_generators().enumerate();
+        user_assert(names.size() == 1)
+            << "A Generator name must be specified when there are " << names.size() << " Generators registered.\n";
+        options.generator_name = names[0];
+    }
+    if (options.generator_params_sets.empty()) {
+        options.generator_params_sets.emplace_back();
+    }
+    std::cout << "Training target is: " << options.target.to_string() << "\n";
+
+    fs::create_directories(options.samples_dir);
+    const string weights = options.samples_dir + "/updated.weights";
+
+    // Pick up any samples from earlier runs, so that retraining sees
+    // everything, and so that we don't clobber their batches.
+    SampleSet samples;
+    int first_batch = 1;
+    size_t num_loaded = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(options.samples_dir)) {
+        const string path = entry.path().string();
+        const string leaf = entry.path().filename().string();
+        if (entry.is_directory() && starts_with(leaf, "batch_")) {
+            first_batch = std::max(first_batch, std::atoi(leaf.c_str() + 6) + 1);
+        }
+        if (ends_with(path, ".sample") && load_sample(&samples, path)) {
+            num_loaded++;
+        }
+    }
+    if (num_loaded > 0) {
+        std::cout << "Loaded " << num_loaded << " existing samples\n";
+    }
+    float best_runtime = 1e20f;
+    string best_sample;
+    if (const Sample *s = fastest_sample(samples)) {
+        best_runtime = s->runtimes[0];
+        best_sample = s->filename;
+    }
+
+    // Only start from the initial weights if we don't have any already,
+    // so that restarted jobs can continue from where they left off.
+    std::unique_ptr<DefaultCostModel> model;
+    if (file_exists(weights)) {
+        std::cout << "Using existing weights " << weights << "\n";
+        model = make_default_cost_model(weights, weights, false);
+    } else {
+        model = make_default_cost_model(options.initial_weights_path, weights, false);
+        model->save_weights();
+    }
+
+    const size_t compile_threads = options.compile_threads > 0 ?
+                                       (size_t)options.compile_threads :
+                                       Tools::ThreadPool<void>::num_processors_online();
+    Tools::ThreadPool<void> compile_pool(compile_threads);
+    Tools::ThreadPool<void> benchmark_pool(std::max(1, options.benchmark_threads));
+    std::mt19937 rng((uint32_t)time(nullptr));
+
+    const string pipeline_name = options.generator_name;
+    for (int batch_id = first_batch; batch_id < first_batch + options.num_batches; batch_id++) {
+        auto batch_start = std::chrono::high_resolution_clock::now();
+
+        for (size_t set_idx = 0; set_idx < options.generator_params_sets.size(); set_idx++) {
+            const string dir = options.samples_dir + "/batch_" + std::to_string(batch_id) + "_" + std::to_string(set_idx);
+            fs::create_directories(dir);
+            // Keep the weights used with the batch so that failures can be reproduced.
+            copy_file(weights, dir + "/used.weights");
+
+            // Candidates are shared with the compile tasks, which may outlive
+            // the batch if they time out.
+            vector<std::shared_ptr<Candidate>> candidates;
+            for (int i = 0; i < options.batch_size; i++) {
+                candidates.push_back(std::make_shared<Candidate>());
+                Candidate &c = *candidates.back();
+                char name[256];
+                snprintf(name, sizeof(name), "%s_batch_%04d_sample_%04d", pipeline_name.c_str(), batch_id, i);
+                c.pipeline_id = (int)set_idx;
+                c.schedule_id = batch_id * 10000 + i;
+                c.name = name;
+                c.dir = dir + "/" + std::to_string(i);
+                c.generator_params = options.generator_params_sets[set_idx];
+
+                // Sample 0 in each batch is best effort beam search, with no
+                // randomness. The other samples are random probes biased by
+                // the cost model, with a 1% chance of operating entirely
+                // greedily. Half of the compile timeout is given to the
+                // search, which stops early rather than overrunning it.
+                const bool beam = i == 0;
+                c.autoscheduler_params = AutoschedulerParams("Adams2019",
+                                                             {{"parallelism", std::to_string(options.parallelism)},
+                                                              {"beam_size", beam ? "32" : "1"},
+                                                              {"random_dropout", beam ? "100" : "1"},
+                                                              {"random_dropout_seed", std::to_string(c.schedule_id)},
+                                                              {"time_budget_s", std::to_string(options.compile_timeout / 2)},
+                                                              {"weights_path", weights}});
+            }
+
+            std::cout << "Compiling " << options.batch_size << " samples\n";
+            vector<std::future<void>> futures;
+            for (const auto &c : candidates) {
+                futures.push_back(compile_pool.async([&options, c]() { compile_candidate(options, c.get()); }));
+            }
+            for (size_t i = 0; i < futures.size(); i++) {
+                // Compilation can't be interrupted, so a candidate that runs
+                // past the timeout is replaced by a failed copy, and its task
+                // left to finish on the original in the background.
+                Candidate &c = *candidates[i];
+                while (futures[i].wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+                    if (c.compiling && seconds_since(c.compile_start) > options.compile_timeout) {
+                        auto failed = std::make_shared<Candidate>();
+                        failed->pipeline_id = c.pipeline_id;
+                        failed->schedule_id = c.schedule_id;
+                        failed->name = c.name;
+                        failed->dir = c.dir;
+                        failed->error = "Compilation timed out after " + std::to_string(options.compile_timeout) + " seconds";
+                        candidates[i] = failed;
+                        break;
+                    }
+                }
+            }
+            futures.clear();
+
+            // Don't start benchmarking until compilation is over, so that it
+            // doesn't disturb the timings.
+            std::cout << "Benchmarking " << options.batch_size << " samples\n";
+            for (const auto &c : candidates) {
+                futures.push_back(benchmark_pool.async([&options, c]() { benchmark_candidate(options, c.get()); }));
+            }
+            for (auto &f : futures) {
+                f.wait();
+            }
+
+            // Save the samples and stream them into the training set.
+            int num_ok = 0;
+            for (const auto &cp : candidates) {
+                const Candidate &c = *cp;
+                fs::create_directories(c.dir);
+                if (!c.error.empty()) {
+                    std::cout << "Sample " << c.name << " failed: " << c.error << "\n";
+                    continue;
+                }
+                const string stem = c.dir + "/" + c.name;
+                {
+                    std::ofstream f(stem + ".schedule.h");
+                    f << c.results.schedule_source;
+                }
+                const float runtime = (float)(c.runtime * 1000);
+                {
+                    std::ofstream f(stem + ".sample", std::ios::binary);
+                    f.write((const char *)c.results.featurization.data(), c.results.featurization.size());
+                    f.write((const char *)&runtime, sizeof(runtime));
+                    f.write((const char *)&c.pipeline_id, sizeof(c.pipeline_id));
+                    f.write((const char *)&c.schedule_id, sizeof(c.schedule_id));
+                }
+                std::cout << c.name << ": " << runtime << " ms\n";
+                if (!load_sample(&samples, stem + ".sample")) {
+                    std::cout << "Discarding implausible featurization for " << c.name << "\n";
+                    continue;
+                }
+                num_ok++;
+                if (runtime < best_runtime) {
+                    best_runtime = runtime;
+                    best_sample = stem + ".sample";
+                }
+            }
+            std::cout << num_ok << " of " << options.batch_size << " samples succeeded\n";
+
+            if (!best_sample.empty()) {
+                std::ofstream f(options.samples_dir + "/best." + pipeline_name + ".benchmark.txt", std::ios_base::trunc);
+                f << "Best runtime is " << best_runtime << " msec, from " << best_sample << "\n";
+                copy_file(best_sample.substr(0, best_sample.size() - 7) + ".schedule.h",
+                          options.samples_dir + "/best." + pipeline_name + ".schedule.h");
+            }
+
+            std::cout << "Retraining model...\n";
+            retrain(model.get(), samples, options, rng);
+        }
+
+        std::cout << "Batch " << batch_id << " took " << seconds_since(batch_start)
+                  << " seconds to compile, benchmark, and retrain\n";
+    }
+}
+
+int autotune_main(int argc, char **argv) {
+    cmdline::parser a;
+    const char *kNoDesc = "";
+    constexpr bool kOptional = false;
+    a.add<string>("generator", 'g', "The Generator to autotune", kOptional, "");
+    a.add<string>("generator_args", '\0', "Space-separated sets of ';'-separated GeneratorParams", kOptional, "");
+    a.add<string>("target", '\0', "Defaults to the host, without AVX-512", kOptional, "");
+    a.add<string>("plugin", 'p', "Path to the Adams2019 autoscheduler plugin", kOptional, "");
+    a.add<string>("initial_weights", '\0', kNoDesc, kOptional, "");
+    a.add<string>("samples", 'o', "Directory to write samples and weights to");
+    a.add<int>("batch_size", '\0', kNoDesc, kOptional, 32);
+    a.add<int>("num_batches", '\0', kNoDesc, kOptional, 1);
+    a.add<int>("parallelism", '\0', kNoDesc, kOptional, 32);
+    a.add<int>("compile_threads", '\0', "0 means one per core", kOptional, 0);
+    a.add<int>("benchmark_threads", '\0', kNoDesc, kOptional, 1);
+    a.add<double>("compile_timeout", '\0', "In seconds", kOptional, 600);
+    a.add<double>("benchmark_time", '\0', "In seconds", kOptional, 60);
+    a.add<int>("epochs", '\0', "Defaults to the batch size", kOptional, 0);
+    a.add<float>("learning_rate", '\0', kNoDesc, kOptional, 0.0001f);
+    a.parse_check(argc, argv);  // exits if parsing fails
+
+    AutotuneOptions options;
+    options.generator_name = a.get<string>("generator");
+    options.plugin_path = a.get<string>("plugin");
+    options.initial_weights_path = a.get<string>("initial_weights");
+    options.samples_dir = a.get<string>("samples");
+    options.batch_size = a.get<int>("batch_size");
+    options.num_batches = a.get<int>("num_batches");
+    options.parallelism = a.get<int>("parallelism");
+    options.compile_threads = a.get<int>("compile_threads");
+    options.benchmark_threads = a.get<int>("benchmark_threads");
+    options.compile_timeout = a.get<double>("compile_timeout");
+    options.benchmark_time = a.get<double>("benchmark_time");
+    options.epochs = a.get<int>("epochs") > 0 ? a.get<int>("epochs") : options.batch_size;
+    options.learning_rate = a.get<float>("learning_rate");
+
+    const string target = a.get<string>("target");
+    if (target.empty()) {
+        // Don't train for AVX-512 by default, at least not yet.
+        options.target = get_host_target();
+        for (auto f : {Target::AVX512, Target::AVX512_KNL, Target::AVX512_Skylake, Target::AVX512_Cannonlake}) {
+            options.target = options.target.without_feature(f);
+        }
+    } else {
+        options.target = Target(target);
+    }
+
+    // Each set of GeneratorParams is delimited by a space, and the
+    // values within each set by ';', e.g. "a=1;b=foo a=2;b=bar".
+    for (const string &set : split_string(a.get<string>("generator_args"), " ")) {
+        if (set.empty()) {
+            continue;
+        }
+        GeneratorParamsMap params;
+        for (const string &kv : split_string(set, ";")) {
+            size_t eq = kv.find('=');
+            if (eq == string::npos) {
+                std::cerr << "Malformed GeneratorParam: " << kv << "\n";
+                return 1;
+            }
+            params[kv.substr(0, eq)] = kv.substr(eq + 1);
+        }
+        options.generator_params_sets.push_back(params);
+    }
+
+#ifdef HALIDE_WITH_EXCEPTIONS
+    try {
+        autotune(options);
+    } catch (const Halide::Error &err) {
+        std::cerr << "Unhandled exception: " << err.what() << "\n";
+        return 1;
+    }
+#else
+    autotune(options);
+#endif
+    return 0;
+}
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
@@ -0,0 +1,94 @@
+#ifndef ADAMS2019_AUTOTUNE_H
+#define ADAMS2019_AUTOTUNE_H
+
+#include "Halide.h"
+
+#include <string>
+#include <vector>
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+/*
+  An in-process replacement for adams2019_autotune_loop.sh. Each batch
+  asks the Adams2019 autoscheduler for a number of randomized schedules
+  of a registered Generator, JIT-compiles them to Callables on one thread
+  pool, benchmarks them on another, and then retrains the cost model on
+  everything measured so far before starting the next batch.
+
+  The files written to the samples directory have the same layout as the
+  ones the script writes, so adams2019_retrain_cost_model can still be
+  run over them, and a restarted run picks up where the last one left off.
+*/
+
+struct AutotuneOptions {
+    /** The registered name of the Generator to tune. May be left empty if
+     * exactly one Generator is registered. */
+    std::string generator_name;
+
+    /** Sets of GeneratorParams to tune for. Each set is treated as a
+     * different pipeline by the cost model. If empty, the Generator is
+     * tuned with its default GeneratorParams only. */
+    std::vector<GeneratorParamsMap> generator_params_sets;
+
+    /** The target to compile and benchmark for. */
+    Target target;
+
+    /** Path to the Adams2019 plugin. If empty, the autoscheduler must
+     * already be loaded. */
+    std::string plugin_path;
+
+    /** The weights to start from if the samples directory does not already
+     * contain updated ones. If empty, the built-in weights are used. */
+    std::string initial_weights_path;
+
+    /** Where to write the samples, schedules, and retrained weights. */
+    std::string samples_dir;
+
+    /** Number of schedules to try per batch and GeneratorParams set, and
+     * the number of batches to run. */
+    int batch_size = 32;
+    int num_batches = 1;
+
+    /** The autoscheduler's parallelism param, also used as the core
+     * count when retraining. */
+    int parallelism = 32;
+
+    /** Number of schedules to autoschedule and compile at once. If 0, use
+     * one per core. */
+    int compile_threads = 0;
+
+    /** Number of schedules to benchmark at once. Anything other than 1
+     * makes the benchmarks compete for the machine. */
+    int benchmark_threads = 1;
+
+    /** Schedules that take longer than this many seconds to autoschedule
+     * and compile are discarded. Half of it is the autoscheduler's search
+     * budget. Compilation can't be interrupted in-process, so one that
+     * overruns is abandoned as soon as it does, and left to finish in the
+     * background. */
+    double compile_timeout = 600;
+
+    /** The most time in seconds to spend benchmarking each schedule. */
+    double benchmark_time = 60;
+
+    /** Retraining parameters applied after each batch. */
+    int epochs = 32;
+    float learning_rate = 0.0001f;
+};
+
+/** Run the autotuning loop described by the options. */
+void autotune(const AutotuneOptions &options);
+
+/** Parse options from the command line and call autotune(). Link
+ * AutotuneMain.cpp with the source of some Generators to get an
+ * autotuning tool for them, in the same way GenGen.cpp makes a Generator
+ * executable. */
+int autotune_main(int argc, char **argv);
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
+
+#endif  // ADAMS2019_AUTOTUNE_H
@@ -0,0 +1,5 @@
+#include "Autotune.h"
+
+int main(int argc, char **argv) {
+    return Halide::Internal::Autoscheduler::autotune_main(argc, argv);
+}
@@ -6,6 +6,20 @@ namespace Halide {
 namespace Internal {
 namespace Autoscheduler {
 
+namespace {
+
+// The vector dimension of the first stage of a Func computed at root.
+int root_vector_dim(const LoopNest *root, const FunctionDAG::Node *node) {
+    for (const auto &child : root->children) {
+        if (child->node == node && child->stage->index == 0) {
+            return child->vector_dim;
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
 bool Cache::add_memoized_blocks(const State *state,
                                 std::function<void(IntrusivePtr<State> &&)> &accept_child,
                                 const FunctionDAG::Node *node, int &num_children,
@@ -18,13 +32,7 @@ bool Cache::add_memoized_blocks(const State *state,
     }
 
     // get correct vector dimension.
-    int vector_dims = -1;
-    for (const auto &child : state->root->children) {
-        if (child->node == node && child->stage->index == 0) {
-            vector_dims = child->vector_dim;
-            break;
-        }
-    }
+    int vector_dims = root_vector_dim(state->root.get(), node);
 
     const auto &vector_dim_map = memoized_compute_root_blocks.get(node);
 
@@ -103,6 +111,26 @@ void Cache::memoize_blocks(const FunctionDAG::Node *node, LoopNest *new_root) {
     }
 }
 
+bool Cache::may_memoize_blocks(const State *state,
+                               const FunctionDAG &dag,
+                               const Adams2019Params &params) const {
+    if (!options.cache_blocks) {
+        return false;
+    }
+
+    // Tilings are only memoized when parallelizing a Func.
+    int phase = 0;
+    const FunctionDAG::Node *node = state->next_node(dag, params, &phase);
+    if (!node || phase == 0) {
+        return false;
+    }
+
+    // If we already have tilings for this vector dimension, the state
+    // will use those instead of making new ones.
+    return !(memoized_compute_root_blocks.contains(node) &&
+             memoized_compute_root_blocks.get(node).count(root_vector_dim(state->root.get(), node)));
+}
+
 }  // namespace Autoscheduler
 }  // namespace Internal
 }  // namespace Halide
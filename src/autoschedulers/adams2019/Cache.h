@@ -9,6 +9,8 @@
 #include "LoopNest.h"
 #include "PerfectHashMap.h"
 
+#include <atomic>
+
 namespace Halide {
 namespace Internal {
 namespace Autoscheduler {
@@ -35,17 +37,20 @@ namespace Autoscheduler {
     the featurizations of its children, and if called again, reuses those cached featurizations.
     The features are saved in a LoopNest's member, std::map<> features_cache. Some features do not
     persist, and the FeaturesIntermediates struct (see Featurization.h) is used to cache useful
-    values that aid in recomputing such features.
+    values that aid in recomputing such features. The working set of each child is cached
+    alongside its features (working_set_cache), so a reused child isn't walked at all.
 
   - LoopNest::compute_working_set_from_features
-    Used to re-compute the working_set from cached features.
+    Used to re-compute the working_set from cached features, if it wasn't cached too.
 
   - LoopNest::recompute_inlined_features
     Recursively recomputes the features of all inlined Funcs based on the cached FeaturesIntermediates
     struct.
 
   - LoopNest::compute_hash_of_producers_stored_at_root
-    Computes a structural hash for use in feature caching in a LoopNest.
+    Computes a structural hash for use in feature caching in a LoopNest. The edges into the
+    LoopNest that the hash starts from are found once per LoopNest (see
+    LoopNest::get_incoming_edges), so only the sites of the producers are looked at again.
 
   - LoopNest::collect_producers
     Collects all producers for a LoopNest for use in calculating the structural hash in
@@ -95,8 +100,8 @@ struct Cache {
     CachingOptions options;
     BlockCache memoized_compute_root_blocks;
 
-    mutable size_t cache_hits = 0;
-    mutable size_t cache_misses = 0;
+    mutable std::atomic<size_t> cache_hits{0};
+    mutable std::atomic<size_t> cache_misses{0};
 
     Cache() = delete;
     Cache(const CachingOptions &_options, size_t nodes_size)
@@ -121,6 +126,13 @@ struct Cache {
 
     // Generate tilings for a specific vector dimension and memoize them.
     void memoize_blocks(const FunctionDAG::Node *node, LoopNest *new_root);
+
+    // Check if generating the children of this state might memoize
+    // new tilings. States for which this is false only read the
+    // cache, so they can be expanded concurrently.
+    bool may_memoize_blocks(const State *state,
+                            const FunctionDAG &dag,
+                            const Adams2019Params &params) const;
 };
 
 }  // namespace Autoscheduler
@@ -20,6 +20,12 @@ struct Adams2019Params {
     /** Maximum level of parallelism available. */
     int parallelism = 16;
 
+    /** The number of instances of the pipeline that will run concurrently on the machine. If
+     * greater than one, optimize for throughput rather than for the latency of a single run:
+     * each instance gets an equal share of the cores, and the cost model sees each instance
+     * competing for the shared last-level cache and memory bandwidth with the others. */
+    int concurrent_instances = 1;
+
     /** Beam size to use in the beam search. Defaults to 32. Use 1 to get a greedy search instead.
      * Formerly HL_BEAM_SIZE */
     int beam_size = 32;
@@ -50,9 +56,30 @@ struct Adams2019Params {
      * Formerly HL_DISABLE_MEMOIZED_BLOCKS */
     int disable_memoized_blocks = 0;
 
-    /** If >= 0, only consider schedules that allocate at most this much memory (measured in bytes).
+    /** If >= 0, only consider schedules that allocate at most this much memory (measured in bytes)
+     * at once, counting the allocations of each thread running a parallel loop.
      * Formerly HL_AUTOSCHEDULE_MEMORY_LIMIT */
     int64_t memory_limit = -1;
+
+    /** If >= 0, only consider schedules in which each thread allocates at most this much memory
+     * (measured in bytes) at once within a parallel loop. Useful to keep the working set of each
+     * core within its share of the cache. */
+    int64_t thread_memory_limit = -1;
+
+    /** Number of threads to use to generate and featurize the children of the states in
+     * the beam. If 0, use one per core. The schedule found does not depend on this. */
+    int search_threads = 1;
+
+    /** If > 0, a wall-clock budget for the beam search, in seconds. Once it is
+     * spent, the pass in progress is finished greedily from the best state in
+     * its beam, no more passes start, and the best schedule found so far is used. */
+    double time_budget_s = 0;
+
+    /** If set, a directory in which to remember the schedules found, so that
+     * scheduling the same pipeline again replays the schedule instead of
+     * searching, and scheduling a similar one starts from it. Not used when
+     * random_dropout is less than 100. */
+    std::string schedule_database;
 };
 
 }  // namespace Autoscheduler
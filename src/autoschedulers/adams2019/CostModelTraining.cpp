@@ -0,0 +1,267 @@
+#include "CostModelTraining.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "NetworkSize.h"
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+using std::string;
+using std::vector;
+
+uint64_t hash_floats(uint64_t h, const float *begin, const float *end) {
+    while (begin != end) {
+        uint32_t bits = *((const uint32_t *)begin);
+        // From boost
+        h ^= (bits + 0x9e3779b9 + (h << 6) + (h >> 2));
+        begin++;
+    }
+    return h;
+}
+
+bool add_sample(SampleSet *samples, const float *data, size_t num_floats, const string &filename) {
+    const size_t features_per_stage = head2_w + (head1_w + 1) * head1_h;
+    if (num_floats < 3 || (num_floats - 3) % features_per_stage != 0) {
+        // We expect truncated files if the benchmarking or
+        // autoscheduling procedure crashes and want to filter them
+        // out with a warning.
+        std::cout << "Truncated sample: " << filename << " " << num_floats << "\n";
+        return false;
+    }
+    const size_t num_features = num_floats - 3;
+    const size_t num_stages = num_features / features_per_stage;
+    if (num_stages == 0) {
+        std::cout << "Empty sample: " << filename << "\n";
+        return false;
+    }
+
+    const float runtime = data[num_features];
+    if (!(runtime <= 100000)) {  // Don't try to predict runtime over 100s
+        std::cout << "Implausible runtime in ms: " << runtime << "\n";
+        return false;
+    }
+
+    int32_t pipeline_id, schedule_id;
+    memcpy(&pipeline_id, &data[num_features + 1], sizeof(pipeline_id));
+    memcpy(&schedule_id, &data[num_features + 2], sizeof(schedule_id));
+
+    PipelineSample &ps = (*samples)[pipeline_id];
+
+    if (ps.pipeline_features.data() == nullptr) {
+        ps.pipeline_id = pipeline_id;
+        ps.num_stages = (int)num_stages;
+        ps.pipeline_features = Runtime::Buffer<float>(head1_w, head1_h, num_stages);
+        for (size_t i = 0; i < num_stages; i++) {
+            for (int x = 0; x < head1_w; x++) {
+                for (int y = 0; y < head1_h; y++) {
+                    float f = data[i * features_per_stage + (x + 1) * 7 + y + head2_w];
+                    if (f < 0 || std::isnan(f)) {
+                        std::cout << "Negative or NaN pipeline feature: " << x << " " << y << " " << i << " " << f << "\n";
+                    }
+                    ps.pipeline_features(x, y, i) = f;
+                }
+            }
+        }
+
+        ps.pipeline_hash = hash_floats(0, ps.pipeline_features.begin(), ps.pipeline_features.end());
+    } else if (ps.num_stages != (int)num_stages) {
+        std::cout << "Sample has " << num_stages << " stages, but pipeline " << pipeline_id
+                  << " has " << ps.num_stages << ": " << filename << "\n";
+        return false;
+    }
+
+    uint64_t schedule_hash = 0;
+    for (size_t i = 0; i < num_stages; i++) {
+        schedule_hash =
+            hash_floats(schedule_hash,
+                        &data[i * features_per_stage],
+                        &data[i * features_per_stage + head2_w]);
+    }
+
+    auto it = ps.schedules.find(schedule_hash);
+    if (it != ps.schedules.end()) {
+        // Keep the smallest runtime at the front
+        float best = it->second.runtimes[0];
+        if (runtime < best) {
+            it->second.runtimes.push_back(best);
+            it->second.runtimes[0] = runtime;
+            it->second.filename = filename;
+            it->second.schedule_id = schedule_id;
+        } else {
+            it->second.runtimes.push_back(runtime);
+        }
+    } else {
+        Sample sample;
+        sample.filename = filename;
+        sample.runtimes.push_back(runtime);
+        sample.schedule_id = schedule_id;
+        sample.schedule_features = Runtime::Buffer<float>(head2_w, num_stages);
+
+        for (size_t i = 0; i < num_stages; i++) {
+            for (int x = 0; x < head2_w; x++) {
+                float f = data[i * features_per_stage + x];
+                if (f < 0 || f > 1e14 || std::isnan(f)) {
+                    // Something must have overflowed
+                    std::cout << "Negative or implausibly large schedule feature: " << i << " " << x << " " << f << "\n";
+                    return false;
+                }
+                sample.schedule_features(x, i) = f;
+            }
+        }
+        ps.schedules.emplace(schedule_hash, std::move(sample));
+    }
+    if (runtime < ps.fastest_runtime) {
+        ps.fastest_runtime = runtime;
+        ps.fastest_schedule_hash = schedule_hash;
+    }
+    return true;
+}
+
+bool load_sample(SampleSet *samples, const string &filename) {
+    // Far larger than any real featurization.
+    constexpr size_t max_floats = 10 * 1024 * 1024;
+
+    // Note we do not check file.fail(). The various failure cases are
+    // handled by add_sample by checking the number of floats read.
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    const std::streamoff bytes = file.tellg();
+    if (bytes < 0) {
+        std::cout << "Unable to read sample: " << filename << "\n";
+        return false;
+    }
+    const size_t num_floats = (size_t)bytes / sizeof(float);
+    if (num_floats > max_floats) {
+        std::cout << "Too-large sample: " << filename << " " << num_floats << "\n";
+        return false;
+    }
+    vector<float> data(num_floats);
+    file.seekg(0);
+    file.read((char *)data.data(), num_floats * sizeof(float));
+    data.resize(file.gcount() / sizeof(float));
+    return add_sample(samples, data.data(), data.size(), filename);
+}
+
+const Sample *fastest_sample(const SampleSet &samples) {
+    const Sample *best = nullptr;
+    for (const auto &p : samples) {
+        auto it = p.second.schedules.find(p.second.fastest_schedule_hash);
+        if (it != p.second.schedules.end() &&
+            (!best || it->second.runtimes[0] < best->runtimes[0])) {
+            best = &it->second;
+        }
+    }
+    return best;
+}
+
+EpochStats train_epoch(DefaultCostModel *model,
+                       SampleSet &training,
+                       SampleSet &validation,
+                       float learning_rate,
+                       int num_cores,
+                       size_t min_schedules,
+                       std::mt19937 &rng) {
+    EpochStats stats;
+    for (int train = 0; train < 2; train++) {
+        for (auto &p : train ? training : validation) {
+            PipelineSample &ps = p.second;
+            if (ps.schedules.size() < min_schedules) {
+                continue;
+            }
+            model->reset();
+            model->set_pipeline_features(ps.pipeline_features, num_cores);
+
+            const size_t batch_size = std::min((size_t)1024, ps.schedules.size());
+            Runtime::Buffer<float> runtimes((int)batch_size);
+
+            size_t first = 0;
+            if (ps.schedules.size() > 1024) {
+                first = rng() % (ps.schedules.size() - 1024);
+            }
+
+            auto it = ps.schedules.begin();
+            std::advance(it, first);
+            for (size_t j = 0; j < batch_size; j++, it++) {
+                Sample &sched = it->second;
+                Runtime::Buffer<float> buf;
+                model->enqueue(ps.num_stages, &buf, &sched.prediction);
+                runtimes((int)j) = sched.runtimes[0];
+                buf.copy_from(sched.schedule_features);
+            }
+
+            if (train) {
+                float loss = model->backprop(runtimes, learning_rate);
+                assert(!std::isnan(loss));
+                stats.loss_sum += loss;
+                stats.loss_count++;
+
+                auto it = ps.schedules.begin();
+                std::advance(it, first);
+                for (size_t j = 0; j < batch_size; j++, it++) {
+                    const Sample &sched = it->second;
+                    float m = sched.runtimes[0] / (sched.prediction + 1e-10f);
+                    if (m > stats.worst_miss) {
+                        stats.worst_miss = m;
+                        stats.worst_miss_pipeline_id = p.first;
+                        stats.worst_miss_schedule_hash = it->first;
+                    }
+                }
+            } else {
+                model->evaluate_costs();
+            }
+
+            int good = 0, bad = 0;
+            const Sample &ref = ps.schedules[ps.fastest_schedule_hash];
+            for (const auto &s : ps.schedules) {
+                const Sample &sched = s.second;
+                if (sched.prediction == 0) {
+                    continue;
+                }
+                assert(sched.runtimes[0] >= ref.runtimes[0]);
+                float runtime_ratio = sched.runtimes[0] / ref.runtimes[0];
+                if (runtime_ratio <= 1.3f) {
+                    continue;  // Within 30% of the runtime of the best
+                }
+                if (sched.prediction >= ref.prediction) {
+                    good++;
+                } else {
+                    if (train) {
+                        float badness = (sched.runtimes[0] - ref.runtimes[0]) * (ref.prediction - sched.prediction);
+                        badness /= (ref.runtimes[0] * ref.runtimes[0]);
+                        EpochStats::Inversion &worst = stats.worst_inversion;
+                        if (badness > worst.badness) {
+                            worst.pipeline_id = p.first;
+                            worst.badness = badness;
+                            worst.r1 = ref.runtimes[0];
+                            worst.r2 = sched.runtimes[0];
+                            worst.p1 = ref.prediction;
+                            worst.p2 = sched.prediction;
+                            worst.f1 = ref.filename;
+                            worst.f2 = sched.filename;
+                        }
+                    }
+                    bad++;
+                }
+            }
+            if (train) {
+                stats.good += good;
+                stats.bad += bad;
+            } else {
+                stats.validation_good += good;
+                stats.validation_bad += bad;
+            }
+        }
+    }
+    return stats;
+}
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
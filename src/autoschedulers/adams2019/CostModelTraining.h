@@ -0,0 +1,98 @@
+#ifndef ADAMS2019_COST_MODEL_TRAINING_H
+#define ADAMS2019_COST_MODEL_TRAINING_H
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DefaultCostModel.h"
+#include "HalideBuffer.h"
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+// Training the cost model on benchmarked schedules, shared by
+// adams2019_retrain_cost_model and the in-process autotuner.
+
+struct Sample {
+    std::vector<float> runtimes;  // in msec, with the smallest first
+    double prediction = 0;
+    std::string filename;
+    int32_t schedule_id = 0;
+    Runtime::Buffer<float> schedule_features;
+};
+
+struct PipelineSample {
+    int32_t pipeline_id = 0;
+    int32_t num_stages = 0;
+    Runtime::Buffer<float> pipeline_features;
+    std::map<uint64_t, Sample> schedules;  // keyed by a hash of the schedule features
+    uint64_t fastest_schedule_hash = 0;
+    float fastest_runtime = 1e30f;  // in msec
+    uint64_t pipeline_hash = 0;
+};
+
+// Keyed by pipeline id.
+using SampleSet = std::map<int, PipelineSample>;
+
+uint64_t hash_floats(uint64_t h, const float *begin, const float *end);
+
+// Add a sample in the layout of a .sample file: the featurization of each
+// stage, then the runtime in msec, the pipeline id, and the schedule
+// id. Samples that look damaged are rejected with a message on stdout,
+// and false is returned. Repeated schedules are merged, keeping all their
+// runtimes.
+bool add_sample(SampleSet *samples, const float *data, size_t num_floats, const std::string &filename);
+
+// Read a .sample file and add it as above.
+bool load_sample(SampleSet *samples, const std::string &filename);
+
+// The fastest schedule of all the pipelines, or nullptr if there are none.
+const Sample *fastest_sample(const SampleSet &samples);
+
+struct EpochStats {
+    float loss_sum = 0;
+    int loss_count = 0;
+
+    // Of the schedules more than 30% slower than the fastest of their
+    // pipeline, how many were predicted to be slower (good) or faster
+    // (bad), in the training and validation sets.
+    int good = 0, bad = 0;
+    int validation_good = 0, validation_bad = 0;
+
+    // The training sample whose runtime was most underestimated.
+    float worst_miss = 0;
+    int worst_miss_pipeline_id = 0;
+    uint64_t worst_miss_schedule_hash = 0;
+
+    // The pair of training samples most badly predicted to be the wrong
+    // way around.
+    struct Inversion {
+        int pipeline_id = 0;
+        std::string f1, f2;
+        float p1 = 0, p2 = 0;
+        float r1 = 0, r2 = 0;
+        float badness = 0;
+    } worst_inversion;
+};
+
+// Run one epoch of training over the pipelines with at least
+// min_schedules schedules: a batch of up to 1024 schedules of each
+// training pipeline is backpropagated, and those of each validation
+// pipeline just predicted.
+EpochStats train_epoch(DefaultCostModel *model,
+                       SampleSet &training,
+                       SampleSet &validation,
+                       float learning_rate,
+                       int num_cores,
+                       size_t min_schedules,
+                       std::mt19937 &rng);
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
+
+#endif  // ADAMS2019_COST_MODEL_TRAINING_H
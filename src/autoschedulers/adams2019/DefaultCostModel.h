@@ -65,6 +65,11 @@ public:
     // Save/Load the model weights to/from disk.
     void save_weights();
     void load_weights();
+
+    // A hash of the weights currently in use.
+    uint64_t weights_hash() const {
+        return weights.hash();
+    }
 };
 
 std::unique_ptr<DefaultCostModel> make_default_cost_model(const std::string &weights_in_dir = "",
@@ -379,6 +379,7 @@ void BoundContents::Layout::allocate_some_more() const {
 }
 
 BoundContents *BoundContents::Layout::make() const {
+    std::lock_guard<std::mutex> lock(mutex);
     if (pool.empty()) {
         allocate_some_more();
     }
@@ -390,6 +391,7 @@ BoundContents *BoundContents::Layout::make() const {
 
 void BoundContents::Layout::release(const BoundContents *b) const {
     internal_assert(b->layout == this) << "Releasing BoundContents onto the wrong pool!";
+    std::lock_guard<std::mutex> lock(mutex);
     b->~BoundContents();
     pool.push_back(const_cast<BoundContents *>(b));
     num_live--;
@@ -1092,6 +1094,15 @@ void FunctionDAG::dump(std::ostream &os) const {
     }
 }
 
+void FeaturizationProfile::dump(std::ostream &os) const {
+    os << "Featurized " << states << " states, time (ms):"
+       << " sites " << sites_ns / 1000000
+       << ", hashing " << hash_ns / 1000000
+       << ", features " << features_ns / 1000000 << "\n"
+       << "Loop nests at root reused from the features cache: " << nests_reused
+       << ", featurized: " << nests_featurized << "\n";
+}
+
 }  // namespace Autoscheduler
 }  // namespace Internal
 }  // namespace Halide
@@ -6,8 +6,10 @@
 #define FUNCTION_DAG_H
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 
@@ -319,9 +321,12 @@ struct BoundContents {
     // We're frequently going to need to make these concrete bounds
     // arrays.  It makes things more efficient if we figure out the
     // memory layout of those data structures once ahead of time, and
-    // make each individual instance just use that. Note that this is
-    // not thread-safe.
+    // make each individual instance just use that. The pool is
+    // guarded by a mutex, because states may be expanded on several
+    // threads at once during the beam search.
     class Layout {
+        mutable std::mutex mutex;
+
         // A memory pool of free BoundContent objects with this layout
         mutable std::vector<BoundContents *> pool;
 
@@ -362,6 +367,24 @@ struct BoundContents {
 
 using Bound = IntrusivePtr<const BoundContents>;
 
+// Where the time spent featurizing States goes, summed over all
+// threads of one search. Reported by generate_schedule.
+struct FeaturizationProfile {
+    // The number of States featurized.
+    std::atomic<int64_t> states{0};
+
+    // Nanoseconds spent finding the sites of every stage, hashing the
+    // producers of each loop nest at the root, and computing the
+    // features themselves.
+    std::atomic<int64_t> sites_ns{0}, hash_ns{0}, features_ns{0};
+
+    // The loop nests at the root whose features were taken from the
+    // features cache, and those that had to be featurized.
+    std::atomic<int64_t> nests_reused{0}, nests_featurized{0};
+
+    void dump(std::ostream &os) const;
+};
+
 // A representation of the function DAG. The nodes and edges are both
 // in reverse realization order, so if you want to walk backwards up
 // the DAG, just iterate the nodes or edges in-order.
@@ -569,6 +592,14 @@ struct FunctionDAG {
 
     void dump(std::ostream &os) const;
 
+    // Statistics of the search over this DAG: the number of times a
+    // cost is enqueued into the cost model, and where featurization
+    // time goes. They live here rather than in statics so that
+    // searches running concurrently in one process (e.g. from the
+    // autotuner) neither race on nor mix their numbers.
+    mutable std::atomic<int> cost_calculations{0};
+    mutable FeaturizationProfile featurization_profile;
+
 private:
     // Compute the featurization for the entire DAG
     void featurize();
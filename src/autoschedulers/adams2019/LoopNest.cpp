@@ -1,6 +1,10 @@
 #include "LoopNest.h"
 #include "Cache.h"
 
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
 using std::set;
 using std::vector;
 
@@ -113,7 +117,7 @@ void LoopNest::copy_from(const LoopNest &n) {
     children = n.children;
     inlined = n.inlined;
     store_at = n.store_at;
-    bounds = n.bounds;
+    bounds = n.copy_of_bounds();
     node = n.node;
     stage = n.stage;
     innermost = n.innermost;
@@ -316,33 +320,51 @@ void LoopNest::compute_features(const FunctionDAG &dag,
 
             if (use_cached_features) {
                 // Checks if the features cache has seen this state before, and use the cached features if so.
-                if (c->features_cache.count(hash_of_producers) > 0) {
-                    const auto &entry = c->features_cache.at(hash_of_producers);
-
-                    for (auto it = entry.begin(); it != entry.end(); it++) {
-                        const auto *stage_ptr = it.key();
-                        const auto &feat = it.value();
-
-                        features->insert(stage_ptr, feat);
+                bool cached = false, working_set_cached = false;
+                int64_t working_set_c{0};
+                {
+                    std::lock_guard<std::mutex> lock(c->features_cache_mutex);
+                    auto entry = c->features_cache.find(hash_of_producers);
+                    if (entry != c->features_cache.end()) {
+                        for (auto it = entry->second.begin(); it != entry->second.end(); it++) {
+                            const auto *stage_ptr = it.key();
+                            const auto &feat = it.value();
+
+                            features->insert(stage_ptr, feat);
+                        }
+                        cached = true;
+                        auto ws = c->working_set_cache.find(hash_of_producers);
+                        if (ws != c->working_set_cache.end()) {
+                            working_set_c = ws->second;
+                            working_set_cached = true;
+                        }
                     }
+                }
 
+                if (cached) {
                     // 'working_set_here' is required below for computing the
                     // root-level features so we compute the value that it
                     // would have had if the current loop nest had not been
                     // memoized
-                    int64_t working_set_c{0};
-                    c->compute_working_set_from_features(&working_set_c, features);
+                    if (!working_set_cached) {
+                        c->compute_working_set_from_features(&working_set_c, features);
+                    }
                     working_set_here += working_set_c;
+                    dag.featurization_profile.nests_reused++;
                     continue;  // no need to recompute fetures
                 }
             }
 
+            const int64_t working_set_before = working_set_here;
             c->compute_features(dag, params, sites, subinstances, parallelism, this, parent, root, &working_set_here, features, use_cached_features);
+            dag.featurization_profile.nests_featurized++;
 
             if (use_cached_features) {
                 // Cache these features for future reference.
+                std::lock_guard<std::mutex> lock(c->features_cache_mutex);
                 c->features_cache[hash_of_producers].make_large(dag.nodes[0].stages[0].max_id);
                 c->memoize_features(c->features_cache[hash_of_producers], features);
+                c->working_set_cache[hash_of_producers] = working_set_here - working_set_before;
             }
         }
 
@@ -425,6 +447,7 @@ void LoopNest::compute_features(const FunctionDAG &dag,
                 // may not have been computed when it is accessed as a memoized
                 // feature. We memoize 'points_computed_minimum' here to ensure
                 // its value is always available
+                std::lock_guard<std::mutex> lock(c->features_cache_mutex);
                 if (c->features_cache.count(hash_of_producers) > 0) {
                     c->memoize_points_computed_minimum(c->features_cache[hash_of_producers], features);
                 }
@@ -1000,6 +1023,7 @@ void LoopNest::compute_features(const FunctionDAG &dag,
         if (use_cached_features) {
             const auto &block = sites.get(stage).task;
             uint64_t hash_of_producers = sites.get(block->stage).hash_of_producers_stored_at_root;
+            std::lock_guard<std::mutex> lock(block->features_cache_mutex);
             auto &intermediate_map = block->feature_intermediates_cache[hash_of_producers].get_or_create(&(f->stages[0]));
             auto &intermediate = intermediate_map.get_or_create(stage);
 
@@ -1014,12 +1038,15 @@ void LoopNest::compute_features(const FunctionDAG &dag,
 // Get the region required of a Func at this site, from which we
 // know what region would be computed if it were scheduled here,
 // and what its loop nest would be.
-const Bound &LoopNest::get_bounds(const FunctionDAG::Node *f) const {
-    if (bounds.contains(f)) {
-        const Bound &b = bounds.get(f);
-        // Expensive validation for debugging
-        // b->validate();
-        return b;
+Bound LoopNest::get_bounds(const FunctionDAG::Node *f) const {
+    {
+        std::lock_guard<std::mutex> lock(bounds_mutex);
+        if (bounds.contains(f)) {
+            const Bound &b = bounds.get(f);
+            // Expensive validation for debugging
+            // b->validate();
+            return b;
+        }
     }
     auto *bound = f->make_bound();
 
@@ -1070,12 +1097,30 @@ const Bound &LoopNest::get_bounds(const FunctionDAG::Node *f) const {
         f->loop_nest_for_region(i, &(bound->region_computed(0)), &(bound->loops(i, 0)));
     }
 
-    const Bound &b = set_bounds(f, bound);
+    // Another thread may have computed the same bounds while we were
+    // working on them. If so, use theirs, so that everyone sees the same
+    // object, and let ours be released.
+    Bound computed(bound);
+    std::lock_guard<std::mutex> lock(bounds_mutex);
+    if (bounds.contains(f)) {
+        return bounds.get(f);
+    }
+    const Bound &b = bounds.emplace(f, std::move(computed));
     // Validation is expensive, turn if off by default.
     // b->validate();
     return b;
 }
 
+Bound LoopNest::set_bounds(const FunctionDAG::Node *f, BoundContents *b) const {
+    std::lock_guard<std::mutex> lock(bounds_mutex);
+    return bounds.emplace(f, b);
+}
+
+NodeMap<Bound> LoopNest::copy_of_bounds() const {
+    std::lock_guard<std::mutex> lock(bounds_mutex);
+    return bounds;
+}
+
 // Recursively print a loop nest representation to stderr
 void LoopNest::dump(std::ostream &os, string prefix, const LoopNest *parent) const {
     if (!is_root()) {
@@ -1163,6 +1208,100 @@ int64_t LoopNest::max_inlined_calls() const {
     return result;
 }
 
+int64_t LoopNest::peak_memory(const Adams2019Params &params, int64_t *per_thread) const {
+    // The children in the order they run: the nodes are in reverse
+    // realization order, and the stages of each node in order.
+    vector<const LoopNest *> order;
+    for (const auto &c : children) {
+        order.push_back(c.get());
+    }
+    std::stable_sort(order.begin(), order.end(), [](const LoopNest *a, const LoopNest *b) {
+        return a->node->id > b->node->id ||
+               (a->node->id == b->node->id && a->stage->index < b->stage->index);
+    });
+
+    // Funcs stored here are allocated for each iteration of this loop,
+    // but are only live from the child that computes them up to the
+    // last child that computes or calls them. Lowering frees them
+    // after their last use, and allocates them where they are first
+    // produced.
+    struct Lifetime {
+        double bytes;
+        int first, last;
+    };
+    vector<Lifetime> lifetimes;
+    for (const auto *n : store_at) {
+        if (n->is_output) {
+            // Not allocated by this pipeline
+            continue;
+        }
+        const auto &bounds = get_bounds(n);
+        Lifetime l{(double)n->bytes_per_point, -1, (int)order.size() - 1};
+        for (int i = 0; i < n->dimensions; i++) {
+            l.bytes *= bounds->region_computed(i).extent();
+        }
+        int last_use = -1;
+        for (int i = 0; i < (int)order.size(); i++) {
+            if (order[i]->computes(n)) {
+                if (l.first < 0) {
+                    l.first = i;
+                }
+                last_use = i;
+            } else if (order[i]->calls(n)) {
+                last_use = i;
+            }
+        }
+        if (l.first >= 0) {
+            l.last = std::max(l.first, last_use);
+        } else {
+            // Computed at no child, so assume it is live throughout.
+            l.first = 0;
+        }
+        lifetimes.push_back(l);
+    }
+
+    if (order.empty()) {
+        double bytes = 0;
+        for (const auto &l : lifetimes) {
+            bytes += l.bytes;
+        }
+        return (int64_t)std::min(bytes, (double)std::numeric_limits<int64_t>::max());
+    }
+
+    // The children run one after the other, and each frees what it
+    // stores before the next one starts.
+    double peak = 0;
+    if (is_root() && per_thread) {
+        *per_thread = 0;
+    }
+    for (int i = 0; i < (int)order.size(); i++) {
+        const LoopNest *c = order[i];
+        double in_child = (double)c->peak_memory(params, nullptr);
+        if (is_root()) {
+            if (per_thread) {
+                *per_thread = std::max(*per_thread, (int64_t)in_child);
+            }
+            int64_t parallel_tasks = 1;
+            for (int idx = (int)c->size.size() - 1; idx >= 0; idx--) {
+                if (c->stage->loop[idx].pure) {
+                    parallel_tasks *= c->size[idx];
+                } else if (c->size[idx] != 1) {
+                    break;
+                }
+            }
+            in_child *= (double)std::min(parallel_tasks, (int64_t)std::max(params.parallelism, 1));
+        }
+        for (const auto &l : lifetimes) {
+            if (l.first <= i && i <= l.last) {
+                in_child += l.bytes;
+            }
+        }
+        peak = std::max(peak, in_child);
+    }
+
+    return (int64_t)std::min(peak, (double)std::numeric_limits<int64_t>::max());
+}
+
 // Does this loop nest access an input buffer? Used to select
 // trail strategies when splitting loops. We don't want to read
 // out of bounds on inputs, even if we don't intend to use the
@@ -1365,7 +1504,7 @@ IntrusivePtr<const LoopNest> LoopNest::parallelize_in_tiles(const Adams2019Param
     inner->innermost = innermost;
     inner->children = children;
     inner->inlined = inlined;
-    inner->bounds = bounds;
+    inner->bounds = copy_of_bounds();
     inner->store_at = store_at;
 
     auto *b = inner->get_bounds(node)->make_copy();
@@ -1539,7 +1678,7 @@ vector<IntrusivePtr<const LoopNest>> LoopNest::compute_in_tiles(const FunctionDA
             inner->innermost = innermost;
             inner->children = children;
             inner->inlined = inlined;
-            inner->bounds = bounds;
+            inner->bounds = copy_of_bounds();
             inner->store_at = store_at;
 
             {
@@ -1950,7 +2089,7 @@ void LoopNest::copy_from_including_features(const LoopNest &n) {
     children = n.children;
     inlined = n.inlined;
     store_at = n.store_at;
-    bounds = n.bounds;
+    bounds = n.copy_of_bounds();
     node = n.node;
     stage = n.stage;
     innermost = n.innermost;
@@ -1958,7 +2097,9 @@ void LoopNest::copy_from_including_features(const LoopNest &n) {
     parallel = n.parallel;
     vector_dim = n.vector_dim;
     vectorized_loop_index = n.vectorized_loop_index;
+    std::lock_guard<std::mutex> lock(n.features_cache_mutex);
     features_cache = n.features_cache;
+    working_set_cache = n.working_set_cache;
     feature_intermediates_cache = n.feature_intermediates_cache;
 }
 
@@ -2033,6 +2174,7 @@ void LoopNest::recompute_inlined_features(const StageMap<Sites> &sites, StageMap
         internal_assert(sites.contains(block->stage));
         uint64_t hash_of_producers = sites.get(block->stage).hash_of_producers_stored_at_root;
 
+        std::lock_guard<std::mutex> lock(block->features_cache_mutex);
         internal_assert(block->feature_intermediates_cache.count(hash_of_producers) > 0);
         auto &intermediate_map = block->feature_intermediates_cache[hash_of_producers].get(&(f->stages[0]));
         auto &intermediate = intermediate_map.get(stage);
@@ -2069,16 +2211,7 @@ uint64_t LoopNest::compute_hash_of_producers_stored_at_root(const StageMap<Sites
 }
 
 vector<pair<int, int>> LoopNest::collect_producers(const StageMap<Sites> &sites) const {
-    set<const FunctionDAG::Node::Stage *> stages;
-    collect_stages(stages);
-
-    vector<const FunctionDAG::Edge *> pending;
-
-    for (const auto *stage : stages) {
-        for (const auto *e : stage->incoming_edges) {
-            pending.push_back(e);
-        }
-    }
+    vector<const FunctionDAG::Edge *> pending = get_incoming_edges();
 
     set<const FunctionDAG::Node *> done;
     vector<pair<int, int>> producers;
@@ -2110,6 +2243,31 @@ vector<pair<int, int>> LoopNest::collect_producers(const StageMap<Sites> &sites)
     return producers;
 }
 
+const vector<const FunctionDAG::Edge *> &LoopNest::get_incoming_edges() const {
+    {
+        std::lock_guard<std::mutex> lock(features_cache_mutex);
+        if (incoming_edges_known) {
+            return incoming_edges;
+        }
+    }
+
+    set<const FunctionDAG::Node::Stage *> stages;
+    collect_stages(stages);
+    vector<const FunctionDAG::Edge *> edges;
+    for (const auto *stage : stages) {
+        for (const auto *e : stage->incoming_edges) {
+            edges.push_back(e);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(features_cache_mutex);
+    if (!incoming_edges_known) {
+        incoming_edges = std::move(edges);
+        incoming_edges_known = true;
+    }
+    return incoming_edges;
+}
+
 void LoopNest::collect_stages(std::set<const FunctionDAG::Node::Stage *> &stages) const {
     stages.insert(stage);
 
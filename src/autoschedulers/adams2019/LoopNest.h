@@ -8,7 +8,9 @@
 
 #include "FunctionDAG.h"
 #include "PerfectHashMap.h"
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <set>
 #include <utility>
 #include <vector>
@@ -50,9 +52,16 @@ struct LoopNest {
 
     // The total bounds required of any given Func over all iterations
     // of this loop. In the paper, this is represented using the
-    // little boxes to the left of the loop nest tree figures.
+    // little boxes to the left of the loop nest tree figures. Filled
+    // in lazily by get_bounds. Loop nests are shared between states,
+    // which may be expanded on several threads at once, so only touch
+    // this through the accessors below.
     mutable NodeMap<Bound> bounds;
 
+    // Guards bounds. Each loop nest has its own, so that threads
+    // expanding different states rarely wait on each other.
+    mutable std::mutex bounds_mutex;
+
     // The Func this loop nest belongs to
     const FunctionDAG::Node *node = nullptr;
 
@@ -145,14 +154,16 @@ struct LoopNest {
     }
 
     // Set the region required of a Func at this site.
-    const Bound &set_bounds(const FunctionDAG::Node *f, BoundContents *b) const {
-        return bounds.emplace(f, b);
-    }
+    Bound set_bounds(const FunctionDAG::Node *f, BoundContents *b) const;
 
     // Get the region required of a Func at this site, from which we
     // know what region would be computed if it were scheduled here,
-    // and what its loop nest would be.
-    const Bound &get_bounds(const FunctionDAG::Node *f) const;
+    // and what its loop nest would be. Returned by value, because
+    // another thread may add to the bounds of this site concurrently.
+    Bound get_bounds(const FunctionDAG::Node *f) const;
+
+    // A copy of all the bounds computed at this site so far.
+    NodeMap<Bound> copy_of_bounds() const;
 
     // Recursively print a loop nest representation to stderr
     void dump(std::ostream &os, string prefix, const LoopNest *parent) const;
@@ -165,6 +176,16 @@ struct LoopNest {
     // generate too much code.
     int64_t max_inlined_calls() const;
 
+    // Estimate the most memory the pipeline allocates at once within
+    // one iteration of this loop, not counting its outputs. Each Func
+    // stored here counts only while it is live, from the child that
+    // computes it to the last child that uses it. At the
+    // root, the outermost pure loops of each Func computed at root are
+    // assumed to run on up to params.parallelism threads, as in
+    // compute_features, and the most memory any one of those threads
+    // allocates at once is stored in *per_thread.
+    int64_t peak_memory(const Adams2019Params &params, int64_t *per_thread) const;
+
     // Does this loop nest access an input buffer? Used to select
     // trail strategies when splitting loops. We don't want to read
     // out of bounds on inputs, even if we don't intend to use the
@@ -265,6 +286,20 @@ struct LoopNest {
     mutable std::map<uint64_t, StageMap<StageMap<FeatureIntermediates>>> feature_intermediates_cache;
     // hash of producers -> StageMap
     mutable std::map<uint64_t, StageMap<ScheduleFeatures>> features_cache;
+    // hash of producers -> working set of this loop nest, given the
+    // cached features above
+    mutable std::map<uint64_t, int64_t> working_set_cache;
+
+    // The edges into the stages in this loop nest. These only depend on
+    // the structure of the loop nest, which never changes once it is
+    // shared, so they are found once and reused by every State the loop
+    // nest is part of.
+    mutable std::vector<const FunctionDAG::Edge *> incoming_edges;
+    mutable bool incoming_edges_known = false;
+
+    // Guards the three feature caches and the incoming edges above,
+    // which are filled in lazily by whichever thread first needs them.
+    mutable std::mutex features_cache_mutex;
 
     // Same as copy_from (above) but also copies the two caches.
     void copy_from_including_features(const LoopNest &n);
@@ -291,6 +326,9 @@ struct LoopNest {
     // Gather all stages that are producers for any Func in this LoopNest.
     std::vector<std::pair<int, int>> collect_producers(const StageMap<Sites> &sites) const;
 
+    // The edges into the stages in this LoopNest. Computed on first use.
+    const std::vector<const FunctionDAG::Edge *> &get_incoming_edges() const;
+
     // Collect all stages referenced in this LoopNest.
     void collect_stages(std::set<const FunctionDAG::Node::Stage *> &stages) const;
 };
@@ -0,0 +1,243 @@
+#include "ScheduleDatabase.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "ASLog.h"
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+namespace {
+
+// Bump this whenever the file format or the meaning of the keys or
+// hashes changes, so that stale entries are ignored.
+constexpr int database_version = 1;
+
+// Deep enough to cover every level of any loop nest.
+constexpr int exact_hash_depth = 1 << 16;
+
+// FNV-1a, so that keys are stable across builds and platforms.
+void hash_bytes(uint64_t &h, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+}
+
+void hash_string(uint64_t &h, const std::string &s) {
+    hash_bytes(h, s.data(), s.size());
+    // Separate consecutive strings.
+    hash_bytes(h, "", 1);
+}
+
+template<typename T>
+void hash_value(uint64_t &h, T value) {
+    hash_bytes(h, &value, sizeof(value));
+}
+
+bool read_entry(const std::string &path, ScheduleDatabaseEntry *entry) {
+    std::ifstream in(path);
+    std::string magic;
+    int version = 0;
+    in >> magic >> version;
+    if (!in || magic != "adams2019_schedule" || version != database_version) {
+        return false;
+    }
+
+    std::string field;
+    size_t num_funcs = 0, num_decisions = 0;
+    in >> field >> std::hex >> entry->key >> std::dec;
+    if (field != "key") {
+        return false;
+    }
+    in >> field >> std::ws;
+    if (field != "target") {
+        return false;
+    }
+    std::getline(in, entry->target);
+    in >> field >> entry->cost;
+    if (field != "cost") {
+        return false;
+    }
+    in >> field >> num_funcs >> std::ws;
+    if (field != "funcs") {
+        return false;
+    }
+    entry->funcs.resize(num_funcs);
+    for (auto &f : entry->funcs) {
+        std::getline(in, f);
+    }
+    in >> field >> num_decisions;
+    if (field != "decisions") {
+        return false;
+    }
+    entry->decisions.resize(num_decisions);
+    in >> std::hex;
+    for (auto &d : entry->decisions) {
+        in >> d.hash >> d.coarse_hash;
+    }
+    return !in.fail();
+}
+
+}  // namespace
+
+ScheduleDecision ScheduleDecision::of(const State &state) {
+    ScheduleDecision d;
+    d.hash = state.structural_hash(exact_hash_depth);
+    d.coarse_hash = state.structural_hash(1);
+    return d;
+}
+
+bool ScheduleDecision::matches(const State &state) const {
+    return state.structural_hash(exact_hash_depth) == hash;
+}
+
+bool ScheduleDecision::roughly_matches(const State &state) const {
+    return state.structural_hash(1) == coarse_hash;
+}
+
+ScheduleDatabase::ScheduleDatabase(const std::string &dir)
+    : dir(dir) {
+}
+
+uint64_t ScheduleDatabase::key(const FunctionDAG &dag, const Target &target, const Adams2019Params &params,
+                               uint64_t weights_hash) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    hash_value(h, database_version);
+
+    // The dump covers the Funcs, their symbolic regions and loop bounds
+    // (with the estimates of any Params substituted in), the
+    // featurization of each stage, and the footprints of each edge.
+    std::ostringstream dump;
+    dag.dump(dump);
+    hash_string(h, dump.str());
+
+    // The concrete estimates of the outputs aren't part of the dump.
+    for (const auto &n : dag.nodes) {
+        for (const auto &s : n.estimated_region_required) {
+            hash_value(h, s.min());
+            hash_value(h, s.max());
+            hash_value(h, s.constant_extent());
+        }
+        hash_value(h, n.bytes_per_point);
+    }
+
+    hash_string(h, target.to_string());
+
+    // The params that change the search space or how it is searched. The
+    // caching and threading params don't change the result.
+    hash_value(h, params.parallelism);
+    hash_value(h, params.concurrent_instances);
+    hash_value(h, params.beam_size);
+    hash_value(h, params.disable_subtiling);
+    hash_value(h, params.memory_limit);
+    hash_value(h, params.thread_memory_limit);
+    // The weights themselves rather than their path, which stays the same
+    // when they are retrained.
+    hash_value(h, weights_hash);
+    return h;
+}
+
+ScheduleDatabaseEntry ScheduleDatabase::make_entry(uint64_t key, const FunctionDAG &dag, const Target &target,
+                                                   const State &optimal) {
+    ScheduleDatabaseEntry entry;
+    entry.key = key;
+    entry.target = target.to_string();
+    for (const auto &n : dag.nodes) {
+        entry.funcs.push_back(n.func.name());
+    }
+    entry.cost = optimal.cost;
+    for (const State *s = &optimal; s->parent.defined(); s = s->parent.get()) {
+        entry.decisions.push_back(ScheduleDecision::of(*s));
+    }
+    std::reverse(entry.decisions.begin(), entry.decisions.end());
+    return entry;
+}
+
+std::string ScheduleDatabase::path_for(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".schedule";
+    return (std::filesystem::path(dir) / name.str()).string();
+}
+
+bool ScheduleDatabase::lookup(uint64_t key, ScheduleDatabaseEntry *entry) const {
+    return read_entry(path_for(key), entry) && entry->key == key;
+}
+
+bool ScheduleDatabase::find_nearest(const FunctionDAG &dag, const Target &target, ScheduleDatabaseEntry *entry) const {
+    std::set<std::string> funcs;
+    for (const auto &n : dag.nodes) {
+        funcs.insert(n.func.name());
+    }
+    const std::string target_str = target.to_string();
+
+    std::error_code ec;
+    size_t best_shared = 0;
+    for (const auto &f : std::filesystem::directory_iterator(dir, ec)) {
+        if (f.path().extension() != ".schedule") {
+            continue;
+        }
+        ScheduleDatabaseEntry candidate;
+        if (!read_entry(f.path().string(), &candidate) || candidate.target != target_str) {
+            continue;
+        }
+        size_t shared = 0;
+        for (const auto &name : candidate.funcs) {
+            shared += funcs.count(name);
+        }
+        if (shared * 2 >= funcs.size() && shared > best_shared) {
+            best_shared = shared;
+            *entry = std::move(candidate);
+        }
+    }
+    return best_shared > 0;
+}
+
+void ScheduleDatabase::insert(const ScheduleDatabaseEntry &entry) const {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    // Write to a temporary file and rename it into place, so that
+    // concurrent builds sharing the database never see partial entries.
+    const std::string path = path_for(entry.key);
+    const std::string tmp_path = path + ".tmp" + std::to_string(std::random_device()());
+    {
+        std::ofstream out(tmp_path);
+        out << "adams2019_schedule " << database_version << "\n"
+            << "key " << std::hex << entry.key << std::dec << "\n"
+            << "target " << entry.target << "\n"
+            << "cost " << std::setprecision(17) << entry.cost << "\n"
+            << "funcs " << entry.funcs.size() << "\n";
+        for (const auto &f : entry.funcs) {
+            out << f << "\n";
+        }
+        out << "decisions " << entry.decisions.size() << "\n"
+            << std::hex;
+        for (const auto &d : entry.decisions) {
+            out << d.hash << " " << d.coarse_hash << "\n";
+        }
+        out.close();
+        if (out.fail()) {
+            aslog(1) << "Unable to write to the schedule database in " << dir << "\n";
+            std::filesystem::remove(tmp_path, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        aslog(1) << "Unable to add to the schedule database in " << dir << ": " << ec.message() << "\n";
+        std::filesystem::remove(tmp_path, ec);
+    }
+}
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
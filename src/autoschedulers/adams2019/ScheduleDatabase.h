@@ -0,0 +1,103 @@
+#ifndef SCHEDULE_DATABASE_H
+#define SCHEDULE_DATABASE_H
+
+#include "CostModel.h"
+#include "FunctionDAG.h"
+#include "Halide.h"
+#include "State.h"
+
+#include <string>
+#include <vector>
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+/*
+  A persistent store of the schedules found by the beam search, so that
+  rebuilding a Generator whose algorithm, estimates and target have not
+  changed doesn't search again. Enabled by setting the schedule_database
+  param to a directory, which may be shared between builds.
+
+  A schedule is stored as the sequence of decisions the search made to
+  reach it, with each decision identified by structural hashes of the
+  State it led to. Replaying the decisions only needs the children of one
+  State per decision, and none of them to be evaluated by the cost model.
+
+  Entries are keyed by a hash of everything the search depends on: the
+  FunctionDAG (its Funcs, their loop bounds, featurization and
+  footprints, with the estimates applied), the output estimates, the
+  target, the params that shape the search space, and the weights of the
+  cost model (so that retraining the weights in place invalidates the
+  entries). When there is no
+  entry for a pipeline, the entry for the same target that shares the
+  most Funcs with it (if it shares at least half) is used to warm-start
+  the search instead. See optimal_schedule_pass.
+*/
+
+// One decision on the way to a schedule.
+struct ScheduleDecision {
+    // The structural hash of the State the decision led to, covering the
+    // entire loop nest. Used to replay the decision exactly.
+    uint64_t hash = 0;
+
+    // The structural hash covering only what is at the root and whether
+    // its loops are trivial. Used to follow the decision approximately
+    // when warm-starting the search for a slightly different pipeline.
+    uint64_t coarse_hash = 0;
+
+    // Describe the decision that led to the given State.
+    static ScheduleDecision of(const State &state);
+
+    // Whether the given State matches the decision, either exactly or
+    // approximately.
+    bool matches(const State &state) const;
+    bool roughly_matches(const State &state) const;
+};
+
+struct ScheduleDatabaseEntry {
+    uint64_t key = 0;
+    std::string target;
+    // The names of the Funcs in the pipeline.
+    std::vector<std::string> funcs;
+    // The cost of the schedule according to the cost model that found it.
+    double cost = 0;
+    std::vector<ScheduleDecision> decisions;
+};
+
+class ScheduleDatabase {
+public:
+    explicit ScheduleDatabase(const std::string &dir);
+
+    // Compute the key for scheduling a pipeline with some target and params,
+    // using a cost model with weights that have the given hash (see
+    // Weights::hash()).
+    static uint64_t key(const FunctionDAG &dag, const Target &target, const Adams2019Params &params,
+                        uint64_t weights_hash);
+
+    // Describe the schedule a search ended in.
+    static ScheduleDatabaseEntry make_entry(uint64_t key, const FunctionDAG &dag, const Target &target,
+                                            const State &optimal);
+
+    // Look up the entry with the given key. Returns false if there isn't one.
+    bool lookup(uint64_t key, ScheduleDatabaseEntry *entry) const;
+
+    // Find the entry for the same target that shares the most Funcs with
+    // the given pipeline. Returns false if no entry shares at least half.
+    bool find_nearest(const FunctionDAG &dag, const Target &target, ScheduleDatabaseEntry *entry) const;
+
+    // Add an entry, replacing any entry with the same key. Failure to
+    // write the database is logged and otherwise ignored.
+    void insert(const ScheduleDatabaseEntry &entry) const;
+
+private:
+    std::string dir;
+
+    std::string path_for(uint64_t key) const;
+};
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
+
+#endif  // SCHEDULE_DATABASE_H
@@ -1,4 +1,5 @@
 #include "State.h"
+#include "Timer.h"
 
 namespace Halide {
 namespace Internal {
@@ -16,6 +17,13 @@ uint64_t State::structural_hash(int depth) const {
 
 void State::compute_featurization(const FunctionDAG &dag, const Adams2019Params &params,
                                   StageMap<ScheduleFeatures> *features, const CachingOptions &cache_options) {
+    auto &profile = dag.featurization_profile;
+    auto nanoseconds = [](const Timer &timer) {
+        return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(timer.elapsed()).count();
+    };
+    profile.states++;
+    Timer timer;
+
     StageMap<LoopNest::Sites> sites;
     sites.make_large(dag.nodes[0].stages[0].max_id);
     features->make_large(dag.nodes[0].stages[0].max_id);
@@ -75,14 +83,20 @@ void State::compute_featurization(const FunctionDAG &dag, const Adams2019Params
         }
     }
 
+    profile.sites_ns += nanoseconds(timer);
+
     if (cache_options.cache_features) {
+        timer.restart();
         // Store unique hashes for each Site, to be used as keys into cache
         for (const auto &c : root->children) {
             sites.get(c->stage).hash_of_producers_stored_at_root = c->compute_hash_of_producers_stored_at_root(sites);
         }
+        profile.hash_ns += nanoseconds(timer);
     }
 
+    timer.restart();
     root->compute_features(dag, params, sites, 1, 1, nullptr, nullptr, *root, nullptr, features, cache_options.cache_features);
+    profile.features_ns += nanoseconds(timer);
 
     for (const auto &n : dag.nodes) {
         if (sites.get(&(n.stages[0])).produce == nullptr) {
@@ -123,11 +137,34 @@ void State::save_featurization(const FunctionDAG &dag, const Adams2019Params &pa
     }
 }
 
+void State::model_concurrent_instances(const Adams2019Params &params, StageMap<ScheduleFeatures> *features) {
+    const double k = params.concurrent_instances;
+    for (auto it = features->begin(); it != features->end(); it++) {
+        auto &feat = it.value();
+        // The other instances' working sets compete for the shared
+        // cache, so a working set behaves as if it were k times larger
+        // than it would be on an idle machine.
+        feat.working_set *= k;
+        feat.working_set_at_task *= k;
+        feat.working_set_at_production *= k;
+        feat.working_set_at_realization *= k;
+        feat.working_set_at_root *= k;
+        // The data a task brings in mostly comes from beyond the
+        // private caches, over memory bandwidth that the instances
+        // share, so it costs as much as k times as much to fetch.
+        feat.unique_bytes_read_per_task *= k;
+        feat.unique_lines_read_per_task *= k;
+    }
+}
+
 bool State::calculate_cost(const FunctionDAG &dag, const Adams2019Params &params,
                            CostModel *cost_model, const CachingOptions &cache_options,
                            int verbosity) {
     StageMap<ScheduleFeatures> features;
     compute_featurization(dag, params, &features, cache_options);
+    if (params.concurrent_instances > 1) {
+        model_concurrent_instances(params, &features);
+    }
 
     cost = 0.0f;
 
@@ -159,17 +196,12 @@ bool State::calculate_cost(const FunctionDAG &dag, const Adams2019Params &params
         return false;
     }
 
-    // Apply the hard limit on memory use
-    if (params.memory_limit >= 0) {
-        int64_t mem_used = (int64_t)features.begin().value().working_set_at_root;
-        for (auto it = features.begin(); it != features.end(); it++) {
-            if (it.key()->node->is_output ||
-                it.key()->node->is_input) {
-                // Not allocated by this pipeline
-                mem_used -= it.value().bytes_at_production;
-            }
-        }
-        if (mem_used > params.memory_limit) {
+    // Apply the hard limits on memory use
+    if (params.memory_limit >= 0 || params.thread_memory_limit >= 0) {
+        int64_t per_thread = 0;
+        int64_t mem_used = root->peak_memory(params, &per_thread);
+        if ((params.memory_limit >= 0 && mem_used > params.memory_limit) ||
+            (params.thread_memory_limit >= 0 && per_thread > params.thread_memory_limit)) {
             cost = 1e50;
             return false;
         }
@@ -181,7 +213,7 @@ bool State::calculate_cost(const FunctionDAG &dag, const Adams2019Params &params
     // batched.
     cost_model->enqueue(dag, features, &cost);
 
-    cost_calculations++;
+    dag.cost_calculations++;
     return true;
 }
 
@@ -198,6 +230,27 @@ IntrusivePtr<State> State::make_child() const {
     return s;
 }
 
+const FunctionDAG::Node *State::next_node(const FunctionDAG &dag,
+                                          const Adams2019Params &params,
+                                          int *phase) const {
+    if (num_decisions_made == 2 * (int)dag.nodes.size()) {
+        return nullptr;
+    }
+
+    int node_idx = num_decisions_made / 2;
+    *phase = num_decisions_made % 2;
+
+    if (params.disable_subtiling) {
+        // When emulating the older search space, we do all
+        // parallelizing last, so that it is independent of the
+        // tiling decisions.
+        node_idx = num_decisions_made % dag.nodes.size();
+        *phase = num_decisions_made / dag.nodes.size();
+    }
+
+    return &dag.nodes[node_idx];
+}
+
 // Generate the successor states to this state
 void State::generate_children(const FunctionDAG &dag,
                               const Adams2019Params &params,
@@ -207,23 +260,13 @@ void State::generate_children(const FunctionDAG &dag,
 
     internal_assert(root.defined() && root->is_root()) << "generate_children needs defined root\n";
 
-    if (num_decisions_made == 2 * (int)dag.nodes.size()) {
+    int phase = 0;
+    const FunctionDAG::Node *node = next_node(dag, params, &phase);
+    if (!node) {
         return;
     }
 
-    int next_node = num_decisions_made / 2;
-    int phase = num_decisions_made % 2;
-
-    if (params.disable_subtiling) {
-        // When emulating the older search space, we do all
-        // parallelizing last, so that it is independent of the
-        // tiling decisions.
-        next_node = num_decisions_made % dag.nodes.size();
-        phase = num_decisions_made / dag.nodes.size();
-    }
-
     // Enumerate all legal ways to schedule the next Func
-    const FunctionDAG::Node *node = &dag.nodes[next_node];
     for (const auto *e : node->outgoing_edges) {
         internal_assert(root->computes(e->consumer->node))
             << "Partially scheduled code doesn't compute " << e->consumer->name
@@ -686,9 +729,6 @@ void State::apply_schedule(const FunctionDAG &dag, const Adams2019Params &params
     }
 }
 
-// Keep track of how many times we evaluated a state.
-int State::cost_calculations = 0;
-
 }  // namespace Autoscheduler
 }  // namespace Internal
 }  // namespace Halide
@@ -9,6 +9,7 @@
 #include "Halide.h"
 #include "LoopNest.h"
 #include "PerfectHashMap.h"
+#include <atomic>
 #include <map>
 #include <utility>
 
@@ -35,10 +36,6 @@ struct State {
     // Computed if `apply_schedule` is called.
     string schedule_source;
 
-    // The number of times a cost is enqueued into the cost model,
-    // for all states.
-    static int cost_calculations;
-
     State() = default;
     State(const State &) = delete;
     State(State &&) = delete;
@@ -62,6 +59,14 @@ struct State {
                             const CachingOptions &cache_options,
                             std::ostream &out);
 
+    // Adjust features computed for an idle machine to account for
+    // params.concurrent_instances - 1 other instances of the pipeline
+    // running alongside this one. Only the cost model sees the adjusted
+    // features; saved featurizations are left as they are, so that they
+    // can be paired with runtimes measured on an idle machine.
+    static void model_concurrent_instances(const Adams2019Params &params,
+                                           StageMap<ScheduleFeatures> *features);
+
     // Performs some pruning to decide if this state is worth queuing in
     // the cost_model. If it is, calls `cost_model->enqueue` and returns true,
     // otherwise sets `cost` equal to a large value and returns false.
@@ -75,6 +80,14 @@ struct State {
     // operation.
     IntrusivePtr<State> make_child() const;
 
+    // The Func the next decision is about. Sets phase to 0 if the
+    // decision is where to compute it, or 1 if it is how to
+    // parallelize it. Returns nullptr if all decisions have been
+    // made.
+    const FunctionDAG::Node *next_node(const FunctionDAG &dag,
+                                       const Adams2019Params &params,
+                                       int *phase) const;
+
     // Generate the successor states to this state.
     // If they are not pruned by `calculate_cost()`,
     // then calls `accept_child()` on them.
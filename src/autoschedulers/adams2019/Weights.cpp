@@ -1,6 +1,7 @@
 #include <fstream>
 #include <iostream>
 #include <random>
+#include <sstream>
 
 #include "Featurization.h"
 #include "HalideBuffer.h"
@@ -24,6 +25,19 @@ void Weights::randomize(uint32_t seed) {
     });
 }
 
+uint64_t Weights::hash() const {
+    std::ostringstream o;
+    save(o);
+    const std::string data = o.str();
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char c : data) {
+        h ^= (uint8_t)c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
 /*
     Structure of the .weights file format:
 
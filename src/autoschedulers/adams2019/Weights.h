@@ -37,6 +37,9 @@ struct Weights {
 
     void randomize(uint32_t seed);
 
+    // A hash of the versions and the values of the weights.
+    uint64_t hash() const;
+
     bool load(std::istream &i);
     bool save(std::ostream &o) const;
 
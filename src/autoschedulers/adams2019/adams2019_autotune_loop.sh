@@ -1,5 +1,9 @@
 #!/bin/bash
 
+# Note that the adams2019_autotune library (Autotune.h) does the same
+# thing in-process, without spawning a generator, compiler and benchmark
+# per sample; link AutotuneMain.cpp with your Generator to use it.
+
 # Build the generator to autotune. This script will be autotuning the
 # autoscheduler's cost model training pipeline, which is large enough
 # to be interesting.
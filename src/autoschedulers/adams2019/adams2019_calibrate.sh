@@ -0,0 +1,79 @@
+#!/bin/bash
+
+# Measure how well the cost model ranks schedules on this machine. For
+# each app, this runs a batch of adams2019_autotune_loop.sh to sample and
+# benchmark some schedules, predicts their runtimes with the weights
+# given, and then reports the rank correlation between the predictions
+# and the measured runtimes and the top-k regret (see
+# cost_model_calibration.cpp). Poor numbers on new hardware suggest the
+# cost model should be retrained there.
+#
+# The apps must already have been built with CMake in apps_build_dir, so
+# that their generators are at apps_build_dir/<app>/<app>.generator.
+#
+# If HL_TARGET is not set, the host target is used. Use a new
+# samples_out_path for each weights file measured.
+
+if [ $# -lt 5 -o $# -gt 6 ]; then
+  echo "Usage: $0 weights_file autoschedule_bin_dir halide_distrib_path apps_build_dir samples_out_path [apps]"
+  exit
+fi
+
+set -eu
+
+WEIGHTS_FILE=${1}
+AUTOSCHED_BIN=${2}
+HALIDE_DISTRIB_PATH=${3}
+APPS_BUILD_DIR=${4}
+SAMPLES=${5}
+
+if [ $# -ge 6 ]; then
+    APPS=${6}
+else
+    APPS="bilateral_grid blur camera_pipe conv_layer harris hist iir_blur interpolate lens_blur local_laplacian max_filter nl_means stencil_chain unsharp"
+fi
+
+SCRIPT_DIR=$(dirname $0)
+
+mkdir -p ${SAMPLES}
+
+PREDICTIONS_FILES=
+for APP in ${APPS}; do
+    GENERATOR=${APPS_BUILD_DIR}/${APP}/${APP}.generator
+    if [ ! -f ${GENERATOR} ]; then
+        echo "Generator ${GENERATOR} not found. Skipping..."
+        continue
+    fi
+
+    PIPELINE=${APP}
+    if [ ${APP} = "blur" ]; then
+        PIPELINE=halide_blur
+    fi
+
+    APP_SAMPLES=${SAMPLES}/${APP}
+    bash ${SCRIPT_DIR}/adams2019_autotune_loop.sh \
+        ${GENERATOR} \
+        ${PIPELINE} \
+        "${HL_TARGET:-}" \
+        ${WEIGHTS_FILE} \
+        ${AUTOSCHED_BIN} \
+        ${HALIDE_DISTRIB_PATH} \
+        ${APP_SAMPLES}
+
+    # The autotuning loop retrains its own copy of the weights, but the
+    # weights being measured are the ones that chose the schedules.
+    find ${APP_SAMPLES} -name "*.sample" | \
+        ${AUTOSCHED_BIN}/adams2019_retrain_cost_model \
+            --num_cores=32 \
+            --initial_weights=${WEIGHTS_FILE} \
+            --predictions_file=${APP_SAMPLES}/predictions > /dev/null
+
+    PREDICTIONS_FILES="${PREDICTIONS_FILES} ${APP_SAMPLES}/predictions"
+done
+
+if [ -z "${PREDICTIONS_FILES}" ]; then
+    echo "No apps found in ${APPS_BUILD_DIR}"
+    exit 1
+fi
+
+${AUTOSCHED_BIN}/cost_model_calibration ${PREDICTIONS_FILES} | tee ${SAMPLES}/calibration.txt
@@ -66,6 +66,7 @@
 #include "NetworkSize.h"
 #include "ParamParser.h"
 #include "PerfectHashMap.h"
+#include "SearchBudget.h"
 #include "State.h"
 
 #ifdef _WIN32
@@ -160,7 +161,8 @@ struct AutoSchedule {
                                               int pass_idx,
                                               int num_passes,
                                               ProgressBar &tick,
-                                              std::unordered_set<uint64_t> &permitted_hashes);
+                                              std::unordered_set<uint64_t> &permitted_hashes,
+                                              SearchBudget &budget);
 
     // Performance coarse-to-fine beam search and return the best state found.
     IntrusivePtr<State> optimal_schedule(int beam_size);
@@ -220,7 +222,8 @@ IntrusivePtr<State> AutoSchedule::optimal_schedule_pass(int beam_size,
                                                         int pass_idx,
                                                         int num_passes,
                                                         ProgressBar &tick,
-                                                        std::unordered_set<uint64_t> &permitted_hashes) {
+                                                        std::unordered_set<uint64_t> &permitted_hashes,
+                                                        SearchBudget &budget) {
     StateQueue q, pending;
 
     // The initial state, with no decisions made
@@ -279,7 +282,8 @@ IntrusivePtr<State> AutoSchedule::optimal_schedule_pass(int beam_size,
                                              pass_idx,
                                              num_passes,
                                              tick,
-                                             permitted_hashes);
+                                             permitted_hashes,
+                                             budget);
             } else {
                 internal_error << "Ran out of legal states with beam size " << beam_size << "\n";
             }
@@ -289,12 +293,24 @@ IntrusivePtr<State> AutoSchedule::optimal_schedule_pass(int beam_size,
             aslog(1) << "Warning: Huge number of states generated (" << pending.size() << ").\n";
         }
 
+        // Once the time budget is spent, finish the pass greedily from
+        // the best state in the beam, so that there is always a
+        // complete schedule to return.
+        int beam_width = beam_size;
+        if (budget.spent()) {
+            if (budget.decisions_when_spent < 0) {
+                budget.decisions_when_spent = pending.top()->num_decisions_made;
+                budget.cut_short = true;
+            }
+            beam_width = 1;
+        }
+
         expanded = 0;
-        while (expanded < beam_size && !pending.empty()) {
+        while (expanded < beam_width && !pending.empty()) {
 
             IntrusivePtr<State> state{pending.pop()};
 
-            if (beam_size > 1 && num_passes > 1 && pass_idx >= 0) {
+            if (beam_width > 1 && num_passes > 1 && pass_idx >= 0) {
                 // We are doing coarse-to-fine beam search using the
                 // hashing strategy mentioned in the paper.
                 //
@@ -518,10 +534,17 @@ IntrusivePtr<State> AutoSchedule::optimal_schedule(int beam_size) {
         --num_passes;
     }
 
+    SearchBudget budget(params.time_budget_s);
+
     for (; pass_idx < num_passes; pass_idx++) {
+        if (best.defined() && budget.spent()) {
+            budget.cut_short = true;
+            break;
+        }
+
         ProgressBar tick;
 
-        auto pass = optimal_schedule_pass(beam_size, pass_idx, num_passes, tick, permitted_hashes);
+        auto pass = optimal_schedule_pass(beam_size, pass_idx, num_passes, tick, permitted_hashes, budget);
 
         tick.clear();
 
@@ -541,6 +564,20 @@ IntrusivePtr<State> AutoSchedule::optimal_schedule(int beam_size) {
             // not necessarily the final one.
             best = pass;
         }
+
+        if (pass_idx >= 0) {
+            budget.passes++;
+        }
+    }
+
+    if (budget.cut_short) {
+        aslog(1) << "Time budget of " << budget.seconds << "s spent after " << budget.passes
+                 << " of " << num_passes << " passes";
+        if (budget.decisions_when_spent >= 0) {
+            aslog(1) << ", the last of which made " << budget.decisions_when_spent << " of "
+                     << 2 * dag.nodes.size() << " decisions with the full beam and the rest greedily";
+        }
+        aslog(1) << "\n";
     }
 
     aslog(1) << "Best cost: " << best->cost << "\n";
@@ -568,6 +605,7 @@ void generate_schedule(const std::vector<Function> &outputs,
     aslog(1) << "Anderson2021Params.freeze_inline_compute_root:" << params.freeze_inline_compute_root << "\n";
     aslog(1) << "Anderson2021Params.partial_schedule_path:" << params.partial_schedule_path << "\n";
     aslog(1) << "Anderson2021Params.num_passes:" << params.num_passes << "\n";
+    aslog(1) << "Anderson2021Params.time_budget_s:" << params.time_budget_s << "\n";
     aslog(1) << "Anderson2021Params.stack_factor:" << params.stack_factor << "\n";
     aslog(1) << "Anderson2021Params.shared_memory_limit_kb:" << params.shared_memory_limit_kb << "\n";
     aslog(1) << "Anderson2021Params.shared_memory_sm_limit_kb:" << params.shared_memory_sm_limit_kb << "\n";
@@ -701,6 +739,7 @@ struct Anderson2021 {
             parser.parse("freeze_inline_compute_root", &params.freeze_inline_compute_root);
             parser.parse("partial_schedule_path", &params.partial_schedule_path);
             parser.parse("num_passes", &params.num_passes);
+            parser.parse("time_budget_s", &params.time_budget_s);
             parser.parse("stack_factor", &params.stack_factor);
             parser.parse("shared_memory_limit_kb", &params.shared_memory_limit_kb);
             parser.parse("shared_memory_sm_limit_kb", &params.shared_memory_sm_limit_kb);
@@ -63,6 +63,11 @@ struct Anderson2021Params {
      * Formerly HL_NUM_PASSES */
     int num_passes = 0;
 
+    /** If > 0, a wall-clock budget for the beam search, in seconds. Once it is
+     * spent, the pass in progress is finished greedily from the best state in
+     * its beam, no more passes start, and the best schedule found so far is used. */
+    double time_budget_s = 0;
+
     /** TODO: document me
      * Formerly HL_STACK_FACTOR */
     double stack_factor = 0.95f;
@@ -234,6 +234,9 @@ for app in $APPS; do
     predict_all ${HALIDE_SRC_DIR} ${HALIDE_BUILD_DIR} ${SAMPLES_DIR} ${WEIGHTS_FILE} ${PREDICTIONS_WITH_FILENAMES_FILE} 1 ${LIMIT:-0} ${PARALLELISM}
     awk -F", " '{printf("%f, %f\n", $2, $3);}' ${PREDICTIONS_WITH_FILENAMES_FILE} > ${PREDICTIONS_FILE}
 
+    echo "Computing cost model calibration..."
+    cost_model_calibration ${HALIDE_BUILD_DIR} ${PREDICTIONS_WITH_FILENAMES_FILE} >> ${OUTPUT_FILE} || echo "Not enough samples to measure calibration"
+
     echo "Computing average statistics..."
     bash ${SCRIPTS_DIR}/average_times.sh ${SAMPLES_DIR} >> ${OUTPUT_FILE}
 
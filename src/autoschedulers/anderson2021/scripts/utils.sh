@@ -113,6 +113,13 @@ function predict_all() {
     bash ${scripts_dir}/predict_all.sh ${halide_build_dir} ${samples_dir} ${weights_dir} ${predictions_file} ${include_filenames} ${limit} ${parallelism}
 }
 
+function cost_model_calibration() {
+    local -r halide_build_dir=$1
+    local -r predictions_file=$2
+
+    ${halide_build_dir}/src/autoschedulers/common/cost_model_calibration ${predictions_file}
+}
+
 function average_compile_time_beam_search() {
     local -r samples_dir=$1
 
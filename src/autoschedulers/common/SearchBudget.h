@@ -0,0 +1,44 @@
+#ifndef SEARCH_BUDGET_H
+#define SEARCH_BUDGET_H
+
+#include <chrono>
+
+namespace Halide {
+namespace Internal {
+namespace Autoscheduler {
+
+// A wall-clock budget for the beam search, which makes it an anytime
+// search. Also records how much of the search it allowed.
+struct SearchBudget {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds;
+
+    // The number of passes finished, including any finished greedily.
+    int passes = 0;
+
+    // The number of decisions the pass in progress had made with its full
+    // beam when the budget was spent, or -1 if it hasn't been spent.
+    int decisions_when_spent = -1;
+
+    // Whether the search stopped before it would have without a budget.
+    bool cut_short = false;
+
+    explicit SearchBudget(double seconds)
+        : seconds(seconds) {
+    }
+
+    // The time since the search started, in seconds.
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool spent() const {
+        return seconds > 0 && elapsed() > seconds;
+    }
+};
+
+}  // namespace Autoscheduler
+}  // namespace Internal
+}  // namespace Halide
+
+#endif  // SEARCH_BUDGET_H
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Measures how well a cost model ranks the schedules of a pipeline, from
+// the predictions files that the autoschedulers' retrain_cost_model tools
+// write with --predictions_file (adams2019) or as the predictions_file
+// positional argument (anderson2021). Each line of these has the form
+//
+//   sample filename, predicted cost, measured runtime[, pipeline id]
+//
+// The schedules in each file (and of each pipeline id within it, if
+// present) are compared with each other, and for each such group this
+// prints:
+//
+//   - the Spearman rank correlation between the predictions and the
+//     runtimes, where 1 means the model orders the schedules perfectly.
+//
+//   - the top-k regret for a few values of k: how much slower the fastest
+//     of the k schedules the model likes most is than the fastest schedule
+//     overall. This is what matters when the model picks the schedule.
+//
+// followed by the means over all groups.
+
+namespace {
+
+struct Group {
+    std::string name;
+    std::vector<std::pair<double, double>> predictions_and_runtimes;
+};
+
+// The ranks of some values, with ties given the mean of the ranks they span.
+std::vector<double> ranks(const std::vector<double> &values) {
+    std::vector<size_t> order(values.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return values[a] < values[b];
+    });
+    std::vector<double> result(values.size());
+    for (size_t i = 0; i < order.size();) {
+        size_t j = i;
+        while (j < order.size() && values[order[j]] == values[order[i]]) {
+            j++;
+        }
+        for (size_t k = i; k < j; k++) {
+            result[order[k]] = (i + j - 1) / 2.0;
+        }
+        i = j;
+    }
+    return result;
+}
+
+double spearman(const Group &g) {
+    std::vector<double> p, r;
+    for (const auto &s : g.predictions_and_runtimes) {
+        p.push_back(s.first);
+        r.push_back(s.second);
+    }
+    p = ranks(p);
+    r = ranks(r);
+    const double n = (double)p.size();
+    double mean = (n - 1) / 2, cov = 0, var_p = 0, var_r = 0;
+    for (size_t i = 0; i < p.size(); i++) {
+        cov += (p[i] - mean) * (r[i] - mean);
+        var_p += (p[i] - mean) * (p[i] - mean);
+        var_r += (r[i] - mean) * (r[i] - mean);
+    }
+    if (var_p == 0 || var_r == 0) {
+        return 0;
+    }
+    return cov / std::sqrt(var_p * var_r);
+}
+
+// Sorts the group by prediction.
+double top_k_regret(Group &g, size_t k) {
+    auto &s = g.predictions_and_runtimes;
+    std::sort(s.begin(), s.end());
+    double best = s[0].second, best_in_top_k = s[0].second;
+    for (size_t i = 0; i < s.size(); i++) {
+        best = std::min(best, s[i].second);
+        if (i < k) {
+            best_in_top_k = std::min(best_in_top_k, s[i].second);
+        }
+    }
+    return best_in_top_k / best - 1;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cout << "Usage: cost_model_calibration predictions_file [predictions_file ...]\n";
+        return -1;
+    }
+
+    std::map<std::pair<int, std::string>, Group> groups;
+    for (int i = 1; i < argc; i++) {
+        std::ifstream in(argv[i]);
+        if (!in) {
+            std::cerr << "Unable to open predictions file: " << argv[i] << "\n";
+            return -1;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            std::vector<std::string> fields;
+            std::istringstream s(line);
+            std::string field;
+            while (std::getline(s, field, ',')) {
+                fields.push_back(field);
+            }
+            if (fields.size() < 3) {
+                continue;
+            }
+            const double prediction = std::atof(fields[1].c_str());
+            const double runtime = std::atof(fields[2].c_str());
+            if (!(runtime > 0) || !std::isfinite(prediction)) {
+                continue;
+            }
+            std::string pipeline = fields.size() > 3 ? fields[3] : "";
+            pipeline.erase(0, pipeline.find_first_not_of(' '));
+            Group &g = groups[{i, pipeline}];
+            if (g.name.empty()) {
+                g.name = argv[i];
+                if (!pipeline.empty()) {
+                    g.name += " (pipeline " + pipeline + ")";
+                }
+            }
+            g.predictions_and_runtimes.emplace_back(prediction, runtime);
+        }
+    }
+
+    const size_t ks[] = {1, 5, 10};
+    const size_t num_ks = sizeof(ks) / sizeof(ks[0]);
+
+    double spearman_sum = 0, regret_sum[num_ks] = {0};
+    int count = 0;
+    for (auto &it : groups) {
+        Group &g = it.second;
+        if (g.predictions_and_runtimes.size() < 2) {
+            continue;
+        }
+        const double rho = spearman(g);
+        std::cout << g.name << ": " << g.predictions_and_runtimes.size() << " schedules"
+                  << ", rank correlation " << rho;
+        spearman_sum += rho;
+        for (size_t j = 0; j < num_ks; j++) {
+            const double regret = top_k_regret(g, ks[j]);
+            std::cout << ", top-" << ks[j] << " regret " << 100 * regret << "%";
+            regret_sum[j] += regret;
+        }
+        std::cout << "\n";
+        count++;
+    }
+
+    if (count == 0) {
+        std::cerr << "No pipelines with at least two schedules\n";
+        return -1;
+    }
+
+    std::cout << "Mean over " << count << " pipelines: rank correlation " << spearman_sum / count;
+    for (size_t j = 0; j < num_ks; j++) {
+        std::cout << ", top-" << ks[j] << " regret " << 100 * regret_sum[j] / count << "%";
+    }
+    std::cout << "\n";
+
+    return 0;
+}
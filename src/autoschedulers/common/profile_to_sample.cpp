@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A sample is a featurization + a runtime + some ids, all together in one file.
+// This utility is like featurization_to_sample, but takes the runtime from the
+// per-Func timings that a pipeline compiled with -profile saved with
+// Halide::Tools::save_profiler_timings(), so that timings of deployed pipelines
+// can be used to fine-tune a cost model. The runtime used is the profiled time
+// per run of the whole pipeline, since that is what the cost model predicts.
+// The per-Func breakdown is printed alongside for reference.
+int main(int argc, char **argv) {
+    if (argc != 7) {
+        std::cout << "Usage: profile_to_sample in.featurization timings.txt pipeline_name pipeline_id schedule_id out.sample\n";
+        return -1;
+    }
+
+    std::ifstream timings(argv[2]);
+    if (!timings) {
+        std::cerr << "Unable to open timings file: " << argv[2] << "\n";
+        return -1;
+    }
+
+    const std::string pipeline_name = argv[3];
+    bool found = false, in_pipeline = false;
+    int runs = 0;
+    uint64_t pipeline_time = 0;
+    std::vector<std::pair<uint64_t, std::string>> funcs;
+    std::string line;
+    while (std::getline(timings, line)) {
+        std::istringstream in(line);
+        std::string kind, name;
+        in >> kind;
+        if (kind == "pipeline") {
+            int r;
+            uint64_t t;
+            in >> r >> t >> std::ws;
+            std::getline(in, name);
+            in_pipeline = (name == pipeline_name);
+            if (in_pipeline) {
+                // Merge the timings if the pipeline appears more than once.
+                found = true;
+                runs += r;
+                pipeline_time += t;
+            }
+        } else if (kind == "func" && in_pipeline) {
+            uint64_t t;
+            in >> t >> std::ws;
+            std::getline(in, name);
+            funcs.emplace_back(t, name);
+        }
+    }
+
+    if (!found || runs == 0) {
+        std::cerr << "No profiled runs of pipeline " << pipeline_name << " in " << argv[2] << "\n";
+        return -1;
+    }
+
+    std::ifstream src(argv[1], std::ios::binary);
+    if (!src) {
+        std::cerr << "Unable to open input file: " << argv[1] << "\n";
+        return -1;
+    }
+
+    std::ofstream dst(argv[6], std::ios::binary);
+    if (!dst) {
+        std::cerr << "Unable to open output file: " << argv[6] << "\n";
+        return -1;
+    }
+
+    dst << src.rdbuf();
+
+    // The profiler measures nanoseconds, but sample files store times in
+    // milliseconds.
+    float r = (float)((double)pipeline_time / runs / 1e6);
+    int32_t pid = atoi(argv[4]);
+    int32_t sid = atoi(argv[5]);
+
+    dst.write((const char *)&r, 4);
+    dst.write((const char *)&pid, 4);
+    dst.write((const char *)&sid, 4);
+
+    src.close();
+    dst.close();
+
+    std::sort(funcs.begin(), funcs.end(), std::greater<>());
+    std::cout << pipeline_name << ": " << r << " ms per run over " << runs << " runs\n";
+    for (const auto &f : funcs) {
+        if (f.first == 0) {
+            break;
+        }
+        std::cout << "  " << f.second << ": " << (double)f.first / runs / 1e6 << " ms ("
+                  << 100.0 * f.first / std::max(pipeline_time, (uint64_t)1) << "%)\n";
+    }
+
+    return 0;
+}
@@ -1,13 +1,17 @@
 #include "HalidePlugin.h"
 
 #include <algorithm>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <set>
 #include <utility>
 
 #include "Halide.h"
 #include "ParamParser.h"
+#include "halide_thread_pool.h"
 
 namespace Halide {
 namespace Internal {
@@ -32,6 +36,10 @@ struct ArchParams {
     /** Indicates how much more expensive is the cost of a load compared to
      * the cost of an arithmetic operation at last level cache. */
     float balance = 40;
+
+    /** Number of threads to use to evaluate the candidate groupings. If 0,
+     * use one per core. The schedule found does not depend on this. */
+    int search_threads = 1;
 };
 
 // Substitute parameter estimates into the exprs describing the box bounds.
@@ -204,6 +212,9 @@ struct DependenceAnalysis {
     // Cache for bounds queries (bound queries with the same parameters are
     // common during the grouping process).
     map<RegionsRequiredQuery, vector<RegionsRequired>> regions_required_cache;
+    // Guards the cache, as the partitioner queries regions from several
+    // threads at once. Held by pointer so that the analysis stays movable.
+    std::unique_ptr<std::mutex> regions_required_cache_mutex = std::make_unique<std::mutex>();
 
     DependenceAnalysis(const map<string, Function> &env, const vector<string> &order,
                        const FuncValueBounds &func_val_bounds)
@@ -400,13 +411,16 @@ DependenceAnalysis::regions_required(const Function &f, int stage_num,
 
     // Check the cache if we've already computed this previously.
     RegionsRequiredQuery query(f.name(), stage_num, prods, only_regions_computed);
-    const auto &iter = regions_required_cache.find(query);
-    if (iter != regions_required_cache.end()) {
-        const auto &it = std::find_if(iter->second.begin(), iter->second.end(),
-                                      [&bounds](const RegionsRequired &r) { return (r.bounds == bounds); });
-        if (it != iter->second.end()) {
-            internal_assert((iter->first == query) && (it->bounds == bounds));
-            return it->regions;
+    {
+        std::lock_guard<std::mutex> lock(*regions_required_cache_mutex);
+        const auto &iter = regions_required_cache.find(query);
+        if (iter != regions_required_cache.end()) {
+            const auto &it = std::find_if(iter->second.begin(), iter->second.end(),
+                                          [&bounds](const RegionsRequired &r) { return (r.bounds == bounds); });
+            if (it != iter->second.end()) {
+                internal_assert((iter->first == query) && (it->bounds == bounds));
+                return it->regions;
+            }
         }
     }
 
@@ -600,6 +614,7 @@ DependenceAnalysis::regions_required(const Function &f, int stage_num,
         concrete_regions[f_reg.first] = concrete_box;
     }
 
+    std::lock_guard<std::mutex> lock(*regions_required_cache_mutex);
     regions_required_cache[query].emplace_back(bounds, concrete_regions);
     return concrete_regions;
 }
@@ -1096,6 +1111,8 @@ struct Partitioner {
     RegionCosts &costs;
     // Output functions of the pipeline.
     const vector<Function> &outputs;
+    // Threads to evaluate grouping choices on, if asked for more than one.
+    std::unique_ptr<Tools::ThreadPool<GroupConfig>> pool;
 
     Partitioner(const map<string, Box> &_pipeline_bounds,
                 const ArchParams &_arch_params,
@@ -1344,6 +1361,13 @@ Partitioner::Partitioner(const map<string, Box> &_pipeline_bounds,
                          RegionCosts &_costs)
     : pipeline_bounds(_pipeline_bounds), arch_params(_arch_params),
       dep_analysis(_dep_analysis), costs(_costs), outputs(_outputs) {
+    if (arch_params.search_threads != 1) {
+        size_t threads = arch_params.search_threads > 0 ?
+                             (size_t)arch_params.search_threads :
+                             Tools::ThreadPool<GroupConfig>::num_processors_online();
+        pool = std::make_unique<Tools::ThreadPool<GroupConfig>>(threads);
+    }
+
     // Place each stage of a function in its own group. Each stage is
     // a node in the pipeline graph.
     for (const auto &f : dep_analysis.env) {
@@ -1451,6 +1475,37 @@ map<string, Expr> Partitioner::evaluate_reuse(const FStage &stg,
 vector<pair<Partitioner::GroupingChoice, Partitioner::GroupConfig>>
 Partitioner::choose_candidate_grouping(const vector<pair<string, string>> &cands,
                                        Partitioner::Level level) {
+    // Find the choices that haven't been evaluated for grouping before.
+    vector<GroupingChoice> to_evaluate;
+    for (const auto &p : cands) {
+        const Function &prod_f = get_element(dep_analysis.env, p.first);
+        FStage prod(prod_f, prod_f.updates().size());
+        for (const FStage &c : get_element(children, prod)) {
+            GroupingChoice cand_choice(prod_f.name(), c);
+            if (grouping_cache.find(cand_choice) == grouping_cache.end()) {
+                to_evaluate.push_back(cand_choice);
+            }
+        }
+    }
+
+    // Evaluate them and cache the results. The evaluations don't depend
+    // on each other, so they can run concurrently.
+    if (pool && to_evaluate.size() > 1) {
+        vector<std::future<GroupConfig>> configs;
+        for (const auto &choice : to_evaluate) {
+            configs.push_back(pool->async([this, &choice, level]() {
+                return evaluate_choice(choice, level);
+            }));
+        }
+        for (size_t i = 0; i < to_evaluate.size(); i++) {
+            grouping_cache.emplace(to_evaluate[i], configs[i].get());
+        }
+    } else {
+        for (const auto &choice : to_evaluate) {
+            grouping_cache.emplace(choice, evaluate_choice(choice, level));
+        }
+    }
+
     vector<pair<GroupingChoice, GroupConfig>> best_grouping;
     Expr best_benefit = make_zero(Int(64));
     for (const auto &p : cands) {
@@ -1463,20 +1518,8 @@ Partitioner::choose_candidate_grouping(const vector<pair<string, string>> &cands
         FStage prod(prod_f, final_stage);
 
         for (const FStage &c : get_element(children, prod)) {
-            GroupConfig best_config;
             GroupingChoice cand_choice(prod_f.name(), c);
-
-            // Check if the candidate has been evaluated for grouping before
-            const auto &iter = grouping_cache.find(cand_choice);
-            if (iter != grouping_cache.end()) {
-                best_config = iter->second;
-            } else {
-                best_config = evaluate_choice(cand_choice, level);
-                // Cache the result of the evaluation for the pair
-                grouping_cache.emplace(cand_choice, best_config);
-            }
-
-            grouping.emplace_back(cand_choice, best_config);
+            grouping.emplace_back(cand_choice, get_element(grouping_cache, cand_choice));
         }
 
         bool no_redundant_work = false;
@@ -3438,6 +3481,7 @@ struct Mullapudi2016 {
             parser.parse("parallelism", &arch_params.parallelism);
             parser.parse("last_level_cache_size", &arch_params.last_level_cache_size);
             parser.parse("balance", &arch_params.balance);
+            parser.parse("search_threads", &arch_params.search_threads);
             parser.finish();
         }
         results.schedule_source = generate_schedules(pipeline_outputs, target, arch_params);
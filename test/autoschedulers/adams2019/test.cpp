@@ -1,8 +1,10 @@
 #include "Halide.h"
-#include <cstdlib>   // setenv (or Windows _putenv_s)
-#include <iostream>  // std::cerr / std::endl
-#include <map>       // std::map
-#include <string>    // std::to_string
+#include <chrono>      // std::chrono::steady_clock
+#include <cstdlib>     // setenv (or Windows _putenv_s)
+#include <filesystem>  // std::filesystem::remove_all
+#include <iostream>    // std::cerr / std::endl
+#include <map>         // std::map
+#include <string>      // std::to_string
 
 using namespace Halide;
 
@@ -55,6 +57,154 @@ bool test_caching(Pipeline &p1, Pipeline &p2, const Target &target) {
     return true;
 }
 
+bool test_search_threads(Pipeline &p1, Pipeline &p2, const Target &target) {
+    constexpr int parallelism = 32;
+    int seed = (int)time(nullptr);
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", std::to_string(parallelism)},
+            {"random_dropout_seed", std::to_string(seed)},
+            {"weights_path", weights_path},
+        });
+
+    params.extra["search_threads"] = "1";
+    auto results_serial = p1.apply_autoscheduler(target, params);
+
+    params.extra["search_threads"] = "4";
+    auto results_parallel = p2.apply_autoscheduler(target, params);
+
+    // Expanding states on several threads must not change the result.
+    return results_serial.schedule_source == results_parallel.schedule_source &&
+           results_serial.featurization == results_parallel.featurization;
+}
+
+bool test_schedule_database(Pipeline &p1, Pipeline &p2, Pipeline &p3, const Target &target) {
+    const std::string database = Internal::dir_make_temp();
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", "32"},
+            {"weights_path", weights_path},
+            {"schedule_database", database},
+        });
+
+    auto results_searched = p1.apply_autoscheduler(target, params);
+
+    // The same pipeline again should replay the same schedule.
+    auto results_replayed = p2.apply_autoscheduler(target, params);
+
+    // A pipeline with different estimates should warm-start from it, and
+    // still produce a schedule.
+    auto results_warm_started = p3.apply_autoscheduler(target, params);
+
+    std::filesystem::remove_all(database);
+
+    return results_searched.schedule_source == results_replayed.schedule_source &&
+           results_searched.featurization == results_replayed.featurization &&
+           !results_warm_started.schedule_source.empty();
+}
+
+bool test_concurrent_instances(Pipeline &p, const Target &target) {
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", "32"},
+            {"concurrent_instances", "32"},
+            {"weights_path", weights_path},
+        });
+
+    auto results = p.apply_autoscheduler(target, params);
+
+    // With as many instances as cores, each instance gets one core, so
+    // there is nothing to gain from parallel loops.
+    return !results.schedule_source.empty() &&
+           results.schedule_source.find(".parallel(") == std::string::npos;
+}
+
+bool test_time_budget(Pipeline &p1, Pipeline &p2, Pipeline &p3, const Target &target) {
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", "32"},
+            {"weights_path", weights_path},
+        });
+
+    // Time a search by apply_autoscheduler() with the given budget. A search
+    // that is cut short doesn't store its schedule in the database, so the
+    // database staying empty shows that it was.
+    const auto timed_search = [&](Pipeline &p, double budget_s, bool *cut_short) {
+        const std::string database = Internal::dir_make_temp();
+        params.extra["schedule_database"] = database;
+        if (budget_s > 0) {
+            params.extra["time_budget_s"] = std::to_string(budget_s);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        auto results = p.apply_autoscheduler(target, params);
+        const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        *cut_short = std::filesystem::is_empty(database);
+        std::filesystem::remove_all(database);
+        return results.schedule_source.empty() ? -1.0 : elapsed_s;
+    };
+
+    bool full_cut_short, greedy_cut_short, budgeted_cut_short;
+    const double full_s = timed_search(p1, 0, &full_cut_short);
+    // Spent before the first decision is made, so this is just the time
+    // to finish the search greedily, and the work outside of it.
+    const double greedy_s = timed_search(p2, 1e-9, &greedy_cut_short);
+    // A quarter of the time the full search took.
+    const double budget_s = full_s / 4;
+    const double budgeted_s = timed_search(p3, budget_s, &budgeted_cut_short);
+
+    // Every search should still finish with a complete schedule, and the
+    // budgeted one should stop soon after its budget is spent.
+    if (full_s < 0 || greedy_s < 0 || budgeted_s < 0 ||
+        full_cut_short || !greedy_cut_short || !budgeted_cut_short ||
+        budgeted_s > greedy_s + 2 * budget_s) {
+        std::cerr << "Full search took " << full_s << "s (cut short: " << full_cut_short << "), "
+                  << "greedy search took " << greedy_s << "s (cut short: " << greedy_cut_short << "), "
+                  << "search with a budget of " << budget_s << "s took " << budgeted_s
+                  << "s (cut short: " << budgeted_cut_short << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int count_occurrences(const std::string &s, const std::string &pattern) {
+    int count = 0;
+    for (size_t pos = s.find(pattern); pos != std::string::npos; pos = s.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+bool test_memory_limits(Pipeline &p1, Pipeline &p2, const Target &target) {
+    AutoschedulerParams params(
+        "Adams2019",
+        {
+            {"parallelism", "32"},
+            {"weights_path", weights_path},
+        });
+
+    // Storing any intermediate at root takes 16MB, so a 4MB limit
+    // rejects those schedules, and accepts ones that fuse everything
+    // into tiles of the output, even with 32 threads allocating tiles.
+    params.extra["memory_limit"] = std::to_string(4 * 1024 * 1024);
+    auto results_fused = p1.apply_autoscheduler(target, params);
+
+    // Nothing allocated inside a parallel loop is allowed at all, which
+    // rejects those same schedules and accepts ones that compute
+    // everything at root.
+    params.extra.erase("memory_limit");
+    params.extra["thread_memory_limit"] = "0";
+    auto results_at_root = p2.apply_autoscheduler(target, params);
+
+    // Only the output is compute_root in the first, and nothing is
+    // computed inside another Func in the second.
+    return count_occurrences(results_fused.schedule_source, ".compute_root()") == 1 &&
+           count_occurrences(results_at_root.schedule_source, ".compute_at(") == 0;
+}
+
 int main(int argc, char **argv) {
     if (argc != 3 || !strlen(argv[1]) || !strlen(argv[2])) {
         fprintf(stderr, "Usage: %s <autoscheduler-lib> <weights-path>\n", argv[0]);
@@ -902,6 +1052,118 @@ int main(int argc, char **argv) {
         }
     }
 
+    // A stencil chain, searched with several threads
+    if (true) {
+        Pipeline p1;
+        Pipeline p2;
+        for (int test_condition = 0; test_condition < 2; test_condition++) {
+            // Name the Funcs, so the schedule sources can be compared.
+            std::vector<Func> stages;
+            stages.emplace_back("s0");
+            stages.back()(x, y) = x + y;
+            for (int i = 1; i <= 6; i++) {
+                Func prev = stages.back();
+                stages.emplace_back("s" + std::to_string(i));
+                stages.back()(x, y) = prev(x - 1, y) + prev(x, y - 1) + prev(x + 1, y + 1);
+            }
+            stages.back().set_estimate(x, 0, 2048).set_estimate(y, 0, 2048);
+
+            if (test_condition) {
+                p2 = Pipeline(stages.back());
+            } else {
+                p1 = Pipeline(stages.back());
+            }
+        }
+
+        if (!test_search_threads(p1, p2, target)) {
+            std::cerr << "Multithreaded search gave a different schedule on stencil chain" << std::endl;
+            return 1;
+        }
+    }
+
+    // The same stencil chain, scheduled via the schedule database
+    if (true) {
+        Pipeline p[3];
+        for (int test_condition = 0; test_condition < 3; test_condition++) {
+            std::vector<Func> stages;
+            stages.emplace_back("s0");
+            stages.back()(x, y) = x + y;
+            for (int i = 1; i <= 6; i++) {
+                Func prev = stages.back();
+                stages.emplace_back("s" + std::to_string(i));
+                stages.back()(x, y) = prev(x - 1, y) + prev(x, y - 1) + prev(x + 1, y + 1);
+            }
+            const int size = test_condition < 2 ? 2048 : 1536;
+            stages.back().set_estimate(x, 0, size).set_estimate(y, 0, size);
+            p[test_condition] = Pipeline(stages.back());
+        }
+
+        if (!test_schedule_database(p[0], p[1], p[2], target)) {
+            std::cerr << "Schedule database gave a different schedule on stencil chain" << std::endl;
+            return 1;
+        }
+    }
+
+    // A stencil chain, scheduled for one instance per core
+    if (true) {
+        Func f[7];
+        f[0](x, y) = x + y;
+        for (int i = 1; i < 7; i++) {
+            f[i](x, y) = f[i - 1](x - 1, y) + f[i - 1](x, y - 1) + f[i - 1](x + 1, y + 1);
+        }
+        f[6].set_estimate(x, 0, 2048).set_estimate(y, 0, 2048);
+        Pipeline p(f[6]);
+
+        if (!test_concurrent_instances(p, target)) {
+            std::cerr << "Scheduling for concurrent instances used parallel loops on stencil chain" << std::endl;
+            return 1;
+        }
+    }
+
+    // A stencil chain, scheduled with too little time to search
+    if (true) {
+        Pipeline p[3];
+        for (int test_condition = 0; test_condition < 3; test_condition++) {
+            Func f[7];
+            f[0](x, y) = x + y;
+            for (int i = 1; i < 7; i++) {
+                f[i](x, y) = f[i - 1](x - 1, y) + f[i - 1](x, y - 1) + f[i - 1](x + 1, y + 1);
+            }
+            f[6].set_estimate(x, 0, 2048).set_estimate(y, 0, 2048);
+            p[test_condition] = Pipeline(f[6]);
+        }
+
+        if (!test_time_budget(p[0], p[1], p[2], target)) {
+            std::cerr << "Search with a time budget wasn't cut short in time on stencil chain" << std::endl;
+            return 1;
+        }
+    }
+
+    // A stencil chain, scheduled under limits on the memory it allocates
+    if (true) {
+        Pipeline p1;
+        Pipeline p2;
+        for (int test_condition = 0; test_condition < 2; test_condition++) {
+            Func f[7];
+            f[0](x, y) = x + y;
+            for (int i = 1; i < 7; i++) {
+                f[i](x, y) = f[i - 1](x - 1, y) + f[i - 1](x, y - 1) + f[i - 1](x + 1, y + 1);
+            }
+            f[6].set_estimate(x, 0, 2048).set_estimate(y, 0, 2048);
+
+            if (test_condition) {
+                p2 = Pipeline(f[6]);
+            } else {
+                p1 = Pipeline(f[6]);
+            }
+        }
+
+        if (!test_memory_limits(p1, p2, target)) {
+            std::cerr << "Memory limits were not respected on stencil chain" << std::endl;
+            return 1;
+        }
+    }
+
     std::cout << "adams2019 testing passed\n";
     return 0;
 }
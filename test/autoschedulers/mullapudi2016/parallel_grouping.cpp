@@ -0,0 +1,98 @@
+// Measures how long the autoscheduler takes to schedule a pipeline with about
+// two hundred stages when it evaluates the candidate groupings on one thread and
+// when it uses one thread per core, and checks that both find the same
+// schedule.
+
+#include "Halide.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Halide;
+
+Pipeline make_pipeline() {
+    const int num_branches = 16;
+    const int branch_length = 12;
+
+    // Name the Funcs, so that the schedule sources can be compared.
+    Var x("x"), y("y");
+    Func input("input");
+    input(x, y) = cast<float>(x + y);
+
+    std::vector<Func> branch_outputs;
+    for (int b = 0; b < num_branches; b++) {
+        Func prev = input;
+        for (int i = 0; i < branch_length; i++) {
+            Func f("b" + std::to_string(b) + "_s" + std::to_string(i));
+            const int dx = 1 + (b + i) % 3;
+            if (i % 2) {
+                f(x, y) = (prev(x - dx, y) + prev(x, y) + prev(x + dx, y)) * 0.33f;
+            } else {
+                f(x, y) = (prev(x, y - dx) + prev(x, y) + prev(x, y + dx)) * 0.33f;
+            }
+            prev = f;
+        }
+        branch_outputs.push_back(prev);
+    }
+
+    Func output("output");
+    Expr e = 0.0f;
+    for (const Func &f : branch_outputs) {
+        e += f(x, y);
+    }
+    output(x, y) = e;
+    output.set_estimate(x, 0, 2048).set_estimate(y, 0, 2048);
+
+    return Pipeline(output);
+}
+
+double schedule(Pipeline &p, const Target &target, const std::string &threads, std::string *schedule_source) {
+    AutoschedulerParams params("Mullapudi2016", {{"search_threads", threads}});
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = p.apply_autoscheduler(target, params);
+    auto end = std::chrono::steady_clock::now();
+
+    *schedule_source = results.schedule_source;
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] Autoschedulers do not support WebAssembly.\n");
+        return 0;
+    }
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <autoscheduler-lib>\n", argv[0]);
+        return 1;
+    }
+
+    load_plugin(argv[1]);
+
+    Target target = get_jit_target_from_environment();
+
+    std::string serial_source, parallel_source;
+    Pipeline p1 = make_pipeline();
+    double serial_time = schedule(p1, target, "1", &serial_source);
+    Pipeline p2 = make_pipeline();
+    double parallel_time = schedule(p2, target, "0", &parallel_source);
+
+    std::cout << "Autoscheduling time on one thread: " << serial_time << "ms\n"
+              << "Autoscheduling time on one thread per core: " << parallel_time << "ms\n"
+              << "Speedup: " << serial_time / parallel_time << "x\n";
+
+    if (serial_source != parallel_source) {
+        std::cerr << "Evaluating groupings on several threads gave a different schedule:\n"
+                  << "======================\n"
+                  << serial_source
+                  << "======================\n"
+                  << parallel_source
+                  << "======================\n";
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
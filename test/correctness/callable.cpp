@@ -1,4 +1,5 @@
 #include "Halide.h"
+#include <array>
 #include <iostream>
 #include <stdio.h>
 
@@ -229,5 +230,49 @@ int main(int argc, char **argv) {
         }
     }
 
+    // Check that a batch of calls runs every entry, serially and in parallel
+    {
+        Param<int32_t> offset;
+        ImageParam in(Int(32), 2);
+
+        Var x("x"), y("y");
+        Func f("f");
+        f(x, y) = in(x, y) + offset;
+        f.parallel(y);
+
+        Callable c = f.compile_to_callable({in, offset}, t);
+
+        for (bool parallel : {false, true}) {
+            constexpr int batch = 16;
+            std::vector<Buffer<int32_t>> ins, outs;
+            int32_t offsets[batch];
+            for (int i = 0; i < batch; i++) {
+                ins.emplace_back(8, 8);
+                ins.back().fill(i);
+                outs.emplace_back(8, 8);
+                offsets[i] = i * 100;
+            }
+
+            JITUserContext empty;
+            JITUserContext *context = &empty;
+            std::vector<std::array<const void *, 4>> argv_store(batch);
+            std::vector<const void *const *> argvs(batch);
+            for (int i = 0; i < batch; i++) {
+                argv_store[i] = {&context, ins[i].raw_buffer(), &offsets[i], outs[i].raw_buffer()};
+                argvs[i] = argv_store[i].data();
+            }
+            check(c.call_argv_batch(4, batch, argvs.data(), parallel));
+
+            for (int i = 0; i < batch; i++) {
+                outs[i].for_each_value([&](int32_t v) {
+                    if (v != i * 101) {
+                        printf("Batch entry %d computed %d instead of %d\n", i, v, i * 101);
+                        exit(1);
+                    }
+                });
+            }
+        }
+    }
+
     printf("Success!\n");
 }
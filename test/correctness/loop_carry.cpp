@@ -19,6 +19,34 @@ public:
     }
 };
 
+// Count the loads from a buffer inside loops nested two or more deep.
+class CountInnerLoads : public IRMutator {
+    using IRMutator::visit;
+
+    std::string buffer_;
+    int depth_ = 0;
+
+    Stmt visit(const For *op) override {
+        depth_++;
+        Stmt s = IRMutator::visit(op);
+        depth_--;
+        return s;
+    }
+
+    Expr visit(const Load *op) override {
+        if (op->name == buffer_ && depth_ >= 2) {
+            count++;
+        }
+        return IRMutator::visit(op);
+    }
+
+public:
+    int count = 0;
+    CountInnerLoads(const std::string &buffer)
+        : buffer_(buffer) {
+    }
+};
+
 int main(int argc, char **argv) {
     Func input;
     Func g;
@@ -59,6 +87,40 @@ int main(int argc, char **argv) {
 
     f.realize({size, size});
 
+    // Check that the loop_carry target feature carries values across
+    // rows of a vertical stencil, and gets the right answer.
+    {
+        Func in("in"), out("out");
+        in(x, y) = x * 3 + y;
+        out(x, y) = in(x, y) + in(x, y + 1) + 2 * in(x, y + 2);
+
+        in.compute_root();
+        out.bound(x, 0, 32)
+            .split(x, xo, xi, 4)
+            .vectorize(xi);
+
+        Buffer<int> expected = out.realize({32, 64});
+
+        CountInnerLoads *counter = new CountInnerLoads("in");
+        out.add_custom_lowering_pass(counter);
+        Target t = get_jit_target_from_environment().with_feature(Target::LoopCarry);
+        Buffer<int> result = out.realize({32, 64}, t);
+
+        if (counter->count != 1) {
+            printf("Expected one load of the input per iteration, found %d\n", counter->count);
+            return 1;
+        }
+
+        for (int j = 0; j < 64; j++) {
+            for (int i = 0; i < 32; i++) {
+                if (result(i, j) != expected(i, j)) {
+                    printf("result(%d, %d) = %d instead of %d\n", i, j, result(i, j), expected(i, j));
+                    return 1;
+                }
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,61 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 96, H = 64;
+
+    Buffer<int> input(W, H);
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = (x * 17 + y * 31) % 256;
+    });
+
+    // Two stages written as separate pipelines, as if they came from
+    // separately-compiled Generators.
+    ImageParam denoise_in(Int(32), 2, "denoise_in");
+    Func denoise("denoise");
+    Var x("x"), y("y");
+    Func clamped_in = BoundaryConditions::repeat_edge(denoise_in);
+    denoise(x, y) = (clamped_in(x - 1, y) + clamped_in(x, y) + clamped_in(x + 1, y)) / 3;
+
+    ImageParam tone_in(Int(32), 2, "tone_in");
+    Func tone("tone");
+    Func clamped_tone = BoundaryConditions::repeat_edge(tone_in);
+    tone(x, y) = clamped_tone(x, y - 1) + 2 * clamped_tone(x, y) + clamped_tone(x, y + 1);
+
+    // Run them back to back through a full-size intermediate.
+    denoise_in.set(input);
+    Buffer<int> intermediate = denoise.realize({W, H});
+    tone_in.set(intermediate);
+    Buffer<int> expected = tone.realize({W, H});
+    tone_in.reset();
+
+    // Now fuse them, and compute the first stage per tile of the second.
+    Pipeline p(tone);
+    p.fuse_input(tone_in, denoise, {{0, W}, {0, H}});
+
+    Var xo("xo"), yo("yo"), xi("xi"), yi("yi");
+    tone.tile(x, y, xo, yo, xi, yi, 32, 16);
+    denoise.compute_at(tone, xo);
+
+    for (const Argument &arg : p.infer_arguments()) {
+        if (arg.name == tone_in.name()) {
+            printf("Fused pipeline still takes %s as an argument\n", arg.name.c_str());
+            return 1;
+        }
+    }
+
+    Buffer<int> result = p.realize({W, H});
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            if (result(i, j) != expected(i, j)) {
+                printf("result(%d, %d) = %d instead of %d\n", i, j, result(i, j), expected(i, j));
+                return 1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -469,6 +469,44 @@ int test12(const Target &t) {
     return 0;
 }
 
+int test13(const Target &t) {
+    if (t.has_feature(Target::HVX)) {
+        // Automatic prefetching is disabled on Hexagon.
+        return 0;
+    }
+
+    ImageParam in(Float(32), 2, "in");
+    Var x("x"), y("y");
+
+    // Walking down a column touches a new cache line on every
+    // iteration, so it should get prefetched.
+    Func f("f");
+    f(x, y) = in(y, x);
+
+    Module m = f.compile_to_module({in}, "", t.with_feature(Target::AutoPrefetch));
+    CollectPrefetches collect;
+    m.functions()[0].body.accept(&collect);
+
+    vector<vector<Expr>> expected = {{Variable::make(Handle(), in.name()), wild<int>(), 1, get_stride(t, 4)}};
+    if (!check(expected, collect.prefetches)) {
+        return 1;
+    }
+
+    // Walking along a row is left to the hardware prefetcher.
+    Func g("g");
+    g(x, y) = in(x, y);
+
+    m = g.compile_to_module({in}, "", t.with_feature(Target::AutoPrefetch));
+    CollectPrefetches collect_contiguous;
+    m.functions()[0].body.accept(&collect_contiguous);
+
+    expected = {};
+    if (!check(expected, collect_contiguous.prefetches)) {
+        return 1;
+    }
+    return 0;
+}
+
 }  // anonymous namespace
 
 int main(int argc, char **argv) {
@@ -476,7 +514,7 @@ int main(int argc, char **argv) {
     std::cout << "Testing target: " << t << "\n";
 
     using Fn = int (*)(const Target &t);
-    std::vector<Fn> tests = {test1, test2, test3, test4, test5, test6, test7, test8, test9, test10, test11, test12};
+    std::vector<Fn> tests = {test1, test2, test3, test4, test5, test6, test7, test8, test9, test10, test11, test12, test13};
 
     for (size_t i = 0; i < tests.size(); i++) {
         printf("Running prefetch test %d\n", (int)i + 1);
@@ -0,0 +1,74 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 64, H = 50, strip_height = 8;
+
+    // The whole input, which we pretend arrives a few rows at a time.
+    Buffer<int> source(W, H + 2);
+    source.for_each_element([&](int x, int y) {
+        source(x, y) = x * 3 + y * 7;
+    });
+
+    ImageParam input(Int(32), 2);
+    Func blur_y, out;
+    Var x, y;
+    blur_y(x, y) = input(x, y) + input(x, y + 1) + input(x, y + 2);
+    out(x, y) = blur_y(x, y) * 2;
+    blur_y.compute_root();
+
+    Buffer<int> expected(W, H);
+    input.set(source);
+    out.realize(expected);
+    input.reset();
+
+    Pipeline p(out);
+    Buffer<int> result(W, H);
+    int next_row = 0, strips = 0;
+    p.realize_strips(
+        Realization(result), strip_height,
+        [&](int y_min, int y_extent) {
+            // The input buffer must cover exactly the rows this strip reads.
+            Buffer<int> in = input.get();
+            if (in.dim(1).min() != y_min || in.dim(1).extent() != y_extent + 2) {
+                printf("Strip at row %d was given input rows [%d, %d)\n",
+                       y_min, in.dim(1).min(), in.dim(1).min() + in.dim(1).extent());
+                exit(1);
+            }
+            in.copy_from(source);
+        },
+        [&](const Realization &strip, int y_min, int y_extent) {
+            Buffer<int> b = strip[0];
+            if (y_min != next_row || b.dim(1).min() != y_min || b.dim(1).extent() != y_extent) {
+                printf("Strip out of order at row %d\n", y_min);
+                exit(1);
+            }
+            next_row += y_extent;
+            strips++;
+        });
+
+    if (next_row != H || strips != (H + strip_height - 1) / strip_height) {
+        printf("Produced %d rows in %d strips\n", next_row, strips);
+        return 1;
+    }
+
+    if (input.get().defined()) {
+        printf("Input was left bound after realize_strips\n");
+        return 1;
+    }
+
+    for (int yi = 0; yi < H; yi++) {
+        for (int xi = 0; xi < W; xi++) {
+            if (result(xi, yi) != expected(xi, yi)) {
+                printf("result(%d, %d) = %d instead of %d\n",
+                       xi, yi, result(xi, yi), expected(xi, yi));
+                return 1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Halide;
+using namespace Halide::Tools;
+
+// Time a pipeline compiled for the given target, and check its output
+// against a reference.
+template<typename T>
+double time_pipeline(Func out, const Target &t, Buffer<T> result, Buffer<T> reference) {
+    out.compile_jit(t);
+    out.realize(result, t);
+    if (reference.defined()) {
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                if (result(x, y) != reference(x, y)) {
+                    printf("result(%d, %d) = %f instead of %f\n", x, y,
+                           (double)result(x, y), (double)reference(x, y));
+                    exit(1);
+                }
+            }
+        }
+    }
+    return benchmark([&]() { out.realize(result, t); });
+}
+
+// Compile and time a pipeline without auto-prefetching, with the
+// default prefetch distance, and then (where setenv is available) with
+// a sweep of forced distances.
+template<typename T>
+void run(const char *name, const std::function<Func()> &make, int w, int h, const Target &target) {
+    Buffer<T> reference(w, h), result(w, h);
+
+    double base = time_pipeline(make(), target, reference, Buffer<T>());
+    Target prefetch_target = target.with_feature(Target::AutoPrefetch);
+    double automatic = time_pipeline(make(), prefetch_target, result, reference);
+    printf("%s: no prefetch %f ms, auto prefetch %f ms (%.2fx)\n",
+           name, base * 1e3, automatic * 1e3, base / automatic);
+
+#ifndef _WIN32
+    for (int distance : {1, 2, 4, 8, 16, 32, 64}) {
+        setenv("HL_AUTO_PREFETCH_DISTANCE", std::to_string(distance).c_str(), 1);
+        double t = time_pipeline(make(), prefetch_target, result, reference);
+        printf("%s: prefetch distance %2d: %f ms (%.2fx)\n", name, distance, t * 1e3, base / t);
+    }
+    unsetenv("HL_AUTO_PREFETCH_DISTANCE");
+#endif
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+    if (target.has_feature(Target::HVX)) {
+        printf("[SKIP] Auto-prefetching is not supported on Hexagon.\n");
+        return 0;
+    }
+
+    const int size = 2048;
+    Buffer<uint16_t> transpose_in(size, size);
+    transpose_in.for_each_element([&](int x, int y) { transpose_in(x, y) = (uint16_t)(x * 3 + y); });
+
+    // A transpose where each iteration of the inner loop reads from a
+    // different row of the input, as in the scalar case of block_transpose.
+    run<uint16_t>(
+        "Scalar transpose", [&]() {
+            Func out;
+            Var x, y;
+            out(x, y) = transpose_in(y, x);
+            return out;
+        },
+        size, size, target);
+
+    // A matrix multiply in which the reduction walks down the columns of B,
+    // as matrix_multiplication does before it is tiled.
+    const int matrix_size = 512;
+    Buffer<float> A(matrix_size, matrix_size), B(matrix_size, matrix_size);
+    A.for_each_element([&](int x, int y) { A(x, y) = (float)((x + y) % 7); });
+    B.for_each_element([&](int x, int y) { B(x, y) = (float)((x * y) % 5); });
+
+    run<float>(
+        "Naive matrix multiply", [&]() {
+            Func prod, out;
+            Var x, y;
+            RDom k(0, matrix_size);
+            prod(x, y) += A(k, y) * B(x, k);
+            out(x, y) = prod(x, y);
+            prod.compute_at(out, x);
+            return out;
+        },
+        matrix_size, matrix_size, target);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "Halide.h"
+#include "halide_benchmark.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Halide;
+using namespace Halide::Internal;
+using namespace Halide::Tools;
+
+// Count the loads done per iteration of innermost loops, summed over
+// all innermost loops.
+class CountInnermostLoads : public IRMutator {
+    using IRMutator::visit;
+
+    bool innermost = false;
+
+    Stmt visit(const For *op) override {
+        innermost = true;
+        Stmt s = IRMutator::visit(op);
+        if (innermost) {
+            // There was no loop inside this one. Count its loads.
+            CountLoads c;
+            op->body.accept(&c);
+            count += c.count;
+        }
+        innermost = false;
+        return s;
+    }
+
+    class CountLoads : public IRVisitor {
+        using IRVisitor::visit;
+        void visit(const Load *op) override {
+            count++;
+            IRVisitor::visit(op);
+        }
+
+    public:
+        int count = 0;
+    };
+
+public:
+    int count = 0;
+};
+
+// Time a pipeline with and without carrying values across loops, and
+// check the outputs match.
+void run(const char *name, const std::function<Func()> &make, int w, int h, const Target &target) {
+    Buffer<uint16_t> reference(w, h), result(w, h);
+
+    double times[2];
+    int loads[2];
+    for (int i = 0; i < 2; i++) {
+        Target t = i == 0 ? target : target.with_feature(Target::LoopCarry);
+        Buffer<uint16_t> out = i == 0 ? reference : result;
+        Func f = make();
+        CountInnermostLoads *counter = new CountInnermostLoads;
+        f.add_custom_lowering_pass(counter);
+        f.compile_jit(t);
+        f.realize(out, t);
+        loads[i] = counter->count;
+        times[i] = benchmark([&]() { f.realize(out, t); });
+    }
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (result(x, y) != reference(x, y)) {
+                printf("%s: result(%d, %d) = %d instead of %d\n",
+                       name, x, y, result(x, y), reference(x, y));
+                exit(1);
+            }
+        }
+    }
+
+    printf("%s: %d loads in innermost loops, %f ms without loop carry; "
+           "%d loads, %f ms with it (%.2fx)\n",
+           name, loads[0], times[0] * 1e3, loads[1], times[1] * 1e3, times[0] / times[1]);
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    const int w = 2048, h = 2048;
+    Buffer<uint16_t> input(w + 8, h + 8);
+    input.for_each_element([&](int x, int y) { input(x, y) = (uint16_t)((x * 7 + y * 13) & 0xfff); });
+
+    // The separable blur from apps/blur, tiled so that blur_y walks
+    // down the rows of each tile of blur_x.
+    run(
+        "Blur", [&]() {
+            Func blur_x, blur_y;
+            Var x, y, xo, yo, xi, yi;
+            blur_x(x, y) = (input(x, y) + input(x + 1, y) + input(x + 2, y)) / 3;
+            blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+            blur_y.tile(x, y, xo, yo, xi, yi, 128, 32)
+                .vectorize(xi, 16);
+            blur_x.compute_at(blur_y, xo)
+                .vectorize(x, 16);
+            return blur_y;
+        },
+        w, h, target);
+
+    // A chain of vertical stencils, as in apps/stencil_chain.
+    run(
+        "Stencil chain", [&]() {
+            const int stages = 4;
+            std::vector<Func> chain;
+            Var x, y, xo, yo, xi, yi;
+            Func first;
+            first(x, y) = input(x, y);
+            chain.push_back(first);
+            for (int s = 0; s < stages; s++) {
+                Func f;
+                Func prev = chain.back();
+                f(x, y) = (prev(x, y) + prev(x, y + 1) * 2 + prev(x, y + 2)) / 4;
+                chain.push_back(f);
+            }
+            Func out = chain.back();
+            out.tile(x, y, xo, yo, xi, yi, 128, 32)
+                .vectorize(xi, 16);
+            for (int s = 1; s < stages; s++) {
+                chain[s].compute_at(out, xo).vectorize(x, 16);
+            }
+            return out;
+        },
+        w, h, target);
+
+    printf("Success!\n");
+    return 0;
+}
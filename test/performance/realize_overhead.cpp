@@ -1,4 +1,5 @@
 #include "Halide.h"
+#include <array>
 #include <iostream>
 
 #include "halide_benchmark.h"
@@ -149,6 +150,46 @@ int main(int argc, char **argv) {
         std::cout << std::to_string(i) << "-argument Func realize to Buffer time " << t * 1e6 << "us.\n";
     }
 
+    {
+        // Many tiny requests, one Callable call each vs. one batched call.
+        const int batch = 256;
+        Func f;
+        Var x, y;
+        ImageParam in(UInt(8), 2);
+
+        f(x, y) = in(x, y) + 1;
+        Callable c = f.compile_to_callable({in});
+
+        std::vector<Buffer<uint8_t>> ins, outs;
+        for (int i = 0; i < batch; i++) {
+            ins.emplace_back(64, 64);
+            ins.back().fill(i);
+            outs.emplace_back(64, 64);
+        }
+
+        double t = benchmark([&]() {
+            for (int i = 0; i < batch; i++) {
+                c(ins[i], outs[i]);
+            }
+        });
+        std::cout << "64x64 Callable call time " << t * 1e6 / batch << "us.\n";
+
+        JITUserContext empty;
+        JITUserContext *context = &empty;
+        std::vector<std::array<const void *, 3>> argv_store(batch);
+        std::vector<const void *const *> argvs(batch);
+        for (int i = 0; i < batch; i++) {
+            argv_store[i] = {&context, ins[i].raw_buffer(), outs[i].raw_buffer()};
+            argvs[i] = argv_store[i].data();
+        }
+
+        t = benchmark([&]() { c.call_argv_batch(3, batch, argvs.data(), false); });
+        std::cout << "64x64 serial batched Callable call time " << t * 1e6 / batch << "us.\n";
+
+        t = benchmark([&]() { c.call_argv_batch(3, batch, argvs.data(), true); });
+        std::cout << "64x64 parallel batched Callable call time " << t * 1e6 / batch << "us.\n";
+    }
+
     std::cout << "Success!\n";
 
     return 0;
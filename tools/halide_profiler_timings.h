@@ -0,0 +1,55 @@
+#ifndef HALIDE_PROFILER_TIMINGS_H
+#define HALIDE_PROFILER_TIMINGS_H
+
+//---------------------------------------------------------------------------
+// Saves the time the runtime profiler has measured for each Func of each
+// pipeline compiled with -profile, so that deployed pipelines can provide
+// training data for an autoscheduler's cost model. Call
+//
+//   Halide::Tools::save_profiler_timings("timings.txt");
+//
+// before the profiler is reset or shut down. The file is text, with one
+// line per pipeline followed by one line per Func of that pipeline:
+//
+//   pipeline <runs> <total time in ns> <pipeline name>
+//   func <total time in ns> <func name>
+//
+// The first Func of each pipeline is the profiler's catch-all "overhead"
+// entry. Names come last because Func names for buffer copies contain
+// spaces. profile_to_sample joins these timings with the featurization an
+// autoscheduler emitted for the same pipeline.
+//---------------------------------------------------------------------------
+
+#include <cstdio>
+#include <string>
+
+#include "HalideRuntime.h"
+
+namespace Halide {
+namespace Tools {
+
+inline bool save_profiler_timings(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    halide_profiler_state *s = halide_profiler_get_state();
+    halide_profiler_lock(s);
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) {
+            continue;
+        }
+        fprintf(f, "pipeline %d %llu %s\n", p->runs, (unsigned long long)p->time, p->name);
+        for (int i = 0; i < p->num_funcs; i++) {
+            fprintf(f, "func %llu %s\n", (unsigned long long)p->funcs[i].time, p->funcs[i].name);
+        }
+    }
+    halide_profiler_unlock(s);
+    return fclose(f) == 0;
+}
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif  // HALIDE_PROFILER_TIMINGS_H